@@ -12,6 +12,8 @@ interface ListenOptions {
   idleTimeout?: number | string,
   congestionLimit?: number | string,
   bufferLimit?: number | string,
+  zeroCopyThreshold?: number | string,
+  batchSize?: number,
   keepAlive?: boolean,
   noDelay?: boolean,
   transparent?: boolean,
@@ -388,6 +390,10 @@ interface Configuration {
    *       Can be a number in bytes or a string with a unit suffix such as `'k'`, `'m'`, `'g'` and `'t'`.
    *   - _bufferLimit_ - Maximum size of data allowed to stay in output buffer as a result of insufficient outbound bandwidth.
    *       Can be a number in bytes or a string with a unit suffix such as `'k'`, `'m'`, `'g'` and `'t'`.
+   *   - _zeroCopyThreshold_ - Minimum size of buffered output to send with `MSG_ZEROCOPY` on Linux, or 0 to disable.
+   *       Can be a number in bytes or a string with a unit suffix such as `'k'`, `'m'`, `'g'` and `'t'`. Defaults to 0.
+   *   - _batchSize_ - Maximum number of UDP datagrams to receive or send in one system call on Linux, or 0 to disable batching.
+   *       Datagrams are also coalesced with GRO/GSO when supported by the kernel. Defaults to 0.
    *   - _retryCount_ - How many times it should retry connection after a failure, or -1 for the infinite retries. Defaults to 0.
    *   - _retryDelay_ - Time duration to wait between connection retries. Defaults to 0.
    *   - _connectTimeout_ - Timeout while connecting.
@@ -413,6 +419,8 @@ interface Configuration {
       bind?: string | (() => string),
       congestionLimit?: number | string,
       bufferLimit?: number | string,
+      zeroCopyThreshold?: number | string,
+      batchSize?: number,
       retryCount?: number,
       retryDelay?: number | string,
       connectTimeout?: number | string,
@@ -995,6 +1003,32 @@ interface Configuration {
    */
   link(pipelineLayoutName: string | (() => string)): Configuration;
 
+  /**
+   * Appends a _linkAsync_ filter to the current pipeline layout.
+   *
+   * A _linkAsync_ filter starts a sub-pipeline and streams events through it.
+   * A pipeline layout that is not a sub-pipeline of the current module is started
+   * on one of the worker threads, chosen by the given policy.
+   *
+   * - **INPUT** - Any types of _Events_ to stream into the sub-pipeline.
+   * - **OUTPUT** - _Events_ streaming out from the sub-pipeline.
+   * - **SUB-INPUT** - _Events_ streaming into the _linkAsync_ filter.
+   * - **SUB-OUTPUT** - Any types of _Events_.
+   *
+   * @param pipelineLayoutName The name of the sub-pipeline layout to link to, or a function that returns that.
+   * @param options Options including:
+   *   - _policy_ - How a worker is chosen, one of _"round-robin"_ (default), _"least-load"_, _"local-first"_ or _"hashing"_.
+   *   - _key_ - A function that returns the value to hash with, required by policy _"hashing"_.
+   * @returns The same _Configuration_ object.
+   */
+  linkAsync(
+    pipelineLayoutName: string | (() => string),
+    options?: {
+      policy?: 'round-robin' | 'least-load' | 'local-first' | 'hashing',
+      key?: () => any,
+    }
+  ): Configuration;
+
   /**
    * Appends a _loop_ filter to the current pipeline layout.
    *
@@ -1264,6 +1298,21 @@ interface Configuration {
    */
   replay(options?: { delay?: number | string | (() => number | string) }): Configuration;
 
+  /**
+   * Appends a _scanMessageBody_ filter to the current pipeline layout.
+   *
+   * A _scanMessageBody_ filter searches message bodies for a set of literals as they stream through,
+   * including matches that span over multiple _Data_ chunks, and calls back user scripts at the end of each message.
+   *
+   * - **INPUT** - Any types of _Events_.
+   * - **OUTPUT** - Same _Events_ as the input.
+   *
+   * @param matcher An _algo.MultiMatcher_ object with the patterns to search for, or a function that returns that.
+   * @param handler A callback function that receives an array of indices of the patterns found in a message body.
+   * @returns The same _Configuration_ object.
+   */
+  scanMessageBody(matcher: MultiMatcher | (() => MultiMatcher), handler: (found: number[]) => void): Configuration;
+
   /**
    * Appends a _serveHTTP_ filter to the current pipeline layout.
    *
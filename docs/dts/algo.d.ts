@@ -31,6 +31,11 @@ interface Cache {
    * Deletes all entries.
    */
   clear(): void;
+
+  /**
+   * Number of entries in the cache.
+   */
+  readonly size: number;
 }
 
 interface CacheConstructor {
@@ -44,8 +49,14 @@ interface CacheConstructor {
    *   It receives 2 parameters: the key and the value of the entry being deleted.
    * @param options Options including:
    *   - _size_ - Maximum number of entries allowed in the cache.
+   *   - _bytes_ - Maximum total size of the keys and values in the cache, counting strings and _Data_ by their lengths.
+   *       Can be a number or a string with one of the unit suffixes such as `'k'`, `'m'` and `'g'`.
    *   - _ttl_ - Time-to-live for the entries in the cache.
    *       Can be a number in seconds or a string with one of the time unit suffixes such as `'s'`, `'m'` and `'h'`.
+   *   - _policy_ - Eviction policy: `'lru'` (default), `'tinylfu'` or `'arc'`.
+   *   - _name_ - Name of the cache, used as the `cache` label of the hit, miss and eviction metrics.
+   *   - _shared_ - If true, the cache is shared by all threads that create a cache with the same _name_.
+   *       Keys are converted to strings, and the options of the first creator take effect.
    * @returns An empty _Cache_ object.
    */
   new(
@@ -53,7 +64,11 @@ interface CacheConstructor {
     onFree?: (key: any, value: any) => void,
     options?: {
       size?: number,
+      bytes?: number | string,
       ttl?: number | string,
+      policy?: 'lru' | 'tinylfu' | 'arc',
+      name?: string,
+      shared?: boolean,
     }
   ): Cache;
 }
@@ -117,9 +132,20 @@ interface QuotaConstructor {
 
 /**
  * Path-based routing algorithm.
+ *
+ * A route is written as `host/path`, where _host_ is optional and can start with `*.`
+ * to match any single leading label. Path segments starting with `:` match one segment
+ * and capture it by name, a `*` segment in the middle matches one segment without capturing,
+ * and a trailing `/*` matches the rest of the path. Static segments take precedence
+ * over parameters, and parameters over prefixes.
  */
 interface URLRouter {
 
+  /**
+   * Number of routes.
+   */
+  readonly size: number;
+
   /**
    * Appends a route.
    *
@@ -135,6 +161,15 @@ interface URLRouter {
    * @returns The value that the queried path maps to, or `undefined` if the path is not found.
    */
   find(...pathSegments: string[]): any;
+
+  /**
+   * Finds a route and captures its parameters.
+   *
+   * @param path A string containing a path to look up.
+   * @returns An object with the _value_ that the path maps to and the captured _params_,
+   *   or `undefined` if the path is not found.
+   */
+  match(path: string): { value: any, params: { [name: string]: string } } | undefined;
 }
 
 interface URLRouterConstructor {
@@ -148,6 +183,53 @@ interface URLRouterConstructor {
   new(routes: { [path: string]: any }): URLRouter;
 }
 
+/**
+ * Multi-pattern literal matching algorithm.
+ *
+ * All patterns are searched for in a single pass over the input, taking the same time
+ * no matter how many patterns there are. Matchers made from the same patterns share one
+ * compiled automaton across all worker threads.
+ */
+interface MultiMatcher {
+
+  /**
+   * Checks if any of the patterns occurs in the input.
+   *
+   * @param input A string or a _Data_ object to search in.
+   * @returns A boolean value indicating whether any pattern is found.
+   */
+  test(input: string | Data): boolean;
+
+  /**
+   * Finds the pattern that occurs first in the input.
+   *
+   * @param input A string or a _Data_ object to search in.
+   * @returns Index of the first found pattern, or -1 if none is found.
+   */
+  find(input: string | Data): number;
+
+  /**
+   * Finds all patterns that occur in the input.
+   *
+   * @param input A string or a _Data_ object to search in.
+   * @returns An array of indices of the found patterns, in the order they are first found.
+   */
+  findAll(input: string | Data): number[];
+}
+
+interface MultiMatcherConstructor {
+
+  /**
+   * Creates an instance of _MultiMatcher_.
+   *
+   * @param patterns An array of strings or _Data_ objects to search for.
+   * @param options Options including:
+   *   - _ignoreCase_ - Whether letters in ASCII are matched case-insensitively. Defaults to `false`.
+   * @returns A _MultiMatcher_ object searching for the given patterns.
+   */
+  new(patterns: (string | Data)[], options?: { ignoreCase?: boolean }): MultiMatcher;
+}
+
 /**
  * Load-balancer base class.
  */
@@ -171,12 +253,56 @@ interface LoadBalancerBase {
  */
 interface HashingLoadBalancer extends LoadBalancerBase {
 
+  /**
+   * Replaces all targets.
+   *
+   * @param targets An array of strings representing the targets, or an object of key-value pairs
+   *   where keys are the targets and values are the weights.
+   */
+  set(targets: string[] | { [id: string]: number }): void;
+
+  /**
+   * Adds a target or sets weight of a target.
+   *
+   * @param target A string representing the target to add or set weight for.
+   * @param weight A number as the weight of the target. Defaults to 1. A target with weight 0 is never selected.
+   */
+  set(target: string, weight?: number): void;
+
   /**
    * Adds a target.
    *
    * @param target A string representing the target to add in the target list.
+   * @param weight A number as the weight of the target. Defaults to 1.
+   */
+  add(target: string, weight?: number): void;
+}
+
+interface HashingLoadBalancerOptions {
+
+  /**
+   * How keys are mapped to targets:
+   *   - _"modulo"_ (default) - Hash modulo the number of targets, in the order as given.
+   *   - _"ring"_ - Consistent hashing on a ring with _replicas_ points per unit of weight.
+   *   - _"maglev"_ - Maglev hashing with a lookup table of _tableSize_ slots.
+   */
+  algorithm?: 'modulo' | 'ring' | 'maglev';
+
+  /**
+   * Number of points on the ring for each unit of weight in _"ring"_ mode.
    */
-  add(target: string): void;
+  replicas?: number;
+
+  /**
+   * Size of the lookup table in _"maglev"_ mode, rounded up to a prime.
+   */
+  tableSize?: number;
+
+  /**
+   * When present, no target takes more keys than _loadFactor_ times its weighted share
+   * of the current load, and keys go to the next target instead. Must be no less than 1.
+   */
+  loadFactor?: number;
 }
 
 interface HashingLoadBalancerConstructor {
@@ -184,11 +310,30 @@ interface HashingLoadBalancerConstructor {
   /**
    * Creates an instance of _HashingLoadBalancer_.
    *
-   * @param targets An array of strings. Each string represents a target.
+   * @param targets An array of strings representing the targets, or an object of key-value pairs
+   *   where keys are the targets and values are the weights.
    * @param unhealthy A _Cache_ object storing _unhealthy_ targets.
+   * @param options Options of the hashing algorithm.
+   * @returns A _HashingLoadBalancer_ object with the specified targets.
+   */
+  new(
+    targets: string[] | { [id: string]: number },
+    unhealthy?: Cache,
+    options?: HashingLoadBalancerOptions,
+  ): HashingLoadBalancer;
+
+  /**
+   * Creates an instance of _HashingLoadBalancer_.
+   *
+   * @param targets An array of strings representing the targets, or an object of key-value pairs
+   *   where keys are the targets and values are the weights.
+   * @param options Options of the hashing algorithm.
    * @returns A _HashingLoadBalancer_ object with the specified targets.
    */
-  new(targets: string[], unhealthy?: Cache): HashingLoadBalancer;
+  new(
+    targets: string[] | { [id: string]: number },
+    options?: HashingLoadBalancerOptions,
+  ): HashingLoadBalancer;
 }
 
 /**
@@ -325,6 +470,7 @@ interface Algo {
   Cache: CacheConstructor;
   Quota: QuotaConstructor;
   URLRouter: URLRouterConstructor;
+  MultiMatcher: MultiMatcherConstructor;
   HashingLoadBalancer: HashingLoadBalancerConstructor;
   RoundRobinLoadBalancer: RoundRobinLoadBalancerConstructor;
   LeastWorkLoadBalancer: LeastWorkLoadBalancerConstructor;
@@ -0,0 +1,243 @@
+/*
+ *  Copyright (c) 2019 by flomesh.io
+ *
+ *  Unless prior written consent has been obtained from the copyright
+ *  owner, the following shall not be allowed.
+ *
+ *  1. The distribution of any source codes, header files, make files,
+ *     or libraries of the software.
+ *
+ *  2. Disclosure of any source codes pertaining to the software to any
+ *     additional parties.
+ *
+ *  3. Alteration or removal of any notices in or on the software or
+ *     within the documentation included within the software.
+ *
+ *  ALL SOURCE CODE AS WELL AS ALL DOCUMENTATION INCLUDED WITH THIS
+ *  SOFTWARE IS PROVIDED IN AN “AS IS” CONDITION, WITHOUT WARRANTY OF ANY
+ *  KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ *  CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ *  TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ *  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "aho-corasick.hpp"
+
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+namespace pipy {
+
+//
+// Aho-Corasick Algorithm
+//
+// Patterns are first put into a trie. Then, walking the trie breadth-first,
+// each state gets a failure link to the state of its longest proper suffix
+// that is also in the trie, and missing transitions are filled in with the
+// transitions of that suffix state. The result is a DFA that never has to
+// step back in the input.
+//
+// A state can complete more than one pattern: the one spelled by its own
+// path, plus all those spelled by its suffixes. The latter are found by
+// following dictionary suffix links, which skip the suffix states that
+// complete nothing.
+//
+
+std::map<std::string, AhoCorasick*> AhoCorasick::s_cache;
+std::mutex AhoCorasick::s_cache_mutex;
+
+auto AhoCorasick::make(const std::vector<std::string> &patterns, bool ignore_case) -> pjs::Ref<AhoCorasick> {
+  std::string key(ignore_case ? "i" : "-");
+  for (const auto &p : patterns) {
+    key += std::to_string(p.length());
+    key += ':';
+    key += p;
+  }
+
+  std::lock_guard<std::mutex> lock(s_cache_mutex);
+  auto i = s_cache.find(key);
+  if (i != s_cache.end()) {
+    // Only revive an automaton that is not already on its way out
+    auto *ac = i->second;
+    auto n = ac->m_refs.load(std::memory_order_relaxed);
+    while (n > 0) {
+      if (ac->m_refs.compare_exchange_weak(n, n + 1, std::memory_order_acquire)) {
+        pjs::Ref<AhoCorasick> ref(ac);
+        ac->m_refs.fetch_sub(1, std::memory_order_relaxed);
+        return ref;
+      }
+    }
+  }
+
+  auto *ac = new AhoCorasick(patterns, ignore_case);
+  ac->m_key = key;
+  s_cache[key] = ac;
+  return ac;
+}
+
+void AhoCorasick::release() {
+  if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    {
+      std::lock_guard<std::mutex> lock(s_cache_mutex);
+      auto i = s_cache.find(m_key);
+      if (i != s_cache.end() && i->second == this) s_cache.erase(i);
+    }
+    delete this;
+  }
+}
+
+AhoCorasick::AhoCorasick(const std::vector<std::string> &patterns, bool ignore_case)
+  : m_refs(0)
+  , m_patterns(patterns)
+{
+  // Bytes that don't appear in any pattern all fall into class 0
+  std::memset(m_classes, 0, sizeof(m_classes));
+  for (const auto &p : patterns) {
+    if (p.empty()) throw std::runtime_error("empty pattern");
+    for (auto c : p) {
+      auto b = (uint8_t)c;
+      if (ignore_case) b = std::tolower(b);
+      if (!m_classes[b]) m_classes[b] = m_class_count++;
+    }
+  }
+  if (ignore_case) {
+    for (int c = 'a'; c <= 'z'; c++) {
+      m_classes[std::toupper(c)] = m_classes[c];
+    }
+  }
+
+  // Build the trie
+  auto cc = m_class_count;
+  m_next.assign(cc, -1);
+  m_output.push_back(-1);
+  m_same.assign(patterns.size(), -1);
+  for (size_t i = 0; i < patterns.size(); i++) {
+    int s = 0;
+    for (auto c : patterns[i]) {
+      auto k = m_classes[(uint8_t)c];
+      auto t = m_next[s * cc + k];
+      if (t < 0) {
+        t = m_output.size();
+        m_next[s * cc + k] = t;
+        m_next.resize(m_next.size() + cc, -1);
+        m_output.push_back(-1);
+      }
+      s = t;
+    }
+    auto &out = m_output[s];
+    if (out < 0) {
+      out = i;
+    } else {
+      auto j = out;
+      while (m_same[j] >= 0) j = m_same[j];
+      m_same[j] = i;
+    }
+  }
+
+  // Fill in failure transitions breadth-first
+  auto n = m_output.size();
+  std::vector<int> fail(n, 0);
+  std::vector<int> queue;
+  queue.reserve(n);
+  m_suffix.assign(n, -1);
+  for (int k = 0; k < cc; k++) {
+    auto &t = m_next[k];
+    if (t < 0) {
+      t = 0;
+    } else {
+      queue.push_back(t);
+    }
+  }
+  for (size_t i = 0; i < queue.size(); i++) {
+    auto s = queue[i];
+    auto f = fail[s];
+    m_suffix[s] = (m_output[f] >= 0 ? f : m_suffix[f]);
+    for (int k = 0; k < cc; k++) {
+      auto &t = m_next[s * cc + k];
+      if (t < 0) {
+        t = m_next[f * cc + k];
+      } else {
+        fail[t] = m_next[f * cc + k];
+        queue.push_back(t);
+      }
+    }
+  }
+
+  m_report.resize(n);
+  for (size_t s = 0; s < n; s++) {
+    m_report[s] = (m_output[s] >= 0 ? s : m_suffix[s]);
+  }
+
+  // Bytes that can leave the root state
+  int first_count = 0;
+  for (int c = 0; c < 256; c++) {
+    auto k = m_classes[c];
+    m_first_bytes[c] = (k > 0 && m_next[k] > 0);
+    if (m_first_bytes[c]) {
+      m_first_byte = c;
+      first_count++;
+    }
+  }
+  if (first_count != 1) m_first_byte = -1;
+}
+
+auto AhoCorasick::skip(const char *data, size_t size, size_t i) const -> size_t {
+  if (m_first_byte >= 0) {
+    auto p = (const char *)std::memchr(data + i, m_first_byte, size - i);
+    return p ? p - data : size;
+  }
+  while (i < size && !m_first_bytes[(uint8_t)data[i]]) i++;
+  return i;
+}
+
+bool AhoCorasick::report(int state, size_t offset, const Scanner::Callback &cb) const {
+  for (auto s = m_report[state]; s >= 0; s = m_suffix[s]) {
+    for (auto i = m_output[s]; i >= 0; i = m_same[i]) {
+      if (!cb(i, offset)) return false;
+    }
+  }
+  return true;
+}
+
+//
+// AhoCorasick::Scanner
+//
+
+bool AhoCorasick::Scanner::input(const char *data, size_t size, const Callback &cb) {
+  const auto *ac = m_ac.get();
+  const auto *next = ac->m_next.data();
+  const auto *report = ac->m_report.data();
+  const auto *classes = ac->m_classes;
+  auto cc = ac->m_class_count;
+  auto s = m_state;
+  size_t i = 0;
+  while (i < size) {
+    if (!s) {
+      i = ac->skip(data, size, i);
+      if (i >= size) break;
+    }
+    s = next[s * cc + classes[(uint8_t)data[i++]]];
+    if (report[s] >= 0 && !ac->report(s, m_offset + i, cb)) {
+      m_state = s;
+      m_offset += i;
+      return false;
+    }
+  }
+  m_state = s;
+  m_offset += size;
+  return true;
+}
+
+bool AhoCorasick::Scanner::input(const Data &data, const Callback &cb) {
+  for (const auto c : data.chunks()) {
+    auto ptr = std::get<0>(c);
+    auto len = std::get<1>(c);
+    if (!input(ptr, len, cb)) return false;
+  }
+  return true;
+}
+
+} // namespace pipy
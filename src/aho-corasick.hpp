@@ -0,0 +1,114 @@
+/*
+ *  Copyright (c) 2019 by flomesh.io
+ *
+ *  Unless prior written consent has been obtained from the copyright
+ *  owner, the following shall not be allowed.
+ *
+ *  1. The distribution of any source codes, header files, make files,
+ *     or libraries of the software.
+ *
+ *  2. Disclosure of any source codes pertaining to the software to any
+ *     additional parties.
+ *
+ *  3. Alteration or removal of any notices in or on the software or
+ *     within the documentation included within the software.
+ *
+ *  ALL SOURCE CODE AS WELL AS ALL DOCUMENTATION INCLUDED WITH THIS
+ *  SOFTWARE IS PROVIDED IN AN “AS IS” CONDITION, WITHOUT WARRANTY OF ANY
+ *  KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ *  CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ *  TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ *  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef AHO_CORASICK_HPP
+#define AHO_CORASICK_HPP
+
+#include "data.hpp"
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace pipy {
+
+//
+// AhoCorasick
+//
+// Finds any of a set of literals in one pass over the input. The trie is
+// completed into a DFA over classes of equivalent bytes, so each input
+// byte costs one table lookup regardless of how many patterns there are.
+// An automaton is immutable once built and can be shared among threads.
+// Identical pattern sets are compiled only once for the whole process.
+//
+
+class AhoCorasick {
+public:
+  static auto make(const std::vector<std::string> &patterns, bool ignore_case = false) -> pjs::Ref<AhoCorasick>;
+
+  void retain() { m_refs.fetch_add(1, std::memory_order_relaxed); }
+  void release();
+
+  auto pattern_count() const -> int { return m_patterns.size(); }
+  auto pattern(int i) const -> const std::string& { return m_patterns[i]; }
+
+  //
+  // AhoCorasick::Scanner
+  //
+  // Keeps the automaton state between inputs, so that matches spanning
+  // over multiple chunks are found the same as in a contiguous input.
+  // The callback receives the index of the matched pattern and the
+  // offset right after the match, and returns false to stop scanning.
+  //
+
+  class Scanner : public pjs::Pooled<Scanner> {
+  public:
+    typedef std::function<bool(int, size_t)> Callback;
+
+    Scanner(AhoCorasick *ac) : m_ac(ac) {}
+
+    auto automaton() const -> AhoCorasick* { return m_ac; }
+    auto offset() const -> size_t { return m_offset; }
+
+    bool input(const char *data, size_t size, const Callback &cb);
+    bool input(const Data &data, const Callback &cb);
+    void reset() { m_state = 0; m_offset = 0; }
+
+  private:
+    pjs::Ref<AhoCorasick> m_ac;
+    int m_state = 0;
+    size_t m_offset = 0;
+  };
+
+private:
+  AhoCorasick(const std::vector<std::string> &patterns, bool ignore_case);
+  ~AhoCorasick() {}
+
+  std::atomic<int> m_refs;
+  std::string m_key;
+  std::vector<std::string> m_patterns;
+  std::vector<int> m_next;
+  std::vector<int> m_output;
+  std::vector<int> m_report;
+  std::vector<int> m_suffix;
+  std::vector<int> m_same;
+  uint16_t m_classes[256];
+  bool m_first_bytes[256];
+  int m_first_byte = -1;
+  int m_class_count = 1;
+
+  auto skip(const char *data, size_t size, size_t i) const -> size_t;
+  bool report(int state, size_t offset, const Scanner::Callback &cb) const;
+
+  static std::map<std::string, AhoCorasick*> s_cache;
+  static std::mutex s_cache_mutex;
+};
+
+} // namespace pipy
+
+#endif // AHO_CORASICK_HPP
@@ -24,12 +24,17 @@
  */
 
 #include "algo.hpp"
+#include "stats.hpp"
+#include "data.hpp"
 #include "context.hpp"
 #include "utils.hpp"
 #include "log.hpp"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <limits>
+#include <thread>
 
 namespace pipy {
 namespace algo {
@@ -52,9 +57,557 @@ Cache::Options::Options(pjs::Object *options) {
   Value(options, "size")
     .get(size)
     .check_nullable();
+  Value(options, "bytes")
+    .get_binary_size(bytes)
+    .check_nullable();
   Value(options, "ttl")
     .get_seconds(ttl)
     .check_nullable();
+  Value(options, "policy")
+    .get_enum(policy)
+    .check_nullable();
+  Value(options, "name")
+    .get(name)
+    .check_nullable();
+  Value(options, "shared")
+    .get(shared)
+    .check_nullable();
+}
+
+//
+// FrequencySketch
+//
+// A count-min sketch of 4-bit counters in 4 rows, used by TinyLFU to
+// estimate how often a key has been seen recently. All counters are
+// halved after a number of increments proportional to the width, so
+// that old popularity fades away.
+//
+
+class FrequencySketch {
+public:
+  void resize(size_t n) {
+    size_t width = 64;
+    while (width < n && width < MAX_WIDTH) width <<= 1;
+    m_mask = width - 1;
+    m_counters.assign(width * ROWS, 0);
+    m_additions = 0;
+    m_sample_size = width * 10;
+  }
+
+  auto width() const -> size_t { return m_mask + 1; }
+
+  void increment(size_t hash) {
+    if (m_counters.empty()) return;
+    auto h = spread(hash);
+    for (int i = 0; i < ROWS; i++) {
+      auto &c = m_counters[index_of(h, i)];
+      if (c < 15) c++;
+    }
+    if (++m_additions >= m_sample_size) {
+      for (auto &c : m_counters) c >>= 1;
+      m_additions /= 2;
+    }
+  }
+
+  auto frequency(size_t hash) const -> int {
+    if (m_counters.empty()) return 0;
+    auto h = spread(hash);
+    int f = 15;
+    for (int i = 0; i < ROWS; i++) {
+      f = std::min(f, int(m_counters[index_of(h, i)]));
+    }
+    return f;
+  }
+
+private:
+  enum { ROWS = 4, MAX_WIDTH = 1 << 22 };
+
+  std::vector<uint8_t> m_counters;
+  size_t m_mask = 0;
+  size_t m_additions = 0;
+  size_t m_sample_size = 0;
+
+  static auto spread(size_t hash) -> uint64_t {
+    uint64_t h = hash;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+  }
+
+  auto index_of(uint64_t h, int row) const -> size_t {
+    static const uint64_t seeds[ROWS] = {
+      0x9e3779b97f4a7c15ull,
+      0xc2b2ae3d27d4eb4full,
+      0x165667b19e3779f9ull,
+      0xd6e8feb86659fd93ull,
+    };
+    return (((h * seeds[row]) >> 40) & m_mask) * ROWS + row;
+  }
+};
+
+//
+// Cache::Store
+//
+// Entries sit in up to 4 intrusive lists, ordered from the least to
+// the most recently used. What the lists mean depends on the policy:
+//
+//   LRU      - 0: all entries
+//   TINY_LFU - 0: window, 1: probation, 2: protected
+//   ARC      - 0: T1 (seen once), 1: T2 (seen more than once),
+//              2: B1 and 3: B2 (keys recently evicted from T1 and T2)
+//
+// Capacities are counted in bytes when there is a byte budget, or in
+// entries otherwise. Without either limit, every policy is just LRU.
+//
+
+template<class K, class V, class Hash, class EqualTo>
+class Cache::Store {
+public:
+  struct Entry : public List<Entry>::Item {
+    K key;
+    V value;
+    double expiration = 0;
+    size_t weight = 0;
+    int list = 0;
+  };
+
+  typedef std::vector<std::pair<K, V>> Evicted;
+
+  Store(Policy policy, size_t max_count, size_t max_bytes)
+    : m_policy(policy)
+    , m_max_count(max_count)
+    , m_max_bytes(max_bytes)
+    , m_capacity(max_bytes > 0 ? max_bytes : max_count)
+  {
+    if (!m_capacity) m_policy = LRU;
+    if (m_policy == TINY_LFU) {
+      m_window_max = std::max<size_t>(m_capacity / 100, 1);
+      m_protected_max = (m_capacity - std::min(m_window_max, m_capacity)) * 8 / 10;
+      m_sketch.resize(max_count > 0 ? max_count : max_bytes / 256);
+    }
+  }
+
+  ~Store() {
+    for (const auto &p : m_map) delete p.second;
+  }
+
+  auto count() const -> size_t { return m_count; }
+
+  auto find(const K &key) -> Entry* {
+    if (m_policy == TINY_LFU) m_sketch.increment(m_hash(key));
+    auto i = m_map.find(key);
+    if (i == m_map.end()) return nullptr;
+    auto e = i->second;
+    if (is_ghost(e)) return nullptr;
+    return e;
+  }
+
+  void access(Entry *e) {
+    switch (m_policy) {
+      case LRU:
+        move(e, e->list);
+        break;
+      case TINY_LFU:
+        if (e->list == PROBATION) {
+          move(e, PROTECTED);
+          while (m_costs[PROTECTED] > m_protected_max && m_lists[PROTECTED].size() > 1) {
+            move(m_lists[PROTECTED].head(), PROBATION);
+          }
+        } else {
+          move(e, e->list);
+        }
+        break;
+      case ARC:
+        move(e, T2);
+        break;
+    }
+  }
+
+  void set(const K &key, const V &value, size_t weight, double expiration, Evicted &evicted) {
+    auto &slot = m_map[key];
+    auto e = slot;
+    auto from_b2 = false;
+
+    if (e && !is_ghost(e)) {
+      unlink(e);
+      m_bytes -= e->weight;
+      e->value = value;
+      e->weight = weight;
+      e->expiration = expiration;
+      m_bytes += weight;
+      link(e, e->list);
+      evict(evicted, false);
+      return;
+    }
+
+    auto list = 0;
+    if (e) {
+      auto b1 = m_costs[B1], b2 = m_costs[B2];
+      auto ghost_list = e->list;
+      unlink(e);
+      e->weight = weight;
+      auto c = cost(e);
+      if (ghost_list == B1) {
+        auto delta = std::max<size_t>(b2 / std::max<size_t>(b1, 1), 1) * c;
+        m_arc_p = std::min(m_capacity, m_arc_p + delta);
+      } else {
+        auto delta = std::max<size_t>(b1 / std::max<size_t>(b2, 1), 1) * c;
+        m_arc_p = (m_arc_p > delta ? m_arc_p - delta : 0);
+        from_b2 = true;
+      }
+      list = T2;
+    } else {
+      slot = e = new Entry;
+      e->key = key;
+      e->weight = weight;
+    }
+
+    e->value = value;
+    e->expiration = expiration;
+    link(e, list);
+    m_count++;
+    m_bytes += weight;
+
+    if (m_policy == TINY_LFU && m_count > m_sketch.width()) {
+      m_sketch.resize(m_count * 2);
+    }
+
+    evict(evicted, from_b2);
+  }
+
+  bool erase(const K &key, V *value) {
+    auto i = m_map.find(key);
+    if (i == m_map.end()) return false;
+    auto e = i->second;
+    if (is_ghost(e)) return false;
+    if (value) *value = e->value;
+    remove(e);
+    return true;
+  }
+
+  void remove(Entry *e) {
+    unlink(e);
+    if (!is_ghost(e)) {
+      m_count--;
+      m_bytes -= e->weight;
+    }
+    m_map.erase(e->key);
+    delete e;
+  }
+
+  void clear(Evicted *evicted) {
+    for (const auto &p : m_map) {
+      auto e = p.second;
+      if (evicted && !is_ghost(e)) evicted->emplace_back(e->key, e->value);
+      delete e;
+    }
+    m_map.clear();
+    for (int i = 0; i < LIST_COUNT; i++) {
+      m_lists[i].clear();
+      m_costs[i] = 0;
+    }
+    m_count = 0;
+    m_bytes = 0;
+    m_arc_p = 0;
+  }
+
+private:
+  enum {
+    WINDOW = 0, PROBATION = 1, PROTECTED = 2,
+    T1 = 0, T2 = 1, B1 = 2, B2 = 3,
+    LIST_COUNT = 4,
+  };
+
+  Policy m_policy;
+  size_t m_max_count;
+  size_t m_max_bytes;
+  size_t m_capacity;
+  size_t m_count = 0;
+  size_t m_bytes = 0;
+  size_t m_window_max = 0;
+  size_t m_protected_max = 0;
+  size_t m_arc_p = 0;
+  std::unordered_map<K, Entry*, Hash, EqualTo> m_map;
+  List<Entry> m_lists[LIST_COUNT];
+  size_t m_costs[LIST_COUNT] = { 0 };
+  FrequencySketch m_sketch;
+  Hash m_hash;
+
+  bool is_ghost(Entry *e) const {
+    return m_policy == ARC && e->list >= B1;
+  }
+
+  bool is_over() const {
+    return (
+      (m_max_count > 0 && m_count > m_max_count) ||
+      (m_max_bytes > 0 && m_bytes > m_max_bytes)
+    );
+  }
+
+  auto cost(Entry *e) const -> size_t {
+    return m_max_bytes > 0 ? e->weight : 1;
+  }
+
+  void link(Entry *e, int list) {
+    e->list = list;
+    m_lists[list].push(e);
+    m_costs[list] += cost(e);
+  }
+
+  void unlink(Entry *e) {
+    m_lists[e->list].remove(e);
+    m_costs[e->list] -= cost(e);
+  }
+
+  void move(Entry *e, int list) {
+    unlink(e);
+    link(e, list);
+  }
+
+  void evict(Entry *e, Evicted &evicted) {
+    evicted.emplace_back(e->key, e->value);
+    remove(e);
+  }
+
+  void evict(Evicted &evicted, bool from_b2) {
+    switch (m_policy) {
+      case LRU:
+        while (is_over() && !m_lists[0].empty()) {
+          evict(m_lists[0].head(), evicted);
+        }
+        break;
+      case TINY_LFU: evict_tiny_lfu(evicted); break;
+      case ARC: evict_arc(evicted, from_b2); break;
+    }
+  }
+
+  //
+  // Entries overflowing the window become candidates at the tail of
+  // probation. A candidate only stays if it has been seen more often
+  // than the victim at the head of probation.
+  //
+
+  void evict_tiny_lfu(Evicted &evicted) {
+    size_t candidates = 0;
+    while (m_costs[WINDOW] > m_window_max && !m_lists[WINDOW].empty()) {
+      move(m_lists[WINDOW].head(), PROBATION);
+      candidates++;
+    }
+    while (is_over()) {
+      auto victim = m_lists[PROBATION].head();
+      if (!victim) victim = m_lists[PROTECTED].head();
+      if (!victim) victim = m_lists[WINDOW].head();
+      if (!victim) break;
+      if (candidates > 0 && victim->list == PROBATION) {
+        auto candidate = m_lists[PROBATION].tail();
+        if (candidate != victim) {
+          auto f1 = m_sketch.frequency(m_hash(candidate->key));
+          auto f2 = m_sketch.frequency(m_hash(victim->key));
+          if (f1 > f2) {
+            evict(victim, evicted);
+          } else {
+            evict(candidate, evicted);
+            candidates--;
+          }
+          continue;
+        }
+        candidates--;
+      }
+      evict(victim, evicted);
+    }
+  }
+
+  //
+  // Evicted entries leave their keys in B1 or B2. A miss on such a key
+  // moves the target size of T1 towards recency or frequency.
+  //
+
+  void evict_arc(Evicted &evicted, bool from_b2) {
+    while (is_over()) {
+      auto &t1 = m_lists[T1];
+      auto &t2 = m_lists[T2];
+      if (t1.empty() && t2.empty()) break;
+      auto from_t1 = !t1.empty() && (
+        t2.empty() ||
+        m_costs[T1] > m_arc_p ||
+        (from_b2 && m_costs[T1] == m_arc_p)
+      );
+      auto e = from_t1 ? t1.head() : t2.head();
+      evicted.emplace_back(e->key, e->value);
+      unlink(e);
+      m_count--;
+      m_bytes -= e->weight;
+      e->value = V();
+      link(e, from_t1 ? B1 : B2);
+    }
+    while (m_costs[T1] + m_costs[B1] > m_capacity && !m_lists[B1].empty()) {
+      remove(m_lists[B1].head());
+    }
+    while (
+      m_costs[T1] + m_costs[T2] + m_costs[B1] + m_costs[B2] > 2 * m_capacity &&
+      !m_lists[B2].empty()
+    ) {
+      remove(m_lists[B2].head());
+    }
+  }
+};
+
+//
+// Cache::SharedStore
+//
+// Entries are spread over segments by their key hashes, each being a
+// Store of shared values under its own mutex. Every lookup updates the
+// policy state, so a plain mutex is used rather than a reader lock.
+//
+
+class Cache::SharedStore : public pjs::RefCountMT<SharedStore> {
+public:
+  static auto get(const std::string &name, const Options &options) -> SharedStore*;
+
+  auto size() -> size_t;
+  bool get(pjs::Str *key, pjs::Value &value, double now);
+  void set(pjs::Str *key, const pjs::Value &value, size_t weight, double expiration, Cache::Evicted &evicted);
+  bool erase(pjs::Str *key, pjs::Value &value);
+  void clear(Cache::Evicted *evicted);
+
+private:
+  enum { SEGMENT_COUNT = 16 };
+
+  typedef pjs::Ref<pjs::Str::CharData> Key;
+
+  struct Hash {
+    size_t operator()(const Key &k) const {
+      return k->hash();
+    }
+  };
+
+  struct EqualTo {
+    bool operator()(const Key &a, const Key &b) const {
+      return a == b || a->str() == b->str();
+    }
+  };
+
+  typedef Store<Key, pjs::SharedValue, Hash, EqualTo> Segment;
+
+  SharedStore(const Options &options);
+  ~SharedStore();
+
+  std::mutex m_mutexes[SEGMENT_COUNT];
+  Segment* m_segments[SEGMENT_COUNT];
+  int m_segment_count;
+
+  auto segment_of(pjs::Str::CharData *key) -> int {
+    return (key->hash() >> 8) % m_segment_count;
+  }
+
+  static std::map<std::string, SharedStore*> s_stores;
+  static std::mutex s_stores_mutex;
+
+  friend class pjs::RefCountMT<SharedStore>;
+};
+
+std::map<std::string, Cache::SharedStore*> Cache::SharedStore::s_stores;
+std::mutex Cache::SharedStore::s_stores_mutex;
+
+auto Cache::SharedStore::get(const std::string &name, const Options &options) -> SharedStore* {
+  std::lock_guard<std::mutex> lock(s_stores_mutex);
+  auto &p = s_stores[name];
+  if (!p) {
+    p = new SharedStore(options);
+    p->retain();
+  }
+  return p;
+}
+
+Cache::SharedStore::SharedStore(const Options &options)
+  : m_segment_count(options.size > 0 && options.size < 256 ? 1 : SEGMENT_COUNT)
+{
+  size_t max_count = std::max(options.size, 0);
+  size_t max_bytes = options.bytes;
+  max_count = (max_count + m_segment_count - 1) / m_segment_count;
+  max_bytes = (max_bytes + m_segment_count - 1) / m_segment_count;
+  for (int i = 0; i < m_segment_count; i++) {
+    m_segments[i] = new Segment(options.policy, max_count, max_bytes);
+  }
+}
+
+Cache::SharedStore::~SharedStore() {
+  for (int i = 0; i < m_segment_count; i++) {
+    delete m_segments[i];
+  }
+}
+
+auto Cache::SharedStore::size() -> size_t {
+  size_t n = 0;
+  for (int i = 0; i < m_segment_count; i++) {
+    std::lock_guard<std::mutex> lock(m_mutexes[i]);
+    n += m_segments[i]->count();
+  }
+  return n;
+}
+
+bool Cache::SharedStore::get(pjs::Str *key, pjs::Value &value, double now) {
+  Key k(key->data());
+  pjs::SharedValue sv;
+  auto i = segment_of(k);
+  {
+    std::lock_guard<std::mutex> lock(m_mutexes[i]);
+    auto segment = m_segments[i];
+    auto e = segment->find(k);
+    if (!e) return false;
+    if (e->expiration > 0 && now >= e->expiration) {
+      segment->remove(e);
+      return false;
+    }
+    segment->access(e);
+    sv = e->value;
+  }
+  sv.to_value(value);
+  return true;
+}
+
+void Cache::SharedStore::set(pjs::Str *key, const pjs::Value &value, size_t weight, double expiration, Cache::Evicted &evicted) {
+  Key k(key->data());
+  pjs::SharedValue sv(value);
+  Segment::Evicted list;
+  auto i = segment_of(k);
+  {
+    std::lock_guard<std::mutex> lock(m_mutexes[i]);
+    m_segments[i]->set(k, sv, weight, expiration, list);
+  }
+  for (const auto &p : list) {
+    pjs::Value v;
+    p.second.to_value(v);
+    evicted.emplace_back(pjs::Str::make(p.first), v);
+  }
+}
+
+bool Cache::SharedStore::erase(pjs::Str *key, pjs::Value &value) {
+  Key k(key->data());
+  pjs::SharedValue sv;
+  auto i = segment_of(k);
+  {
+    std::lock_guard<std::mutex> lock(m_mutexes[i]);
+    if (!m_segments[i]->erase(k, &sv)) return false;
+  }
+  sv.to_value(value);
+  return true;
+}
+
+void Cache::SharedStore::clear(Cache::Evicted *evicted) {
+  for (int i = 0; i < m_segment_count; i++) {
+    Segment::Evicted list;
+    {
+      std::lock_guard<std::mutex> lock(m_mutexes[i]);
+      m_segments[i]->clear(evicted ? &list : nullptr);
+    }
+    for (const auto &p : list) {
+      pjs::Value v;
+      p.second.to_value(v);
+      evicted->emplace_back(pjs::Str::make(p.first), v);
+    }
+  }
 }
 
 //
@@ -65,13 +618,23 @@ Cache::Cache(const Options &options, pjs::Function *allocate, pjs::Function *fre
   : m_options(options)
   , m_allocate(allocate)
   , m_free(free)
-  , m_cache(pjs::OrderedHash<pjs::Value, Entry>::make())
+  , m_name(options.name ? options.name.get() : pjs::Str::empty.get())
 {
   m_options.ttl *= 1000;
+  if (m_options.shared) {
+    if (!m_options.name) throw std::runtime_error("a shared cache requires a name");
+    m_shared = SharedStore::get(m_options.name->str(), m_options);
+  } else {
+    m_store = new LocalStore(m_options.policy, std::max(m_options.size, 0), m_options.bytes);
+  }
+  init_metrics();
+  all().push(this);
 }
 
 Cache::~Cache()
 {
+  all().remove(this);
+  delete m_store;
 }
 
 bool Cache::get(pjs::Context &ctx, const pjs::Value &key, pjs::Value &value) {
@@ -82,26 +645,17 @@ bool Cache::get(pjs::Context &ctx, const pjs::Value &key, pjs::Value &value) {
       pjs::Value arg(key);
       (*m_allocate)(ctx, 1, &arg, value);
       return ctx.ok();
-    }
+    },
+    free_func(ctx)
   );
 }
 
 void Cache::set(pjs::Context &ctx, const pjs::Value &key, const pjs::Value &value) {
-  set(
-    key, value,
-    [&](const pjs::Value &key, const pjs::Value &value) {
-      if (!m_free) return true;
-      pjs::Value argv[2], ret;
-      argv[0] = key;
-      argv[1] = value;
-      (*m_free)(ctx, 2, argv, ret);
-      return ctx.ok();
-    }
-  );
+  set(key, value, free_func(ctx));
 }
 
 bool Cache::get(const pjs::Value &key, pjs::Value &value) {
-  return get(key, value, nullptr);
+  return get(key, value, nullptr, nullptr);
 }
 
 void Cache::set(const pjs::Value &key, const pjs::Value &value) {
@@ -114,117 +668,176 @@ bool Cache::has(const pjs::Value &key) {
 }
 
 bool Cache::find(const pjs::Value &key, pjs::Value &value) {
-  Entry entry;
-  bool found = m_cache->use(key, entry);
-  if (!found) return false;
-  if (m_options.ttl > 0) {
-    auto now = utils::now();
-    if (now >= entry.ttl) {
-      m_cache->erase(key);
-      return false;
-    }
-  }
-  value = entry.value;
-  return true;
+  return lookup(key, value, now());
 }
 
 bool Cache::remove(const pjs::Value &key) {
-  return m_cache->erase(key);
+  pjs::Value value;
+  return erase(key, value);
 }
 
 bool Cache::remove(pjs::Context &ctx, const pjs::Value &key) {
+  pjs::Value value;
+  if (!erase(key, value)) return false;
   if (m_free) {
-    Entry entry;
-    auto found = m_cache->get(key, entry);
-    if (found) {
-      if (m_options.ttl > 0) {
-        auto now = utils::now();
-        if (now >= entry.ttl) found = false;
-      }
-      pjs::Value argv[2], ret;
-      argv[0] = key;
-      argv[1] = entry.value;
-      (*m_free)(ctx, 2, argv, ret);
-      m_cache->erase(key);
-    }
-    return found;
-  } else {
-    return m_cache->erase(key);
+    pjs::Value argv[2], ret;
+    argv[0] = key;
+    argv[1] = value;
+    (*m_free)(ctx, 2, argv, ret);
   }
+  return true;
 }
 
 bool Cache::clear(pjs::Context &ctx) {
-  if (m_free) {
-    pjs::OrderedHash<pjs::Value, Entry>::Iterator it(m_cache);
-    while (auto *p = it.next()) {
-      pjs::Value argv[2], ret;
-      argv[0] = p->k;
-      argv[1] = p->v.value;
-      (*m_free)(ctx, 2, argv, ret);
-      if (!ctx.ok()) return false;
-    }
+  Evicted evicted;
+  auto list = (m_free ? &evicted : nullptr);
+  if (m_shared) {
+    m_shared->clear(list);
+  } else {
+    LocalStore::Evicted local;
+    m_store->clear(list ? &local : nullptr);
+    for (const auto &p : local) evicted.emplace_back(p.first, p.second);
+  }
+  for (const auto &p : evicted) {
+    pjs::Value argv[2], ret;
+    argv[0] = p.first;
+    argv[1] = p.second;
+    (*m_free)(ctx, 2, argv, ret);
+    if (!ctx.ok()) return false;
   }
-  m_cache->clear();
   return true;
 }
 
+auto Cache::size() -> size_t {
+  return m_shared ? m_shared->size() : m_store->count();
+}
+
 bool Cache::get(
   const pjs::Value &key, pjs::Value &value,
-  const std::function<bool(pjs::Value &)> &allocate
+  const std::function<bool(pjs::Value &)> &allocate,
+  const FreeFunc &free
 ) {
-  auto now = (m_options.ttl > 0 ? utils::now() : 0);
-  Entry entry;
-  bool found = m_cache->use(key, entry);
-  if (found) {
-    if (m_options.ttl > 0) {
-      if (now >= entry.ttl) {
-        found = false;
-      }
-    }
-  }
-  if (!found) {
-    if (!allocate) return false;
-    if (!allocate(value)) return false;
-    entry.value = value;
-    entry.ttl = now + m_options.ttl;
-    m_cache->set(key, entry);
-    return true;
-  } else {
-    value = entry.value;
+  if (lookup(key, value, now())) {
+    m_hits++;
     return true;
   }
+  m_misses++;
+  if (!allocate) return false;
+  if (!allocate(value)) return false;
+  set(key, value, free);
+  return true;
 }
 
 void Cache::set(
   const pjs::Value &key, const pjs::Value &value,
-  const std::function<bool(const pjs::Value &, const pjs::Value &)> &free
+  const FreeFunc &free
 ) {
-  auto now = (m_options.ttl > 0 ? utils::now() : 0);
-  Entry entry;
-  entry.value = value;
-  entry.ttl = now + m_options.ttl;
-  if (m_cache->set(key, entry)) {
-    if (m_options.size > 0 && m_cache->size() > m_options.size) {
-      int n = m_cache->size() - m_options.size;
-      pjs::OrderedHash<pjs::Value, Entry>::Iterator it(m_cache);
-      if (free) {
-        pjs::Value argv[2], ret;
-        while (auto *p = it.next()) {
-          if (!free(p->k, p->v.value)) break;
-          m_cache->erase(p->k);
-          if (!--n) break;
-        }
-      }
-      if (n > 0) {
-        while (auto *p = it.next()) {
-          m_cache->erase(p->k);
-          if (!--n) break;
-        }
-      }
+  auto t = now();
+  auto expiration = (m_options.ttl > 0 ? t + m_options.ttl : 0);
+  auto weight = weight_of(key) + weight_of(value);
+  Evicted evicted;
+  if (m_shared) {
+    m_shared->set(shared_key(key), value, weight, expiration, evicted);
+  } else {
+    LocalStore::Evicted local;
+    m_store->set(key, value, weight, expiration, local);
+    for (const auto &p : local) evicted.emplace_back(p.first, p.second);
+  }
+  m_evictions += evicted.size();
+  if (free) {
+    for (const auto &p : evicted) {
+      if (!free(p.first, p.second)) break;
     }
   }
 }
 
+bool Cache::lookup(const pjs::Value &key, pjs::Value &value, double now) {
+  if (m_shared) return m_shared->get(shared_key(key), value, now);
+  auto e = m_store->find(key);
+  if (!e) return false;
+  if (e->expiration > 0 && now >= e->expiration) {
+    m_store->remove(e);
+    return false;
+  }
+  m_store->access(e);
+  value = e->value;
+  return true;
+}
+
+bool Cache::erase(const pjs::Value &key, pjs::Value &value) {
+  if (m_shared) return m_shared->erase(shared_key(key), value);
+  return m_store->erase(key, &value);
+}
+
+auto Cache::free_func(pjs::Context &ctx) -> FreeFunc {
+  if (!m_free) return nullptr;
+  return [&](const pjs::Value &key, const pjs::Value &value) {
+    pjs::Value argv[2], ret;
+    argv[0] = key;
+    argv[1] = value;
+    (*m_free)(ctx, 2, argv, ret);
+    return ctx.ok();
+  };
+}
+
+//
+// Entries in a shared cache may have been set by other workers with a
+// different TTL, so the clock is always read for them.
+//
+
+auto Cache::now() const -> double {
+  return (m_options.ttl > 0 || m_shared ? utils::now() : 0);
+}
+
+auto Cache::weight_of(const pjs::Value &value) -> size_t {
+  if (value.is_string()) return value.s()->size();
+  if (value.is_instance_of<Data>()) return value.as<Data>()->size();
+  return sizeof(double);
+}
+
+auto Cache::shared_key(const pjs::Value &key) -> pjs::Ref<pjs::Str> {
+  if (key.is_string()) return key.s();
+  auto s = key.to_string();
+  pjs::Ref<pjs::Str> ref(s);
+  s->release();
+  return ref;
+}
+
+auto Cache::all() -> List<Cache>& {
+  thread_local static List<Cache> s_all;
+  return s_all;
+}
+
+void Cache::init_metrics() {
+  thread_local static bool s_initialized = false;
+  if (s_initialized) return;
+
+  pjs::Ref<pjs::Array> label_names = pjs::Array::make(1);
+  label_names->set(0, "cache");
+
+  auto make_counter = [&](const char *name, uint64_t Cache::*field) {
+    stats::Counter::make(
+      pjs::Str::make(name),
+      label_names,
+      [=](stats::Counter *counter) {
+        for (auto *c = all().head(); c; c = c->next()) {
+          auto n = c->*field;
+          c->*field = 0;
+          pjs::Str *labels[1] = { c->m_name };
+          counter->with_labels(labels, 1)->increase(n);
+          counter->increase(n);
+        }
+      }
+    );
+  };
+
+  make_counter("pipy_cache_hit", &Cache::m_hits);
+  make_counter("pipy_cache_miss", &Cache::m_misses);
+  make_counter("pipy_cache_eviction", &Cache::m_evictions);
+
+  s_initialized = true;
+}
+
 //
 // Quota
 //
@@ -514,6 +1127,7 @@ void Quota::Counter::finalize() {
 SharedMap::SharedMap(pjs::Str *name)
   : m_map(Map::get(name->str()))
 {
+  init_metrics();
 }
 
 auto SharedMap::size() -> size_t {
@@ -543,8 +1157,7 @@ bool SharedMap::get(pjs::Str *key, pjs::Value &value) {
 }
 
 void SharedMap::set(pjs::Str *key, const pjs::Value &value) {
-  pjs::SharedValue sv(value);
-  m_map->set(key->data(), sv);
+  m_map->set(key->data(), value);
 }
 
 auto SharedMap::add(pjs::Str *key, double value) -> double {
@@ -552,7 +1165,37 @@ auto SharedMap::add(pjs::Str *key, double value) -> double {
 }
 
 auto SharedMap::sub(pjs::Str *key, double value) -> double {
-  return m_map->sub(key->data(), value);
+  return m_map->add(key->data(), -value);
+}
+
+void SharedMap::init_metrics() {
+  thread_local static bool s_initialized = false;
+  if (s_initialized) return;
+
+  pjs::Ref<pjs::Array> label_names = pjs::Array::make(2);
+  label_names->set(0, "map");
+  label_names->set(1, "shard");
+
+  stats::Counter::make(
+    pjs::Str::make("pipy_shared_map_contention"),
+    label_names,
+    [](stats::Counter *counter) {
+      Map::for_each(
+        [&](Map *map) {
+          pjs::Ref<pjs::Str> name(pjs::Str::make(map->name()));
+          for (int i = 0; i < Map::SHARD_COUNT; i++) {
+            pjs::Ref<pjs::Str> shard(pjs::Str::make(i));
+            pjs::Str *labels[2] = { name, shard };
+            auto n = map->contentions(i);
+            counter->with_labels(labels, 2)->increase(n);
+            counter->increase(n);
+          }
+        }
+      );
+    }
+  );
+
+  s_initialized = true;
 }
 
 //
@@ -566,71 +1209,146 @@ auto SharedMap::Map::get(const std::string &name) -> Map* {
   std::lock_guard<std::mutex> lock(m_maps_mutex);
   auto &p = m_maps[name];
   if (!p) {
-    p = new Map;
+    p = new Map(name);
     p->retain();
   }
   return p;
 }
 
+void SharedMap::Map::for_each(const std::function<void(Map*)> &callback) {
+  std::lock_guard<std::mutex> lock(m_maps_mutex);
+  for (const auto &p : m_maps) {
+    callback(p.second);
+  }
+}
+
 auto SharedMap::Map::size() -> size_t {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  return m_map.size();
+  size_t n = 0;
+  for (auto &shard : m_shards) {
+    shard.lock_shared();
+    n += shard.map.size();
+    shard.unlock_shared();
+  }
+  return n;
 }
 
 void SharedMap::Map::clear() {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  m_map.clear();
+  for (auto &shard : m_shards) {
+    shard.lock();
+    shard.map.clear();
+    shard.unlock();
+  }
 }
 
 bool SharedMap::Map::erase(pjs::Str::CharData *key) {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  auto i = m_map.find(key);
-  if (i == m_map.end()) return false;
-  m_map.erase(i);
-  return true;
+  auto &shard = shard_of(key);
+  shard.lock();
+  auto n = shard.map.erase(key);
+  shard.unlock();
+  return n > 0;
 }
 
 bool SharedMap::Map::has(pjs::Str::CharData *key) {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  auto i = m_map.find(key);
-  return i != m_map.end();
+  auto &shard = shard_of(key);
+  shard.lock_shared();
+  auto found = shard.map.count(key) > 0;
+  shard.unlock_shared();
+  return found;
 }
 
 bool SharedMap::Map::get(pjs::Str::CharData *key, pjs::SharedValue &value) {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  auto i = m_map.find(key);
-  if (i == m_map.end()) return false;
-  value = i->second;
-  return true;
+  auto &shard = shard_of(key);
+  shard.lock_shared();
+  auto i = shard.map.find(key);
+  auto found = (i != shard.map.end());
+  if (found) {
+    auto &e = i->second;
+    if (e.is_number) {
+      value = pjs::Value(e.number.load(std::memory_order_relaxed));
+    } else {
+      value = e.value;
+    }
+  }
+  shard.unlock_shared();
+  return found;
 }
 
-void SharedMap::Map::set(pjs::Str::CharData *key, const pjs::SharedValue &value) {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  m_map[key] = value;
+void SharedMap::Map::set(pjs::Str::CharData *key, const pjs::Value &value) {
+  pjs::SharedValue sv;
+  if (!value.is_number()) sv = value;
+  auto &shard = shard_of(key);
+  shard.lock();
+  auto &e = shard.map[key];
+  if (value.is_number()) {
+    e.value = pjs::SharedValue();
+    e.number.store(value.n(), std::memory_order_relaxed);
+    e.is_number = true;
+  } else {
+    e.value = sv;
+    e.is_number = false;
+  }
+  shard.unlock();
 }
 
 auto SharedMap::Map::add(pjs::Str::CharData *key, double value) -> double {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  auto i = m_map.find(key);
-  if (i == m_map.end()) return std::numeric_limits<double>::quiet_NaN();
-  pjs::Value v;
-  i->second.to_value(v);
-  if (!v.is_number()) return std::numeric_limits<double>::quiet_NaN();
-  v.set(v.n() + value);
-  i->second = v;
-  return v.n();
+  auto ret = std::numeric_limits<double>::quiet_NaN();
+  auto &shard = shard_of(key);
+  shard.lock_shared();
+  auto i = shard.map.find(key);
+  if (i != shard.map.end() && i->second.is_number) {
+    auto &n = i->second.number;
+    auto old = n.load(std::memory_order_relaxed);
+    while (!n.compare_exchange_weak(old, old + value, std::memory_order_relaxed)) {}
+    ret = old + value;
+  }
+  shard.unlock_shared();
+  return ret;
 }
 
-auto SharedMap::Map::sub(pjs::Str::CharData *key, double value) -> double {
-  std::lock_guard<std::mutex> lock(m_mutex);
-  auto i = m_map.find(key);
-  if (i == m_map.end()) return std::numeric_limits<double>::quiet_NaN();
-  pjs::Value v;
-  i->second.to_value(v);
-  if (!v.is_number()) return std::numeric_limits<double>::quiet_NaN();
-  v.set(v.n() - value);
-  i->second = v;
-  return v.n();
+auto SharedMap::Map::contentions(int shard) -> uint64_t {
+  return m_shards[shard].contentions();
+}
+
+//
+// SharedMap::Map::Shard
+//
+// The lock state holds the number of readers and a writer bit.
+// A writer sets the bit first to keep off new readers and then
+// waits for the existing readers to leave.
+//
+
+void SharedMap::Map::Shard::lock_shared() {
+  int spins = 0;
+  for (;;) {
+    auto state = m_state.load(std::memory_order_relaxed);
+    if (!(state & WRITER) && m_state.compare_exchange_weak(state, state + 1, std::memory_order_acquire)) return;
+    wait(spins);
+  }
+}
+
+void SharedMap::Map::Shard::unlock_shared() {
+  m_state.fetch_sub(1, std::memory_order_release);
+}
+
+void SharedMap::Map::Shard::lock() {
+  int spins = 0;
+  for (;;) {
+    auto state = m_state.load(std::memory_order_relaxed);
+    if (!(state & WRITER) && m_state.compare_exchange_weak(state, state | WRITER, std::memory_order_acquire)) break;
+    wait(spins);
+  }
+  while (m_state.load(std::memory_order_acquire) != WRITER) {
+    wait(spins);
+  }
+}
+
+void SharedMap::Map::Shard::unlock() {
+  m_state.store(0, std::memory_order_release);
+}
+
+void SharedMap::Map::Shard::wait(int &spins) {
+  if (!spins++) m_contentions.fetch_add(1, std::memory_order_relaxed);
+  if (spins > 64) std::this_thread::yield();
 }
 
 //
@@ -638,7 +1356,6 @@ auto SharedMap::Map::sub(pjs::Str::CharData *key, double value) -> double {
 //
 
 URLRouter::URLRouter()
-  : m_root(new Node())
 {
 }
 
@@ -655,119 +1372,267 @@ URLRouter::URLRouter(pjs::Object *rules)
 }
 
 URLRouter::~URLRouter() {
-  delete m_root;
 }
 
 void URLRouter::add(const std::string &url, const pjs::Value &value) {
-  auto segs = utils::split(url, '/');
-  auto domain = segs.front();
-  segs.pop_front();
+  auto path_start = url.find_first_of('/');
+  if (path_start == std::string::npos) throw std::runtime_error("invalid URL pattern");
 
-  if (segs.empty() || domain.find_first_of(':') != std::string::npos) {
+  auto domain = url.substr(0, path_start);
+  if (domain.find_first_of(':') != std::string::npos) {
     throw std::runtime_error("invalid URL pattern");
   }
 
-  auto node = m_root;
-
+  auto node = &m_paths;
   if (!domain.empty()) {
-    auto segs = utils::split(domain, '.');
-    for (const auto &seg : segs) {
-      node = node->new_child(seg);
+    Node *host;
+    if (domain.length() > 2 && domain[0] == '*' && domain[1] == '.') {
+      host = m_wildcard_hosts.insert(domain.c_str() + 2, domain.length() - 2);
+    } else {
+      host = m_hosts.insert(domain.c_str(), domain.length());
+    }
+    if (!host->paths) host->paths = new Node;
+    node = host->paths;
+  }
+
+  auto path = url.substr(path_start);
+  auto len = path.length();
+  auto is_prefix = (len >= 2 && path[len-2] == '/' && path[len-1] == '*');
+  if (is_prefix) len -= 2;
+
+  std::vector<pjs::Ref<pjs::Str>> params;
+  size_t i = 0, p = 0;
+  while (i < len) {
+    auto j = i + 1;
+    while (j < len && path[j] != '/') j++;
+    auto seg = path.c_str() + i + 1;
+    auto seg_len = j - i - 1;
+    if (seg_len > 0 && (seg[0] == ':' || (seg_len == 1 && seg[0] == '*'))) {
+      if (params.size() >= MAX_CAPTURES) throw std::runtime_error("too many parameters in URL pattern");
+      node = node->insert(path.c_str() + p, i + 1 - p);
+      if (!node->param) node->param = new Node;
+      node = node->param;
+      params.push_back(seg[0] == ':' ? pjs::Str::make(seg + 1, seg_len - 1) : nullptr);
+      p = j;
     }
+    i = j;
   }
 
-  node = node->new_child("/");
+  node = node->insert(path.c_str() + p, len - p);
+
+  auto &route = (is_prefix ? node->prefix : node->exact);
+  if (!route) {
+    route = new Route;
+    m_size++;
+  }
+  route->value = value;
+  route->params = std::move(params);
+}
 
-  if (segs.back() == "*") {
-    for (const auto &seg : segs) {
-      if (!seg.empty()) {
-        node = node->new_child(seg);
+bool URLRouter::find(const std::string &url, pjs::Value &value) {
+  return find(url.c_str(), url.length(), value);
+}
+
+bool URLRouter::find(const char *url, size_t len, pjs::Value &value, pjs::Object *params) {
+  auto path = (const char *)std::memchr(url, '/', len);
+  if (!path) return false;
+
+  auto path_start = path - url;
+  auto path_end = len;
+  if (auto q = (const char *)std::memchr(path, '?', len - path_start)) path_end = q - url;
+  auto path_len = path_end - path_start;
+
+  auto domain_end = path_start;
+  while (domain_end > 0 && url[domain_end-1] != ':') domain_end--;
+  if (domain_end > 0) domain_end--; else domain_end = path_start;
+
+  Captures captures;
+  const Route *route = nullptr;
+
+  if (domain_end > 0) {
+    if (auto host = m_hosts.lookup(url, domain_end)) {
+      if (host->paths) route = host->paths->match(path, path_len, captures);
+    }
+    if (!route) {
+      if (auto dot = (const char *)std::memchr(url, '.', domain_end)) {
+        auto i = dot + 1 - url;
+        if (auto host = m_wildcard_hosts.lookup(dot + 1, domain_end - i)) {
+          if (host->paths) route = host->paths->match(path, path_len, captures);
+        }
+      }
+    }
+  }
+
+  if (!route) route = m_paths.match(path, path_len, captures);
+  if (!route) return false;
+
+  value = route->value;
+
+  if (params) {
+    for (int i = 0; i < captures.count; i++) {
+      if (auto name = route->params[i].get()) {
+        params->set(name, pjs::Str::make(captures.ptr[i], captures.len[i]));
+      }
+    }
+  }
+
+  return true;
+}
+
+//
+// URLRouter::Node
+//
+
+URLRouter::Node::~Node() {
+  for (auto *c : children) delete c;
+  delete param;
+  delete paths;
+  delete exact;
+  delete prefix;
+}
+
+auto URLRouter::Node::insert(const char *str, size_t len) -> Node* {
+  auto node = this;
+  while (len > 0) {
+    auto i = node->heads.find(str[0]);
+    if (i == std::string::npos) {
+      auto child = new Node;
+      child->label.assign(str, len);
+      node->heads.push_back(str[0]);
+      node->children.push_back(child);
+      return child;
+    }
+    auto child = node->children[i];
+    const auto &label = child->label;
+    size_t n = 0;
+    while (n < label.length() && n < len && label[n] == str[n]) n++;
+    if (n < label.length()) {
+      auto split = new Node;
+      split->label = label.substr(0, n);
+      child->label.erase(0, n);
+      split->heads.push_back(child->label[0]);
+      split->children.push_back(child);
+      node->children[i] = split;
+      child = split;
+    }
+    node = child;
+    str += n;
+    len -= n;
+  }
+  return node;
+}
+
+auto URLRouter::Node::lookup(const char *str, size_t len) const -> const Node* {
+  auto node = this;
+  while (len > 0) {
+    auto i = node->heads.find(str[0]);
+    if (i == std::string::npos) return nullptr;
+    auto child = node->children[i];
+    auto n = child->label.length();
+    if (n > len || std::memcmp(child->label.c_str(), str, n)) return nullptr;
+    node = child;
+    str += n;
+    len -= n;
+  }
+  return node;
+}
+
+//
+// Static text takes precedence over parameters, and parameters over
+// prefixes, so the most specific route wins. On a mismatch further
+// down, the search backtracks to the less specific alternatives.
+//
+
+auto URLRouter::Node::match(const char *str, size_t len, Captures &captures) const -> const Route* {
+  if (len == 0) {
+    if (exact) return exact;
+  } else {
+    auto i = heads.find(str[0]);
+    if (i != std::string::npos) {
+      auto child = children[i];
+      auto n = child->label.length();
+      if (n <= len && !std::memcmp(child->label.c_str(), str, n)) {
+        if (auto r = child->match(str + n, len - n, captures)) return r;
+      }
+    }
+    if (param && captures.count < MAX_CAPTURES) {
+      size_t n = 0;
+      while (n < len && str[n] != '/') n++;
+      if (n > 0) {
+        auto k = captures.count++;
+        captures.ptr[k] = str;
+        captures.len[k] = n;
+        if (auto r = param->match(str + n, len - n, captures)) return r;
+        captures.count = k;
       }
     }
-    node->value = value;
-  } else {
-    auto i = url.find_first_of('/');
-    node->new_child(url.substr(i))->value = value;
   }
+  if (prefix && (len == 0 || str[0] == '/')) return prefix;
+  return nullptr;
 }
 
-bool URLRouter::find(const std::string &url, pjs::Value &value) {
-  static const std::string s_slash("/");
-  static const std::string s_asterisk("*");
-
-  auto path_start = url.find_first_of('/');
-  if (path_start == std::string::npos) return false;
-
-  auto path_end = url.find_first_of('?', path_start);
-  if (path_end == std::string::npos) path_end = url.length();
-
-  auto domain_end = url.find_last_of(':', path_start);
-  if (domain_end == std::string::npos) domain_end = path_start;
-
-  std::function<Node*(Node*, int)> find_host, find_path;
-
-  find_host = [&](Node *node, int p) -> Node* {
-    auto i = p;
-    while (i < domain_end && url[i] != '.') i++;
-    auto s = url.substr(p, i - p);
-    node = node->child(s);
-    if (!node) return nullptr;
-    p = i + 1;
-    if (p <= domain_end) return find_host(node, p);
-    node = node->child(s_slash);
-    if (!node) return nullptr;
-    if (auto exact = node->child(url.substr(path_start, path_end - path_start))) {
-      return exact;
-    }
-    return find_path(node, path_start + 1);
-  };
+//
+// MultiMatcher
+//
 
-  find_path = [&](Node *node, int p) -> Node* {
-    auto i = p;
-    while (i < path_end && url[i] != '/') i++;
-    auto s = url.substr(p, i - p);
-    if (auto c = node->child(s)) {
-      p = i + 1;
-      c = p >= path_end ? c->child(s_asterisk) : find_path(c, p);
-      if (c) return c;
-    }
-    if (auto c = node->child(s_asterisk)) return c;
-    return nullptr;
-  };
+MultiMatcher::Options::Options(pjs::Object *options) {
+  Value(options, "ignoreCase")
+    .get(ignore_case)
+    .check_nullable();
+}
 
-  auto node = find_host(m_root, 0);
-  if (!node) {
-    auto i = 0;
-    while (i < domain_end && url[i] != '.') i++;
-    if (i < domain_end) {
-      if (auto c = m_root->child(s_asterisk)) {
-        node = find_host(c, i + 1);
-      }
-    }
-  }
-  if (!node) {
-    if (auto c = m_root->child(s_slash)) {
-      if (auto exact = c->child(url.substr(path_start, path_end - path_start))) {
-        node = exact;
+MultiMatcher::MultiMatcher(pjs::Array *patterns, const Options &options) {
+  std::vector<std::string> list;
+  list.reserve(patterns->length());
+  patterns->iterate_all(
+    [&](pjs::Value &v, int) {
+      if (v.is<Data>()) {
+        list.push_back(v.as<Data>()->to_string());
       } else {
-        node = find_path(c, path_start + 1);
+        auto *s = v.to_string();
+        list.push_back(s->str());
+        s->release();
       }
     }
-  }
+  );
+  m_automaton = AhoCorasick::make(list, options.ignore_case);
+}
 
-  if (node) {
-    value = node->value;
-    return true;
-  }
+bool MultiMatcher::test(const pjs::Value &input) {
+  bool found = false;
+  scan(input, [&](int, size_t) { found = true; return false; });
+  return found;
+}
+
+auto MultiMatcher::find(const pjs::Value &input) -> int {
+  int index = -1;
+  scan(input, [&](int i, size_t) { index = i; return false; });
+  return index;
+}
 
-  return false;
+auto MultiMatcher::find_all(const pjs::Value &input) -> pjs::Array* {
+  std::vector<bool> found(m_automaton->pattern_count());
+  auto *a = pjs::Array::make();
+  scan(
+    input, [&](int i, size_t) {
+      if (!found[i]) {
+        found[i] = true;
+        a->push(i);
+      }
+      return true;
+    }
+  );
+  return a;
 }
 
-void URLRouter::dump(Node *node, int level) {
-  for (auto &i : node->children) {
-    std::cout << std::string(level * 2, ' ');
-    std::cout << i.first << std::endl;
-    dump(i.second, level + 1);
+void MultiMatcher::scan(const pjs::Value &input, const AhoCorasick::Scanner::Callback &cb) {
+  AhoCorasick::Scanner scanner(m_automaton);
+  if (input.is<Data>()) {
+    scanner.input(*input.as<Data>(), cb);
+  } else {
+    auto *s = input.to_string();
+    scanner.input(s->c_str(), s->size(), cb);
+    s->release();
   }
 }
 
@@ -1122,8 +1987,50 @@ void LoadBalancerBase::Session::on_weak_ptr_gone() {
 // HashingLoadBalancer
 //
 
-HashingLoadBalancer::HashingLoadBalancer(pjs::Object *targets, Cache *unhealthy)
+static auto hash_mix(uint64_t x) -> uint64_t {
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+static auto hash_str(const std::string &s) -> uint64_t {
+  uint64_t h = 0xcbf29ce484222325ull;
+  for (auto c : s) {
+    h ^= (uint8_t)c;
+    h *= 0x100000001b3ull;
+  }
+  return hash_mix(h);
+}
+
+HashingLoadBalancer::Options::Options(pjs::Object *options) {
+  Value(options, "algorithm")
+    .get_enum(algorithm)
+    .check_nullable();
+  Value(options, "replicas")
+    .get(replicas)
+    .check_nullable();
+  Value(options, "tableSize")
+    .get(table_size)
+    .check_nullable();
+  Value(options, "loadFactor")
+    .get(load_factor)
+    .check_nullable();
+
+  if (replicas < 1) {
+    throw std::runtime_error("options.replicas expects a positive integer");
+  }
+  if (table_size < 2) {
+    throw std::runtime_error("options.tableSize expects an integer greater than 1");
+  }
+  if (load_factor != 0 && load_factor < 1) {
+    throw std::runtime_error("options.loadFactor expects a number no less than 1");
+  }
+}
+
+HashingLoadBalancer::HashingLoadBalancer(pjs::Object *targets, Cache *unhealthy, const Options &options)
   : pjs::ObjectTemplate<HashingLoadBalancer, LoadBalancerBase>(unhealthy)
+  , m_options(options)
 {
   set(targets);
 }
@@ -1133,37 +2040,294 @@ HashingLoadBalancer::~HashingLoadBalancer()
 }
 
 void HashingLoadBalancer::set(pjs::Object *targets) {
-  if (targets) {
-    m_targets.clear();
-    if (targets->is_array()) {
-      targets->as<pjs::Array>()->iterate_all(
-        [this](pjs::Value &v, int i) {
-          auto s = v.to_string();
-          m_targets.push_back(s);
-          s->release();
-        }
-      );
-    } else {
-      targets->iterate_all(
-        [this](pjs::Str *k, pjs::Value &) {
-          m_targets.push_back(k);
-        }
-      );
+  if (!targets) return;
+  for (auto &t : m_targets) t.removed = true;
+
+  //
+  // Targets are kept in the order as given, which
+  // decides how keys are mapped in modulo mode
+  //
+
+  auto update = [this](pjs::Str *id, double weight) {
+    set(id, weight);
+    auto i = m_target_map[id];
+    m_targets.splice(m_targets.end(), m_targets, i);
+  };
+
+  if (targets->is_array()) {
+    targets->as<pjs::Array>()->iterate_all(
+      [&](pjs::Value &v, int) {
+        auto s = v.to_string();
+        update(s, 1);
+        s->release();
+      }
+    );
+  } else {
+    // Values other than numbers used to be ignored and stay weighted as 1
+    targets->iterate_all(
+      [&](pjs::Str *k, pjs::Value &v) {
+        update(k, v.is_number() ? v.n() : 1);
+      }
+    );
+  }
+
+  m_dirty = true;
+}
+
+void HashingLoadBalancer::set(pjs::Str *target, double weight) {
+  if (!(weight > 0)) weight = 0;
+
+  auto i = m_target_map.find(target);
+  if (i == m_target_map.end()) {
+    m_targets.emplace_back();
+    auto &t = m_targets.back();
+    t.id = target;
+    t.weight = weight;
+    t.hash = hash_str(target->str());
+    t.load = 0;
+    t.placed = false;
+    t.removed = false;
+    m_target_map[target] = std::prev(m_targets.end());
+  } else {
+    auto &t = *i->second;
+    if (t.weight != weight) {
+      t.weight = weight;
+      t.placed = false;
     }
+    t.removed = false;
   }
+
+  m_dirty = true;
 }
 
-void HashingLoadBalancer::add(pjs::Str *target) {
-  m_targets.push_back(target);
+void HashingLoadBalancer::add(pjs::Str *target, double weight) {
+  set(target, weight);
 }
 
 auto HashingLoadBalancer::select(const pjs::Value &key, Cache *unhealthy) -> pjs::Str* {
-  if (m_targets.empty()) return nullptr;
+  if (m_dirty) rebuild();
+
   std::hash<pjs::Value> hash;
-  auto h = hash(key);
-  auto s = m_targets[h % m_targets.size()].get();
-  if (s && !is_healthy(s, unhealthy)) return nullptr;
-  return s;
+  auto k = hash(key);
+  auto h = hash_mix(k);
+  Target *t = nullptr;
+
+  switch (m_options.algorithm) {
+    case Algorithm::MODULO: {
+      // Keys are not mixed here so that they map as they did before
+      // other algorithms were added
+      h = k;
+      auto n = m_order.size();
+      for (size_t i = 0; i < n; i++) {
+        auto p = m_order[(h + i) % n];
+        if (is_available(p, unhealthy)) { t = p; break; }
+      }
+      break;
+    }
+    case Algorithm::RING: {
+      auto n = m_ring.size();
+      if (!n) break;
+      size_t i = m_ring_index[h >> m_ring_shift];
+      while (i < n && m_ring[i].hash < h) i++;
+      for (size_t j = 0; j < n; j++) {
+        auto p = m_ring[(i + j) % n].target;
+        if (is_available(p, unhealthy)) { t = p; break; }
+      }
+      break;
+    }
+    case Algorithm::MAGLEV: {
+      auto n = m_table.size();
+      if (!n) break;
+      auto i = h % n;
+      for (size_t j = 0; j < n; j++) {
+        auto p = m_table[(i + j) % n];
+        if (is_available(p, unhealthy)) { t = p; break; }
+      }
+      break;
+    }
+  }
+
+  if (!t) return nullptr;
+
+  if (m_options.load_factor > 0) {
+    t->load++;
+    m_total_load++;
+  }
+
+  return t->id;
+}
+
+void HashingLoadBalancer::deselect(pjs::Str *target) {
+  if (m_options.load_factor > 0 && target) {
+    auto i = m_target_map.find(target);
+    if (i != m_target_map.end()) {
+      auto &t = *i->second;
+      if (t.load > 0) {
+        t.load--;
+        m_total_load--;
+      }
+    }
+  }
+}
+
+//
+// With bounded loads, a target is skipped when taking one more
+// key would put it above its share of the total load by more
+// than the load factor
+//
+
+bool HashingLoadBalancer::is_available(Target *target, Cache *unhealthy) {
+  if (!is_healthy(target->id, unhealthy)) return false;
+  if (m_options.load_factor > 0) {
+    auto limit = std::ceil(m_options.load_factor * (m_total_load + 1) * target->weight / m_total_weight);
+    if (target->load + 1 > limit) return false;
+  }
+  return true;
+}
+
+void HashingLoadBalancer::rebuild() {
+  bool changed = false;
+  for (const auto &t : m_targets) {
+    if (t.removed || !t.placed) {
+      changed = true;
+      break;
+    }
+  }
+
+  if (changed) {
+    switch (m_options.algorithm) {
+      case Algorithm::RING: build_ring(); break;
+      case Algorithm::MAGLEV: build_maglev(); break;
+      default: break;
+    }
+
+    for (auto i = m_targets.begin(); i != m_targets.end(); ) {
+      auto p = i++;
+      if (p->removed) {
+        m_total_load -= p->load;
+        m_target_map.erase(p->id);
+        m_targets.erase(p);
+      } else {
+        p->placed = true;
+      }
+    }
+  }
+
+  m_order.clear();
+  m_total_weight = 0;
+  for (auto &t : m_targets) {
+    if (t.weight > 0) {
+      m_order.push_back(&t);
+      m_total_weight += t.weight;
+    }
+  }
+
+  m_dirty = false;
+}
+
+//
+// The ring is updated incrementally: points of the removed or
+// reweighted targets are dropped and new points are merged in
+//
+
+void HashingLoadBalancer::build_ring() {
+  std::vector<Point> ring, points;
+  ring.reserve(m_ring.size());
+  for (const auto &p : m_ring) {
+    if (!p.target->removed && p.target->placed) {
+      ring.push_back(p);
+    }
+  }
+
+  for (auto &t : m_targets) {
+    if (!t.removed && !t.placed && t.weight > 0) {
+      auto n = (int)std::round(t.weight * m_options.replicas);
+      if (n < 1) n = 1;
+      for (int i = 0; i < n; i++) {
+        points.push_back({ hash_mix(t.hash + uint64_t(i + 1) * 0x9e3779b97f4a7c15ull), &t });
+      }
+    }
+  }
+
+  auto less = [](const Point &a, const Point &b) { return a.hash < b.hash; };
+  std::sort(points.begin(), points.end(), less);
+  m_ring.resize(ring.size() + points.size());
+  std::merge(ring.begin(), ring.end(), points.begin(), points.end(), m_ring.begin(), less);
+
+  int bits = 1;
+  while ((size_t(1) << bits) < m_ring.size()) bits++;
+  m_ring_shift = 64 - bits;
+  m_ring_index.resize(size_t(1) << bits);
+
+  size_t i = 0;
+  for (size_t b = 0; b < m_ring_index.size(); b++) {
+    auto start = uint64_t(b) << m_ring_shift;
+    while (i < m_ring.size() && m_ring[i].hash < start) i++;
+    m_ring_index[b] = i;
+  }
+}
+
+//
+// Each target fills its preferred slots in turn as described
+// by Maglev, only that a target gets its turns in proportion
+// to its weight. The table size is a prime number so that all
+// permutations cover the whole table.
+//
+
+void HashingLoadBalancer::build_maglev() {
+  uint64_t size = m_options.table_size;
+  for (;; size++) {
+    bool prime = true;
+    for (uint64_t d = 2; d * d <= size; d++) {
+      if (size % d == 0) { prime = false; break; }
+    }
+    if (prime) break;
+  }
+
+  struct Permutation {
+    Target *target;
+    uint64_t offset;
+    uint64_t skip;
+    uint64_t next;
+    double credit;
+  };
+
+  std::vector<Permutation> permutations;
+  double max_weight = 0;
+  for (auto &t : m_targets) {
+    if (!t.removed && t.weight > 0) {
+      permutations.push_back({
+        &t,
+        hash_mix(t.hash ^ 1) % size,
+        hash_mix(t.hash ^ 2) % (size - 1) + 1,
+        0, 0,
+      });
+      max_weight = std::max(max_weight, t.weight);
+    }
+  }
+
+  m_table.assign(size, nullptr);
+  if (permutations.empty()) {
+    m_table.clear();
+    return;
+  }
+
+  uint64_t filled = 0;
+  while (filled < size) {
+    for (auto &p : permutations) {
+      p.credit += p.target->weight / max_weight;
+      if (p.credit < 1) continue;
+      p.credit -= 1;
+      auto c = (p.offset + p.next * p.skip) % size;
+      while (m_table[c]) {
+        p.next++;
+        c = (p.offset + p.next * p.skip) % size;
+      }
+      m_table[c] = p.target;
+      p.next++;
+      if (++filled == size) break;
+    }
+  }
 }
 
 //
@@ -1503,10 +2667,23 @@ void ResourcePool::free(const pjs::Value &resource) {
 // Percentile
 //
 
+static auto double_to_bits(double n) -> uint64_t {
+  uint64_t bits;
+  std::memcpy(&bits, &n, sizeof(bits));
+  return bits;
+}
+
+static auto bits_to_double(uint64_t bits) -> double {
+  double n;
+  std::memcpy(&n, &bits, sizeof(n));
+  return n;
+}
+
 Percentile::Percentile(pjs::Array *buckets)
   : m_counts(buckets->length())
   , m_buckets(buckets->length())
 {
+  bool ascending = true;
   double last = std::numeric_limits<double>::min();
   buckets->iterate_all(
     [&](pjs::Value &v, int i) {
@@ -1516,15 +2693,40 @@ Percentile::Percentile(pjs::Array *buckets)
           "buckets are not in ascending order: changed from %f to %f at #%d",
           last, limit, i
         );
+        ascending = false;
       }
       m_buckets[i] = limit;
       last = limit;
     }
   );
 
+  if (ascending) build_index();
   reset();
 }
 
+//
+// Bucket limits for a DDSketch with the given relative accuracy,
+// growing by a factor of (1 + a) / (1 - a) from min to max. Counts
+// of sketches with the same limits are merged by simply adding up,
+// so quantiles can be calculated across threads and instances
+//
+
+auto Percentile::sketch(double accuracy, double min, double max) -> pjs::Array* {
+  if (!(0 < accuracy && accuracy < 1)) throw std::runtime_error("accuracy out of range (0, 1)");
+  if (!(0 < min && min < max)) throw std::runtime_error("invalid range of values");
+  auto gamma = (1 + accuracy) / (1 - accuracy);
+  auto log_gamma = std::log(gamma);
+  auto first = (int)std::ceil(std::log(min) / log_gamma);
+  auto last = (int)std::ceil(std::log(max) / log_gamma);
+  if (last - first > INDEX_MAX_SIZE) throw std::runtime_error("too many buckets");
+  auto buckets = pjs::Array::make(last - first + 2);
+  for (int i = first; i <= last; i++) {
+    buckets->set(i - first, std::pow(gamma, i));
+  }
+  buckets->set(last - first + 1, std::numeric_limits<double>::infinity());
+  return buckets;
+}
+
 void Percentile::reset() {
   for (auto &n : m_counts) n = 0;
   m_sample_count = 0;
@@ -1548,18 +2750,16 @@ void Percentile::set(int bucket, size_t count) {
 }
 
 void Percentile::observe(double sample) {
-  for (size_t i = 0, n = m_counts.size(); i < n; i++) {
-    if (sample <= m_buckets[i]) {
-      m_counts[i]++;
-      m_sample_count++;
-      break;
-    }
+  auto i = index_of(sample);
+  if (i < m_counts.size()) {
+    m_counts[i]++;
+    m_sample_count++;
   }
 }
 
-auto Percentile::calculate(int percentage) -> double {
+auto Percentile::calculate(double percentage) -> double {
   if (percentage <= 0) return 0;
-  size_t total = m_sample_count * percentage / 100;
+  auto total = m_sample_count * percentage / 100;
   size_t count = 0;
   for (size_t i = 0, n = m_buckets.size(); i < n; i++) {
     count += m_counts[i];
@@ -1579,6 +2779,47 @@ void Percentile::dump(const std::function<void(double, size_t)> &cb) {
   }
 }
 
+void Percentile::build_index() {
+  double min = 0, max = 0;
+  for (auto b : m_buckets) {
+    if (b > 0 && std::isfinite(b)) {
+      if (min == 0) min = b;
+      max = b;
+    }
+  }
+
+  if (min == 0) return;
+
+  auto base = index_key(min);
+  auto size = index_key(max) - base + 1;
+  if (size > INDEX_MAX_SIZE) return;
+
+  m_index.resize(size);
+  m_index_base = base;
+  m_index_min = bits_to_double(base << (52 - INDEX_SUB_BITS));
+
+  size_t i = 0, n = m_buckets.size();
+  for (uint64_t k = 0; k < size; k++) {
+    auto start = bits_to_double((base + k) << (52 - INDEX_SUB_BITS));
+    while (i < n && m_buckets[i] < start) i++;
+    m_index[k] = i;
+  }
+}
+
+auto Percentile::index_of(double sample) const -> size_t {
+  size_t i = 0, n = m_buckets.size();
+  if (!m_index.empty() && sample >= m_index_min) {
+    auto k = index_key(sample) - m_index_base;
+    i = m_index[std::min<uint64_t>(k, m_index.size() - 1)];
+  }
+  while (i < n && !(sample <= m_buckets[i])) i++;
+  return i;
+}
+
+auto Percentile::index_key(double sample) -> uint64_t {
+  return double_to_bits(sample) >> (52 - INDEX_SUB_BITS);
+}
+
 } // namespace algo
 } // namespace pipy
 
@@ -1591,6 +2832,12 @@ using namespace pipy::algo;
 // Cache
 //
 
+template<> void EnumDef<Cache::Policy>::init() {
+  define(Cache::LRU, "lru");
+  define(Cache::TINY_LFU, "tinylfu");
+  define(Cache::ARC, "arc");
+}
+
 template<> void ClassDef<Cache>::init() {
   ctor([](Context &ctx) -> Object* {
     Function *allocate = nullptr, *free = nullptr;
@@ -1600,7 +2847,12 @@ template<> void ClassDef<Cache>::init() {
       ctx.try_arguments(1, &allocate, &options) ||
       ctx.try_arguments(0, &options)
     ) {
-      return Cache::make(options, allocate, free);
+      try {
+        return Cache::make(options, allocate, free);
+      } catch (std::runtime_error &err) {
+        ctx.error(err);
+        return nullptr;
+      }
     } else {
       ctx.error_argument_type(0, "a function or an object");
       return nullptr;
@@ -1640,6 +2892,8 @@ template<> void ClassDef<Cache>::init() {
   method("clear", [](Context &ctx, Object *obj, Value &ret) {
     obj->as<Cache>()->clear(ctx);
   });
+
+  accessor("size", [](Object *obj, Value &ret) { ret.set((int)obj->as<Cache>()->size()); });
 }
 
 template<> void ClassDef<Constructor<Cache>>::init() {
@@ -1778,7 +3032,15 @@ template<> void ClassDef<URLRouter>::init() {
     }
   });
 
+  accessor("size", [](Object *obj, Value &ret) { ret.set((int)obj->as<URLRouter>()->size()); });
+
   method("find", [](Context &ctx, Object *obj, Value &ret) {
+    auto router = obj->as<URLRouter>();
+    if (ctx.argc() == 1 && ctx.arg(0).is_string()) {
+      auto s = ctx.arg(0).s();
+      router->find(s->c_str(), s->size(), ret);
+      return;
+    }
     std::string url;
     for (int i = 0; i < ctx.argc(); i++) {
       const auto &seg = ctx.arg(i);
@@ -1792,7 +3054,22 @@ template<> void ClassDef<URLRouter>::init() {
         s->release();
       }
     }
-    obj->as<URLRouter>()->find(url, ret);
+    router->find(url, ret);
+  });
+
+  method("match", [](Context &ctx, Object *obj, Value &ret) {
+    thread_local static ConstStr s_value("value");
+    thread_local static ConstStr s_params("params");
+    Str *url;
+    if (!ctx.arguments(1, &url)) return;
+    Value value;
+    pjs::Ref<Object> params = Object::make();
+    if (obj->as<URLRouter>()->find(url->c_str(), url->size(), value, params)) {
+      auto result = Object::make();
+      result->set(s_value, value);
+      result->set(s_params, params.get());
+      ret.set(result);
+    }
   });
 }
 
@@ -1801,6 +3078,47 @@ template<> void ClassDef<Constructor<URLRouter>>::init() {
   ctor();
 }
 
+//
+// MultiMatcher
+//
+
+template<> void ClassDef<MultiMatcher>::init() {
+  ctor([](Context &ctx) -> Object* {
+    Array *patterns;
+    Object *options = nullptr;
+    if (!ctx.arguments(1, &patterns, &options)) return nullptr;
+    try {
+      return MultiMatcher::make(patterns, options);
+    } catch (std::runtime_error &err) {
+      ctx.error(err);
+      return nullptr;
+    }
+  });
+
+  method("test", [](Context &ctx, Object *obj, Value &ret) {
+    Value input;
+    if (!ctx.arguments(1, &input)) return;
+    ret.set(obj->as<MultiMatcher>()->test(input));
+  });
+
+  method("find", [](Context &ctx, Object *obj, Value &ret) {
+    Value input;
+    if (!ctx.arguments(1, &input)) return;
+    ret.set(obj->as<MultiMatcher>()->find(input));
+  });
+
+  method("findAll", [](Context &ctx, Object *obj, Value &ret) {
+    Value input;
+    if (!ctx.arguments(1, &input)) return;
+    ret.set(obj->as<MultiMatcher>()->find_all(input));
+  });
+}
+
+template<> void ClassDef<Constructor<MultiMatcher>>::init() {
+  super<Function>();
+  ctor();
+}
+
 //
 // LoadBalancer
 //
@@ -1907,26 +3225,51 @@ template<> void ClassDef<LoadBalancerBase::Resource>::init() {
 // HashingLoadBalancer
 //
 
+template<> void EnumDef<HashingLoadBalancer::Algorithm>::init() {
+  define(HashingLoadBalancer::Algorithm::MODULO, "modulo");
+  define(HashingLoadBalancer::Algorithm::RING, "ring");
+  define(HashingLoadBalancer::Algorithm::MAGLEV, "maglev");
+}
+
 template<> void ClassDef<HashingLoadBalancer>::init() {
   super<LoadBalancerBase>();
 
   ctor([](Context &ctx) -> Object* {
     Object *targets = nullptr;
     Cache *unhealthy = nullptr;
-    if (!ctx.arguments(0, &targets, &unhealthy)) return nullptr;
-    return HashingLoadBalancer::make(targets, unhealthy);
+    Object *options = nullptr;
+    if (!ctx.get(1, unhealthy) && ctx.get(1, options)) {
+      if (!ctx.arguments(0, &targets, &options)) return nullptr;
+    } else {
+      if (!ctx.arguments(0, &targets, &unhealthy, &options)) return nullptr;
+    }
+    try {
+      return HashingLoadBalancer::make(targets, unhealthy, HashingLoadBalancer::Options(options));
+    } catch (std::runtime_error &err) {
+      ctx.error(err);
+      return nullptr;
+    }
   });
 
   method("set", [](Context &ctx, Object *obj, Value &ret) {
     Object *targets;
-    if (!ctx.arguments(1, &targets)) return;
-    obj->as<HashingLoadBalancer>()->set(targets);
+    Str *target;
+    double weight = 1;
+    if (ctx.get(0, targets)) {
+      obj->as<HashingLoadBalancer>()->set(targets);
+    } else if (ctx.get(0, target)) {
+      if (!ctx.arguments(1, &target, &weight)) return;
+      obj->as<HashingLoadBalancer>()->set(target, weight);
+    } else {
+      ctx.error_argument_type(0, "a string or an object");
+    }
   });
 
   method("add", [](Context &ctx, Object *obj, Value &ret) {
     Str *target;
-    if (!ctx.arguments(1, &target)) return;
-    obj->as<HashingLoadBalancer>()->add(target);
+    double weight = 1;
+    if (!ctx.arguments(1, &target, &weight)) return;
+    obj->as<HashingLoadBalancer>()->add(target, weight);
   });
 }
 
@@ -2059,7 +3402,7 @@ template<> void ClassDef<Percentile>::init() {
   });
 
   method("calculate", [](Context &ctx, Object *obj, Value &ret) {
-    int percentage;
+    double percentage;
     if (!ctx.arguments(1, &percentage)) return;
     ret.set(obj->as<Percentile>()->calculate(percentage));
   });
@@ -2068,6 +3411,16 @@ template<> void ClassDef<Percentile>::init() {
 template<> void ClassDef<Constructor<Percentile>>::init() {
   super<Function>();
   ctor();
+
+  method("sketch", [](Context &ctx, Object *obj, Value &ret) {
+    double accuracy, min, max;
+    if (!ctx.arguments(3, &accuracy, &min, &max)) return;
+    try {
+      ret.set(Percentile::sketch(accuracy, min, max));
+    } catch (std::runtime_error &err) {
+      ctx.error(err);
+    }
+  });
 }
 
 //
@@ -2080,6 +3433,7 @@ template<> void ClassDef<Algo>::init() {
   variable("Quota", class_of<Constructor<Quota>>());
   variable("SharedMap", class_of<Constructor<SharedMap>>());
   variable("URLRouter", class_of<Constructor<URLRouter>>());
+  variable("MultiMatcher", class_of<Constructor<MultiMatcher>>());
   variable("LoadBalancer", class_of<Constructor<LoadBalancer>>());
   variable("HashingLoadBalancer", class_of<Constructor<HashingLoadBalancer>>());
   variable("RoundRobinLoadBalancer", class_of<Constructor<RoundRobinLoadBalancer>>());
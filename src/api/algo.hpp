@@ -27,6 +27,7 @@
 #define ALGO_HPP
 
 #include "pjs/pjs.hpp"
+#include "aho-corasick.hpp"
 #include "list.hpp"
 #include "net.hpp"
 #include "timer.hpp"
@@ -34,6 +35,7 @@
 
 #include <atomic>
 #include <limits>
+#include <list>
 #include <map>
 #include <mutex>
 #include <set>
@@ -46,11 +48,24 @@ namespace algo {
 // Cache
 //
 
-class Cache : public pjs::ObjectTemplate<Cache> {
+class Cache :
+  public pjs::ObjectTemplate<Cache>,
+  public List<Cache>::Item
+{
 public:
+  enum Policy {
+    LRU,
+    TINY_LFU,
+    ARC,
+  };
+
   struct Options : public pipy::Options {
     int size = 0;
+    size_t bytes = 0;
     double ttl = 0;
+    Policy policy = LRU;
+    pjs::Ref<pjs::Str> name;
+    bool shared = false;
 
     Options() {}
     Options(pjs::Object *options);
@@ -65,31 +80,50 @@ public:
   bool remove(const pjs::Value &key);
   bool remove(pjs::Context &ctx, const pjs::Value &key);
   bool clear(pjs::Context &ctx);
+  auto size() -> size_t;
 
 private:
   Cache(const Options &options, pjs::Function *allocate = nullptr, pjs::Function *free = nullptr);
   ~Cache();
 
-  struct Entry {
-    pjs::Value value;
-    double ttl;
-  };
+  template<class K, class V, class Hash, class EqualTo> class Store;
+  class SharedStore;
+
+  typedef Store<pjs::Value, pjs::Value, std::hash<pjs::Value>, std::equal_to<pjs::Value>> LocalStore;
+  typedef std::function<bool(const pjs::Value &, const pjs::Value &)> FreeFunc;
+  typedef std::vector<std::pair<pjs::Value, pjs::Value>> Evicted;
 
   Options m_options;
   pjs::Ref<pjs::Function> m_allocate;
   pjs::Ref<pjs::Function> m_free;
-  pjs::Ref<pjs::OrderedHash<pjs::Value, Entry>> m_cache;
+  pjs::Ref<pjs::Str> m_name;
+  LocalStore* m_store = nullptr;
+  pjs::Ref<SharedStore> m_shared;
+  uint64_t m_hits = 0;
+  uint64_t m_misses = 0;
+  uint64_t m_evictions = 0;
 
   bool get(
     const pjs::Value &key, pjs::Value &value,
-    const std::function<bool(pjs::Value &)> &allocate
+    const std::function<bool(pjs::Value &)> &allocate,
+    const FreeFunc &free
   );
 
   void set(
     const pjs::Value &key, const pjs::Value &value,
-    const std::function<bool(const pjs::Value &, const pjs::Value &)> &free
+    const FreeFunc &free
   );
 
+  bool lookup(const pjs::Value &key, pjs::Value &value, double now);
+  bool erase(const pjs::Value &key, pjs::Value &value);
+  auto free_func(pjs::Context &ctx) -> FreeFunc;
+  auto now() const -> double;
+
+  static auto weight_of(const pjs::Value &value) -> size_t;
+  static auto shared_key(const pjs::Value &key) -> pjs::Ref<pjs::Str>;
+  static auto all() -> List<Cache>&;
+  static void init_metrics();
+
   friend class pjs::ObjectTemplate<Cache>;
 };
 
@@ -239,44 +273,91 @@ private:
   //
   // SharedMap::Map
   //
+  // Keys are spread over shards by their cached hashes. Each shard
+  // has a reader-writer spin lock, which is held in shared mode for
+  // lookups and numeric updates. Numbers are kept in atomics so that
+  // add() and sub() never block each other.
+  //
 
   class Map : public pjs::RefCountMT<Map> {
   public:
+    enum { SHARD_COUNT = 16 };
+
     static auto get(const std::string &name) -> Map*;
+    static void for_each(const std::function<void(Map*)> &callback);
 
+    auto name() const -> const std::string& { return m_name; }
     auto size() -> size_t;
     void clear();
     bool erase(pjs::Str::CharData *key);
     bool has(pjs::Str::CharData *key);
     bool get(pjs::Str::CharData *key, pjs::SharedValue &value);
-    void set(pjs::Str::CharData *key, const pjs::SharedValue &value);
+    void set(pjs::Str::CharData *key, const pjs::Value &value);
     auto add(pjs::Str::CharData *key, double value) -> double;
-    auto sub(pjs::Str::CharData *key, double value) -> double;
+    auto contentions(int shard) -> uint64_t;
 
   private:
+    Map(const std::string &name) : m_name(name) {}
+
     typedef pjs::Ref<pjs::Str::CharData> Key;
 
     struct Hash {
       size_t operator()(const Key &k) const {
-        std::hash<std::string> h;
-        return h(k->str());
+        return k->hash();
       }
     };
 
     struct EqualTo {
       bool operator()(const Key &a, const Key &b) const {
-        return a->str() == b->str();
+        return a == b || a->str() == b->str();
       }
     };
 
-    std::unordered_map<Key, pjs::SharedValue, Hash, EqualTo> m_map;
-    std::mutex m_mutex;
+    struct Entry {
+      pjs::SharedValue value;
+      std::atomic<double> number;
+      bool is_number = false;
+    };
+
+    //
+    // SharedMap::Map::Shard
+    //
+
+    class Shard {
+    public:
+      std::unordered_map<Key, Entry, Hash, EqualTo> map;
+
+      void lock_shared();
+      void unlock_shared();
+      void lock();
+      void unlock();
+      auto contentions() -> uint64_t { return m_contentions.exchange(0, std::memory_order_relaxed); }
+
+    private:
+      enum { WRITER = 1 << 30 };
+
+      std::atomic<int> m_state{0};
+      std::atomic<uint64_t> m_contentions{0};
+
+      void wait(int &spins);
+    };
+
+    std::string m_name;
+    Shard m_shards[SHARD_COUNT];
+
+    auto shard_of(pjs::Str::CharData *key) -> Shard& {
+      return m_shards[(key->hash() >> 8) % SHARD_COUNT];
+    }
 
     static std::map<std::string, Map*> m_maps;
     static std::mutex m_maps_mutex;
+
+    friend class pjs::RefCountMT<Map>;
   };
 
   pjs::Ref<Map> m_map;
+
+  static void init_metrics();
 };
 
 //
@@ -313,41 +394,97 @@ class URLRouter : public pjs::ObjectTemplate<URLRouter> {
 public:
   void add(const std::string &url, const pjs::Value &value);
   bool find(const std::string &url, pjs::Value &value);
+  bool find(const char *url, size_t len, pjs::Value &value, pjs::Object *params = nullptr);
+  auto size() const -> size_t { return m_size; }
 
 private:
   URLRouter();
   URLRouter(pjs::Object *rules);
   ~URLRouter();
 
-  struct Node {
-    std::map<std::string, Node*> children;
-    pjs::Value value;
+  enum { MAX_CAPTURES = 32 };
 
-    auto child(const std::string &name) -> Node* {
-      auto i = children.find(name);
-      return i == children.end() ? nullptr : i->second;
-    }
+  //
+  // URLRouter::Route
+  //
 
-    auto new_child(const std::string &name) -> Node* {
-      auto i = children.find(name);
-      if (i != children.end()) return i->second;
-      return children[name] = new Node;
-    }
+  struct Route {
+    pjs::Value value;
+    std::vector<pjs::Ref<pjs::Str>> params;
+  };
 
-    ~Node() {
-      for (auto &i : children) {
-        delete i.second;
-      }
-    }
+  //
+  // URLRouter::Captures
+  //
+
+  struct Captures {
+    const char *ptr[MAX_CAPTURES];
+    size_t len[MAX_CAPTURES];
+    int count = 0;
   };
 
-  Node* m_root;
+  //
+  // URLRouter::Node
+  //
+  // A node in a compressed radix trie. Static text is stored on the
+  // edges, with one child per distinct first byte. A ':param' or a
+  // '*' in the middle of a path matches one segment through the
+  // param child. A trailing '*' makes a prefix route on the node,
+  // matching the rest of the path from a segment boundary onwards.
+  //
+
+  struct Node {
+    std::string label;
+    std::string heads;
+    std::vector<Node*> children;
+    Node* param = nullptr;
+    Node* paths = nullptr;
+    Route* exact = nullptr;
+    Route* prefix = nullptr;
+
+    ~Node();
+
+    auto insert(const char *str, size_t len) -> Node*;
+    auto lookup(const char *str, size_t len) const -> const Node*;
+    auto match(const char *str, size_t len, Captures &captures) const -> const Route*;
+  };
 
-  void dump(Node *node, int level);
+  Node m_hosts;
+  Node m_wildcard_hosts;
+  Node m_paths;
+  size_t m_size = 0;
 
   friend class pjs::ObjectTemplate<URLRouter>;
 };
 
+//
+// MultiMatcher
+//
+
+class MultiMatcher : public pjs::ObjectTemplate<MultiMatcher> {
+public:
+  struct Options : public pipy::Options {
+    bool ignore_case = false;
+    Options() {}
+    Options(pjs::Object *options);
+  };
+
+  auto automaton() const -> AhoCorasick* { return m_automaton; }
+
+  bool test(const pjs::Value &input);
+  auto find(const pjs::Value &input) -> int;
+  auto find_all(const pjs::Value &input) -> pjs::Array*;
+
+private:
+  MultiMatcher(pjs::Array *patterns, const Options &options);
+
+  pjs::Ref<AhoCorasick> m_automaton;
+
+  void scan(const pjs::Value &input, const AhoCorasick::Scanner::Callback &cb);
+
+  friend class pjs::ObjectTemplate<MultiMatcher>;
+};
+
 //
 // LoadBalancer
 //
@@ -544,17 +681,77 @@ private:
 
 class HashingLoadBalancer : public pjs::ObjectTemplate<HashingLoadBalancer, LoadBalancerBase> {
 public:
+
+  //
+  // HashingLoadBalancer::Algorithm
+  //
+
+  enum class Algorithm {
+    MODULO,
+    RING,
+    MAGLEV,
+  };
+
+  //
+  // HashingLoadBalancer::Options
+  //
+
+  struct Options : public pipy::Options {
+    Algorithm algorithm = Algorithm::MODULO;
+    int replicas = 160;
+    int table_size = 65537;
+    double load_factor = 0;
+    Options() {}
+    Options(pjs::Object *options);
+  };
+
   void set(pjs::Object *targets);
-  void add(pjs::Str *target);
+  void set(pjs::Str *target, double weight);
+  void add(pjs::Str *target, double weight = 1);
 
   virtual auto select(const pjs::Value &key, Cache *unhealthy) -> pjs::Str* override;
-  virtual void deselect(pjs::Str *target) override {}
+  virtual void deselect(pjs::Str *target) override;
 
 private:
-  HashingLoadBalancer(pjs::Object *targets, Cache *unhealthy = nullptr);
+  HashingLoadBalancer(pjs::Object *targets, Cache *unhealthy = nullptr, const Options &options = Options());
   ~HashingLoadBalancer();
 
-  std::vector<pjs::Ref<pjs::Str>> m_targets;
+  struct Target {
+    pjs::Ref<pjs::Str> id;
+    double weight;
+    uint64_t hash;
+    int load;
+    bool placed;
+    bool removed;
+  };
+
+  //
+  // Points on the ring are sorted by hash. Which point to start
+  // looking from is found in an index of hash prefixes, so that
+  // lookups take constant time on average.
+  //
+
+  struct Point {
+    uint64_t hash;
+    Target *target;
+  };
+
+  Options m_options;
+  std::list<Target> m_targets;
+  std::map<pjs::Str*, std::list<Target>::iterator> m_target_map;
+  std::vector<Target*> m_order;
+  std::vector<Point> m_ring;
+  std::vector<uint32_t> m_ring_index;
+  int m_ring_shift = 0;
+  std::vector<Target*> m_table;
+  double m_total_weight = 0;
+  int m_total_load = 0;
+  bool m_dirty = false;
+
+  void rebuild();
+  void build_ring();
+  void build_maglev();
+  bool is_available(Target *target, Cache *unhealthy);
 
   friend class pjs::ObjectTemplate<HashingLoadBalancer, LoadBalancerBase>;
 };
@@ -626,21 +823,42 @@ private:
 
 class Percentile : public pjs::ObjectTemplate<Percentile> {
 public:
+  static auto sketch(double accuracy, double min, double max) -> pjs::Array*;
+
   void reset();
   auto size() const -> size_t { return m_buckets.size(); }
   auto get(int bucket) -> size_t;
   void set(int bucket, size_t count);
   void observe(double sample);
-  auto calculate(int percentage) -> double;
+  auto calculate(double percentage) -> double;
   void dump(const std::function<void(double, size_t)> &cb);
 
 private:
   Percentile(pjs::Array *buckets);
 
+  //
+  // Buckets are located by a log-linear index of samples, made of
+  // the exponent and the top mantissa bits of a double, which maps
+  // to the first bucket that can hold a sample with that index
+  //
+
+  enum {
+    INDEX_SUB_BITS = 4,
+    INDEX_MAX_SIZE = 1 << 16,
+  };
+
   std::vector<size_t> m_counts;
   std::vector<double> m_buckets;
+  std::vector<uint32_t> m_index;
+  uint64_t m_index_base = 0;
+  double m_index_min = 0;
   size_t m_sample_count;
 
+  void build_index();
+  auto index_of(double sample) const -> size_t;
+
+  static auto index_key(double sample) -> uint64_t;
+
   friend class pjs::ObjectTemplate<Percentile>;
 };
 
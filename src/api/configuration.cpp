@@ -334,11 +334,11 @@ void FilterConfigurator::link(pjs::Function *name) {
   }
 }
 
-void FilterConfigurator::link_async(pjs::Function *name) {
+void FilterConfigurator::link_async(pjs::Function *name, pjs::Object *options) {
   if (name) {
-    append_filter(new LinkAsync(name));
+    append_filter(new LinkAsync(name, options));
   } else {
-    require_sub_pipeline(append_filter(new LinkAsync()));
+    require_sub_pipeline(append_filter(new LinkAsync(nullptr, options)));
   }
 }
 
@@ -1881,11 +1881,13 @@ template<> void ClassDef<FilterConfigurator>::init() {
     try {
       Str *name;
       Function *name_f;
+      Object *options = nullptr;
+      if (!ctx.check(1, options, options)) return;
       if (ctx.get(0, name)) {
-        config->link_async();
+        config->link_async(nullptr, options);
         config->to(name);
       } else if (ctx.get(0, name_f)) {
-        config->link_async(name_f);
+        config->link_async(name_f, options);
       } else {
         ctx.error_argument_type(0, "a string or a function");
       }
@@ -108,7 +108,7 @@ public:
   void handle_tls_client_hello(pjs::Function *callback);
   void insert(pjs::Object *events);
   void link(pjs::Function *name = nullptr);
-  void link_async(pjs::Function *name = nullptr);
+  void link_async(pjs::Function *name = nullptr, pjs::Object *options = nullptr);
   void loop();
   void mux(pjs::Function *session_selector, pjs::Object *options);
   void mux_fcgi(pjs::Function *session_selector, pjs::Object *options);
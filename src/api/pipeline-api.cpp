@@ -63,6 +63,7 @@
 #include "filters/replace-message.hpp"
 #include "filters/replace-start.hpp"
 #include "filters/resp.hpp"
+#include "filters/scan-body.hpp"
 #include "filters/socks.hpp"
 #include "filters/split.hpp"
 #include "filters/swap.hpp"
@@ -406,6 +407,10 @@ void PipelineDesigner::print() {
   append_filter(new Print());
 }
 
+void PipelineDesigner::scan_body(const pjs::Value &matcher, pjs::Function *callback) {
+  append_filter(new ScanBody(matcher, callback));
+}
+
 void PipelineDesigner::serve_http(pjs::Object *handler, pjs::Object *options) {
   append_filter(new http::Server(handler, options));
 }
@@ -1247,6 +1252,14 @@ template<> void ClassDef<PipelineDesigner>::init() {
     obj->replace_start(replacement);
   });
 
+  // PipelineDesigner.scanMessageBody
+  filter("scanMessageBody", [](Context &ctx, PipelineDesigner *obj) {
+    Value matcher;
+    Function *callback;
+    if (!ctx.arguments(2, &matcher, &callback)) return;
+    obj->scan_body(matcher, callback);
+  });
+
   // PipelineDesigner.serveHTTP
   filter("serveHTTP", [](Context &ctx, PipelineDesigner *obj) {
     Object *handler;
@@ -1510,7 +1510,7 @@ auto Histogram::get_value(int dim) -> double {
 void Histogram::set_value(int dim, double value) {
   int size = m_percentile->size();
   if (0 <= dim && dim < size) {
-    m_percentile->set(dim - 1, value);
+    m_percentile->set(dim, value);
   }
   switch (dim - size) {
     case 0: m_count = value; break;
@@ -29,6 +29,8 @@
 namespace pipy {
 
 const size_t DATA_CHUNK_SIZE = 0x4000;
+const size_t DATA_CHUNK_SIZE_MIN = 0x200;
+const size_t DATA_CHUNK_SIZE_MAX = 0x10000;
 const size_t RECEIVE_BUFFER_SIZE = 0x4000;
 
 } // namespace pipy
@@ -41,6 +41,16 @@ auto Data::Producer::producer_list_mutex() -> std::mutex& {
   return s_mutex;
 }
 
+auto Data::Chunk::pool(int size_class) -> pjs::Pool& {
+  thread_local static pjs::PooledClass s_classes[SIZE_CLASSES] = {
+    { "pipy::Data::Chunk[512]", sizeof(Chunk) + class_size(0) },
+    { "pipy::Data::Chunk[2K]", sizeof(Chunk) + class_size(1) },
+    { "pipy::Data::Chunk[16K]", sizeof(Chunk) + class_size(2) },
+    { "pipy::Data::Chunk[64K]", sizeof(Chunk) + class_size(3) },
+  };
+  return s_classes[size_class].pool();
+}
+
 void Data::pack(const Data &data, Producer *producer, double vacancy) {
   assert_same_thread(*this);
   if (&data == this) return;
@@ -55,13 +65,14 @@ void Data::pack(const Data &data, Producer *producer, double vacancy) {
     auto tail_offset = tail->offset;
     auto tail_length = tail->length;
     if (tail_length < occupancy || view->length + tail_length <= DATA_CHUNK_SIZE) {
-      if (tail_offset > 0 || tail->chunk->retain_count > 1) {
-        tail = tail->clone(producer);
+      auto size = std::min(view->length + tail_length, int(DATA_CHUNK_SIZE));
+      if (tail_offset > 0 || tail->chunk->retain_count > 1 || tail->chunk->size() < size) {
+        tail = tail->clone(producer, size);
         delete pop_view();
         push_view(tail);
       }
-      auto tail_room = DATA_CHUNK_SIZE - tail_length;
-      auto length = std::min(view->length, int(tail_room));
+      auto tail_room = tail->chunk->size() - tail_length;
+      auto length = std::min(view->length, tail_room);
       std::memcpy(
         tail->chunk->data + tail_length,
         view->chunk->data + view->offset,
@@ -84,6 +95,21 @@ void Data::pack(const Data &data, Producer *producer, double vacancy) {
   }
 }
 
+void Data::shrink(Producer *producer) {
+  assert_same_thread(*this);
+  if (!producer) producer = &s_unknown_producer;
+  int capacity = 0;
+  for (auto view = m_head; view; view = view->next) {
+    capacity += view->chunk->size();
+  }
+  if (m_size * 4 > capacity) return;
+  Data data;
+  for (auto view = m_head; view; view = view->next) {
+    data.push(view->chunk->data + view->offset, view->length, producer);
+  }
+  *this = std::move(data);
+}
+
 auto Data::to_string(Encoding encoding) const -> std::string {
   assert_same_thread(*this);
   switch (encoding) {
@@ -30,12 +30,14 @@
 #include "constants.hpp"
 #include "list.hpp"
 #include "options.hpp"
+#include "simd.hpp"
 #include "utils.hpp"
 
 #include <cstring>
 #include <functional>
 #include <atomic>
 #include <mutex>
+#include <new>
 
 namespace pipy {
 
@@ -81,13 +83,14 @@ public:
       }
     }
 
-    Producer(const std::string &name) : m_name(name), m_count(0) {
+    Producer(const std::string &name) : m_name(name), m_count(0), m_size(0) {
       std::lock_guard<std::mutex> lock(producer_list_mutex());
       s_all_producers.push(this);
     }
 
     auto name() const -> const std::string& { return m_name; }
     auto count() const -> size_t { return m_count.load(std::memory_order_relaxed); }
+    auto size() const -> size_t { return m_size.load(std::memory_order_relaxed); }
 
     Data* make(int size) { return Data::make(size, this); }
     Data* make(int size, int value) { return Data::make(size, value, this); }
@@ -108,11 +111,19 @@ public:
   private:
     std::string m_name;
     std::atomic<size_t> m_count;
+    std::atomic<size_t> m_size;
 
     static auto producer_list_mutex() -> std::mutex&;
 
-    void increase() { m_count.fetch_add(1, std::memory_order_relaxed); }
-    void decrease() { m_count.fetch_sub(1, std::memory_order_relaxed); }
+    void increase(size_t size) {
+      m_count.fetch_add(1, std::memory_order_relaxed);
+      m_size.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    void decrease(size_t size) {
+      m_count.fetch_sub(1, std::memory_order_relaxed);
+      m_size.fetch_sub(size, std::memory_order_relaxed);
+    }
 
     static List<Producer> s_all_producers;
 
@@ -128,10 +139,10 @@ public:
     Builder(Data &data, Producer *producer = nullptr)
       : m_data(data)
       , m_producer(producer)
-      , m_chunk(new Chunk(producer)) {}
+      , m_chunk(Chunk::make(producer, DATA_CHUNK_SIZE_MIN)) {}
 
     ~Builder() {
-      delete m_chunk;
+      m_chunk->destroy();
     }
 
     int size() const {
@@ -146,7 +157,7 @@ public:
     void flush() {
       if (m_ptr > 0) {
         m_data.push_view(new View(m_chunk, 0, m_ptr));
-        m_chunk = new Chunk(m_producer);
+        m_chunk = Chunk::make(m_producer, m_chunk->size());
         m_ptr = 0;
       }
     }
@@ -154,8 +165,8 @@ public:
     void push(char c) {
       m_chunk->data[m_ptr++] = c;
       m_size++;
-      if (m_ptr >= sizeof(m_chunk->data)) {
-        flush();
+      if (m_ptr >= m_chunk->size()) {
+        grow();
       }
     }
 
@@ -167,16 +178,12 @@ public:
       auto &p = m_ptr;
       m_size += n;
       while (n > 0) {
-        int l = sizeof(m_chunk->data) - p;
+        int l = m_chunk->size() - p;
         if (l > n) l = n;
         std::memset(m_chunk->data + p, c, l);
         p += l;
         n -= l;
-        if (p >= sizeof(m_chunk->data)) {
-          m_data.push_view(new View(m_chunk, 0, p));
-          m_chunk = new Chunk(m_producer);
-          p = 0;
-        }
+        if (p >= m_chunk->size()) grow();
       }
     }
 
@@ -188,17 +195,13 @@ public:
       auto &p = m_ptr;
       m_size += n;
       while (n > 0) {
-        int l = sizeof(m_chunk->data) - p;
+        int l = m_chunk->size() - p;
         if (l > n) l = n;
         std::memcpy(m_chunk->data + p, s, l);
         s += l;
         p += l;
         n -= l;
-        if (p >= sizeof(m_chunk->data)) {
-          m_data.push_view(new View(m_chunk, 0, p));
-          m_chunk = new Chunk(m_producer);
-          p = 0;
-        }
+        if (p >= m_chunk->size()) grow();
       }
     }
 
@@ -234,6 +237,14 @@ public:
     Chunk* m_chunk;
     int m_ptr = 0;
     int m_size = 0;
+
+    // Start small and move up a size class every time a chunk fills up
+    void grow() {
+      auto size = std::min(m_chunk->size() * 4, int(DATA_CHUNK_SIZE));
+      m_data.push_view(new View(m_chunk, 0, m_ptr));
+      m_chunk = Chunk::make(m_producer, size);
+      m_ptr = 0;
+    }
   };
 
   //
@@ -359,22 +370,63 @@ private:
   //
   // Data::Chunk
   //
+  // Chunks come in a few size classes, each from its own pool,
+  // so that a small payload does not pin down a full-sized chunk.
+  //
 
-  struct Chunk : public Pooled<Chunk> {
-    std::atomic<int> retain_count;
-    char data[DATA_CHUNK_SIZE];
+  struct Chunk {
+    enum { SIZE_CLASSES = 4 };
 
-    Chunk(Producer *producer)
-      : retain_count(0)
-      , m_producer(producer ? producer : Producer::unknown()) { m_producer->increase(); }
-    ~Chunk() { m_producer->decrease(); }
+    static auto class_size(int size_class) -> int {
+      static const int sizes[SIZE_CLASSES] = {
+        DATA_CHUNK_SIZE_MIN,
+        DATA_CHUNK_SIZE_MIN * 4,
+        DATA_CHUNK_SIZE,
+        DATA_CHUNK_SIZE_MAX,
+      };
+      return sizes[size_class];
+    }
+
+    static auto size_class(int size) -> int {
+      for (int i = 0; i < SIZE_CLASSES - 1; i++) {
+        if (size <= class_size(i)) return i;
+      }
+      return SIZE_CLASSES - 1;
+    }
+
+    // Makes a chunk of the smallest class that holds the size,
+    // or of the largest class if none does
+    static auto make(Producer *producer, int size = DATA_CHUNK_SIZE) -> Chunk* {
+      auto c = size_class(size);
+      return new (pool(c).alloc()) Chunk(producer, c);
+    }
+
+    std::atomic<int> retain_count;
 
-    auto size() const -> int { return sizeof(data); }
+    auto size() const -> int { return class_size(m_size_class); }
     void retain() { retain_count.fetch_add(1, std::memory_order_relaxed); }
-    void release() { if (retain_count.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this; }
+    void release() { if (retain_count.fetch_sub(1, std::memory_order_acq_rel) == 1) destroy(); }
+
+    void destroy() {
+      auto &p = pool(m_size_class);
+      this->~Chunk();
+      p.free(this);
+    }
 
   private:
+    Chunk(Producer *producer, int size_class)
+      : retain_count(0)
+      , m_producer(producer ? producer : Producer::unknown())
+      , m_size_class(size_class) { m_producer->increase(size()); }
+    ~Chunk() { m_producer->decrease(size()); }
+
     Producer* m_producer;
+    int m_size_class;
+
+    static auto pool(int size_class) -> pjs::Pool&;
+
+  public:
+    char data[];
   };
 
   //
@@ -432,9 +484,9 @@ private:
       return view;
     }
 
-    View* clone(Producer *producer) {
+    View* clone(Producer *producer, int size = 0) {
       if (!producer) producer = &s_unknown_producer;
-      auto new_chunk = new Chunk(producer);
+      auto new_chunk = Chunk::make(producer, std::max(size, length));
       std::memcpy(new_chunk->data, chunk->data + offset, length);
       return new View(new_chunk, 0, length);
     }
@@ -446,6 +498,10 @@ public:
     return data && data->empty();
   }
 
+  static auto chunk_size(int size) -> int {
+    return Chunk::class_size(Chunk::size_class(size));
+  }
+
   //
   // Data::Chunks
   //
@@ -501,7 +557,7 @@ public:
   {
     if (!producer) producer = &s_unknown_producer;
     while (size > 0) {
-      auto chunk = new Chunk(producer);
+      auto chunk = Chunk::make(producer, size);
       auto length = std::min(size, chunk->size());
       push_view(new View(chunk, 0, length));
       size -= length;
@@ -515,7 +571,7 @@ public:
   {
     if (!producer) producer = &s_unknown_producer;
     while (size > 0) {
-      auto chunk = new Chunk(producer);
+      auto chunk = Chunk::make(producer, size);
       auto length = std::min(size, chunk->size());
       std::memset(chunk->data, value, length);
       push_view(new View(chunk, 0, length));
@@ -713,6 +769,7 @@ public:
     assert_same_thread(*this);
     if (!producer) producer = &s_unknown_producer;
     const char *p = (const char*)data;
+    int size = 0;
     if (auto view = m_tail) {
       auto chunk = view->chunk;
       if (chunk->retain_count == 1) {
@@ -720,13 +777,16 @@ public:
         m_size += added;
         p += added;
         n -= added;
+        size = chunk->size();
       }
     }
     while (n > 0) {
-      auto view = new View(new Chunk(producer), 0, 0);
+      size = std::min(size * 4, int(DATA_CHUNK_SIZE));
+      auto view = new View(Chunk::make(producer, std::max(size, n)), 0, 0);
       auto added = view->push(p, n);
       p += added;
       n -= added;
+      size = view->chunk->size();
       push_view(view);
     }
   }
@@ -737,6 +797,7 @@ public:
 
   void push(char ch, Producer *producer) {
     assert_same_thread(*this);
+    int size = 0;
     if (auto tail = m_tail) {
       auto chunk = tail->chunk;
       if (chunk->retain_count == 1) {
@@ -747,9 +808,10 @@ public:
           m_size++;
           return;
         }
+        size = std::min(chunk->size() * 4, int(DATA_CHUNK_SIZE));
       }
     }
-    auto chunk = new Chunk(producer ? producer : &s_unknown_producer);
+    auto chunk = Chunk::make(producer ? producer : &s_unknown_producer, size);
     auto view = new View(chunk, 0, 1);
     chunk->data[0] = ch;
     push_view(view);
@@ -926,7 +988,27 @@ public:
     }
   }
 
+  bool shift_to(char c, Data &out) {
+    assert_same_thread(*this);
+    assert_same_thread(out);
+    while (auto view = m_head) {
+      auto size = view->length;
+      auto n = int(simd::find_byte(view->chunk->data + view->offset, size, c));
+      auto found = (n < size);
+      if (found) n++;
+      if (n == size) {
+        out.push_view(shift_view());
+      } else {
+        out.push_view(view->shift(n));
+        m_size -= n;
+      }
+      if (found) return true;
+    }
+    return false;
+  }
+
   void pack(const Data &data, Producer *producer, double vacancy = 0.5);
+  void shrink(Producer *producer);
 
   void to_chunks(const std::function<void(const uint8_t*, int)> &cb) const {
     assert_same_thread(*this);
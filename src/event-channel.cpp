@@ -0,0 +1,126 @@
+/*
+ *  Copyright (c) 2019 by flomesh.io
+ *
+ *  Unless prior written consent has been obtained from the copyright
+ *  owner, the following shall not be allowed.
+ *
+ *  1. The distribution of any source codes, header files, make files,
+ *     or libraries of the software.
+ *
+ *  2. Disclosure of any source codes pertaining to the software to any
+ *     additional parties.
+ *
+ *  3. Alteration or removal of any notices in or on the software or
+ *     within the documentation included within the software.
+ *
+ *  ALL SOURCE CODE AS WELL AS ALL DOCUMENTATION INCLUDED WITH THIS
+ *  SOFTWARE IS PROVIDED IN AN “AS IS” CONDITION, WITHOUT WARRANTY OF ANY
+ *  KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ *  CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ *  TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ *  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "event-channel.hpp"
+#include "input.hpp"
+
+namespace pipy {
+
+thread_local size_t EventChannel::s_wakeups = 0;
+
+auto EventChannel::current() -> EventChannel* {
+  thread_local static EventChannel s_channel;
+  return &s_channel;
+}
+
+auto EventChannel::wakeups() -> size_t {
+  auto n = s_wakeups;
+  s_wakeups = 0;
+  return n;
+}
+
+EventChannel::EventChannel()
+  : m_net(&Net::current())
+  , m_head(&m_stub)
+  , m_tail(&m_stub)
+  , m_depth(0)
+  , m_scheduled(false)
+{
+  m_stub.next.store(nullptr, std::memory_order_relaxed);
+}
+
+void EventChannel::send(Receiver *receiver, int tag, SharedEvent *se) {
+  auto *msg = new Message;
+  msg->receiver = receiver;
+  msg->event = se ? se->retain() : nullptr;
+  msg->tag = tag;
+  m_depth.fetch_add(1, std::memory_order_relaxed);
+  push(msg);
+  schedule();
+}
+
+void EventChannel::push(Message *msg) {
+  msg->next.store(nullptr, std::memory_order_relaxed);
+  auto *prev = m_head.exchange(msg, std::memory_order_acq_rel);
+  prev->next.store(msg, std::memory_order_release);
+}
+
+//
+// Returns nullptr when the queue is empty, and also when a producer
+// has swapped in a new head but has not linked it yet. In the latter
+// case that producer is about to call schedule(), which posts another
+// drain since the flag has been cleared before popping.
+//
+
+auto EventChannel::pop() -> Message* {
+  auto *tail = m_tail;
+  auto *next = tail->next.load(std::memory_order_acquire);
+  if (tail == &m_stub) {
+    if (!next) return nullptr;
+    m_tail = tail = next;
+    next = next->next.load(std::memory_order_acquire);
+  }
+  if (next) {
+    m_tail = next;
+    return tail;
+  }
+  if (tail != m_head.load(std::memory_order_acquire)) return nullptr;
+  push(&m_stub);
+  next = tail->next.load(std::memory_order_acquire);
+  if (next) {
+    m_tail = next;
+    return tail;
+  }
+  return nullptr;
+}
+
+void EventChannel::schedule() {
+  if (!m_scheduled.exchange(true, std::memory_order_acq_rel)) {
+    m_net->post([this]() { drain(); });
+  }
+}
+
+void EventChannel::drain() {
+  s_wakeups++;
+  m_scheduled.store(false, std::memory_order_seq_cst);
+
+  InputContext ic;
+  int n = 0;
+  while (n < BATCH_SIZE) {
+    auto *msg = pop();
+    if (!msg) break;
+    m_depth.fetch_sub(1, std::memory_order_relaxed);
+    auto *se = msg->event;
+    msg->receiver->on_receive(se, msg->tag);
+    if (se) se->release();
+    delete msg;
+    n++;
+  }
+
+  // Yield to other handlers and continue with the rest later
+  if (n == BATCH_SIZE) schedule();
+}
+
+} // namespace pipy
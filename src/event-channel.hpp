@@ -0,0 +1,96 @@
+/*
+ *  Copyright (c) 2019 by flomesh.io
+ *
+ *  Unless prior written consent has been obtained from the copyright
+ *  owner, the following shall not be allowed.
+ *
+ *  1. The distribution of any source codes, header files, make files,
+ *     or libraries of the software.
+ *
+ *  2. Disclosure of any source codes pertaining to the software to any
+ *     additional parties.
+ *
+ *  3. Alteration or removal of any notices in or on the software or
+ *     within the documentation included within the software.
+ *
+ *  ALL SOURCE CODE AS WELL AS ALL DOCUMENTATION INCLUDED WITH THIS
+ *  SOFTWARE IS PROVIDED IN AN “AS IS” CONDITION, WITHOUT WARRANTY OF ANY
+ *  KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ *  CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ *  TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ *  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef EVENT_CHANNEL_HPP
+#define EVENT_CHANNEL_HPP
+
+#include "event.hpp"
+#include "net.hpp"
+
+#include <atomic>
+
+namespace pipy {
+
+//
+// EventChannel
+//
+// Per-thread mailbox for events sent from other threads. Any thread can
+// send, only the owning thread receives. Messages are linked into a
+// lock-free MPSC queue and drained in batches, so the owning thread is
+// woken up once per batch instead of once per event.
+//
+
+class EventChannel {
+public:
+  enum { BATCH_SIZE = 256 };
+
+  //
+  // EventChannel::Receiver
+  //
+
+  class Receiver {
+  public:
+    virtual void on_receive(SharedEvent *se, int tag) = 0;
+  };
+
+  static auto current() -> EventChannel*;
+  static auto wakeups() -> size_t;
+
+  EventChannel();
+
+  void send(Receiver *receiver, int tag, SharedEvent *se);
+  auto depth() const -> size_t { return m_depth.load(std::memory_order_relaxed); }
+
+private:
+
+  //
+  // EventChannel::Message
+  //
+
+  struct Message : public pjs::Pooled<Message> {
+    Receiver* receiver = nullptr;
+    SharedEvent* event = nullptr;
+    int tag = 0;
+    std::atomic<Message*> next;
+  };
+
+  Net* m_net;
+  std::atomic<Message*> m_head;
+  Message* m_tail;
+  Message m_stub;
+  std::atomic<size_t> m_depth;
+  std::atomic<bool> m_scheduled;
+
+  void push(Message *msg);
+  auto pop() -> Message*;
+  void schedule();
+  void drain();
+
+  thread_local static size_t s_wakeups;
+};
+
+} // namespace pipy
+
+#endif // EVENT_CHANNEL_HPP
@@ -103,7 +103,10 @@ protected:
 // MessageStart
 //
 
-class MessageStart : public EventTemplate<MessageStart> {
+class MessageStart :
+  public EventTemplate<MessageStart>,
+  public pjs::ArenaResident
+{
 public:
   static const Type __TYPE = Type::MessageStart;
 
@@ -127,7 +130,10 @@ private:
 // MessageEnd
 //
 
-class MessageEnd : public EventTemplate<MessageEnd> {
+class MessageEnd :
+  public EventTemplate<MessageEnd>,
+  public pjs::ArenaResident
+{
 public:
   static const Type __TYPE = Type::MessageEnd;
 
@@ -158,7 +164,10 @@ private:
 // StreamEnd
 //
 
-class StreamEnd : public EventTemplate<StreamEnd> {
+class StreamEnd :
+  public EventTemplate<StreamEnd>,
+  public pjs::ArenaResident
+{
 public:
   static const Type __TYPE = Type::StreamEnd;
 
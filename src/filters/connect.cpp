@@ -24,7 +24,10 @@
  */
 
 #include "connect.hpp"
+#include "context.hpp"
+#include "inbound.hpp"
 #include "outbound.hpp"
+#include "pipeline.hpp"
 #include "utils.hpp"
 
 namespace pipy {
@@ -53,6 +56,12 @@ Connect::Options::Options(pjs::Object *options) {
   Value(options, "bufferLimit")
     .get_binary_size(buffer_limit)
     .check_nullable();
+  Value(options, "zeroCopyThreshold")
+    .get_binary_size(zero_copy_threshold)
+    .check_nullable();
+  Value(options, "batchSize")
+    .get(batch_size)
+    .check_nullable();
   Value(options, "retryCount")
     .get(retry_count)
     .check_nullable();
@@ -226,6 +235,17 @@ void Connect::process(Event *evt) {
       Filter::error("%s", e.what());
       return;
     }
+
+    // With nothing else in the pipeline to look at the bytes,
+    // the inbound can hand them over to the outbound by itself
+    if (protocol == Outbound::Protocol::TCP) {
+      auto p = Filter::pipeline();
+      if (p->layout()->filter_count() == 1) {
+        if (auto inbound = Filter::context()->inbound()) {
+          inbound->splice(p, m_outbound);
+        }
+      }
+    }
   }
 
   if (m_outbound) {
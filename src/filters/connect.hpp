@@ -50,6 +50,8 @@ public:
   Connect(const pjs::Value &target, const Options &options);
   Connect(const pjs::Value &target, pjs::Function *options);
 
+  auto outbound() const -> Outbound* { return m_outbound; }
+
 private:
   Connect(const Connect &r);
   ~Connect();
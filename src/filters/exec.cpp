@@ -34,6 +34,7 @@
 
 #ifndef _WIN32
 
+#include <signal.h>
 #include <unistd.h>
 #include <sys/wait.h>
 
@@ -279,6 +280,7 @@ bool Exec::exec_argv(const std::list<std::string> &args, const std::list<std::st
     pid = forkpty(&master_fd, nullptr, &term, nullptr);
 
     if (pid == 0) {
+      signal(SIGPIPE, SIG_DFL);
       if (env.size() > 0) {
         execve(argv[0], argv, envp);
       } else {
@@ -310,6 +312,7 @@ bool Exec::exec_argv(const std::list<std::string> &args, const std::list<std::st
       dup2(in[0], 0);
       dup2(out[1], 1);
       dup2(err[1], 2);
+      signal(SIGPIPE, SIG_DFL);
       if (env.size() > 0) {
         execve(argv[0], argv, envp);
       } else {
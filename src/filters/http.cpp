@@ -30,6 +30,7 @@
 #include "pipeline.hpp"
 #include "module.hpp"
 #include "inbound.hpp"
+#include "simd.hpp"
 #include "str-map.hpp"
 #include "utils.hpp"
 
@@ -101,6 +102,7 @@ thread_local static const StrMap s_strmap_headers({
   "content-length",
   "content-type",
   "transfer-encoding",
+  "upgrade",
 });
 
 thread_local static const StrMap s_strmap_header_values({
@@ -291,26 +293,39 @@ static auto read_str(Data::Reader &dr, char ending, const StrMap &strmap, char *
   }
 }
 
-static auto read_str_lower(Data::Reader &dr, char ending, const StrMap &strmap, char *buf, char *buf_lower) -> pjs::Str* {
+//
+// Parses a header line with the colon and CR found by vector scans,
+// looking up the lower-cased name and the value in the precomputed maps
+//
+
+static bool parse_header(
+  const char *line, size_t len, char *buf_lower,
+  const char *&name, pjs::Ref<pjs::Str> &key, pjs::Ref<pjs::Str> &val
+) {
+  auto colon = simd::find_byte(line, len, ':');
+  if (colon == len) return false;
   size_t i = 0;
-  StrMap::Parser p(strmap);
-  pjs::Str *found = nullptr;
-  for (;;) {
-    auto c = dr.get();
-    if (c < 0) return nullptr;
-    if (c == ending) {
-      if (found && found != pjs::Str::empty) {
-        return found;
-      } else {
-        return i > 0 ? pjs::Str::make(buf_lower, i) : nullptr;
-      }
-    }
-    if (c == ' ' && !i) continue;
-    auto l = std::tolower(c);
-    found = p.parse(l);
-    buf_lower[i] = l;
-    buf[i++] = c;
+  while (i < colon && line[i] == ' ') i++;
+  if (i == colon) return false;
+  auto name_len = colon - i;
+  name = line + i;
+  simd::to_lower(name, buf_lower, name_len);
+  key = s_strmap_headers.match(buf_lower, name_len);
+  if (!key) key = pjs::Str::make(buf_lower, name_len);
+
+  auto p = line + colon + 1;
+  auto n = len - colon - 1;
+  auto cr = simd::find_byte(p, n, '\r');
+  if (cr == n) return false;
+  i = 0;
+  while (i < cr && p[i] == ' ') i++;
+  if (i == cr) {
+    val = pjs::Str::empty;
+  } else {
+    val = s_strmap_header_values.match(p + i, cr - i);
+    if (!val) val = pjs::Str::make(p + i, cr - i);
   }
+  return true;
 }
 
 static auto read_uint(Data::Reader &dr, char ending) -> int {
@@ -373,76 +388,55 @@ void Decoder::on_event(Event *evt) {
       data->shift(n, output);
       if (0 == (m_current_size -= n)) state = (state == BODY ? HEAD : CHUNK_TAIL);
 
-    // byte scan the head
-    } else {
-      data->shift_to(
-        [&](int c) -> bool {
-          switch (state) {
-          case HEAD:
-            if (c == '\n') {
-              state = HEAD_EOL;
-              return true;
-            }
-            return false;
-
-          case HEADER:
-            if (c == '\n') {
-              state = HEADER_EOL;
-              return true;
-            }
-            return false;
+    // vector scan the head for line endings
+    } else if (state == HEAD || state == HEADER) {
+      if (data->shift_to('\n', output)) {
+        state = (state == HEAD ? HEAD_EOL : HEADER_EOL);
+      }
 
-          case CHUNK_HEAD:
-            m_body_size++;
-            if (c == '\n') {
-              if (m_current_size > 0) {
-                state = CHUNK_BODY;
-                return true;
-              } else {
-                state = CHUNK_LAST;
-                return false;
+    // vector scan the chunk heads, tails and the last chunk
+    } else if (state == CHUNK_HEAD || state == CHUNK_TAIL || state == CHUNK_LAST) {
+      while (state == CHUNK_HEAD || state == CHUNK_TAIL || state == CHUNK_LAST) {
+        Data line;
+        auto eol = data->shift_to('\n', line);
+        m_body_size += line.size();
+        if (state == CHUNK_HEAD) {
+          line.to_chunks(
+            [this](const uint8_t *p, int n) {
+              for (int i = 0; i < n; i++) {
+                auto c = p[i];
+                if ('0' <= c && c <= '9') m_current_size = (m_current_size << 4) + (c - '0');
+                else if ('a' <= c && c <= 'f') m_current_size = (m_current_size << 4) + (c - 'a') + 10;
+                else if ('A' <= c && c <= 'F') m_current_size = (m_current_size << 4) + (c - 'A') + 10;
               }
             }
-            else if ('0' <= c && c <= '9') m_current_size = (m_current_size << 4) + (c - '0');
-            else if ('a' <= c && c <= 'f') m_current_size = (m_current_size << 4) + (c - 'a') + 10;
-            else if ('A' <= c && c <= 'F') m_current_size = (m_current_size << 4) + (c - 'A') + 10;
-            return false;
-
-          case CHUNK_TAIL:
-            m_body_size++;
-            if (c == '\n') {
-              state = CHUNK_HEAD;
-              m_current_size = 0;
-            }
-            return false;
-
-          case CHUNK_LAST:
-            m_body_size++;
-            if (c == '\n') {
-              state = HEAD;
-              return true;
-            }
-            return false;
-
-          case HEAD_EOL:
-          case HEADER_EOL:
-            return false;
+          );
+        }
+        if (!eol) break;
+        if (state == CHUNK_HEAD) {
+          state = (m_current_size > 0 ? CHUNK_BODY : CHUNK_LAST);
+        } else if (state == CHUNK_TAIL) {
+          state = CHUNK_HEAD;
+          m_current_size = 0;
+        } else {
+          state = HEAD;
+        }
+      }
 
+    // byte scan the HTTP/2 preface
+    } else {
+      data->shift_to(
+        [&](int c) -> bool {
+          switch (state) {
           case HTTP2_PREFACE:
             if (!--m_current_size) {
               state = HTTP2_PASS;
               return true;
             }
             return false;
-
-          case HTTP2_PASS:
-            return false;
-
           default:
-            // case BODY:
-            // case CHUNK_BODY:
-            // handle in the 'fast scan'
-            return true;
+            // case HTTP2_PASS:
+            return false;
           }
         },
         output
@@ -527,10 +521,10 @@ void Decoder::on_event(Event *evt) {
         pjs::vl_array<char, DATA_CHUNK_SIZE> buf_lower(len);
         m_head_size += len;
         if (len > 2) {
-          Data::Reader dr(m_head_buffer);
-          pjs::Ref<pjs::Str> key(read_str_lower(dr, ':', s_strmap_headers, buf, buf_lower));
-          pjs::Ref<pjs::Str> val(read_str(dr, '\r', s_strmap_header_values, buf_lower));
-          if (!key || !val) { error(); break; }
+          m_head_buffer.to_bytes((uint8_t *)(char *)buf);
+          const char *name;
+          pjs::Ref<pjs::Str> key, val;
+          if (!parse_header(buf, len, buf_lower, name, key, val)) { error(); break; }
           auto headers = m_head->headers.get();
           if (key == s_cookie || key == s_set_cookie) {
             pjs::Value old;
@@ -554,9 +548,9 @@ void Decoder::on_event(Event *evt) {
             if (v) headers->set(key, v);
           }
           if (auto names = m_head->headerNames.get()) {
-            pjs::Ref<pjs::Str> name(pjs::Str::make(buf, key->size()));
-            if (name != key) {
-              names->set(key, name.get());
+            pjs::Ref<pjs::Str> original(pjs::Str::make(name, key->size()));
+            if (original != key) {
+              names->set(key, original.get());
             }
           }
           state = HEADER;
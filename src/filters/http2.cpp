@@ -85,6 +85,15 @@ thread_local static const pjs::ConstStr s_trailers("trailers");
 thread_local static const pjs::ConstStr s_content_length("content-length");
 thread_local static const pjs::ConstStr s_cookie("cookie");
 thread_local static const pjs::ConstStr s_set_cookie("set-cookie");
+thread_local static const pjs::ConstStr s_authorization("authorization");
+thread_local static const pjs::ConstStr s_proxy_authorization("proxy-authorization");
+thread_local static const pjs::ConstStr s_date("date");
+thread_local static const pjs::ConstStr s_age("age");
+thread_local static const pjs::ConstStr s_etag("etag");
+thread_local static const pjs::ConstStr s_last_modified("last-modified");
+thread_local static const pjs::ConstStr s_if_modified_since("if-modified-since");
+thread_local static const pjs::ConstStr s_if_none_match("if-none-match");
+thread_local static const pjs::ConstStr s_location("location");
 
 static struct {
   const char *name;
@@ -675,8 +684,9 @@ void FrameEncoder::header(uint8_t *buf, int id, uint8_t type, uint8_t flags, siz
 //
 
 void DynamicTable::reset() {
+  auto mask = m_entries.size() - 1;
   for (auto i = m_tail + 1; i <= m_head; i++) {
-    auto entry = m_entries[i % MAX_ENTRY_COUNT];
+    auto entry = m_entries[i & mask];
     delete entry;
   }
   m_size = 0;
@@ -687,27 +697,34 @@ void DynamicTable::reset() {
 auto DynamicTable::get(size_t i) const -> const TableEntry* {
   auto n = m_head - m_tail;
   if (i >= n) return nullptr;
-  return m_entries[(m_head - i) % MAX_ENTRY_COUNT];
+  return m_entries[(m_head - i) & (m_entries.size() - 1)];
 }
 
 void DynamicTable::add(pjs::Str *name, pjs::Str *value) {
+  if (m_head - m_tail + 1 >= m_entries.size()) grow();
   auto i = ++m_head;
-  if (i - m_tail >= MAX_ENTRY_COUNT) {
-    auto entry = m_entries[++m_tail % MAX_ENTRY_COUNT];
-    m_size -= 32 + entry->name->size() + entry->value->size();
-    delete entry;
-  }
-  auto entry = m_entries[i % MAX_ENTRY_COUNT] = new TableEntry;
+  auto entry = m_entries[i & (m_entries.size() - 1)] = new TableEntry;
   entry->name = name;
   entry->value = value;
   m_size += 32 + name->size() + value->size();
   evict();
 }
 
+void DynamicTable::grow() {
+  auto old_size = m_entries.size();
+  auto new_size = old_size ? old_size * 2 : 16;
+  std::vector<TableEntry*> entries(new_size);
+  for (auto i = m_tail + 1; i <= m_head; i++) {
+    entries[i & (new_size - 1)] = m_entries[i & (old_size - 1)];
+  }
+  m_entries.swap(entries);
+}
+
 void DynamicTable::evict() {
+  auto mask = m_entries.size() - 1;
   while (m_size > m_capacity) {
     auto i = ++m_tail;
-    auto entry = m_entries[i % MAX_ENTRY_COUNT];
+    auto entry = m_entries[i & mask];
     m_size -= 32 + entry->name->size() + entry->value->size();
     delete entry;
   }
@@ -719,7 +736,7 @@ void DynamicTable::evict() {
 
 thread_local
 const HeaderDecoder::StaticTable HeaderDecoder::s_static_table;
-const HeaderDecoder::HuffmanTree HeaderDecoder::s_huffman_tree;
+const HeaderDecoder::HuffmanTable HeaderDecoder::s_huffman_table;
 
 HeaderDecoder::HeaderDecoder(const Settings &settings)
   : m_settings(settings)
@@ -775,14 +792,14 @@ auto HeaderDecoder::decode(Data &data) -> ErrorCode {
         }
         case NAME_LENGTH: {
           if (read_int(c)) {
-            m_ptr = 0;
+            m_huffman_state = 0;
             m_state = NAME_STRING;
           }
           break;
         }
         case NAME_STRING: {
           if (read_str(c, true)) {
-            m_name = pjs::Str::make(m_buffer.to_string());
+            m_name = pjs::Str::make(m_buffer);
             m_buffer.clear();
             m_state = VALUE_PREFIX;
           }
@@ -800,14 +817,14 @@ auto HeaderDecoder::decode(Data &data) -> ErrorCode {
         }
         case VALUE_LENGTH: {
           if (read_int(c)) {
-            m_ptr = 0;
+            m_huffman_state = 0;
             m_state = VALUE_STRING;
           }
           break;
         }
         case VALUE_STRING: {
           if (read_str(c, false)) {
-            auto value = pjs::Str::make(m_buffer.to_string());
+            auto value = pjs::Str::make(m_buffer);
             m_buffer.clear();
             if (add_field(m_name, value)) {
               if (m_is_new) new_entry(m_name, value);
@@ -853,35 +870,26 @@ bool HeaderDecoder::read_int(uint8_t c) {
 
 bool HeaderDecoder::read_str(uint8_t c, bool lowercase_only) {
   if (m_prefix & 0x80) {
-    const auto &tree = s_huffman_tree.get();
-    int last_bit = 8;
-    for (int b = 7; b >= 0; b--) {
-      bool bit = (c >> b) & 1;
-      m_ptr = bit ? tree[m_ptr].right : tree[m_ptr].left;
-      auto &node = tree[m_ptr];
-      if (!node.left) {
-        auto ch = node.right;
-        if (ch == 256) {
-          error(); // EOS is considered an error
+    for (int i = 0; i < 2; i++) {
+      const auto &step = s_huffman_table.step(m_huffman_state, i ? c & 0x0f : c >> 4);
+      if (step.flags & HuffmanTable::FAIL) {
+        error(); // EOS is considered an error
+        return false;
+      }
+      if (step.flags & HuffmanTable::SYMBOL) {
+        auto ch = step.symbol;
+        if (lowercase_only && std::tolower(ch) != ch) {
+          error(PROTOCOL_ERROR);
           return false;
         }
-        if (lowercase_only) {
-          if (std::tolower(ch) != ch) {
-            error(PROTOCOL_ERROR);
-            return false;
-          }
-        }
-        s_dp.push(&m_buffer, char(ch));
-        m_ptr = 0;
-        last_bit = b;
+        m_buffer.push_back(char(ch));
       }
+      m_huffman_state = step.state;
+      m_huffman_accepted = step.flags & HuffmanTable::ACCEPT;
     }
-    if (m_int == 1) {
-      uint8_t mask = uint8_t(1 << last_bit) - 1;
-      if (mask == 0xff || (c & mask) != mask) {
-        error();
-        return false;
-      }
+    if (m_int == 1 && !m_huffman_accepted) {
+      error();
+      return false;
     }
   } else {
     if (lowercase_only) {
@@ -890,7 +898,7 @@ bool HeaderDecoder::read_str(uint8_t c, bool lowercase_only) {
         return false;
       }
     }
-    s_dp.push(&m_buffer, c);
+    m_buffer.push_back(char(c));
   }
   return !--m_int;
 }
@@ -952,7 +960,7 @@ void HeaderDecoder::name_prefix(uint8_t prefix) {
     m_exp = 0;
     m_state = NAME_LENGTH;
   } else {
-    m_ptr = 0;
+    m_huffman_state = 0;
     m_state = NAME_STRING;
   }
 }
@@ -963,7 +971,7 @@ void HeaderDecoder::value_prefix(uint8_t prefix) {
     m_exp = 0;
     m_state = VALUE_LENGTH;
   } else {
-    m_ptr = 0;
+    m_huffman_state = 0;
     m_state = VALUE_STRING;
   }
 }
@@ -1096,26 +1104,68 @@ HeaderDecoder::StaticTable::StaticTable() {
 }
 
 //
-// HeaderDecoder::HuffmanTree
+// HeaderDecoder::HuffmanTable
 //
 
-HeaderDecoder::HuffmanTree::HuffmanTree() {
+HeaderDecoder::HuffmanTable::HuffmanTable() {
+  struct Node {
+    uint16_t child[2] = { 0, 0 };
+    uint16_t symbol = 0;
+    int state = -1;
+    bool accepted = false;
+  };
+
+  // Build the code tree
+  std::vector<Node> tree(1);
   int n = sizeof(s_hpack_huffman_table) / sizeof(s_hpack_huffman_table[0]);
-  m_tree.resize(1);
   for (int i = 0; i < n; i++) {
     auto &p = s_hpack_huffman_table[i];
     int ptr = 0;
     for (int b = p.bits - 1; b >= 0; b--) {
-      bool bit = (p.code >> b) & 1;
-      auto &node = m_tree[ptr];
-      ptr = bit ? node.right : node.left;
-      if (!ptr) {
-        ptr = m_tree.size();
-        (bit ? node.right : node.left) = ptr;
-        m_tree.emplace_back();
+      int bit = (p.code >> b) & 1;
+      if (!tree[ptr].child[bit]) {
+        tree[ptr].child[bit] = tree.size();
+        tree.emplace_back();
       }
+      ptr = tree[ptr].child[bit];
+    }
+    tree[ptr].symbol = i;
+  }
+
+  // Up to 7 bits of 1s are a valid padding
+  for (int i = 0, depth = 0; depth < 8; i = tree[i].child[1], depth++) {
+    tree[i].accepted = true;
+  }
+
+  // Number the inner nodes as states
+  int state_count = 0;
+  for (auto &node : tree) {
+    if (node.child[0]) node.state = state_count++;
+  }
+
+  // Walk 4 bits from every state
+  for (const auto &node : tree) {
+    if (node.state < 0) continue;
+    for (int nibble = 0; nibble < 16; nibble++) {
+      auto &step = m_steps[node.state][nibble];
+      step.flags = 0;
+      step.symbol = 0;
+      const Node *p = &node;
+      for (int b = 3; b >= 0; b--) {
+        p = &tree[p->child[(nibble >> b) & 1]];
+        if (!p->child[0]) {
+          if (p->symbol == 256) {
+            step.flags = FAIL;
+            break;
+          }
+          step.flags |= SYMBOL;
+          step.symbol = p->symbol;
+          p = &tree[0];
+        }
+      }
+      step.state = p->state < 0 ? 0 : p->state;
+      if (p->accepted) step.flags |= ACCEPT;
     }
-    m_tree[ptr].right = i;
   }
 }
 
@@ -1124,10 +1174,41 @@ HeaderDecoder::HuffmanTree::HuffmanTree() {
 //
 
 thread_local HeaderEncoder::StaticTable HeaderEncoder::m_static_table;
+thread_local size_t HeaderEncoder::s_raw_size = 0;
+thread_local size_t HeaderEncoder::s_encoded_size = 0;
+
+HeaderEncoder::HeaderEncoder(Indexing indexing, size_t max_table_size)
+  : m_indexing(indexing)
+  , m_max_table_size(max_table_size)
+{
+  reset();
+}
+
+void HeaderEncoder::reset() {
+  m_dynamic_table.reset();
+  m_dynamic_table.resize(Settings::DEFAULT_HEADER_TABLE_SIZE);
+  m_table_size_changed = false;
+  resize(Settings::DEFAULT_HEADER_TABLE_SIZE);
+}
+
+void HeaderEncoder::resize(size_t peer_table_size) {
+  auto size = std::min(peer_table_size, m_max_table_size);
+  if (m_indexing == Indexing::NEVER) size = 0;
+  if (!m_table_size_changed) {
+    if (size == m_dynamic_table.capacity()) return;
+    m_min_table_size = size;
+    m_table_size_changed = true;
+  } else if (size < m_min_table_size) {
+    m_min_table_size = size;
+  }
+  m_dynamic_table.resize(size);
+}
 
 void HeaderEncoder::encode(bool is_response, bool is_tail, pjs::Object *head, Data &data) {
+  auto size = data.size();
   Data::Builder db(data, &s_dp);
   bool has_authority = false;
+  encode_table_size(db);
   if (!is_tail) {
     if (is_response) {
       pjs::Ref<http::ResponseHead> h = pjs::coerce<http::ResponseHead>(head);
@@ -1196,21 +1277,87 @@ void HeaderEncoder::encode(bool is_response, bool is_tail, pjs::Object *head, Da
   }
 
   db.flush();
+  s_encoded_size += data.size() - size;
+}
+
+bool HeaderEncoder::is_empty(pjs::Object *head) {
+  if (!head) return true;
+  pjs::Value headers;
+  head->get(s_headers, headers);
+  if (!headers.is_object() || !headers.o()) return true;
+  return headers.o()->iterate_while(
+    [](pjs::Str *k, pjs::Value &) {
+      return (
+        k == pjs::Str::empty ||
+        k == s_connection ||
+        k == s_keep_alive ||
+        k == s_proxy_connection ||
+        k == s_transfer_encoding ||
+        k == s_upgrade
+      );
+    }
+  );
 }
 
 void HeaderEncoder::encode_header_field(Data::Builder &db, pjs::Str *k, pjs::Str *v) {
-  if (const auto *ent = m_static_table.find(k)) {
+  pjs::Ref<pjs::Str> name(k);
+  for (auto ch : k->str()) {
+    if (std::isupper(ch)) {
+      auto s = k->str();
+      for (auto &c : s) c = std::tolower(c);
+      name = pjs::Str::make(std::move(s));
+      break;
+    }
+  }
+
+  s_raw_size += name->size() + v->size();
+
+  int name_index = 0;
+  if (const auto *ent = m_static_table.find(name)) {
     auto i = ent->values.find(v);
-    if (i == ent->values.end()) {
-      encode_int(db, 0x00, 4, ent->index);
-      encode_str(db, v, false);
-    } else {
+    if (i != ent->values.end()) {
       encode_int(db, 0x80, 1, i->second);
+      return;
     }
+    name_index = ent->index;
+  }
+
+  int dynamic_name_index = 0;
+  if (auto i = m_dynamic_table.find(name, v, dynamic_name_index)) {
+    encode_int(db, 0x80, 1, i);
+    return;
+  }
+
+  if (!name_index) name_index = dynamic_name_index;
+
+  if (should_index(name, v)) {
+    encode_int(db, 0x40, 2, name_index);
+    m_dynamic_table.add(name, v);
+  } else if (
+    name == s_authorization ||
+    name == s_proxy_authorization ||
+    (name == s_cookie && v->size() < 20)
+  ) {
+    encode_int(db, 0x10, 4, name_index);
   } else {
-    encode_int(db, 0x00, 4, 0);
-    encode_str(db, k, true);
-    encode_str(db, v, false);
+    encode_int(db, 0x00, 4, name_index);
+  }
+
+  if (!name_index) encode_str(db, name);
+  encode_str(db, v);
+}
+
+//
+// Dynamic table size update must lead the first header block after a change,
+// announcing the smallest size in between if the table was shrunk and regrown
+//
+
+void HeaderEncoder::encode_table_size(Data::Builder &db) {
+  if (m_table_size_changed) {
+    auto size = m_dynamic_table.capacity();
+    if (m_min_table_size < size) encode_int(db, 0x20, 3, m_min_table_size);
+    encode_int(db, 0x20, 3, size);
+    m_table_size_changed = false;
   }
 }
 
@@ -1221,26 +1368,69 @@ void HeaderEncoder::encode_int(Data::Builder &db, uint8_t prefix, int prefix_len
   } else {
     db.push(uint8_t(prefix | mask));
     n -= mask;
-    while (n) {
-      if (n >> 7) {
-        db.push(uint8_t(0x80 | (n & 0x7f)));
-      } else {
-        db.push(uint8_t(n & 0x7f));
-      }
+    while (n >> 7) {
+      db.push(uint8_t(0x80 | (n & 0x7f)));
       n >>= 7;
     }
+    db.push(uint8_t(n));
   }
 }
 
-void HeaderEncoder::encode_str(Data::Builder &db, pjs::Str *s, bool lowercase) {
-  encode_int(db, 0, 1, s->size());
-  if (lowercase) {
-    for (auto ch : s->str()) {
-      db.push(char(std::tolower(ch)));
+//
+// String literals go Huffman-coded whenever that makes them shorter
+//
+
+void HeaderEncoder::encode_str(Data::Builder &db, pjs::Str *s) {
+  const auto &str = s->str();
+  size_t bits = 0;
+  for (auto ch : str) bits += s_hpack_huffman_table[uint8_t(ch)].bits;
+  auto size = (bits + 7) >> 3;
+  if (size < str.size()) {
+    encode_int(db, 0x80, 1, size);
+    uint64_t buf = 0;
+    int len = 0;
+    for (auto ch : str) {
+      const auto &h = s_hpack_huffman_table[uint8_t(ch)];
+      buf = (buf << h.bits) | h.code;
+      len += h.bits;
+      while (len >= 8) {
+        len -= 8;
+        db.push(uint8_t(buf >> len));
+      }
+    }
+    if (len > 0) {
+      db.push(uint8_t((buf << (8 - len)) | (0xff >> len)));
     }
   } else {
-    db.push(s->str());
+    encode_int(db, 0x00, 1, str.size());
+    db.push(str);
+  }
+}
+
+bool HeaderEncoder::should_index(pjs::Str *k, pjs::Str *v) const {
+  switch (m_indexing) {
+    case Indexing::NEVER: return false;
+    case Indexing::ALWAYS: break;
+    default:
+      if (
+        k == s_colon_path ||
+        k == s_content_length ||
+        k == s_authorization ||
+        k == s_proxy_authorization ||
+        k == s_set_cookie ||
+        k == s_date ||
+        k == s_age ||
+        k == s_etag ||
+        k == s_last_modified ||
+        k == s_if_modified_since ||
+        k == s_if_none_match ||
+        k == s_location ||
+        (k == s_cookie && v->size() < 20)
+      ) return false;
+      break;
   }
+  auto size = k->size() + v->size() + 32;
+  return size <= m_dynamic_table.capacity() / 2;
 }
 
 HeaderEncoder::StaticTable::StaticTable() {
@@ -1260,6 +1450,54 @@ auto HeaderEncoder::StaticTable::find(pjs::Str *name) -> const Entry* {
   return &i->second;
 }
 
+//
+// HeaderEncoder::DynamicTable
+//
+
+void HeaderEncoder::DynamicTable::reset() {
+  m_fields.clear();
+  m_index.clear();
+  m_size = 0;
+}
+
+auto HeaderEncoder::DynamicTable::find(pjs::Str *name, pjs::Str *value, int &name_index) const -> int {
+  auto i = m_index.find(name);
+  if (i == m_index.end()) return 0;
+  const auto &values = i->second;
+  auto j = values.find(value);
+  if (j != values.end()) return index_of(j->second);
+  name_index = index_of(values.begin()->second);
+  return 0;
+}
+
+void HeaderEncoder::DynamicTable::add(pjs::Str *name, pjs::Str *value) {
+  auto size = name->size() + value->size() + 32;
+  if (size > m_capacity) {
+    reset();
+    return;
+  }
+  evict(size);
+  auto id = m_next_id++;
+  m_fields.push_back({ name, value, id });
+  m_index[name][value] = id;
+  m_size += size;
+}
+
+void HeaderEncoder::DynamicTable::evict(size_t room) {
+  while (!m_fields.empty() && m_size + room > m_capacity) {
+    auto &f = m_fields.front();
+    auto i = m_index.find(f.name);
+    if (i != m_index.end()) {
+      auto &values = i->second;
+      auto j = values.find(f.value);
+      if (j != values.end() && j->second == f.id) values.erase(j);
+      if (values.empty()) m_index.erase(i);
+    }
+    m_size -= f.name->size() + f.value->size() + 32;
+    m_fields.pop_front();
+  }
+}
+
 //
 // Endpoint
 //
@@ -1277,12 +1515,19 @@ Endpoint::Options::Options(pjs::Object *options) {
   Value(options, "streamWindowSize")
     .get_binary_size(stream_window_size)
     .check_nullable();
+  Value(options, "headerTableSize")
+    .get_binary_size(header_table_size)
+    .check_nullable();
+  Value(options, "headerIndexing")
+    .get_enum(header_indexing)
+    .check_nullable();
 }
 
 Endpoint::Endpoint(bool is_server_side, const Options &options)
   : m_id(s_endpoint_id.fetch_add(1, std::memory_order_relaxed))
   , m_options(options)
   , m_header_decoder(m_settings)
+  , m_header_encoder(options.header_indexing, options.header_table_size)
   , m_is_server_side(is_server_side)
 {
   init_metrics();
@@ -1302,6 +1547,7 @@ void Endpoint::reset() {
   m_streams.clear();
   m_streams_pending.clear();
   m_header_decoder.reset();
+  m_header_encoder.reset();
   m_peer_settings = Settings();
   m_output_buffer.clear();
   m_last_received_stream_id = 0;
@@ -1314,6 +1560,7 @@ void Endpoint::reset() {
 
 void Endpoint::init_settings(const uint8_t *data, size_t size) {
   m_peer_settings.decode(data, size);
+  m_header_encoder.resize(m_peer_settings.header_table_size);
 }
 
 void Endpoint::process_event(Event *evt) {
@@ -1461,6 +1708,7 @@ void Endpoint::on_deframe(Frame &frm) {
             auto err = m_peer_settings.decode(buf, len);
             if (err == NO_ERROR) {
               bool ok = true;
+              m_header_encoder.resize(m_peer_settings.header_table_size);
               if (m_peer_settings.initial_window_size != old_initial_window_size) {
                 auto delta = m_peer_settings.initial_window_size - old_initial_window_size;
                 ok = for_each_stream(
@@ -1734,6 +1982,8 @@ void Endpoint::init_metrics() {
   if (!s_metrics_initialized) {
     thread_local static pjs::ConstStr s_server("Server");
     thread_local static pjs::ConstStr s_client("Client");
+    thread_local static pjs::ConstStr s_raw("raw");
+    thread_local static pjs::ConstStr s_encoded("encoded");
 
     pjs::Ref<pjs::Array> label_names = pjs::Array::make();
     label_names->length(1);
@@ -1751,6 +2001,22 @@ void Endpoint::init_metrics() {
       }
     );
 
+    label_names->set(0, "size");
+
+    stats::Counter::make(
+      pjs::Str::make("pipy_http2_header_bytes"),
+      label_names,
+      [=](stats::Counter *counter) {
+        pjs::Str *raw = s_raw;
+        pjs::Str *encoded = s_encoded;
+        auto raw_size = HeaderEncoder::raw_size();
+        auto encoded_size = HeaderEncoder::encoded_size();
+        counter->with_labels(&raw, 1)->increase(raw_size);
+        counter->with_labels(&encoded, 1)->increase(encoded_size);
+        counter->increase(raw_size);
+      }
+    );
+
     s_metrics_initialized = true;
   }
 }
@@ -1857,9 +2123,8 @@ void Endpoint::StreamBase::encoder_input(Event *evt) {
           } else {
             if (m_is_tunnel_requested) return;
           }
-          if (auto tail = end->tail()) {
-            m_header_encoder.encode(m_is_server_side, true, tail, m_tail_buffer);
-          }
+          auto tail = end->tail();
+          if (!HeaderEncoder::is_empty(tail)) m_tail = tail;
         }
         if (m_state == OPEN) {
           m_state = HALF_CLOSED_LOCAL;
@@ -2210,7 +2475,7 @@ void Endpoint::StreamBase::set_clearing(bool clearing) {
 }
 
 void Endpoint::StreamBase::pump() {
-  bool is_empty_end = (m_end_stream_send && m_send_buffer.empty() && m_tail_buffer.empty());
+  bool is_empty_end = (m_end_stream_send && m_send_buffer.empty() && !m_tail);
   int size = m_send_buffer.size();
   if (size > m_send_window) size = m_send_window;
   if (size > 0) size = deduct_send(size);
@@ -2223,7 +2488,7 @@ void Endpoint::StreamBase::pump() {
       frm.stream_id = m_id;
       frm.type = Frame::DATA;
       if (n > 0) m_send_buffer.shift(n, frm.payload);
-      if (m_end_stream_send && m_send_buffer.empty() && m_tail_buffer.empty()) {
+      if (m_end_stream_send && m_send_buffer.empty() && !m_tail) {
         frm.flags = Frame::BIT_END_STREAM;
         m_end_stream_send = false;
       } else {
@@ -2234,7 +2499,12 @@ void Endpoint::StreamBase::pump() {
     m_send_window -= size;
   }
   if (m_send_buffer.empty()) {
-    if (!m_tail_buffer.empty()) write_header_block(m_tail_buffer);
+    if (m_tail) {
+      Data buf;
+      m_header_encoder.encode(m_is_server_side, true, m_tail, buf);
+      m_tail = nullptr;
+      write_header_block(buf);
+    }
     set_pending(false);
   } else {
     set_pending(true);
@@ -2411,3 +2681,15 @@ void Client::Stream::end() {
 
 } // namespace http2
 } // namespace pipy
+
+namespace pjs {
+
+using namespace pipy::http2;
+
+template<> void EnumDef<HeaderEncoder::Indexing>::init() {
+  define(HeaderEncoder::Indexing::DEFAULT, "default");
+  define(HeaderEncoder::Indexing::ALWAYS, "always");
+  define(HeaderEncoder::Indexing::NEVER, "never");
+}
+
+} // namespace pjs
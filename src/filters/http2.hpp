@@ -37,6 +37,7 @@
 #include "demux.hpp"
 #include "options.hpp"
 
+#include <deque>
 #include <map>
 #include <vector>
 #include <iostream>
@@ -194,14 +195,19 @@ public:
   void add(pjs::Str *name, pjs::Str *value);
 
 private:
-  enum { MAX_ENTRY_COUNT = 128 };
 
-  TableEntry* m_entries[MAX_ENTRY_COUNT];
+  //
+  // Entries live in a ring that grows in powers of 2 as needed,
+  // so the table is bounded by its size in bytes only
+  //
+
+  std::vector<TableEntry*> m_entries;
   size_t m_capacity = Settings::DEFAULT_HEADER_TABLE_SIZE;
   size_t m_size = 0;
   size_t m_head = 0;
   size_t m_tail = 0;
 
+  void grow();
   void evict();
 };
 
@@ -239,14 +245,6 @@ private:
     VALUE_STRING,
   };
 
-  struct Huffman {
-    uint16_t left = 0;
-    union {
-      uint16_t right = 0;
-      uint16_t code;
-    };
-  };
-
   const Settings& m_settings;
   State m_state;
   ErrorCode m_error;
@@ -258,8 +256,9 @@ private:
   uint8_t m_prefix;
   uint8_t m_exp;
   uint32_t m_int;
-  uint16_t m_ptr;
-  Data m_buffer;
+  uint8_t m_huffman_state;
+  bool m_huffman_accepted;
+  std::string m_buffer;
   pjs::Ref<http::MessageHead> m_head;
   pjs::Ref<pjs::Str> m_name;
   int m_content_length;
@@ -291,20 +290,40 @@ private:
   };
 
   //
-  // HeaderDecoder::HuffmanTree
+  // HeaderDecoder::HuffmanTable
+  //
+  // Huffman codes are decoded 4 bits at a time. Each of the 256 states is an
+  // inner node of the code tree. A lookup by state and input nibble gives
+  // the next state and the symbol completed along the way, if any.
   //
 
-  class HuffmanTree {
+  class HuffmanTable {
   public:
-    HuffmanTree();
-    auto get() const -> const std::vector<Huffman>& { return m_tree; }
+    enum {
+      SYMBOL = 0x01, // a symbol is completed
+      ACCEPT = 0x02, // the remaining bits are a valid padding
+      FAIL   = 0x04, // EOS is decoded
+    };
+
+    struct Step {
+      uint8_t state;
+      uint8_t flags;
+      uint8_t symbol;
+    };
+
+    HuffmanTable();
+
+    auto step(uint8_t state, uint8_t nibble) const -> const Step& {
+      return m_steps[state][nibble];
+    }
+
   private:
-    std::vector<Huffman> m_tree;
+    Step m_steps[256][16];
   };
 
   thread_local
   static const StaticTable s_static_table;
-  static const HuffmanTree s_huffman_tree;
+  static const HuffmanTable s_huffman_table;
 };
 
 //
@@ -313,6 +332,26 @@ private:
 
 class HeaderEncoder {
 public:
+
+  //
+  // HeaderEncoder::Indexing
+  //
+  // DEFAULT indexes all fields except the volatile ones such as :path or date,
+  // and encodes credentials as never-indexed literals. ALWAYS indexes every
+  // field. NEVER leaves the dynamic table empty.
+  //
+
+  enum class Indexing {
+    DEFAULT,
+    ALWAYS,
+    NEVER,
+  };
+
+  HeaderEncoder(Indexing indexing = Indexing::DEFAULT, size_t max_table_size = Settings::DEFAULT_HEADER_TABLE_SIZE);
+
+  void reset();
+  void resize(size_t peer_table_size);
+
   void encode(
     bool is_response,
     bool is_tail,
@@ -320,6 +359,11 @@ public:
     Data &data
   );
 
+  static bool is_empty(pjs::Object *head);
+
+  static auto raw_size() -> size_t { auto n = s_raw_size; s_raw_size = 0; return n; }
+  static auto encoded_size() -> size_t { auto n = s_encoded_size; s_encoded_size = 0; return n; }
+
 private:
   void encode_header_field(
     Data::Builder &db,
@@ -327,8 +371,10 @@ private:
     pjs::Str *v
   );
 
+  void encode_table_size(Data::Builder &db);
   void encode_int(Data::Builder &db, uint8_t prefix, int prefix_len, uint32_t n);
-  void encode_str(Data::Builder &db, pjs::Str *s, bool lowercase);
+  void encode_str(Data::Builder &db, pjs::Str *s);
+  bool should_index(pjs::Str *k, pjs::Str *v) const;
 
   struct Entry {
     int index = 0;
@@ -347,7 +393,46 @@ private:
     std::map<pjs::Ref<pjs::Str>, Entry> m_table;
   };
 
+  //
+  // HeaderEncoder::DynamicTable
+  //
+
+  class DynamicTable {
+  public:
+    void reset();
+    auto capacity() const -> size_t { return m_capacity; }
+    void resize(size_t size) { m_capacity = size; evict(0); }
+    auto find(pjs::Str *name, pjs::Str *value, int &name_index) const -> int;
+    void add(pjs::Str *name, pjs::Str *value);
+
+  private:
+    struct Field {
+      pjs::Ref<pjs::Str> name;
+      pjs::Ref<pjs::Str> value;
+      uint64_t id;
+    };
+
+    std::deque<Field> m_fields;
+    std::map<pjs::Ref<pjs::Str>, std::map<pjs::Ref<pjs::Str>, uint64_t>> m_index;
+    uint64_t m_next_id = 0;
+    size_t m_capacity = Settings::DEFAULT_HEADER_TABLE_SIZE;
+    size_t m_size = 0;
+
+    auto index_of(uint64_t id) const -> int { return STATIC_TABLE_SIZE + int(m_next_id - id); }
+    void evict(size_t room);
+
+    enum { STATIC_TABLE_SIZE = 61 };
+  };
+
+  Indexing m_indexing;
+  size_t m_max_table_size;
+  size_t m_min_table_size = 0;
+  bool m_table_size_changed = false;
+  DynamicTable m_dynamic_table;
+
   thread_local static StaticTable m_static_table;
+  thread_local static size_t s_raw_size;
+  thread_local static size_t s_encoded_size;
 };
 
 //
@@ -363,6 +448,8 @@ public:
   struct Options : public pipy::Options {
     size_t connection_window_size = 0x100000;
     size_t stream_window_size = 0x100000;
+    size_t header_table_size = Settings::DEFAULT_HEADER_TABLE_SIZE;
+    HeaderEncoder::Indexing header_indexing = HeaderEncoder::Indexing::DEFAULT;
     Options() {}
     Options(pjs::Object *options);
   };
@@ -519,7 +606,7 @@ protected:
     HeaderDecoder& m_header_decoder;
     HeaderEncoder& m_header_encoder;
     Data m_send_buffer;
-    Data m_tail_buffer;
+    pjs::Ref<pjs::Object> m_tail;
     int m_send_window = INITIAL_SEND_WINDOW_SIZE;
     int m_recv_window;
     int m_recv_window_max;
@@ -32,12 +32,29 @@
 
 namespace pipy {
 
+//
+// LinkAsync::Options
+//
+
+LinkAsync::Options::Options(pjs::Object *options) {
+  Value(options, "policy")
+    .get_enum(policy)
+    .check_nullable();
+  Value(options, "key")
+    .get(key_f)
+    .check_nullable();
+  if (policy == PipelineLoadBalancer::Policy::HASHING && !key_f) {
+    throw std::runtime_error("options.key is required by policy 'hashing'");
+  }
+}
+
 //
 // LinkAsync
 //
 
-LinkAsync::LinkAsync(pjs::Function *name)
+LinkAsync::LinkAsync(pjs::Function *name, const Options &options)
   : m_name_f(name)
+  , m_options(options)
   , m_buffer(Filter::buffer_stats())
 {
 }
@@ -45,6 +62,7 @@ LinkAsync::LinkAsync(pjs::Function *name)
 LinkAsync::LinkAsync(const LinkAsync &r)
   : Filter(r)
   , m_name_f(r.m_name_f)
+  , m_options(r.m_options)
   , m_buffer(r.m_buffer)
 {
 }
@@ -82,10 +100,16 @@ void LinkAsync::process(Event *evt) {
       if (ret.is_nullish()) return;
 
       if (ret.is_string()) {
+        size_t hash = 0;
+        if (m_options.policy == PipelineLoadBalancer::Policy::HASHING) {
+          pjs::Value key;
+          if (!Filter::eval(m_options.key_f, key)) return;
+          hash = std::hash<pjs::Value>()(key);
+        }
         if (auto layout = module_legacy()->get_pipeline(ret.s())) {
           m_pipeline = sub_pipeline(layout, false, EventSource::reply())->start();
           m_is_started = true;
-        } else if (auto aw = static_cast<JSModule*>(module_legacy())->alloc_pipeline_lb(ret.s(), Filter::output())) {
+        } else if (auto aw = static_cast<JSModule*>(module_legacy())->alloc_pipeline_lb(ret.s(), Filter::output(), m_options.policy, hash)) {
           m_async_wrapper = aw;
           m_is_started = true;
         } else {
@@ -136,3 +160,16 @@ void LinkAsync::flush() {
 }
 
 } // namespace pipy
+
+namespace pjs {
+
+using namespace pipy;
+
+template<> void EnumDef<PipelineLoadBalancer::Policy>::init() {
+  define(PipelineLoadBalancer::Policy::ROUND_ROBIN, "round-robin");
+  define(PipelineLoadBalancer::Policy::LEAST_LOAD, "least-load");
+  define(PipelineLoadBalancer::Policy::LOCAL_FIRST, "local-first");
+  define(PipelineLoadBalancer::Policy::HASHING, "hashing");
+}
+
+} // namespace pjs
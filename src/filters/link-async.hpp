@@ -28,6 +28,7 @@
 
 #include "filter.hpp"
 #include "pipeline-lb.hpp"
+#include "options.hpp"
 #include "net.hpp"
 
 namespace pipy {
@@ -38,7 +39,14 @@ namespace pipy {
 
 class LinkAsync : public Filter, public EventSource {
 public:
-  LinkAsync(pjs::Function *name = nullptr);
+  struct Options : public pipy::Options {
+    PipelineLoadBalancer::Policy policy = PipelineLoadBalancer::Policy::ROUND_ROBIN;
+    pjs::Ref<pjs::Function> key_f;
+    Options() {}
+    Options(pjs::Object *options);
+  };
+
+  LinkAsync(pjs::Function *name = nullptr, const Options &options = Options());
 
 private:
   LinkAsync(const LinkAsync &r);
@@ -57,6 +65,7 @@ private:
   };
 
   pjs::Ref<pjs::Function> m_name_f;
+  Options m_options;
   pjs::Ref<Pipeline> m_pipeline;
   PipelineLoadBalancer::AsyncWrapper* m_async_wrapper = nullptr;
   EventBuffer m_buffer;
@@ -0,0 +1,125 @@
+/*
+ *  Copyright (c) 2019 by flomesh.io
+ *
+ *  Unless prior written consent has been obtained from the copyright
+ *  owner, the following shall not be allowed.
+ *
+ *  1. The distribution of any source codes, header files, make files,
+ *     or libraries of the software.
+ *
+ *  2. Disclosure of any source codes pertaining to the software to any
+ *     additional parties.
+ *
+ *  3. Alteration or removal of any notices in or on the software or
+ *     within the documentation included within the software.
+ *
+ *  ALL SOURCE CODE AS WELL AS ALL DOCUMENTATION INCLUDED WITH THIS
+ *  SOFTWARE IS PROVIDED IN AN “AS IS” CONDITION, WITHOUT WARRANTY OF ANY
+ *  KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ *  CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ *  TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ *  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "scan-body.hpp"
+#include "api/algo.hpp"
+
+namespace pipy {
+
+//
+// ScanBody
+//
+
+ScanBody::ScanBody(const pjs::Value &matcher, pjs::Function *callback)
+  : m_matcher(matcher)
+  , m_callback(callback)
+{
+}
+
+ScanBody::ScanBody(const ScanBody &r)
+  : Filter(r)
+  , m_matcher(r.m_matcher)
+  , m_callback(r.m_callback)
+{
+}
+
+ScanBody::~ScanBody()
+{
+  delete m_scanner;
+}
+
+void ScanBody::dump(Dump &d) {
+  Filter::dump(d);
+  d.name = "scanMessageBody";
+}
+
+auto ScanBody::clone() -> Filter* {
+  return new ScanBody(*this);
+}
+
+void ScanBody::reset() {
+  Filter::reset();
+  delete m_scanner;
+  m_scanner = nullptr;
+  m_matches = nullptr;
+  m_started = false;
+}
+
+void ScanBody::process(Event *evt) {
+  if (evt->is<MessageStart>()) {
+    if (!m_started && !start()) return;
+
+  } else if (auto data = evt->as<Data>()) {
+    if (m_started) {
+      m_scanner->input(
+        *data, [this](int i, size_t) {
+          if (!m_found[i]) {
+            m_found[i] = true;
+            m_matches->push(i);
+          }
+          return true;
+        }
+      );
+    }
+
+  } else if (evt->is<MessageEnd>() || evt->is<StreamEnd>()) {
+    if (m_started) end();
+  }
+
+  Filter::output(evt);
+}
+
+bool ScanBody::start() {
+  pjs::Value ret;
+  if (!eval(m_matcher, ret)) return false;
+  if (!ret.is<algo::MultiMatcher>()) {
+    Filter::error("matcher is not an algo.MultiMatcher");
+    return false;
+  }
+
+  auto *ac = ret.as<algo::MultiMatcher>()->automaton();
+  if (!m_scanner) {
+    m_scanner = new AhoCorasick::Scanner(ac);
+  } else if (m_scanner->automaton() != ac) {
+    delete m_scanner;
+    m_scanner = new AhoCorasick::Scanner(ac);
+  } else {
+    m_scanner->reset();
+  }
+
+  m_found.assign(ac->pattern_count(), false);
+  m_matches = pjs::Array::make();
+  m_started = true;
+  return true;
+}
+
+void ScanBody::end() {
+  pjs::Value arg(m_matches.get()), ret;
+  m_matches = nullptr;
+  m_started = false;
+  Filter::callback(m_callback, 1, &arg, ret);
+}
+
+} // namespace pipy
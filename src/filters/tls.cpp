@@ -24,13 +24,45 @@
  */
 
 #include "tls.hpp"
+#include "connect.hpp"
 #include "context.hpp"
+#include "inbound.hpp"
+#include "input.hpp"
+#include "net.hpp"
+#include "outbound.hpp"
 #include "module.hpp"
 #include "pipeline.hpp"
 #include "api/crypto.hpp"
+#include "utils.hpp"
 #include "log.hpp"
 
+#include <openssl/async.h>
 #include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+
+#ifndef PIPY_USE_OPENSSL1
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/tls.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#endif
 
 namespace pipy {
 namespace tls {
@@ -101,6 +133,10 @@ Options::Options(pjs::Object *options, const char *base_name) {
     .get(on_state_f)
     .check_nullable();
 
+  Value(options, "ktls", base_name)
+    .get(ktls)
+    .check_nullable();
+
 #if PIPY_USE_NTLS
   Value(options, "ntls", base_name)
     .get(ntls)
@@ -108,11 +144,328 @@ Options::Options(pjs::Object *options, const char *base_name) {
 #endif
 }
 
+//
+// SessionCache
+//
+
+SessionCache::SessionCache(size_t capacity, int shard_count) {
+  for (int i = 0; i < shard_count; i++) {
+    m_shards.emplace_back(new Shard);
+  }
+  reserve(capacity);
+}
+
+SessionCache::~SessionCache() {
+  for (const auto &shard : m_shards) {
+    for (const auto &p : shard->lru) {
+      SSL_SESSION_free(p.second);
+    }
+  }
+}
+
+auto SessionCache::server() -> SessionCache& {
+  static SessionCache s_cache(0, 16);
+  return s_cache;
+}
+
+void SessionCache::reserve(size_t capacity) {
+  auto n = m_shards.size();
+  auto size = (capacity + n - 1) / n;
+  for (const auto &shard : m_shards) {
+    std::lock_guard<std::mutex> lock(shard->lock);
+    if (size > shard->capacity) shard->capacity = size;
+  }
+}
+
+auto SessionCache::get(const std::string &key) -> SSL_SESSION* {
+  auto &shard = shard_of(key);
+  std::lock_guard<std::mutex> lock(shard.lock);
+  auto i = shard.map.find(key);
+  if (i == shard.map.end()) return nullptr;
+  shard.lru.splice(shard.lru.begin(), shard.lru, i->second);
+  auto session = i->second->second;
+  SSL_SESSION_up_ref(session);
+  return session;
+}
+
+void SessionCache::set(const std::string &key, SSL_SESSION *session) {
+  auto &shard = shard_of(key);
+  SSL_SESSION *evicted = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(shard.lock);
+    auto i = shard.map.find(key);
+    if (i != shard.map.end()) {
+      evicted = i->second->second;
+      i->second->second = session;
+      shard.lru.splice(shard.lru.begin(), shard.lru, i->second);
+    } else {
+      if (shard.lru.size() >= shard.capacity && !shard.lru.empty()) {
+        auto &last = shard.lru.back();
+        evicted = last.second;
+        shard.map.erase(last.first);
+        shard.lru.pop_back();
+      }
+      shard.lru.emplace_front(key, session);
+      shard.map[key] = shard.lru.begin();
+    }
+  }
+  if (evicted) SSL_SESSION_free(evicted);
+}
+
+void SessionCache::remove(const std::string &key) {
+  auto &shard = shard_of(key);
+  SSL_SESSION *removed = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(shard.lock);
+    auto i = shard.map.find(key);
+    if (i == shard.map.end()) return;
+    removed = i->second->second;
+    shard.lru.erase(i->second);
+    shard.map.erase(i);
+  }
+  SSL_SESSION_free(removed);
+}
+
+auto SessionCache::shard_of(const std::string &key) -> Shard& {
+  auto h = std::hash<std::string>()(key);
+  return *m_shards[h % m_shards.size()];
+}
+
+//
+// SessionTicketKeys
+//
+
+auto SessionTicketKeys::get() -> SessionTicketKeys& {
+  static SessionTicketKeys s_keys;
+  return s_keys;
+}
+
+void SessionTicketKeys::current(Key &key) {
+  std::lock_guard<std::mutex> lock(m_lock);
+  auto now = std::chrono::steady_clock::now();
+  if (!m_key_count || now - m_rotation_time >= std::chrono::seconds(ROTATION_INTERVAL)) {
+    rotate();
+    m_rotation_time = now;
+  }
+  key = m_keys[0];
+}
+
+auto SessionTicketKeys::find(const unsigned char *name, Key &key) -> int {
+  std::lock_guard<std::mutex> lock(m_lock);
+  for (int i = 0; i < m_key_count; i++) {
+    if (!std::memcmp(m_keys[i].name, name, sizeof(key.name))) {
+      key = m_keys[i];
+      return i == 0 ? 1 : 2; // 2 for renewing tickets issued with older keys
+    }
+  }
+  return 0;
+}
+
+void SessionTicketKeys::rotate() {
+  for (int i = KEY_COUNT - 1; i > 0; i--) m_keys[i] = m_keys[i-1];
+  auto &key = m_keys[0];
+  if (
+    RAND_bytes(key.name, sizeof(key.name)) <= 0 ||
+    RAND_bytes(key.aes_key, sizeof(key.aes_key)) <= 0 ||
+    RAND_bytes(key.hmac_key, sizeof(key.hmac_key)) <= 0
+  ) throw_error();
+  if (m_key_count < KEY_COUNT) m_key_count++;
+}
+
+//
+// CryptoThreadPool
+//
+
+class CryptoThreadPool {
+public:
+  static auto get() -> CryptoThreadPool& {
+    static auto *pool = new CryptoThreadPool(std::max(1u, std::thread::hardware_concurrency()));
+    return *pool;
+  }
+
+  void run(const std::function<void()> &job) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_jobs.push_back(job);
+    m_condition.notify_one();
+  }
+
+private:
+  CryptoThreadPool(int size) {
+    for (int i = 0; i < size; i++) {
+      std::thread(&CryptoThreadPool::main, this).detach();
+    }
+  }
+
+  std::mutex m_lock;
+  std::condition_variable m_condition;
+  std::deque<std::function<void()>> m_jobs;
+
+  void main() {
+    for (;;) {
+      std::function<void()> job;
+      {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_condition.wait(lock, [this]() { return !m_jobs.empty(); });
+        job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+      }
+      job();
+    }
+  }
+};
+
+//
+// AsyncKey
+//
+
+auto AsyncKey::wrap(EVP_PKEY *pkey) -> EVP_PKEY* {
+
+  //
+  // Wrapped keys are cached per original key, which is held
+  // until the cache grows too big and gets cleared
+  //
+
+  struct Cache : public std::map<EVP_PKEY*, EVP_PKEY*> {
+    ~Cache() { clear(); }
+    void clear() {
+      for (const auto &p : *this) {
+        EVP_PKEY_free(p.first);
+        EVP_PKEY_free(p.second);
+      }
+      std::map<EVP_PKEY*, EVP_PKEY*>::clear();
+    }
+  };
+
+  thread_local static Cache s_cache;
+
+  auto i = s_cache.find(pkey);
+  if (i != s_cache.end()) return i->second;
+  if (s_cache.size() >= 1000) s_cache.clear();
+
+  EVP_PKEY *wrapped = nullptr;
+  switch (EVP_PKEY_base_id(pkey)) {
+    case EVP_PKEY_RSA:
+      if (auto rsa = EVP_PKEY_get1_RSA(pkey)) {
+        if (auto dup = RSAPrivateKey_dup(rsa)) {
+          RSA_set_method(dup, rsa_method());
+          wrapped = EVP_PKEY_new();
+          EVP_PKEY_assign_RSA(wrapped, dup);
+        }
+        RSA_free(rsa);
+      }
+      break;
+    case EVP_PKEY_EC:
+      if (auto ec = EVP_PKEY_get1_EC_KEY(pkey)) {
+        if (auto dup = EC_KEY_dup(ec)) {
+          EC_KEY_set_method(dup, ec_method());
+          wrapped = EVP_PKEY_new();
+          EVP_PKEY_assign_EC_KEY(wrapped, dup);
+        }
+        EC_KEY_free(ec);
+      }
+      break;
+  }
+
+  if (!wrapped) {
+    EVP_PKEY_up_ref(pkey);
+    wrapped = pkey;
+  }
+
+  EVP_PKEY_up_ref(pkey);
+  s_cache[pkey] = wrapped;
+  return wrapped;
+}
+
+auto AsyncKey::sign(const std::function<int()> &op) -> int {
+  auto session = TLSSession::current();
+  if (!session || !ASYNC_get_current_job()) return op();
+
+  struct Result {
+    std::atomic<bool> done{false};
+    int ret = 0;
+  };
+
+  auto result = std::make_shared<Result>();
+  auto net = &Net::current();
+
+  session->on_async_wait();
+
+  CryptoThreadPool::get().run(
+    [=]() {
+      result->ret = op();
+      result->done = true;
+      net->post(
+        [=]() {
+          InputContext ic;
+          session->on_async_done();
+        }
+      );
+    }
+  );
+
+  do {
+    ASYNC_pause_job();
+  } while (!result->done);
+
+  return result->ret;
+}
+
+auto AsyncKey::rsa_method() -> RSA_METHOD* {
+  static auto *method = []() {
+    auto m = RSA_meth_dup(RSA_PKCS1_OpenSSL());
+    RSA_meth_set1_name(m, "pipy async RSA method");
+    RSA_meth_set_priv_enc(m, rsa_priv_enc);
+    return m;
+  }();
+  return method;
+}
+
+auto AsyncKey::ec_method() -> EC_KEY_METHOD* {
+  static auto *method = []() {
+    auto m = EC_KEY_METHOD_new(EC_KEY_OpenSSL());
+    int (*sign_setup)(EC_KEY*, BN_CTX*, BIGNUM**, BIGNUM**) = nullptr;
+    ECDSA_SIG* (*sign_sig)(const unsigned char*, int, const BIGNUM*, const BIGNUM*, EC_KEY*) = nullptr;
+    EC_KEY_METHOD_get_sign(m, nullptr, &sign_setup, &sign_sig);
+    EC_KEY_METHOD_set_sign(m, ec_sign, sign_setup, sign_sig);
+    return m;
+  }();
+  return method;
+}
+
+auto AsyncKey::rsa_priv_enc(
+  int flen,
+  const unsigned char *from,
+  unsigned char *to,
+  RSA *rsa,
+  int padding
+) -> int {
+  auto priv_enc = RSA_meth_get_priv_enc(RSA_PKCS1_OpenSSL());
+  return sign([=]() { return priv_enc(flen, from, to, rsa, padding); });
+}
+
+auto AsyncKey::ec_sign(
+  int type,
+  const unsigned char *dgst,
+  int dlen,
+  unsigned char *sig,
+  unsigned int *siglen,
+  const BIGNUM *kinv,
+  const BIGNUM *r,
+  EC_KEY *eckey
+) -> int {
+  int (*ec_sign)(int, const unsigned char*, int, unsigned char*, unsigned int*, const BIGNUM*, const BIGNUM*, EC_KEY*) = nullptr;
+  EC_KEY_METHOD_get_sign(EC_KEY_OpenSSL(), &ec_sign, nullptr, nullptr);
+  return sign([=]() { return ec_sign(type, dgst, dlen, sig, siglen, kinv, r, eckey); });
+}
+
 //
 // TLSContext
 //
 
-TLSContext::TLSContext(bool is_server, const Options &options) {
+TLSContext::TLSContext(bool is_server, const Options &options)
+  : m_is_server(is_server)
+  , m_ktls(options.ktls)
+{
 #if PIPY_USE_NTLS
   if(options.ntls) {
     m_ctx = SSL_CTX_new(is_server ? NTLS_server_method() : NTLS_client_method());
@@ -134,6 +487,11 @@ TLSContext::TLSContext(bool is_server, const Options &options) {
 
   SSL_CTX_set0_verify_cert_store(m_ctx, m_verify_store);
   SSL_CTX_set_tlsext_servername_callback(m_ctx, on_server_name);
+  SSL_CTX_set_app_data(m_ctx, this);
+
+  if (m_ktls) {
+    SSL_CTX_set_keylog_callback(m_ctx, on_keylog);
+  }
 
   if (options.alpn && is_server) {
     SSL_CTX_set_alpn_select_cb(m_ctx, on_select_alpn, this);
@@ -145,6 +503,10 @@ TLSContext::~TLSContext() {
   if (m_ctx) SSL_CTX_free(m_ctx);
 }
 
+auto TLSContext::get(SSL *ssl) -> TLSContext* {
+  return static_cast<TLSContext*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+}
+
 void TLSContext::set_protocol_versions(ProtocolVersion min, ProtocolVersion max) {
   auto f = [](ProtocolVersion v) {
     switch (v) {
@@ -198,6 +560,162 @@ void TLSContext::set_server_alpn(const std::set<pjs::Ref<pjs::Str>> &protocols)
   m_server_alpn = protocols;
 }
 
+void TLSContext::set_session_id_context(const unsigned char *data, size_t size) {
+  SSL_CTX_set_session_id_context(m_ctx, data, std::min(size, size_t(SSL_MAX_SID_CTX_LENGTH)));
+}
+
+void TLSContext::set_session_timeout(double timeout) {
+  if (timeout > 0) SSL_CTX_set_timeout(m_ctx, long(timeout));
+}
+
+void TLSContext::set_session_tickets(bool enabled) {
+  if (enabled) {
+#ifndef PIPY_USE_OPENSSL1
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(m_ctx, on_ticket_key);
+#else
+    SSL_CTX_set_tlsext_ticket_key_cb(m_ctx, on_ticket_key);
+#endif
+  } else {
+    SSL_CTX_set_options(m_ctx, SSL_OP_NO_TICKET);
+  }
+}
+
+//
+// Servers share one process-wide cache looked up by session ID,
+// whereas each client context keeps its own cache keyed by SNI
+//
+
+void TLSContext::set_session_cache(size_t size) {
+  if (!size) {
+    if (m_is_server) SSL_CTX_set_session_cache_mode(m_ctx, SSL_SESS_CACHE_OFF);
+    return;
+  }
+  if (m_is_server) {
+    SessionCache::server().reserve(size);
+    SSL_CTX_set_session_cache_mode(m_ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+    SSL_CTX_sess_set_get_cb(m_ctx, on_get_session);
+    SSL_CTX_sess_set_remove_cb(m_ctx, on_remove_session);
+  } else {
+    m_client_sessions.reset(new SessionCache(size));
+    SSL_CTX_set_session_cache_mode(m_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  }
+  SSL_CTX_sess_set_new_cb(m_ctx, on_new_session);
+}
+
+//
+// RSA key exchange is left out with asynchronous handshakes
+// since decryption with the implicit rejection required by TLS
+// is only available to keys of the default provider
+//
+
+void TLSContext::set_async_handshake(pjs::Str *ciphers) {
+  std::string list(ciphers ? ciphers->str() : "DEFAULT");
+  list += ":!kRSA";
+  SSL_CTX_set_cipher_list(m_ctx, list.c_str());
+  SSL_CTX_set_client_hello_cb(m_ctx, on_client_hello, this);
+  m_async_handshake = true;
+}
+
+auto TLSContext::client_session(const char *name) -> SSL_SESSION* {
+  if (!m_client_sessions || !name) return nullptr;
+  auto session = m_client_sessions->get(name);
+  if (session && !SSL_SESSION_is_resumable(session)) {
+    SSL_SESSION_free(session);
+    m_client_sessions->remove(name);
+    return nullptr;
+  }
+  return session;
+}
+
+auto TLSContext::on_new_session(SSL *ssl, SSL_SESSION *session) -> int {
+  if (SSL_is_server(ssl)) {
+    unsigned int len = 0;
+    auto id = SSL_SESSION_get_id(session, &len);
+    SessionCache::server().set(std::string((const char *)id, len), session);
+    return 1;
+  } else if (auto name = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name)) {
+    if (auto *cache = get(ssl)->m_client_sessions.get()) {
+      cache->set(name, session);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+auto TLSContext::on_get_session(SSL *ssl, const unsigned char *id, int len, int *copy) -> SSL_SESSION* {
+  *copy = 0;
+  return SessionCache::server().get(std::string((const char *)id, len));
+}
+
+void TLSContext::on_remove_session(SSL_CTX *ctx, SSL_SESSION *session) {
+  unsigned int len = 0;
+  auto id = SSL_SESSION_get_id(session, &len);
+  SessionCache::server().remove(std::string((const char *)id, len));
+}
+
+void TLSContext::on_keylog(const SSL *ssl, const char *line) {
+  TLSSession::get(const_cast<SSL*>(ssl))->on_keylog(line);
+}
+
+#ifndef PIPY_USE_OPENSSL1
+
+auto TLSContext::on_ticket_key(
+  SSL *ssl,
+  unsigned char *name,
+  unsigned char *iv,
+  EVP_CIPHER_CTX *ctx,
+  EVP_MAC_CTX *hctx,
+  int enc
+) -> int {
+  SessionTicketKeys::Key key;
+  int ret = 1;
+  if (enc) {
+    SessionTicketKeys::get().current(key);
+    std::memcpy(name, key.name, sizeof(key.name));
+    if (RAND_bytes(iv, EVP_CIPHER_get_iv_length(EVP_aes_256_cbc())) <= 0) return -1;
+    if (!EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key.aes_key, iv)) return -1;
+  } else {
+    ret = SessionTicketKeys::get().find(name, key);
+    if (!ret) return 0;
+    if (!EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key.aes_key, iv)) return -1;
+  }
+  OSSL_PARAM params[] = {
+    OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.hmac_key, sizeof(key.hmac_key)),
+    OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char *)"SHA256", 0),
+    OSSL_PARAM_construct_end(),
+  };
+  if (!EVP_MAC_CTX_set_params(hctx, params)) return -1;
+  return ret;
+}
+
+#else // PIPY_USE_OPENSSL1
+
+auto TLSContext::on_ticket_key(
+  SSL *ssl,
+  unsigned char *name,
+  unsigned char *iv,
+  EVP_CIPHER_CTX *ctx,
+  HMAC_CTX *hctx,
+  int enc
+) -> int {
+  SessionTicketKeys::Key key;
+  int ret = 1;
+  if (enc) {
+    SessionTicketKeys::get().current(key);
+    std::memcpy(name, key.name, sizeof(key.name));
+    if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) <= 0) return -1;
+    if (!EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key.aes_key, iv)) return -1;
+  } else {
+    ret = SessionTicketKeys::get().find(name, key);
+    if (!ret) return 0;
+    if (!EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key.aes_key, iv)) return -1;
+  }
+  if (!HMAC_Init_ex(hctx, key.hmac_key, sizeof(key.hmac_key), EVP_sha256(), nullptr)) return -1;
+  return ret;
+}
+
+#endif // PIPY_USE_OPENSSL1
+
 auto TLSContext::on_verify(int preverify_ok, X509_STORE_CTX *ctx) -> int {
   auto *ssl = (SSL*)X509_STORE_CTX_get_ex_data(ctx, SSL_get_ex_data_X509_STORE_CTX_idx());
   return TLSSession::get(ssl)->on_verify(preverify_ok, ctx);
@@ -208,6 +726,13 @@ auto TLSContext::on_server_name(SSL *ssl, int*, void *thiz) -> int {
   return SSL_TLSEXT_ERR_OK;
 }
 
+auto TLSContext::on_client_hello(SSL *ssl, int*, void*) -> int {
+  if (ASYNC_get_current_job()) return SSL_CLIENT_HELLO_SUCCESS;
+  TLSSession::get(ssl)->on_client_hello();
+  SSL_set_mode(ssl, SSL_MODE_ASYNC);
+  return SSL_CLIENT_HELLO_RETRY;
+}
+
 auto TLSContext::on_select_alpn(
   SSL *ssl,
   const unsigned char **out,
@@ -235,7 +760,8 @@ auto TLSContext::on_select_alpn(
       return SSL_TLSEXT_ERR_OK;
     }
   }
-  auto sel = TLSSession::get(ssl)->on_select_alpn(name_array);
+  auto session = TLSSession::get(ssl);
+  auto sel = session->m_async_hello ? session->m_alpn_selected : session->on_select_alpn(name_array);
   if (0 <= sel && sel < n) {
     *out = names[sel] + 1;
     *outlen = *names[sel];
@@ -264,6 +790,9 @@ auto TLSContext::on_select_alpn(
 //
 
 int TLSSession::s_user_data_index = 0;
+thread_local TLSSession* TLSSession::s_current = nullptr;
+thread_local int TLSSession::s_async_pending_count = 0;
+thread_local pjs::Ref<stats::Histogram> TLSSession::s_metric_handshake_time;
 
 void TLSSession::init() {
   SSL_load_error_strings();
@@ -277,6 +806,31 @@ auto TLSSession::get(SSL *ssl) -> TLSSession* {
   return reinterpret_cast<TLSSession*>(ptr);
 }
 
+void TLSSession::init_metrics() {
+  if (!s_metric_handshake_time) {
+    pjs::Ref<pjs::Array> buckets = pjs::Array::make(21);
+    double limit = 1.5;
+    for (int i = 0; i < 20; i++) {
+      buckets->set(i, std::floor(limit));
+      limit *= 1.5;
+    }
+    buckets->set(20, std::numeric_limits<double>::infinity());
+
+    s_metric_handshake_time = stats::Histogram::make(
+      pjs::Str::make("pipy_tls_handshake_time"),
+      buckets, nullptr
+    );
+
+    stats::Gauge::make(
+      pjs::Str::make("pipy_tls_handshake_queue"),
+      nullptr,
+      [](stats::Gauge *gauge) {
+        gauge->set(s_async_pending_count);
+      }
+    );
+  }
+}
+
 TLSSession::TLSSession(
   TLSContext *ctx,
   Filter *filter,
@@ -300,7 +854,11 @@ TLSSession::TLSSession(
 #if PIPY_USE_NTLS
   , m_is_ntls(is_ntls)
 #endif
+  , m_async(ctx->async_handshake())
+  , m_ktls(ctx->ktls())
 {
+  if (is_server) init_metrics();
+
   m_ssl = SSL_new(ctx->ctx());
   SSL_set_ex_data(m_ssl, s_user_data_index, this);
 
@@ -327,7 +885,13 @@ TLSSession::~TLSSession() {
 }
 
 void TLSSession::start_handshake(const char *name) {
-  if (name) SSL_set_tlsext_host_name(m_ssl, name);
+  if (name) {
+    SSL_set_tlsext_host_name(m_ssl, name);
+    if (auto session = TLSContext::get(m_ssl)->client_session(name)) {
+      SSL_set_session(m_ssl, session);
+      SSL_SESSION_free(session);
+    }
+  }
   handshake_step();
 }
 
@@ -379,8 +943,13 @@ void TLSSession::on_input(Event *evt) {
       m_buffer_receive.push(*data);
       if (handshake_step()) pump_read();
     } else {
-      m_buffer_write.push(*data);
-      if (handshake_step()) pump_write();
+      if (m_ktls_tx_pending) ktls_send();
+      if (m_ktls_tx) {
+        forward(evt);
+      } else {
+        m_buffer_write.push(*data);
+        if (handshake_step()) pump_write();
+      }
     }
 
   } else if (evt->is<StreamEnd>()) {
@@ -397,8 +966,13 @@ void TLSSession::on_reply(Event *evt) {
 
   } else if (auto *data = evt->as<Data>()) {
     if (m_is_server) {
-      m_buffer_write.push(*data);
-      if (handshake_step()) pump_write();
+      if (m_ktls_tx_pending) ktls_send();
+      if (m_ktls_tx) {
+        output(evt);
+      } else {
+        m_buffer_write.push(*data);
+        if (handshake_step()) pump_write();
+      }
     } else {
       m_buffer_receive.push(*data);
       if (handshake_step()) pump_read();
@@ -424,6 +998,7 @@ auto TLSSession::on_verify(int preverify_ok, X509_STORE_CTX *cert_store_ctx) ->
 }
 
 void TLSSession::on_server_name() {
+  if (m_async_hello) return;
   if (auto name = SSL_get_servername(m_ssl, TLSEXT_NAMETYPE_host_name)) {
     pjs::Ref<pjs::Str> sni(pjs::Str::make(name));
     use_certificate(sni);
@@ -538,7 +1113,8 @@ void TLSSession::use_certificate(pjs::Str *sni) {
   }
 #endif
 
-  SSL_use_PrivateKey(m_ssl, key.as<crypto::PrivateKey>()->pkey());
+  auto pkey = key.as<crypto::PrivateKey>()->pkey();
+  SSL_use_PrivateKey(m_ssl, m_async ? AsyncKey::wrap(pkey) : pkey);
 
   if (cert.is<crypto::Certificate>()) {
     SSL_use_certificate(m_ssl, cert.as<crypto::Certificate>()->x509());
@@ -557,14 +1133,81 @@ void TLSSession::use_certificate(pjs::Str *sni) {
   }
 }
 
+//
+// Server name and ALPN are handled here ahead of their callbacks
+// as those will be called later within an async job
+//
+
+void TLSSession::on_client_hello() {
+  if (m_async_hello) return;
+  m_async_hello = true;
+
+  const unsigned char *p = nullptr;
+  size_t len = 0;
+
+  if (SSL_client_hello_get0_ext(m_ssl, TLSEXT_TYPE_server_name, &p, &len)) {
+    if (len > 5 && p[2] == TLSEXT_NAMETYPE_host_name) {
+      size_t n = (p[3] << 8) | p[4];
+      if (5 + n <= len) {
+        pjs::Ref<pjs::Str> sni(pjs::Str::make((const char *)p + 5, n));
+        use_certificate(sni);
+      }
+    }
+  }
+
+  if (m_alpn && SSL_client_hello_get0_ext(m_ssl, TLSEXT_TYPE_application_layer_protocol_negotiation, &p, &len)) {
+    if (len > 2) {
+      pjs::Ref<pjs::Array> name_array = pjs::Array::make();
+      size_t i = 2;
+      while (i < len && name_array->length() < 100) {
+        auto n = p[i];
+        if (i + 1 + n > len) break;
+        name_array->push(pjs::Str::make((const char *)p + i + 1, n));
+        i += n + 1;
+      }
+      m_alpn_selected = on_select_alpn(name_array);
+    }
+  }
+}
+
+void TLSSession::on_async_wait() {
+  m_async_pending = true;
+  s_async_pending_count++;
+  retain();
+}
+
+void TLSSession::on_async_done() {
+  m_async_pending = false;
+  s_async_pending_count--;
+  if (ref_count() > 1 && m_state != State::closed) {
+    if (handshake_step()) pump_read();
+  } else {
+    do_handshake(); // let the paused job finish before the session goes away
+  }
+  release();
+}
+
+auto TLSSession::do_handshake() -> int {
+  s_current = this;
+  auto ret = SSL_do_handshake(m_ssl);
+  s_current = nullptr;
+  return ret;
+}
+
 bool TLSSession::handshake_step() {
-  if (m_state == State::idle) set_state(State::handshake);
+  if (m_async_pending) return false;
+  if (m_state == State::idle) {
+    m_handshake_start = utils::now();
+    set_state(State::handshake);
+  }
   while (!SSL_is_init_finished(m_ssl)) {
     pump_receive();
-    int ret = SSL_do_handshake(m_ssl);
+    int ret = do_handshake();
     if (ret == 1) {
+      if (m_async) SSL_clear_mode(m_ssl, SSL_MODE_ASYNC);
       handshake_done();
       pump_send();
+      if (m_ktls) ktls_start();
       pump_write();
       return true;
     }
@@ -574,11 +1217,15 @@ bool TLSSession::handshake_step() {
     }
     bool blocked = false;
     auto status = SSL_get_error(m_ssl, ret);
+    if (status == SSL_ERROR_WANT_ASYNC) return false;
+    if (m_async && status != SSL_ERROR_WANT_CLIENT_HELLO_CB) {
+      SSL_clear_mode(m_ssl, SSL_MODE_ASYNC);
+    }
     if (status == SSL_ERROR_WANT_READ) {
       if (m_buffer_receive.empty()) {
         blocked = true;
       }
-    } else if (status != SSL_ERROR_WANT_WRITE) {
+    } else if (status != SSL_ERROR_WANT_WRITE && status != SSL_ERROR_WANT_CLIENT_HELLO_CB) {
       Log::warn("[tls] handshake failed (error = %d)", status);
       set_error();
       close();
@@ -601,6 +1248,9 @@ void TLSSession::handshake_done() {
     pjs::Value arg(info), ret;
     (*m_handshake)(ctx, 1, &arg, ret);
   }
+  if (m_is_server) {
+    s_metric_handshake_time->observe(utils::now() - m_handshake_start);
+  }
   set_state(State::connected);
   if (m_is_server) {
     forward(Data::make());
@@ -610,6 +1260,14 @@ void TLSSession::handshake_done() {
 }
 
 auto TLSSession::pump_send() -> int {
+  if (m_ktls_tx) {
+    if (auto n = BIO_ctrl_pending(m_wbio)) {
+      char buf[DATA_CHUNK_SIZE];
+      while (BIO_read(m_wbio, buf, sizeof(buf)) > 0) {}
+      Log::warn("[tls] dropped %d bytes of post-handshake messages after kTLS offload", int(n));
+    }
+    return 0;
+  }
   int size = 0;
   for (;;) {
     size_t n = 0;
@@ -619,6 +1277,7 @@ auto TLSSession::pump_send() -> int {
     auto len = std::get<1>(*chunk);
     if (BIO_read_ex(m_wbio, ptr, len, &n)) {
       data.pop(data.size() - n);
+      if (m_ktls_tx_pending) ktls_count_records(data);
       if (m_is_server) {
         output(Data::make(data));
       } else {
@@ -722,6 +1381,255 @@ void TLSSession::close() {
   set_state(State::closed);
 }
 
+#ifdef __linux__
+
+static auto hex_to_bytes(const char *hex, size_t len) -> std::string {
+  std::string out;
+  auto h = [](char c) { return std::isdigit(c) ? c - '0' : std::tolower(c) - 'a' + 10; };
+  for (size_t i = 0; i + 1 < len; i += 2) {
+    out.push_back(char((h(hex[i]) << 4) | h(hex[i+1])));
+  }
+  return out;
+}
+
+//
+// HKDF-Expand-Label() from RFC 8446 section 7.1
+//
+
+static bool hkdf_expand_label(
+  const EVP_MD *md,
+  const std::string &secret,
+  const std::string &label,
+  unsigned char *out,
+  size_t len
+) {
+  std::string info;
+  std::string full_label("tls13 ");
+  full_label += label;
+  info.push_back(char(len >> 8));
+  info.push_back(char(len));
+  info.push_back(char(full_label.length()));
+  info += full_label;
+  info.push_back(0);
+
+  auto pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr);
+  if (!pctx) return false;
+  auto ok = (
+    EVP_PKEY_derive_init(pctx) > 0 &&
+    EVP_PKEY_CTX_set_hkdf_mode(pctx, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) > 0 &&
+    EVP_PKEY_CTX_set_hkdf_md(pctx, md) > 0 &&
+    EVP_PKEY_CTX_set1_hkdf_key(pctx, (const unsigned char *)secret.c_str(), secret.length()) > 0 &&
+    EVP_PKEY_CTX_add1_hkdf_info(pctx, (const unsigned char *)info.c_str(), info.length()) > 0 &&
+    EVP_PKEY_derive(pctx, out, &len) > 0
+  );
+  EVP_PKEY_CTX_free(pctx);
+  return ok;
+}
+
+void TLSSession::on_keylog(const char *line) {
+  static const std::string s_client("CLIENT_TRAFFIC_SECRET_0 ");
+  static const std::string s_server("SERVER_TRAFFIC_SECRET_0 ");
+  std::string *secret = nullptr;
+  if (!std::strncmp(line, s_client.c_str(), s_client.length())) secret = &m_ktls_client_secret;
+  else if (!std::strncmp(line, s_server.c_str(), s_server.length())) secret = &m_ktls_server_secret;
+  if (!secret) return;
+  auto p = std::strrchr(line, ' ');
+  if (p) *secret = hex_to_bytes(p + 1, std::strlen(p + 1));
+}
+
+//
+// Once sending is offloaded, OpenSSL's write state is left behind, so
+// records it queues later on can no longer be sent. With renegotiation
+// ruled out, the only such record is the reply to a KeyUpdate request
+// from the peer, which pump_send() drops: the peer keeps receiving under
+// the current key and the session carries on without that rekey.
+//
+
+void TLSSession::ktls_start() {
+  if (SSL_version(m_ssl) != TLS1_3_VERSION) return;
+  if (m_ktls_client_secret.empty() || m_ktls_server_secret.empty()) return;
+
+  bool drained;
+  SocketTCP *socket;
+  if (ktls_socket(drained, socket) < 0) return;
+
+  SSL_set_options(m_ssl, SSL_OP_NO_RENEGOTIATION);
+  if (!SSL_key_update(m_ssl, SSL_KEY_UPDATE_NOT_REQUESTED)) return;
+  if (SSL_do_handshake(m_ssl) != 1) return;
+  pump_send();
+
+  auto md = SSL_CIPHER_get_handshake_digest(SSL_get_current_cipher(m_ssl));
+  const auto &secret = m_is_server ? m_ktls_server_secret : m_ktls_client_secret;
+  m_ktls_tx_secret.resize(EVP_MD_size(md));
+  if (!hkdf_expand_label(md, secret, "traffic upd", (unsigned char *)&m_ktls_tx_secret[0], m_ktls_tx_secret.size())) return;
+  m_ktls_tx_pending = true;
+  m_ktls_tx_records = 0;
+  m_ktls_tx_header_size = 0;
+  m_ktls_tx_record_left = 0;
+  ktls_send();
+}
+
+void TLSSession::ktls_send() {
+  bool drained;
+  SocketTCP *socket;
+  auto fd = ktls_socket(drained, socket);
+  if (fd < 0) {
+    m_ktls_tx_pending = false;
+  } else if (drained) {
+    m_ktls_tx_pending = false;
+    m_ktls_tx = ktls_install(fd, m_ktls_tx_secret, m_ktls_tx_records);
+
+    // The kernel's TLS sendmsg() refuses MSG_ZEROCOPY
+    if (m_ktls_tx) socket->disable_zero_copy();
+  }
+}
+
+//
+// A session is offloaded only when it is directly attached to a TCP socket:
+// the first filter of an inbound's root pipeline on the server side, or
+// followed by a connect() in its sub-pipeline on the client side
+//
+
+auto TLSSession::ktls_socket(bool &drained, SocketTCP *&socket) -> int {
+  if (m_is_server) {
+    auto inbound = m_filter->context()->inbound();
+    if (!inbound || !inbound->is<InboundTCP>()) return -1;
+    auto pipeline = inbound->pipeline();
+    if (pipeline != m_filter->pipeline() || pipeline->head() != m_filter) return -1;
+    drained = !inbound->get_buffered();
+    socket = static_cast<InboundTCP*>(inbound);
+    return inbound->get_socket()->fd();
+  } else {
+    auto connect = dynamic_cast<Connect*>(m_pipeline->head());
+    if (!connect) return -1;
+    auto outbound = connect->outbound();
+    if (!outbound || outbound->protocol() != Outbound::Protocol::TCP) return -1;
+    if (outbound->state() != Outbound::State::connected) return -1;
+    drained = !outbound->get_buffered();
+    socket = static_cast<OutboundTCP*>(outbound);
+    return outbound->get_socket()->fd();
+  }
+}
+
+bool TLSSession::ktls_install(int fd, const std::string &secret, uint64_t seq) {
+  auto cipher = SSL_get_current_cipher(m_ssl);
+  auto md = SSL_CIPHER_get_handshake_digest(cipher);
+
+  union {
+    tls12_crypto_info_aes_gcm_128 aes_gcm_128;
+    tls12_crypto_info_aes_gcm_256 aes_gcm_256;
+    tls12_crypto_info_chacha20_poly1305 chacha20_poly1305;
+  } info;
+
+  unsigned char key[32], iv[12], rec_seq[8];
+  size_t key_size, info_size;
+  std::memset(&info, 0, sizeof(info));
+  for (int i = 0; i < 8; i++) rec_seq[i] = seq >> (56 - i * 8);
+
+  switch (SSL_CIPHER_get_id(cipher)) {
+    case TLS1_3_CK_AES_128_GCM_SHA256:
+      key_size = 16;
+      info_size = sizeof(info.aes_gcm_128);
+      info.aes_gcm_128.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+      break;
+    case TLS1_3_CK_AES_256_GCM_SHA384:
+      key_size = 32;
+      info_size = sizeof(info.aes_gcm_256);
+      info.aes_gcm_256.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+      break;
+    case TLS1_3_CK_CHACHA20_POLY1305_SHA256:
+      key_size = 32;
+      info_size = sizeof(info.chacha20_poly1305);
+      info.chacha20_poly1305.info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+      break;
+    default: return false;
+  }
+
+  if (
+    !hkdf_expand_label(md, secret, "key", key, key_size) ||
+    !hkdf_expand_label(md, secret, "iv", iv, sizeof(iv))
+  ) return false;
+
+  switch (SSL_CIPHER_get_id(cipher)) {
+    case TLS1_3_CK_AES_128_GCM_SHA256: {
+      auto &i = info.aes_gcm_128;
+      i.info.version = TLS_1_3_VERSION;
+      std::memcpy(i.key, key, sizeof(i.key));
+      std::memcpy(i.salt, iv, sizeof(i.salt));
+      std::memcpy(i.iv, iv + sizeof(i.salt), sizeof(i.iv));
+      std::memcpy(i.rec_seq, rec_seq, sizeof(i.rec_seq));
+      break;
+    }
+    case TLS1_3_CK_AES_256_GCM_SHA384: {
+      auto &i = info.aes_gcm_256;
+      i.info.version = TLS_1_3_VERSION;
+      std::memcpy(i.key, key, sizeof(i.key));
+      std::memcpy(i.salt, iv, sizeof(i.salt));
+      std::memcpy(i.iv, iv + sizeof(i.salt), sizeof(i.iv));
+      std::memcpy(i.rec_seq, rec_seq, sizeof(i.rec_seq));
+      break;
+    }
+    default: {
+      auto &i = info.chacha20_poly1305;
+      i.info.version = TLS_1_3_VERSION;
+      std::memcpy(i.key, key, sizeof(i.key));
+      std::memcpy(i.iv, iv, sizeof(i.iv));
+      std::memcpy(i.rec_seq, rec_seq, sizeof(i.rec_seq));
+      break;
+    }
+  }
+
+  if (!m_ktls_ulp) {
+    if (setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) < 0) {
+      Log::warn("[tls] unable to enable kTLS: %s", std::strerror(errno));
+      m_ktls = false;
+      return false;
+    }
+    m_ktls_ulp = true;
+  }
+
+  if (setsockopt(fd, SOL_TLS, TLS_TX, &info, info_size) < 0) {
+    Log::warn("[tls] unable to offload sending to kTLS: %s", std::strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+void TLSSession::ktls_count_records(const Data &data) {
+  for (const auto c : data.chunks()) {
+    auto ptr = (const uint8_t *)std::get<0>(c);
+    auto len = std::get<1>(c);
+    while (len > 0) {
+      if (m_ktls_tx_record_left > 0) {
+        auto n = std::min(m_ktls_tx_record_left, size_t(len));
+        m_ktls_tx_record_left -= n;
+        ptr += n;
+        len -= n;
+      } else {
+        m_ktls_tx_header[m_ktls_tx_header_size++] = *ptr++;
+        len--;
+        if (m_ktls_tx_header_size == sizeof(m_ktls_tx_header)) {
+          m_ktls_tx_record_left = (m_ktls_tx_header[3] << 8) | m_ktls_tx_header[4];
+          m_ktls_tx_header_size = 0;
+          m_ktls_tx_records++;
+        }
+      }
+    }
+  }
+}
+
+#else // !__linux__
+
+void TLSSession::on_keylog(const char *line) {}
+void TLSSession::ktls_start() {}
+void TLSSession::ktls_send() { m_ktls_tx_pending = false; }
+auto TLSSession::ktls_socket(bool &drained, SocketTCP *&socket) -> int { return -1; }
+bool TLSSession::ktls_install(int fd, const std::string &secret, uint64_t seq) { return false; }
+void TLSSession::ktls_count_records(const Data &data) {}
+
+#endif // __linux__
+
 //
 // Client::Options
 //
@@ -759,6 +1667,10 @@ Client::Options::Options(pjs::Object *options, const char *base_name)
     .get(sni)
     .get(sni_f)
     .check_nullable();
+
+  Value(options, "sessionCache", base_name)
+    .get(session_cache)
+    .check_nullable();
 }
 
 //
@@ -794,6 +1706,8 @@ Client::Client(const Options &options)
   if (options.alpn_list.size() > 0) {
     m_tls_context->set_client_alpn(options.alpn_list);
   }
+
+  m_tls_context->set_session_cache(options.session_cache);
 }
 
 Client::Client(const Client &r)
@@ -889,6 +1803,22 @@ Server::Options::Options(pjs::Object *options)
       }
     );
   }
+
+  Value(options, "sessionTickets")
+    .get(session_tickets)
+    .check_nullable();
+
+  Value(options, "sessionCache")
+    .get(session_cache)
+    .check_nullable();
+
+  Value(options, "sessionTimeout")
+    .get_seconds(session_timeout)
+    .check_nullable();
+
+  Value(options, "asyncHandshake")
+    .get(async_handshake)
+    .check_nullable();
 }
 
 //
@@ -928,6 +1858,57 @@ Server::Server(const Options &options)
   }
 
   m_tls_context->set_server_alpn(options.alpn_set);
+
+  unsigned char sid_ctx[SHA256_DIGEST_LENGTH];
+  session_id_context(options, sid_ctx);
+  m_tls_context->set_session_id_context(sid_ctx, sizeof(sid_ctx));
+  m_tls_context->set_session_timeout(options.session_timeout);
+  m_tls_context->set_session_tickets(options.session_tickets);
+  m_tls_context->set_session_cache(options.session_cache);
+
+  if (options.async_handshake) {
+    m_tls_context->set_async_handshake(options.ciphers);
+  }
+}
+
+//
+// Sessions are shared across threads and reloads, so the session ID
+// context is derived from the options that decide whether a session
+// is still good for the same server, most importantly the trusted CAs
+// for client certificates
+//
+
+void Server::session_id_context(const Options &options, unsigned char *out) {
+  auto ctx = EVP_MD_CTX_new();
+  EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr);
+  auto update_x509 = [&](X509 *x509) {
+    unsigned char *der = nullptr;
+    auto len = i2d_X509(x509, &der);
+    if (len > 0) {
+      EVP_DigestUpdate(ctx, der, len);
+      OPENSSL_free(der);
+    }
+  };
+  int versions[2] = { int(options.minVersion), int(options.maxVersion) };
+  EVP_DigestUpdate(ctx, versions, sizeof(versions));
+  if (options.ciphers) {
+    EVP_DigestUpdate(ctx, options.ciphers->c_str(), options.ciphers->size());
+  }
+  for (const auto &cert : options.trusted) {
+    update_x509(cert->x509());
+  }
+  if (options.certificate && !options.certificate->is_function()) {
+    pjs::Value cert;
+    options.certificate->get("cert", cert);
+    if (cert.is<crypto::Certificate>()) {
+      update_x509(cert.as<crypto::Certificate>()->x509());
+    } else if (cert.is<crypto::CertificateChain>()) {
+      auto chain = cert.as<crypto::CertificateChain>();
+      if (chain->size() > 0) update_x509(chain->x509(0));
+    }
+  }
+  EVP_DigestFinal_ex(ctx, out, nullptr);
+  EVP_MD_CTX_free(ctx);
 }
 
 Server::Server(const Server &r)
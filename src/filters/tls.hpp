@@ -29,17 +29,28 @@
 #include "filter.hpp"
 #include "data.hpp"
 #include "api/crypto.hpp"
+#include "api/stats.hpp"
 #include "options.hpp"
 
 #include <openssl/bio.h>
+#include <openssl/ec.h>
+#include <openssl/rsa.h>
 #include <openssl/ssl.h>
 
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
 #include <set>
+#include <unordered_map>
 
 namespace pipy {
 
+class SocketTCP;
+
 namespace tls {
 
 class TLSFilter;
@@ -69,6 +80,7 @@ struct Options : public pipy::Options {
   pjs::Ref<pjs::Function> on_verify_f;
   pjs::Ref<pjs::Function> on_state_f;
   bool alpn = false;
+  bool ktls = false;
 #if PIPY_USE_NTLS
   bool ntls = false;
 #endif
@@ -77,6 +89,115 @@ struct Options : public pipy::Options {
   Options(pjs::Object *options, const char *base_name = nullptr);
 };
 
+//
+// SessionCache
+//
+// An LRU cache of SSL sessions. Keys are spread over lock-striped
+// shards so that one cache can be shared by all worker threads.
+//
+
+class SessionCache {
+public:
+  SessionCache(size_t capacity, int shard_count = 1);
+  ~SessionCache();
+
+  static auto server() -> SessionCache&;
+
+  void reserve(size_t capacity);
+  auto get(const std::string &key) -> SSL_SESSION*;
+  void set(const std::string &key, SSL_SESSION *session);
+  void remove(const std::string &key);
+
+private:
+  typedef std::list<std::pair<std::string, SSL_SESSION*>> LRU;
+
+  struct Shard {
+    std::mutex lock;
+    LRU lru;
+    std::unordered_map<std::string, LRU::iterator> map;
+    size_t capacity = 0;
+  };
+
+  std::vector<std::unique_ptr<Shard>> m_shards;
+
+  auto shard_of(const std::string &key) -> Shard&;
+};
+
+//
+// SessionTicketKeys
+//
+// Keys for encrypting session tickets, shared by all worker threads
+// so that a ticket issued on one thread is accepted on any other.
+// A new key is rolled out every hour and the last 2 are kept for
+// decryption only.
+//
+
+class SessionTicketKeys {
+public:
+  struct Key {
+    unsigned char name[16];
+    unsigned char aes_key[32];
+    unsigned char hmac_key[32];
+  };
+
+  static auto get() -> SessionTicketKeys&;
+
+  void current(Key &key);
+  auto find(const unsigned char *name, Key &key) -> int;
+
+private:
+  enum {
+    KEY_COUNT = 3,
+    ROTATION_INTERVAL = 3600,
+  };
+
+  std::mutex m_lock;
+  Key m_keys[KEY_COUNT];
+  int m_key_count = 0;
+  std::chrono::steady_clock::time_point m_rotation_time;
+
+  void rotate();
+};
+
+//
+// AsyncKey
+//
+// Wraps RSA and EC private keys so that signing in a handshake can run
+// on a dedicated pool of crypto threads. A signing request made from
+// within an OpenSSL async job is queued to the pool and the job is paused
+// until the result is posted back to the worker thread, which then
+// resumes the handshake. Outside of async jobs, keys sign inline.
+//
+
+class AsyncKey {
+public:
+  static auto wrap(EVP_PKEY *pkey) -> EVP_PKEY*;
+
+private:
+  static auto sign(const std::function<int()> &op) -> int;
+  static auto rsa_method() -> RSA_METHOD*;
+  static auto ec_method() -> EC_KEY_METHOD*;
+
+  static auto rsa_priv_enc(
+    int flen,
+    const unsigned char *from,
+    unsigned char *to,
+    RSA *rsa,
+    int padding
+  ) -> int;
+
+  static auto ec_sign(
+    int type,
+    const unsigned char *dgst,
+    int dlen,
+    unsigned char *sig,
+    unsigned int *siglen,
+    const BIGNUM *kinv,
+    const BIGNUM *r,
+    EC_KEY *eckey
+  ) -> int;
+};
+
 //
 // TLSContext
 //
@@ -86,22 +207,60 @@ public:
   TLSContext(bool is_server, const Options &options);
   ~TLSContext();
 
+  static auto get(SSL *ssl) -> TLSContext*;
+
   auto ctx() const -> SSL_CTX* { return m_ctx; }
+  bool ktls() const { return m_ktls; }
+  bool async_handshake() const { return m_async_handshake; }
   void set_protocol_versions(ProtocolVersion min, ProtocolVersion max);
   void set_ciphers(const std::string &ciphers);
   void set_dhparam(const std::string &data);
   void add_certificate(crypto::Certificate *cert);
   void set_client_alpn(const std::vector<std::string> &protocols);
   void set_server_alpn(const std::set<pjs::Ref<pjs::Str>> &protocols);
+  void set_session_id_context(const unsigned char *data, size_t size);
+  void set_session_timeout(double timeout);
+  void set_session_tickets(bool enabled);
+  void set_session_cache(size_t size);
+  void set_async_handshake(pjs::Str *ciphers);
+  auto client_session(const char *name) -> SSL_SESSION*;
 
 private:
   SSL_CTX* m_ctx;
   DH* m_dhparam = nullptr;
   X509_STORE* m_verify_store;
   std::set<pjs::Ref<pjs::Str>> m_server_alpn;
+  std::unique_ptr<SessionCache> m_client_sessions;
+  bool m_is_server;
+  bool m_ktls;
+  bool m_async_handshake = false;
 
   static auto on_verify(int preverify_ok, X509_STORE_CTX *ctx) -> int;
   static auto on_server_name(SSL *ssl, int*, void*) -> int;
+  static auto on_client_hello(SSL *ssl, int*, void*) -> int;
+  static auto on_new_session(SSL *ssl, SSL_SESSION *session) -> int;
+  static auto on_get_session(SSL *ssl, const unsigned char *id, int len, int *copy) -> SSL_SESSION*;
+  static void on_remove_session(SSL_CTX *ctx, SSL_SESSION *session);
+  static void on_keylog(const SSL *ssl, const char *line);
+#ifndef PIPY_USE_OPENSSL1
+  static auto on_ticket_key(
+    SSL *ssl,
+    unsigned char *name,
+    unsigned char *iv,
+    EVP_CIPHER_CTX *ctx,
+    EVP_MAC_CTX *hctx,
+    int enc
+  ) -> int;
+#else
+  static auto on_ticket_key(
+    SSL *ssl,
+    unsigned char *name,
+    unsigned char *iv,
+    EVP_CIPHER_CTX *ctx,
+    HMAC_CTX *hctx,
+    int enc
+  ) -> int;
+#endif
   static auto on_select_alpn(
     SSL *ssl,
     const unsigned char **out,
@@ -143,6 +302,7 @@ public:
 
   static void init();
   static auto get(SSL *ssl) -> TLSSession*;
+  static auto current() -> TLSSession* { return s_current; }
 
   void start_handshake(const char *name = nullptr);
 
@@ -193,6 +353,57 @@ private:
 #endif
   bool m_closed_input = false;
   bool m_closed_output = false;
+  double m_handshake_start = 0;
+
+  //
+  // Asynchronous handshake
+  //
+  // The ClientHello is first processed outside of any async job so that
+  // script callbacks for certificates and ALPN run on the worker's own
+  // stack. The handshake is then retried within an async job, where the
+  // signing by an AsyncKey can be paused, and leaves async mode as soon
+  // as that job is finished.
+  //
+
+  bool m_async;
+  bool m_async_hello = false;
+  bool m_async_pending = false;
+  int m_alpn_selected = -1;
+
+  void on_client_hello();
+  void on_async_wait();
+  void on_async_done();
+  auto do_handshake() -> int;
+
+  //
+  // Kernel TLS
+  //
+  // Only TLS 1.3 is offloaded. Receiving is offloaded on the server side
+  // when no application data has arrived along with the handshake.
+  // Sending is offloaded on both sides after a KeyUpdate, whose new key
+  // starts over from record number 0 so that the records sent since can
+  // be counted, once the socket has flushed everything encrypted by
+  // OpenSSL so far.
+  //
+
+  bool m_ktls;
+  bool m_ktls_ulp = false;
+  bool m_ktls_tx = false;
+  bool m_ktls_tx_pending = false;
+  uint64_t m_ktls_tx_records = 0;
+  uint8_t m_ktls_tx_header[5];
+  int m_ktls_tx_header_size = 0;
+  size_t m_ktls_tx_record_left = 0;
+  std::string m_ktls_client_secret;
+  std::string m_ktls_server_secret;
+  std::string m_ktls_tx_secret;
+
+  void ktls_start();
+  void ktls_send();
+  auto ktls_socket(bool &drained, SocketTCP *&socket) -> int;
+  bool ktls_install(int fd, const std::string &secret, uint64_t seq);
+  void ktls_count_records(const Data &data);
+  void on_keylog(const char *line);
 
   virtual void on_input(Event *evt) override;
   virtual void on_reply(Event *evt) override;
@@ -214,9 +425,15 @@ private:
   void close();
 
   static int s_user_data_index;
+  thread_local static TLSSession* s_current;
+  thread_local static int s_async_pending_count;
+  thread_local static pjs::Ref<stats::Histogram> s_metric_handshake_time;
+
+  static void init_metrics();
 
   friend class pjs::ObjectTemplate<TLSSession>;
   friend class TLSContext;
+  friend class AsyncKey;
 };
 
 //
@@ -229,6 +446,7 @@ public:
     std::vector<std::string> alpn_list;
     pjs::Ref<pjs::Str> sni;
     pjs::Ref<pjs::Function> sni_f;
+    size_t session_cache = 1024;
 
     Options() {}
     Options(pjs::Object *options, const char *base_name = nullptr);
@@ -261,6 +479,10 @@ public:
     pjs::Ref<Data> dhparam;
     pjs::Ref<pjs::Function> alpn_f;
     std::set<pjs::Ref<pjs::Str>> alpn_set;
+    bool session_tickets = true;
+    size_t session_cache = 0;
+    double session_timeout = 0;
+    bool async_handshake = false;
 
     Options() {}
     Options(pjs::Object *options);
@@ -280,6 +502,8 @@ private:
   std::shared_ptr<TLSContext> m_tls_context;
   std::shared_ptr<Options> m_options;
   pjs::Ref<TLSSession> m_session;
+
+  static void session_id_context(const Options &options, unsigned char *out);
 };
 
 //
@@ -25,6 +25,7 @@
 
 #include "inbound.hpp"
 #include "listener.hpp"
+#include "outbound.hpp"
 #include "pipeline.hpp"
 #include "worker.hpp"
 #include "constants.hpp"
@@ -139,6 +140,10 @@ void Inbound::start() {
   }
 }
 
+void Inbound::splice(Pipeline *pipeline, Outbound *outbound) {
+  if (pipeline == m_pipeline) on_splice(outbound);
+}
+
 void Inbound::restart() {
   m_listener->accept();
   m_listener = nullptr;
@@ -282,6 +287,25 @@ void InboundTCP::accept(asio::ip::tcp::acceptor &acceptor) {
   retain();
 }
 
+void InboundTCP::accept(const asio::ip::tcp &protocol, int fd) {
+  InputContext ic(this);
+
+  std::error_code ec;
+  socket().assign(protocol, fd, ec);
+  if (ec) {
+    ::close(fd);
+  } else {
+    m_peer = socket().remote_endpoint(ec);
+  }
+
+  if (ec) {
+    log_error("error accepting connection", ec);
+  } else if (m_listener && m_listener->pipeline_layout()) {
+    log_debug("connection accepted");
+    start();
+  }
+}
+
 auto InboundTCP::get_socket() -> Socket* {
   if (!m_socket) {
     m_socket = Socket::make(this, SocketTCP::socket().native_handle());
@@ -335,6 +359,12 @@ void InboundTCP::on_get_address() {
 #endif // __linux__
 }
 
+void InboundTCP::on_splice(Outbound *outbound) {
+  if (auto ob = dynamic_cast<OutboundTCP*>(outbound)) {
+    SocketTCP::splice(ob);
+  }
+}
+
 void InboundTCP::start() {
   Inbound::start();
   retain();
@@ -41,6 +41,7 @@ namespace pipy {
 class Listener;
 class PipelineLayout;
 class Pipeline;
+class Outbound;
 
 //
 // Inbound
@@ -69,6 +70,7 @@ public:
   auto ori_dst_address() -> pjs::Str*;
   auto ori_dst_port() -> int { address(); return m_ori_dst_port; }
   bool is_receiving() const { return m_receiving_state == RECEIVING; }
+  auto pipeline() const -> Pipeline* { return m_pipeline; }
 
   virtual auto get_socket() -> Socket* = 0;
   virtual auto get_buffered() const -> size_t = 0;
@@ -76,6 +78,7 @@ public:
   virtual auto get_traffic_out() ->size_t = 0;
 
   void dangle() { m_listener = nullptr; }
+  void splice(Pipeline *pipeline, Outbound *outbound);
 
 protected:
   Inbound(Listener *listener, const Options &options);
@@ -114,6 +117,7 @@ protected:
 
 private:
   virtual void on_get_address() = 0;
+  virtual void on_splice(Outbound *outbound) {}
 
   uint64_t m_id;
   pjs::Ref<Pipeline> m_pipeline;
@@ -139,6 +143,7 @@ class InboundTCP :
 {
 public:
   void accept(asio::ip::tcp::acceptor &acceptor);
+  void accept(const asio::ip::tcp &protocol, int fd);
   void cancel() { m_canceled = true; }
 
 private:
@@ -154,6 +159,7 @@ private:
   virtual auto get_traffic_in() -> size_t override;
   virtual auto get_traffic_out() -> size_t override;
   virtual void on_get_address() override;
+  virtual void on_splice(Outbound *outbound) override;
   virtual void on_event(Event *evt) override { SocketTCP::output(evt); }
   virtual void on_socket_input(Event *evt) override { m_input->input(evt); }
   virtual void on_socket_close() override { Inbound::end(); release(); }
@@ -0,0 +1,400 @@
+/*
+ *  Copyright (c) 2019 by flomesh.io
+ *
+ *  Unless prior written consent has been obtained from the copyright
+ *  owner, the following shall not be allowed.
+ *
+ *  1. The distribution of any source codes, header files, make files,
+ *     or libraries of the software.
+ *
+ *  2. Disclosure of any source codes pertaining to the software to any
+ *     additional parties.
+ *
+ *  3. Alteration or removal of any notices in or on the software or
+ *     within the documentation included within the software.
+ *
+ *  ALL SOURCE CODE AS WELL AS ALL DOCUMENTATION INCLUDED WITH THIS
+ *  SOFTWARE IS PROVIDED IN AN “AS IS” CONDITION, WITHOUT WARRANTY OF ANY
+ *  KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ *  CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ *  TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ *  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "io-uring.hpp"
+
+#ifdef PIPY_USE_IO_URING
+
+#include "log.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+namespace pipy {
+
+static int io_uring_setup(unsigned entries, io_uring_params *params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static int io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+  return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+template<typename T>
+inline static auto load_acquire(const T *p) -> T {
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+template<typename T>
+inline static void store_release(T *p, T v) {
+  __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+//
+// IOUring
+//
+
+Data::Producer IOUring::s_dp("io_uring");
+
+auto IOUring::get() -> IOUring* {
+  if (Net::io_engine() != Net::IOEngine::IO_URING) return nullptr;
+  thread_local static IOUring s_ring;
+  return s_ring.m_fd >= 0 ? &s_ring : nullptr;
+}
+
+IOUring::IOUring()
+  : m_event(Net::context())
+{
+  std::string error;
+  if (!init(error)) {
+    release();
+    Log::warn("[io_uring] %s, falling back to epoll", error.c_str());
+  }
+}
+
+IOUring::~IOUring() {
+  release();
+}
+
+void IOUring::accept(int fd, Request *req) {
+  auto *e = sqe();
+  e->opcode = IORING_OP_ACCEPT;
+  e->fd = fd;
+  e->ioprio = IORING_ACCEPT_MULTISHOT;
+  e->accept_flags = SOCK_CLOEXEC;
+  e->user_data = (uint64_t)req;
+}
+
+void IOUring::receive(int fd, Request *req) {
+  auto *e = sqe();
+  e->opcode = IORING_OP_RECV;
+  e->fd = fd;
+  e->flags = IOSQE_BUFFER_SELECT;
+  e->buf_group = BUFFER_GROUP;
+  e->user_data = (uint64_t)req;
+}
+
+void IOUring::send(int fd, const msghdr *msg, Request *req) {
+  auto *e = sqe();
+  e->opcode = IORING_OP_SENDMSG;
+  e->fd = fd;
+  e->addr = (uint64_t)msg;
+  e->len = 1;
+  e->msg_flags = MSG_NOSIGNAL;
+  e->user_data = (uint64_t)req;
+}
+
+void IOUring::cancel(Request *req) {
+  auto *e = sqe();
+  e->opcode = IORING_OP_ASYNC_CANCEL;
+  e->fd = -1;
+  e->addr = (uint64_t)req;
+  e->user_data = 0;
+}
+
+bool IOUring::init(std::string &error) {
+  struct utsname uts;
+  int major = 0, minor = 0;
+  if (!uname(&uts)) std::sscanf(uts.release, "%d.%d", &major, &minor);
+  if (major < 6) {
+    error = "Linux 6.0 or above is required";
+    return false;
+  }
+
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_SINGLE_ISSUER;
+  params.cq_entries = CQ_ENTRIES;
+
+  m_fd = io_uring_setup(SQ_ENTRIES, &params);
+  if (m_fd < 0) {
+    error = std::string("io_uring_setup: ") + std::strerror(errno);
+    return false;
+  }
+
+  m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+  auto single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP);
+  if (single_mmap) {
+    m_sq_ring_size = m_cq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+  }
+
+  auto *sq = mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED) {
+    error = std::string("mmap: ") + std::strerror(errno);
+    return false;
+  }
+
+  m_sq_ring = sq;
+
+  if (single_mmap) {
+    m_cq_ring = sq;
+  } else {
+    auto *cq = mmap(nullptr, m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED) {
+      error = std::string("mmap: ") + std::strerror(errno);
+      return false;
+    }
+    m_cq_ring = cq;
+  }
+
+  auto *sqes = mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    error = std::string("mmap: ") + std::strerror(errno);
+    return false;
+  }
+
+  m_sqes = (io_uring_sqe*)sqes;
+  m_sq_entries = params.sq_entries;
+
+  auto *sp = (char*)m_sq_ring;
+  m_sq_head = (unsigned*)(sp + params.sq_off.head);
+  m_sq_tail = (unsigned*)(sp + params.sq_off.tail);
+  m_sq_flags = (unsigned*)(sp + params.sq_off.flags);
+  m_sq_array = (unsigned*)(sp + params.sq_off.array);
+  m_sq_mask = *(unsigned*)(sp + params.sq_off.ring_mask);
+
+  auto *cp = (char*)m_cq_ring;
+  m_cq_head = (unsigned*)(cp + params.cq_off.head);
+  m_cq_tail = (unsigned*)(cp + params.cq_off.tail);
+  m_cq_mask = *(unsigned*)(cp + params.cq_off.ring_mask);
+  m_cqes = (io_uring_cqe*)(cp + params.cq_off.cqes);
+
+  m_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (m_event_fd < 0) {
+    error = std::string("eventfd: ") + std::strerror(errno);
+    return false;
+  }
+
+  if (io_uring_register(m_fd, IORING_REGISTER_EVENTFD, &m_event_fd, 1) < 0) {
+    error = std::string("IORING_REGISTER_EVENTFD: ") + std::strerror(errno);
+    return false;
+  }
+
+  if (!init_buffers(error)) return false;
+
+  m_event.assign(m_event_fd);
+  wait();
+  return true;
+}
+
+//
+// Receive buffers are whole Data chunks lent to the kernel through a
+// provided buffer ring. A completion hands the filled chunk over as-is
+// and a fresh chunk takes its place in the ring.
+//
+
+bool IOUring::init_buffers(std::string &error) {
+  m_buf_ring_size = BUFFER_COUNT * sizeof(io_uring_buf);
+
+  auto *p = mmap(nullptr, m_buf_ring_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+  if (p == MAP_FAILED) {
+    error = std::string("mmap: ") + std::strerror(errno);
+    return false;
+  }
+
+  m_buf_ring = (io_uring_buf_ring*)p;
+
+  io_uring_buf_reg reg;
+  std::memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = (uint64_t)p;
+  reg.ring_entries = BUFFER_COUNT;
+  reg.bgid = BUFFER_GROUP;
+
+  if (io_uring_register(m_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+    error = std::string("IORING_REGISTER_PBUF_RING: ") + std::strerror(errno);
+    return false;
+  }
+
+  m_buffers.resize(BUFFER_COUNT);
+  for (int i = 0; i < BUFFER_COUNT; i++) {
+    m_buffers[i] = Data(DATA_CHUNK_SIZE, &s_dp);
+    provide(i);
+  }
+
+  return true;
+}
+
+void IOUring::release() {
+  if (m_event.is_open()) {
+    std::error_code ec;
+    m_event.close(ec);
+  } else if (m_event_fd >= 0) {
+    ::close(m_event_fd);
+  }
+  m_event_fd = -1;
+
+  if (m_fd >= 0) {
+    ::close(m_fd);
+    m_fd = -1;
+  }
+
+  if (m_buf_ring) munmap(m_buf_ring, m_buf_ring_size);
+  if (m_sqes) munmap(m_sqes, m_sq_entries * sizeof(io_uring_sqe));
+  if (m_cq_ring && m_cq_ring != m_sq_ring) munmap(m_cq_ring, m_cq_ring_size);
+  if (m_sq_ring) munmap(m_sq_ring, m_sq_ring_size);
+
+  m_buf_ring = nullptr;
+  m_sqes = nullptr;
+  m_cq_ring = nullptr;
+  m_sq_ring = nullptr;
+  m_buffers.clear();
+}
+
+auto IOUring::sqe() -> io_uring_sqe* {
+  auto tail = *m_sq_tail + m_sq_pending;
+  if (tail - load_acquire(m_sq_head) >= m_sq_entries) {
+    submit();
+    tail = *m_sq_tail;
+  }
+
+  auto i = tail & m_sq_mask;
+  auto *e = &m_sqes[i];
+  std::memset(e, 0, sizeof(*e));
+  m_sq_array[i] = i;
+  m_sq_pending++;
+
+  schedule();
+  return e;
+}
+
+//
+// Index the ring as a plain array of io_uring_buf rather than through
+// io_uring_buf_ring::bufs, whose flexible-array wrapper is laid out at
+// a non-zero offset when compiled as C++.
+//
+
+void IOUring::provide(int bid) {
+  auto chunk = *m_buffers[bid].chunks().begin();
+  auto *buf = (io_uring_buf*)m_buf_ring + (m_buf_tail & (BUFFER_COUNT - 1));
+  buf->addr = (uint64_t)std::get<0>(chunk);
+  buf->len = std::get<1>(chunk);
+  buf->bid = bid;
+  store_release(&m_buf_ring->tail, ++m_buf_tail);
+}
+
+void IOUring::submit() {
+  if (m_sq_pending > 0) {
+    store_release(m_sq_tail, *m_sq_tail + m_sq_pending);
+    m_sq_pending = 0;
+  }
+
+  auto n = *m_sq_tail - load_acquire(m_sq_head);
+  if (n > 0 && io_uring_enter(m_fd, n, 0, 0) < 0) {
+    if (errno != EAGAIN && errno != EBUSY && errno != EINTR) {
+      Log::error("[io_uring] io_uring_enter: %s", std::strerror(errno));
+    }
+  }
+}
+
+void IOUring::schedule() {
+  if (!m_submit_scheduled) {
+    m_submit_scheduled = true;
+    asio::post(
+      Net::context(),
+      [this]() {
+        m_submit_scheduled = false;
+        submit();
+      }
+    );
+  }
+}
+
+void IOUring::wait() {
+  m_event.async_wait(
+    asio::posix::stream_descriptor::wait_read,
+    [this](const std::error_code &ec) {
+      if (ec) return;
+      reap();
+      wait();
+    }
+  );
+}
+
+void IOUring::reap() {
+  if (::read(m_event_fd, &m_event_count, sizeof(m_event_count)) < 0) m_event_count = 0;
+
+  for (;;) {
+    auto head = *m_cq_head;
+    auto tail = load_acquire(m_cq_tail);
+
+    if (head == tail) {
+      if (load_acquire(m_sq_flags) & IORING_SQ_CQ_OVERFLOW) {
+        io_uring_enter(m_fd, 0, 0, IORING_ENTER_GETEVENTS);
+        continue;
+      }
+      break;
+    }
+
+    while (head != tail) {
+      auto cqe = m_cqes[head & m_cq_mask];
+      store_release(m_cq_head, ++head);
+
+      auto *req = (Request*)cqe.user_data;
+      if (!req) continue;
+
+      auto more = bool(cqe.flags & IORING_CQE_F_MORE);
+      if (cqe.flags & IORING_CQE_F_BUFFER) {
+        auto bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+        if (cqe.res > 0) {
+          Data data;
+          if (Data::chunk_size(cqe.res) < DATA_CHUNK_SIZE) {
+            // Copy small reads out to a best-fit chunk and hand
+            // the same buffer straight back to the kernel
+            auto chunk = *m_buffers[bid].chunks().begin();
+            data.push(std::get<0>(chunk), cqe.res, &s_dp);
+          } else {
+            data = std::move(m_buffers[bid]);
+            data.pop(data.size() - cqe.res);
+            m_buffers[bid] = Data(DATA_CHUNK_SIZE, &s_dp);
+          }
+          provide(bid);
+          req->on_complete(cqe.res, more, &data);
+          continue;
+        }
+        provide(bid);
+      }
+
+      req->on_complete(cqe.res, more, nullptr);
+    }
+  }
+
+  submit();
+}
+
+} // namespace pipy
+
+#endif // PIPY_USE_IO_URING
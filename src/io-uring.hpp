@@ -0,0 +1,128 @@
+/*
+ *  Copyright (c) 2019 by flomesh.io
+ *
+ *  Unless prior written consent has been obtained from the copyright
+ *  owner, the following shall not be allowed.
+ *
+ *  1. The distribution of any source codes, header files, make files,
+ *     or libraries of the software.
+ *
+ *  2. Disclosure of any source codes pertaining to the software to any
+ *     additional parties.
+ *
+ *  3. Alteration or removal of any notices in or on the software or
+ *     within the documentation included within the software.
+ *
+ *  ALL SOURCE CODE AS WELL AS ALL DOCUMENTATION INCLUDED WITH THIS
+ *  SOFTWARE IS PROVIDED IN AN “AS IS” CONDITION, WITHOUT WARRANTY OF ANY
+ *  KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ *  CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ *  TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ *  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef IO_URING_HPP
+#define IO_URING_HPP
+
+#ifdef PIPY_USE_IO_URING
+
+#include "net.hpp"
+#include "data.hpp"
+
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+
+#include <string>
+#include <vector>
+
+namespace pipy {
+
+//
+// IOUring
+//
+// Optional per-thread I/O engine selected by --io-engine=io_uring.
+// Submissions are batched and handed to the kernel once per loop turn.
+// Completions are signaled through an eventfd watched by asio, so the
+// ring runs alongside everything else on the same io_context.
+//
+
+class IOUring {
+public:
+  enum {
+    SQ_ENTRIES = 1024,
+    CQ_ENTRIES = 4096,
+    BUFFER_COUNT = 256,
+    BUFFER_GROUP = 0,
+  };
+
+  //
+  // IOUring::Request
+  //
+
+  class Request {
+  private:
+    virtual void on_complete(int result, bool more, Data *data) = 0;
+    friend class IOUring;
+  };
+
+  static auto get() -> IOUring*;
+
+  ~IOUring();
+
+  void accept(int fd, Request *req);
+  void receive(int fd, Request *req);
+  void send(int fd, const msghdr *msg, Request *req);
+  void cancel(Request *req);
+
+private:
+  IOUring();
+
+  int m_fd = -1;
+  int m_event_fd = -1;
+  asio::posix::stream_descriptor m_event;
+  uint64_t m_event_count = 0;
+
+  void* m_sq_ring = nullptr;
+  void* m_cq_ring = nullptr;
+  size_t m_sq_ring_size = 0;
+  size_t m_cq_ring_size = 0;
+  io_uring_sqe* m_sqes = nullptr;
+  unsigned* m_sq_head;
+  unsigned* m_sq_tail;
+  unsigned* m_sq_flags;
+  unsigned* m_sq_array;
+  unsigned m_sq_mask;
+  unsigned m_sq_entries;
+  unsigned m_sq_pending = 0;
+  unsigned* m_cq_head;
+  unsigned* m_cq_tail;
+  unsigned m_cq_mask;
+  io_uring_cqe* m_cqes;
+
+  io_uring_buf_ring* m_buf_ring = nullptr;
+  size_t m_buf_ring_size = 0;
+  uint16_t m_buf_tail = 0;
+  std::vector<Data> m_buffers;
+
+  bool m_submit_scheduled = false;
+
+  bool init(std::string &error);
+  bool init_buffers(std::string &error);
+  void release();
+  auto sqe() -> io_uring_sqe*;
+  void provide(int bid);
+  void submit();
+  void schedule();
+  void wait();
+  void reap();
+
+  static Data::Producer s_dp;
+};
+
+} // namespace pipy
+
+#endif // PIPY_USE_IO_URING
+
+#endif // IO_URING_HPP
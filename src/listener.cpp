@@ -29,8 +29,196 @@
 #include "worker-thread.hpp"
 #include "log.hpp"
 
+#include <cstring>
+#include <mutex>
+
+#ifdef __linux__
+#include <linux/bpf.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // __linux__
+
 namespace pipy {
 
+#ifdef __linux__
+
+//
+// ReusePortGroup
+//
+// Every address listened on with --reuse-port=cpu gets a REUSEPORT_SOCKARRAY
+// with one slot per worker, and a program selecting the slot of the worker
+// pinned on the CPU that handles the packet. Each socket is put in the slot
+// of its own worker, so the order in which workers join the group doesn't
+// matter. Workers sharing one CPU are chosen from by the packet hash. When
+// nothing is selected, the kernel falls back to its own hashing. The map and
+// the program are kept for the lifetime of the process, and closed sockets
+// drop out of the map by themselves. The program is attached after bind(),
+// since a group made by attaching to an unbound socket can't be joined.
+//
+
+class ReusePortGroup {
+public:
+  static auto get(Port::Protocol protocol, const std::string &ip, int port, const std::vector<int> &cpus) -> ReusePortGroup*;
+
+  void attach(int sock);
+  void add(int sock, int worker);
+
+private:
+  ReusePortGroup(int map_fd, int prog_fd)
+    : m_map_fd(map_fd)
+    , m_prog_fd(prog_fd) {}
+
+  int m_map_fd;
+  int m_prog_fd;
+
+  static std::map<std::string, ReusePortGroup*> s_groups;
+  static std::mutex s_groups_mutex;
+
+  static auto bpf(int cmd, bpf_attr &attr) -> int {
+    return syscall(__NR_bpf, cmd, &attr, sizeof(attr));
+  }
+
+  static auto insn(int code, int dst, int src, int off, int imm) -> bpf_insn {
+    bpf_insn i;
+    std::memset(&i, 0, sizeof(i));
+    i.code = code;
+    i.dst_reg = dst;
+    i.src_reg = src;
+    i.off = off;
+    i.imm = imm;
+    return i;
+  }
+
+  static auto load(int map_fd, const std::vector<int> &cpus) -> int;
+};
+
+std::map<std::string, ReusePortGroup*> ReusePortGroup::s_groups;
+std::mutex ReusePortGroup::s_groups_mutex;
+
+auto ReusePortGroup::get(Port::Protocol protocol, const std::string &ip, int port, const std::vector<int> &cpus) -> ReusePortGroup* {
+  std::lock_guard<std::mutex> lock(s_groups_mutex);
+  auto key = std::to_string(int(protocol)) + '/' + ip + '/' + std::to_string(port);
+  auto i = s_groups.find(key);
+  if (i != s_groups.end()) return i->second;
+
+  ReusePortGroup *group = nullptr;
+
+  bpf_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.map_type = BPF_MAP_TYPE_REUSEPORT_SOCKARRAY;
+  attr.key_size = sizeof(uint32_t);
+  attr.value_size = sizeof(uint64_t);
+  attr.max_entries = cpus.size();
+
+  auto map_fd = bpf(BPF_MAP_CREATE, attr);
+  if (map_fd < 0) {
+    Log::warn("[listener] Cannot create reuseport socket array: %s", std::strerror(errno));
+  } else {
+    auto prog_fd = load(map_fd, cpus);
+    if (prog_fd < 0) {
+      Log::warn("[listener] Cannot load reuseport steering program: %s", std::strerror(errno));
+      ::close(map_fd);
+    } else {
+      group = new ReusePortGroup(map_fd, prog_fd);
+    }
+  }
+
+  // Failures are remembered as well so they are only reported once
+  s_groups[key] = group;
+  return group;
+}
+
+auto ReusePortGroup::load(int map_fd, const std::vector<int> &cpus) -> int {
+  std::map<int, std::vector<int>> workers_on_cpu;
+  for (size_t i = 0; i < cpus.size(); i++) {
+    if (cpus[i] >= 0) workers_on_cpu[cpus[i]].push_back(i);
+  }
+
+  std::vector<bpf_insn> code;
+  std::vector<size_t> jumps_to_cpu, jumps_to_select;
+
+  // r6 = ctx, r0 = current CPU
+  code.push_back(insn(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_6, BPF_REG_1, 0, 0));
+  code.push_back(insn(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_get_smp_processor_id));
+
+  // if r0 == cpu goto that CPU's part
+  for (const auto &p : workers_on_cpu) {
+    jumps_to_cpu.push_back(code.size());
+    code.push_back(insn(BPF_JMP | BPF_JEQ | BPF_K, BPF_REG_0, 0, 0, p.first));
+  }
+
+  // Unknown CPU: pass without selecting
+  code.push_back(insn(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, SK_PASS));
+  code.push_back(insn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0));
+
+  // r2 = worker index, picked by hash if more than one is on the CPU
+  size_t k = 0;
+  for (const auto &p : workers_on_cpu) {
+    auto j = jumps_to_cpu[k++];
+    code[j].off = code.size() - j - 1;
+    const auto &workers = p.second;
+    auto n = workers.size();
+    if (n > 1) {
+      code.push_back(insn(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_6, offsetof(sk_reuseport_md, hash), 0));
+      code.push_back(insn(BPF_ALU | BPF_MOD | BPF_K, BPF_REG_2, 0, 0, n));
+      for (size_t i = 0; i + 1 < n; i++) {
+        code.push_back(insn(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_2, 0, 2, i));
+        code.push_back(insn(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_2, 0, 0, workers[i]));
+        jumps_to_select.push_back(code.size());
+        code.push_back(insn(BPF_JMP | BPF_JA, 0, 0, 0, 0));
+      }
+    }
+    code.push_back(insn(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_2, 0, 0, workers[n - 1]));
+    jumps_to_select.push_back(code.size());
+    code.push_back(insn(BPF_JMP | BPF_JA, 0, 0, 0, 0));
+  }
+
+  // bpf_sk_select_reuseport(ctx, map, &r2, 0)
+  for (auto j : jumps_to_select) code[j].off = code.size() - j - 1;
+  code.push_back(insn(BPF_STX | BPF_MEM | BPF_W, BPF_REG_10, BPF_REG_2, -4, 0));
+  code.push_back(insn(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_1, BPF_REG_6, 0, 0));
+  code.push_back(insn(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_2, BPF_PSEUDO_MAP_FD, 0, map_fd));
+  code.push_back(insn(0, 0, 0, 0, 0));
+  code.push_back(insn(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_3, BPF_REG_10, 0, 0));
+  code.push_back(insn(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_3, 0, 0, -4));
+  code.push_back(insn(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_4, 0, 0, 0));
+  code.push_back(insn(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_sk_select_reuseport));
+  code.push_back(insn(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, SK_PASS));
+  code.push_back(insn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0));
+
+  static const char license[] = "Apache-2.0";
+  bpf_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.prog_type = BPF_PROG_TYPE_SK_REUSEPORT;
+  attr.insn_cnt = code.size();
+  attr.insns = (uint64_t)(uintptr_t)code.data();
+  attr.license = (uint64_t)(uintptr_t)license;
+  return bpf(BPF_PROG_LOAD, attr);
+}
+
+void ReusePortGroup::attach(int sock) {
+  if (setsockopt(sock, SOL_SOCKET, SO_ATTACH_REUSEPORT_EBPF, &m_prog_fd, sizeof(m_prog_fd))) {
+    Log::warn("[listener] Cannot attach reuseport steering program: %s", std::strerror(errno));
+  }
+}
+
+void ReusePortGroup::add(int sock, int worker) {
+  uint32_t key = worker;
+  uint64_t value = sock;
+  bpf_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.map_fd = m_map_fd;
+  attr.key = (uint64_t)(uintptr_t)&key;
+  attr.value = (uint64_t)(uintptr_t)&value;
+  attr.flags = BPF_ANY;
+  if (bpf(BPF_MAP_UPDATE_ELEM, attr)) {
+    Log::warn("[listener] Cannot add socket to reuseport group: %s", std::strerror(errno));
+  }
+}
+
+#endif // __linux__
+
 //
 // Port
 //
@@ -121,6 +309,12 @@ Listener::Options::Options(pjs::Object *options) {
   Value(options, "bufferLimit")
     .get_binary_size(buffer_limit)
     .check_nullable();
+  Value(options, "zeroCopyThreshold")
+    .get_binary_size(zero_copy_threshold)
+    .check_nullable();
+  Value(options, "batchSize")
+    .get(batch_size)
+    .check_nullable();
   Value(options, "keepAlive")
     .get(keep_alive)
     .check_nullable();
@@ -144,11 +338,22 @@ Listener::Options::Options(pjs::Object *options) {
 
 thread_local std::set<Listener*> Listener::s_listeners;
 bool Listener::s_reuse_port = false;
+std::vector<int> Listener::s_reuse_port_cpus;
 
 void Listener::set_reuse_port(bool reuse) {
   s_reuse_port = reuse;
 }
 
+//
+// CPUs of the worker threads by worker index. When not empty, a connection
+// is steered to the socket of the worker running on the CPU that handles
+// its packets.
+//
+
+void Listener::set_reuse_port_cpus(const std::vector<int> &cpus) {
+  s_reuse_port_cpus = cpus;
+}
+
 void Listener::commit_all() {
   for (auto l : s_listeners) {
     l->commit();
@@ -438,6 +643,19 @@ void Listener::set_sock_opts(int sock) {
   }
 }
 
+void Listener::join_reuse_port(int sock) {
+#ifdef __linux__
+  if (s_reuse_port && !s_reuse_port_cpus.empty()) {
+    auto *wt = WorkerThread::current();
+    if (!wt || wt->index() >= int(s_reuse_port_cpus.size())) return;
+    if (auto *group = ReusePortGroup::get(protocol(), ip(), port(), s_reuse_port_cpus)) {
+      group->attach(sock);
+      group->add(sock, wt->index());
+    }
+  }
+#endif // __linux__
+}
+
 auto Listener::find(Port::Protocol protocol, const std::string &ip, int port) -> Listener* {
   for (auto *l : s_listeners) {
     if (l->protocol() == protocol && l->ip() == ip && l->port() == port) {
@@ -469,15 +687,42 @@ void Listener::AcceptorTCP::start(const asio::ip::tcp::endpoint &endpoint) {
 
   m_acceptor.bind(endpoint);
   m_acceptor.listen(asio::socket_base::max_connections);
+
+  m_listener->join_reuse_port(m_acceptor.native_handle());
+
+#ifdef PIPY_USE_IO_URING
+  m_protocol = endpoint.protocol();
+#endif
 }
 
 void Listener::AcceptorTCP::accept() {
+#ifdef PIPY_USE_IO_URING
+  if (auto *ring = IOUring::get()) {
+    m_ring_wanted = true;
+    while (m_ring_wanted && !m_ring_backlog.empty()) {
+      auto fd = m_ring_backlog.front();
+      m_ring_backlog.pop_front();
+      serve(fd);
+    }
+    if (m_ring_wanted && !m_ring_accepting) {
+      ring->accept(m_acceptor.native_handle(), this);
+      m_ring_accepting = true;
+      retain();
+    }
+    return;
+  }
+#endif
+
   auto inbound = InboundTCP::make(m_listener, m_listener->m_options);
   inbound->accept(m_acceptor);
   m_accepting = inbound;
 }
 
 void Listener::AcceptorTCP::cancel() {
+#ifdef PIPY_USE_IO_URING
+  cancel_ring();
+#endif
+
   m_acceptor.cancel();
   if (m_accepting) {
     m_accepting->cancel();
@@ -486,6 +731,12 @@ void Listener::AcceptorTCP::cancel() {
 }
 
 void Listener::AcceptorTCP::stop() {
+#ifdef PIPY_USE_IO_URING
+  cancel_ring();
+  for (auto fd : m_ring_backlog) ::close(fd);
+  m_ring_backlog.clear();
+#endif
+
   m_acceptor.close();
   if (m_accepting) {
     m_accepting->dangle();
@@ -493,6 +744,59 @@ void Listener::AcceptorTCP::stop() {
   }
 }
 
+#ifdef PIPY_USE_IO_URING
+
+void Listener::AcceptorTCP::serve(int fd) {
+  if (m_listener->pipeline_layout()) {
+    pjs::Ref<InboundTCP> inbound = InboundTCP::make(m_listener, m_listener->m_options);
+    inbound->accept(m_protocol, fd);
+  } else {
+    ::close(fd);
+  }
+}
+
+void Listener::AcceptorTCP::cancel_ring() {
+  if (m_ring_wanted) {
+    m_ring_wanted = false;
+    if (m_ring_accepting) {
+      IOUring::get()->cancel(this);
+    }
+  }
+}
+
+//
+// One multishot accept stays armed for as long as the listener is not
+// paused. Connections the kernel has already accepted by the time the
+// cancellation lands are held back until the listener resumes, so that
+// pausing still caps the number of open connections.
+//
+
+void Listener::AcceptorTCP::on_complete(int result, bool more, Data *) {
+  if (result >= 0) {
+    if (!m_acceptor.is_open()) {
+      ::close(result);
+    } else if (m_ring_wanted) {
+      serve(result);
+    } else {
+      m_ring_backlog.push_back(result);
+    }
+  } else if (result != -ECANCELED) {
+    Log::error("[listener] error accepting connection: %s", std::strerror(-result));
+  }
+
+  if (!more) {
+    m_ring_accepting = false;
+    if (m_ring_wanted && m_acceptor.is_open()) {
+      IOUring::get()->accept(m_acceptor.native_handle(), this);
+      m_ring_accepting = true;
+    } else {
+      release();
+    }
+  }
+}
+
+#endif // PIPY_USE_IO_URING
+
 //
 // Listener::AcceptorUDP
 //
@@ -518,6 +822,8 @@ void Listener::AcceptorUDP::start(const asio::ip::udp::endpoint &endpoint) {
   m_listener->set_sock_opts(s.native_handle());
 
   s.bind(endpoint);
+  m_listener->join_reuse_port(s.native_handle());
+
   const auto &ep = s.local_endpoint();
   m_local_addr = ep.address().to_string();
   m_local_port = ep.port();
@@ -33,10 +33,12 @@
 #include "options.hpp"
 
 #include <atomic>
+#include <deque>
 #include <functional>
 #include <string>
 #include <set>
 #include <map>
+#include <vector>
 
 namespace pipy {
 
@@ -110,6 +112,7 @@ public:
   };
 
   static void set_reuse_port(bool reuse);
+  static void set_reuse_port_cpus(const std::vector<int> &cpus);
 
   static auto get(Port::Protocol protocol, const std::string &ip, int port) -> Listener* {
     if (auto *l = find(protocol, ip, port)) return l;
@@ -172,7 +175,12 @@ private:
   // Listener::AcceptorTCP
   //
 
-  class AcceptorTCP : public Acceptor {
+  class AcceptorTCP :
+    public Acceptor
+#ifdef PIPY_USE_IO_URING
+    , public IOUring::Request
+#endif
+  {
   public:
     AcceptorTCP(Listener *listener);
     virtual ~AcceptorTCP();
@@ -187,6 +195,18 @@ private:
     Listener* m_listener;
     asio::ip::tcp::acceptor m_acceptor;
     pjs::Ref<InboundTCP> m_accepting;
+
+#ifdef PIPY_USE_IO_URING
+    asio::ip::tcp m_protocol = asio::ip::tcp::v4();
+    std::deque<int> m_ring_backlog;
+    bool m_ring_accepting = false;
+    bool m_ring_wanted = false;
+
+    void serve(int fd);
+    void cancel_ring();
+
+    virtual void on_complete(int result, bool more, Data *data) override;
+#endif
   };
 
   //
@@ -230,6 +250,7 @@ private:
   void print_state(const char *msg);
   void describe(char *buf, size_t len);
   void set_sock_opts(int sock);
+  void join_reuse_port(int sock);
 
   Net& m_net;
   Options m_options;
@@ -249,6 +270,7 @@ private:
 
   thread_local static std::set<Listener*> s_listeners;
   static bool s_reuse_port;
+  static std::vector<int> s_reuse_port_cpus;
 
   static auto find(Port::Protocol protocol, const std::string &ip, int port) -> Listener*;
 
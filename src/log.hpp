@@ -71,6 +71,7 @@ public:
     BPF       = 1<<15,
     USER      = 1<<16,
     CODEBASE  = 1<<17,
+    SCRIPT    = 1<<18,
   };
 
   static void init();
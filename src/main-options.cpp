@@ -66,6 +66,8 @@ void MainOptions::show_help() {
   std::cout << "  --, -args, --args                    Indicate the end of Pipy options and the start of script arguments" << std::endl;
   std::cout << "  --pipy-options                       Indicate the beginning of Pipy options while processing script arguments" << std::endl;
   std::cout << "  --threads=<number>                   Number of worker threads (1, 2, ... max)" << std::endl;
+  std::cout << "  --cpu-affinity=<auto|cpus>           Pin worker threads to CPUs (such as 'auto', '0-3', '0,2,4,6', ...)" << std::endl;
+  std::cout << "  --numa                               Allocate memory for worker threads on the NUMA node of their CPUs" << std::endl;
   std::cout << "  --log-file=<filename>                Set the pathname of the log file" << std::endl;
   std::cout << "  --log-file-max-size=<size>           Set the maximum log file size in bytes" << std::endl;
   std::cout << "  --log-file-max-count=<number>        Set the number of log files to keep" << std::endl;
@@ -84,7 +86,9 @@ void MainOptions::show_help() {
   std::cout << "  --init-code=<codebase>               Start running the specified codebase after repo initialization" << std::endl;
   std::cout << "  --instance-uuid=<uuid>               Specify a UUID for this worker process" << std::endl;
   std::cout << "  --instance-name=<name>               Specify a name for this worker process" << std::endl;
-  std::cout << "  --reuse-port                         Enable kernel load balancing for all listening ports" << std::endl;
+  std::cout << "  --reuse-port[=cpu]                   Enable kernel load balancing for all listening ports, optionally steered by CPU" << std::endl;
+  std::cout << "  --io-engine=<epoll|io_uring>         Select the socket I/O engine (default: epoll)" << std::endl;
+  std::cout << "  --script-tier=<bytecode|tree>        Select how script functions are executed (default: bytecode)" << std::endl;
   std::cout << "  --admin-port=<[[ip]:]port>           Enable administration service on the specified port" << std::endl;
   std::cout << "  --admin-port-off                     Do not start administration service at startup" << std::endl;
   std::cout << "  --admin-gui=<dirname>                Specify the location of administration GUI front-end files" << std::endl;
@@ -120,6 +124,7 @@ static const struct {
   { Log::BPF      , "bpf" },
   { Log::USER     , "user" },
   { Log::CODEBASE , "codebase" },
+  { Log::SCRIPT   , "script" },
   { Log::NO_TOPIC , nullptr },
 };
 
@@ -196,6 +201,25 @@ void MainOptions::parse(const std::list<std::string> &args) {
             throw std::runtime_error(msg + std::to_string(max_threads));
           }
         }
+      } else if (k == "--cpu-affinity") {
+        cpu_affinity = v;
+        cpu_list.clear();
+        if (v != "auto") {
+          for (const auto &s : utils::split(v, ',')) {
+            auto i = s.find('-');
+            char *end;
+            auto a = std::strtol(s.c_str(), &end, 10);
+            auto b = a;
+            if (i != std::string::npos) {
+              if (end != s.c_str() + i) throw std::runtime_error("invalid --cpu-affinity");
+              b = std::strtol(s.c_str() + i + 1, &end, 10);
+            }
+            if (*end || s.empty() || a < 0 || b < a) throw std::runtime_error("invalid --cpu-affinity");
+            for (auto cpu = a; cpu <= b; cpu++) cpu_list.push_back(cpu);
+          }
+        }
+      } else if (k == "--numa") {
+        numa = true;
       } else if (k == "--log-file") {
         log_file = v;
       } else if (k == "--log-file-max-size") {
@@ -272,7 +296,15 @@ void MainOptions::parse(const std::list<std::string> &args) {
       } else if (k == "--instance-name") {
         instance_name = v;
       } else if (k == "--reuse-port") {
+        if (!v.empty() && v != "cpu") throw std::runtime_error("unknown --reuse-port mode: " + v);
         reuse_port = true;
+        reuse_port_cpu = (v == "cpu");
+      } else if (k == "--io-engine") {
+        if (v != "epoll" && v != "io_uring") throw std::runtime_error("unknown I/O engine: " + v);
+        io_engine = v;
+      } else if (k == "--script-tier") {
+        if (v != "bytecode" && v != "tree") throw std::runtime_error("unknown script tier: " + v);
+        script_tier = v;
       } else if (k == "--admin-port-off") {
         admin_port_off = true;
       } else if (k == "--admin-port") {
@@ -340,6 +372,14 @@ void MainOptions::parse(const std::list<std::string> &args) {
   if (bool(tls_cert) != bool(tls_key)) {
     throw std::runtime_error("--tls-cert and --tls-key must be used in conjunction");
   }
+
+  if (numa && cpu_affinity.empty()) {
+    throw std::runtime_error("--cpu-affinity is required for --numa");
+  }
+
+  if (reuse_port_cpu && cpu_affinity.empty()) {
+    throw std::runtime_error("--cpu-affinity is required for --reuse-port=cpu");
+  }
 }
 
 void MainOptions::parse(const std::string &args) {
@@ -351,6 +391,8 @@ auto MainOptions::to_string() -> std::string {
   std::string str;
 
   if (threads > 1) list.push_back("--threads=" + std::to_string(threads));
+  if (!cpu_affinity.empty()) list.push_back("--cpu-affinity=" + cpu_affinity);
+  if (numa) list.push_back("--numa");
   if (!log_file.empty()) list.push_back("--log-file=" + log_file);
   switch (log_level) {
     case Log::DEBUG: {
@@ -394,7 +436,9 @@ auto MainOptions::to_string() -> std::string {
   if (!init_code.empty()) list.push_back("--init-code=" + init_code);
   if (!instance_uuid.empty()) list.push_back("--instance-uuid" + instance_uuid);
   if (!instance_name.empty()) list.push_back("--instance-name" + instance_name);
-  if (reuse_port) list.push_back("--reuse-port");
+  if (reuse_port) list.push_back(reuse_port_cpu ? "--reuse-port=cpu" : "--reuse-port");
+  if (!io_engine.empty()) list.push_back("--io-engine=" + io_engine);
+  if (!script_tier.empty()) list.push_back("--script-tier=" + script_tier);
   if (admin_port_off) list.push_back("--admin-port-off");
   if (!admin_port.empty()) list.push_back("--admin-port=" + admin_port);
   if (!admin_gui.empty()) list.push_back("--admin-gui=" + admin_gui);
@@ -58,7 +58,13 @@ public:
   bool        trace_objects = false;
   bool        force_start = false;
   bool        reuse_port = false;
+  bool        reuse_port_cpu = false;
+  std::string io_engine;
+  std::string script_tier;
   int         threads = 1;
+  std::string cpu_affinity;
+  std::vector<int> cpu_list;
+  bool        numa = false;
   std::string log_file;
   int         log_file_max_size = 0;
   int         log_file_max_count = 0;
@@ -188,6 +188,7 @@ class PoolCleaner : public PeriodicJob {
     for (const auto &p : pjs::Pool::all()) {
       p.second->clean();
     }
+    pjs::Arena::clean();
     WorkerManager::get().recycle();
     next();
   }
@@ -449,7 +450,28 @@ int pipy_main(int argc, char *argv[]) {
     Log::init();
     logging::Logger::set_history_size(opts.log_history_limit);
     Listener::set_reuse_port(opts.reuse_port);
+    if (!opts.cpu_affinity.empty()) {
+      auto cpus = (opts.cpu_affinity == "auto" ? os::cpu_list() : opts.cpu_list);
+      if (cpus.empty()) {
+        Log::warn("[thread] CPU affinity is not supported on this platform");
+      } else {
+        WorkerThread::set_cpu_affinity(cpus, opts.numa);
+        if (opts.reuse_port_cpu) {
+          std::vector<int> worker_cpus;
+          for (int i = 0; i < opts.threads; i++) worker_cpus.push_back(WorkerThread::cpu_of(i));
+          Listener::set_reuse_port_cpus(worker_cpus);
+        }
+      }
+    }
+    if (opts.io_engine == "io_uring") {
+#ifdef PIPY_USE_IO_URING
+      Net::set_io_engine(Net::IOEngine::IO_URING);
+#else
+      Log::warn("[io_uring] not supported in this build, falling back to epoll");
+#endif
+    }
     pjs::Class::set_tracing(opts.trace_objects);
+    pjs::Bytecode::enable(opts.script_tier != "tree");
     pjs::Math::init();
     crypto::Crypto::init(opts.openssl_engine);
     tls::TLSSession::init();
@@ -98,8 +98,11 @@ void JSModule::setup_pipeline_lb(PipelineLoadBalancer *plb) {
   }
 }
 
-auto JSModule::alloc_pipeline_lb(pjs::Str *name, EventTarget::Input *output) -> PipelineLoadBalancer::AsyncWrapper* {
-  return m_worker->m_pipeline_lb->allocate(filename()->str(), name->str(), output);
+auto JSModule::alloc_pipeline_lb(
+  pjs::Str *name, EventTarget::Input *output,
+  PipelineLoadBalancer::Policy policy, size_t hash
+) -> PipelineLoadBalancer::AsyncWrapper* {
+  return m_worker->m_pipeline_lb->allocate(filename()->str(), name->str(), output, policy, hash);
 }
 
 auto JSModule::new_context(Context *base) -> Context* {
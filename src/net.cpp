@@ -28,6 +28,7 @@
 namespace pipy {
 
 Net* Net::s_main = nullptr;
+Net::IOEngine Net::s_io_engine = Net::IOEngine::EPOLL;
 
 auto Net::current() -> Net& {
   static thread_local Net s_current;
@@ -42,7 +42,14 @@ namespace pipy {
 
 class Net {
 public:
+  enum class IOEngine {
+    EPOLL,
+    IO_URING,
+  };
+
   static void init();
+  static void set_io_engine(IOEngine engine) { s_io_engine = engine; }
+  static auto io_engine() -> IOEngine { return s_io_engine; }
 
   static auto main() -> Net& {
     return *s_main;
@@ -70,6 +77,7 @@ private:
   asio::io_context m_io_context;
   bool m_is_running;
   static Net* s_main;
+  static IOEngine s_io_engine;
 };
 
 //
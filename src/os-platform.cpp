@@ -37,6 +37,11 @@
 
 #endif // _WIN32
 
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#endif // __linux__
+
 namespace pipy {
 namespace os {
 
@@ -270,6 +275,14 @@ void kill(int pid, int sig) {
   // TODO
 }
 
+auto cpu_list() -> std::vector<int> {
+  return std::vector<int>();
+}
+
+bool pin_thread(int cpu, bool numa) {
+  return false;
+}
+
 auto FileHandle::std_input() -> FileHandle {
   if (!s_stdin_server) {
     char name[256];
@@ -447,6 +460,9 @@ auto get_last_error() -> std::string {
 
 void init()
 {
+  // Writes to a socket with no MSG_NOSIGNAL, such as splice(),
+  // must report EPIPE instead of killing the process
+  signal(SIGPIPE, SIG_IGN);
 }
 
 void cleanup()
@@ -462,6 +478,46 @@ void kill(int pid, int sig) {
   ::kill(pid, sig);
 }
 
+auto cpu_list() -> std::vector<int> {
+  std::vector<int> list;
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (!sched_getaffinity(0, sizeof(set), &set)) {
+    for (int i = 0; i < CPU_SETSIZE; i++) {
+      if (CPU_ISSET(i, &set)) list.push_back(i);
+    }
+  }
+#endif // __linux__
+  return list;
+}
+
+//
+// Pins the calling thread to a CPU. With numa, memory allocated by
+// the thread from then on comes from the node of that CPU when possible.
+//
+
+bool pin_thread(int cpu, bool numa) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (sched_setaffinity(0, sizeof(set), &set)) return false;
+  if (numa) {
+    static const int MPOL_PREFERRED = 1;
+    static const int BITS = 8 * sizeof(unsigned long);
+    unsigned int c = 0, node = 0;
+    if (syscall(SYS_getcpu, &c, &node, nullptr)) return false;
+    unsigned long mask[1024 / BITS] = {};
+    mask[node / BITS] |= 1ul << (node % BITS);
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, 1024)) return false;
+  }
+  return true;
+#else
+  return false;
+#endif // __linux__
+}
+
 FileHandle::FileHandle(int fd, const char *mode) {
   m_file = fdopen(fd, mode);
 }
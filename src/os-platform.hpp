@@ -28,6 +28,8 @@
 
 #include "net.hpp"
 
+#include <vector>
+
 namespace pipy {
 namespace os {
 
@@ -35,6 +37,8 @@ void init();
 void cleanup();
 auto process_id() -> int;
 void kill(int pid, int sig = 0);
+auto cpu_list() -> std::vector<int>;
+bool pin_thread(int cpu, bool numa);
 
 } // namespace os
 } // namespace pipy
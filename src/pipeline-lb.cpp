@@ -53,49 +53,114 @@ void PipelineLoadBalancer::add_target(PipelineLayout *layout) {
   auto &p = m_modules[m->filename()->str()].pipelines[layout->name()->str()];
   auto *t = new Target;
   t->net = &Net::current();
+  t->channel = EventChannel::current();
   t->layout = layout;
   t->next = p.targets;
   p.targets = t;
+  p.count++;
 }
 
-auto PipelineLoadBalancer::allocate(const std::string &module, const std::string &name, EventTarget::Input *output) -> AsyncWrapper* {
+auto PipelineLoadBalancer::allocate(
+  const std::string &module, const std::string &name, EventTarget::Input *output,
+  Policy policy, size_t hash
+) -> AsyncWrapper* {
   std::lock_guard<std::mutex> lock(m_mutex);
   auto i = m_modules.find(module); if (i == m_modules.end()) return nullptr;
   auto j = i->second.pipelines.find(name); if (j == i->second.pipelines.end()) return nullptr;
-  auto t = j->second.current;
-  if (!t) t = j->second.targets;
+  auto &p = j->second;
+  Target *t = nullptr;
+  switch (policy) {
+    case Policy::ROUND_ROBIN: t = p.next(); break;
+    case Policy::LEAST_LOAD: t = p.least_loaded(); break;
+    case Policy::LOCAL_FIRST: t = p.local(); break;
+    case Policy::HASHING: t = p.hashed(hash); break;
+  }
   if (!t) return nullptr;
-  j->second.current = t->next;
-  return new AsyncWrapper(t->net, t->layout, output);
+  t->layout->m_inflight.fetch_add(1, std::memory_order_relaxed);
+  return new AsyncWrapper(t->channel, t->layout, output);
+}
+
+//
+// PipelineLoadBalancer::PipelineInfo
+//
+
+auto PipelineLoadBalancer::PipelineInfo::next() -> Target* {
+  auto t = current;
+  if (!t) t = targets;
+  if (!t) return nullptr;
+  current = t->next;
+  return t;
+}
+
+//
+// Scans from the round-robin position so that targets
+// with equal loads still get their turns
+//
+
+auto PipelineLoadBalancer::PipelineInfo::least_loaded() -> Target* {
+  auto start = current ? current : targets;
+  if (!start) return nullptr;
+  Target *best = nullptr;
+  size_t best_load = 0;
+  auto t = start;
+  do {
+    auto load = t->load();
+    if (!best || load < best_load) {
+      best = t;
+      best_load = load;
+    }
+    t = t->next ? t->next : targets;
+  } while (t != start);
+  current = best->next;
+  return best;
+}
+
+auto PipelineLoadBalancer::PipelineInfo::local() -> Target* {
+  auto net = &Net::current();
+  for (auto t = targets; t; t = t->next) {
+    if (t->net == net) {
+      if (!t->is_saturated()) return t;
+      break;
+    }
+  }
+  return least_loaded();
+}
+
+auto PipelineLoadBalancer::PipelineInfo::hashed(size_t hash) -> Target* {
+  if (!count) return nullptr;
+  auto i = hash % count;
+  auto t = targets;
+  while (i-- > 0) t = t->next;
+  return t;
 }
 
 //
 // PipelineLoadBalancer::AsyncWrapper
 //
 
-PipelineLoadBalancer::AsyncWrapper::AsyncWrapper(Net *net, PipelineLayout *layout, EventTarget::Input *output)
-  : m_input_net(net)
-  , m_output_net(&Net::current())
+PipelineLoadBalancer::AsyncWrapper::AsyncWrapper(EventChannel *channel, PipelineLayout *layout, EventTarget::Input *output)
+  : m_input_channel(channel)
+  , m_output_channel(EventChannel::current())
   , m_pipeline_layout(layout)
   , m_output(output)
 {
   retain();
-  m_input_net->io_context().post(OpenHandler(this));
+  m_input_channel->send(this, OPEN, nullptr);
 }
 
 void PipelineLoadBalancer::AsyncWrapper::input(Event *evt) {
   retain();
-  m_input_net->io_context().post(InputHandler(this, SharedEvent::make(evt)));
+  m_input_channel->send(this, INPUT, SharedEvent::make(evt));
 }
 
 void PipelineLoadBalancer::AsyncWrapper::close() {
   m_output = nullptr;
-  m_input_net->io_context().post(CloseHandler(this));
+  m_input_channel->send(this, CLOSE, nullptr);
 }
 
 void PipelineLoadBalancer::AsyncWrapper::on_event(Event *evt) {
   retain();
-  m_output_net->io_context().post(OutputHandler(this, SharedEvent::make(evt)));
+  m_output_channel->send(this, OUTPUT, SharedEvent::make(evt));
 }
 
 void PipelineLoadBalancer::AsyncWrapper::on_open() {
@@ -107,12 +172,22 @@ void PipelineLoadBalancer::AsyncWrapper::on_open() {
 }
 
 void PipelineLoadBalancer::AsyncWrapper::on_close() {
+  m_pipeline_layout->m_inflight.fetch_sub(1, std::memory_order_relaxed);
   m_pipeline = nullptr;
   m_pipeline_layout = nullptr;
   EventTarget::close();
   release();
 }
 
+void PipelineLoadBalancer::AsyncWrapper::on_receive(SharedEvent *se, int tag) {
+  switch (tag) {
+    case OPEN: on_open(); break;
+    case CLOSE: on_close(); break;
+    case INPUT: on_input(se); break;
+    case OUTPUT: on_output(se); break;
+  }
+}
+
 void PipelineLoadBalancer::AsyncWrapper::on_input(SharedEvent *se) {
   if (auto evt = se->to_event()) {
     if (m_pipeline) {
@@ -27,6 +27,7 @@
 #define PIPELINE_LB_HPP
 
 #include "event.hpp"
+#include "event-channel.hpp"
 #include "net.hpp"
 #include "pipeline.hpp"
 
@@ -45,6 +46,17 @@ public:
     return new PipelineLoadBalancer;
   }
 
+  //
+  // Policy
+  //
+
+  enum class Policy {
+    ROUND_ROBIN,
+    LEAST_LOAD,
+    LOCAL_FIRST,
+    HASHING,
+  };
+
   //
   // AsyncWrapper
   //
@@ -52,51 +64,27 @@ public:
   class AsyncWrapper :
     public pjs::Pooled<AsyncWrapper>,
     public pjs::RefCountMT<AsyncWrapper>,
-    public EventTarget {
+    public EventTarget,
+    public EventChannel::Receiver {
   public:
     void input(Event *evt);
     void close();
 
   private:
-    AsyncWrapper(Net *net, PipelineLayout *layout, EventTarget::Input *output);
-
-    struct OpenHandler : SelfHandlerMT<AsyncWrapper> {
-      using SelfHandlerMT::SelfHandlerMT;
-      OpenHandler(const OpenHandler &r) : SelfHandlerMT(r) {}
-      void operator()() { self->on_open(); }
-    };
-
-    struct CloseHandler : SelfHandlerMT<AsyncWrapper> {
-      using SelfHandlerMT::SelfHandlerMT;
-      CloseHandler(const CloseHandler &r) : SelfHandlerMT(r) {}
-      void operator()() { self->on_close(); }
-    };
-
-    struct InputHandler : SelfDataHandlerMT<AsyncWrapper, SharedEvent> {
-      using SelfDataHandlerMT::SelfDataHandlerMT;
-      InputHandler(AsyncWrapper *s, SharedEvent *d) : SelfDataHandlerMT(s, d) { d->retain(); }
-      InputHandler(const InputHandler &r) : SelfDataHandlerMT(r) { r.data->retain(); }
-      ~InputHandler() { data->release(); }
-      void operator()() { self->on_input(data); }
-    };
-
-    struct OutputHandler : SelfDataHandlerMT<AsyncWrapper, SharedEvent> {
-      using SelfDataHandlerMT::SelfDataHandlerMT;
-      OutputHandler(AsyncWrapper *s, SharedEvent *d) : SelfDataHandlerMT(s, d) { d->retain(); }
-      OutputHandler(const OutputHandler &r) : SelfDataHandlerMT(r) { r.data->retain(); }
-      ~OutputHandler() { data->release(); }
-      void operator()() { self->on_output(data); }
-    };
+    AsyncWrapper(EventChannel *channel, PipelineLayout *layout, EventTarget::Input *output);
+
+    enum { OPEN, CLOSE, INPUT, OUTPUT };
 
     virtual void on_event(Event *evt) override;
+    virtual void on_receive(SharedEvent *se, int tag) override;
 
     void on_open();
     void on_close();
     void on_input(SharedEvent *se);
     void on_output(SharedEvent *se);
 
-    Net* m_input_net;
-    Net* m_output_net;
+    EventChannel* m_input_channel;
+    EventChannel* m_output_channel;
     pjs::Ref<PipelineLayout> m_pipeline_layout;
     pjs::Ref<Pipeline> m_pipeline;
     pjs::Ref<EventTarget::Input> m_output;
@@ -106,7 +94,10 @@ public:
   };
 
   void add_target(PipelineLayout *target);
-  auto allocate(const std::string &module, const std::string &name, EventTarget::Input *output) -> AsyncWrapper*;
+  auto allocate(
+    const std::string &module, const std::string &name, EventTarget::Input *output,
+    Policy policy = Policy::ROUND_ROBIN, size_t hash = 0
+  ) -> AsyncWrapper*;
 
 private:
   PipelineLoadBalancer() {}
@@ -118,8 +109,11 @@ private:
 
   struct Target {
     Net* net = nullptr;
+    EventChannel* channel = nullptr;
     Target* next = nullptr;
     pjs::Ref<PipelineLayout> layout;
+    auto load() const -> size_t { return layout->inflight() + channel->depth(); }
+    bool is_saturated() const { return channel->depth() >= EventChannel::BATCH_SIZE; }
   };
 
   //
@@ -129,8 +123,11 @@ private:
   struct PipelineInfo {
     Target* targets = nullptr;
     Target* current = nullptr;
-    void add(Net *net, PipelineLayout *layout);
-    auto next() -> Net*;
+    size_t count = 0;
+    auto next() -> Target*;
+    auto least_loaded() -> Target*;
+    auto local() -> Target*;
+    auto hashed(size_t hash) -> Target*;
   };
 
   //
@@ -46,6 +46,7 @@ PipelineLayout::PipelineLayout(Worker *worker, ModuleBase *module, int index, co
   , m_label(pjs::Str::make(label))
   , m_worker(worker)
   , m_module(module)
+  , m_inflight(0)
 {
   s_all_pipeline_layouts.push(this);
   if (module) {
@@ -194,6 +195,10 @@ Pipeline::~Pipeline() {
   }
 }
 
+auto Pipeline::head() const -> Filter* {
+  return m_filters.head();
+}
+
 void Pipeline::start(const pjs::Value &args) {
   if (args.is_empty()) {
     start();
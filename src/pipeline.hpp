@@ -32,6 +32,7 @@
 #include "list.hpp"
 #include "buffer.hpp"
 
+#include <atomic>
 #include <list>
 #include <memory>
 #include <set>
@@ -106,6 +107,8 @@ public:
   auto name_or_label() const -> pjs::Str*;
   auto allocated() const -> size_t { return m_allocated; }
   auto active() const -> size_t { return m_pipelines.size(); }
+  auto inflight() const -> int { return m_inflight.load(std::memory_order_relaxed); }
+  auto filter_count() const -> size_t { return m_filters.size(); }
   void on_start_location(pjs::Location &loc) { m_on_start_location = loc; }
   void on_start(pjs::Object *e) { m_on_start = e; }
   void on_end(pjs::Function *f) { m_on_end = f; }
@@ -136,6 +139,7 @@ private:
   List<Pipeline> m_pipelines;
   int m_allocated = 0;
   int m_active = 0;
+  std::atomic<int> m_inflight;
 
   thread_local static List<PipelineLayout> s_all_pipeline_layouts;
   thread_local static size_t s_active_pipeline_count;
@@ -143,6 +147,7 @@ private:
   friend class pjs::RefCountMT<PipelineLayout>;
   friend class Pipeline;
   friend class Graph;
+  friend class PipelineLoadBalancer;
 };
 
 //
@@ -185,6 +190,7 @@ public:
   auto layout() const -> PipelineLayout* { return m_layout; }
   auto context() const -> Context* { return m_context; }
   auto chain() const -> PipelineLayout::Chain* { return m_chain; }
+  auto head() const -> Filter*;
   void chain(Input *input) { EventProxy::chain(input); }
   void chain(PipelineLayout::Chain *chain, const pjs::Value &args = pjs::Value::undefined) { m_chain = chain; m_chain_args = args; }
   auto chain_args() const -> const pjs::Value& { return m_chain_args; }
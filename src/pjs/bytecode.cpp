@@ -0,0 +1,270 @@
+/*
+ *  Copyright (c) 2019 by flomesh.io
+ *
+ *  Unless prior written consent has been obtained from the copyright
+ *  owner, the following shall not be allowed.
+ *
+ *  1. The distribution of any source codes, header files, make files,
+ *     or libraries of the software.
+ *
+ *  2. Disclosure of any source codes pertaining to the software to any
+ *     additional parties.
+ *
+ *  3. Alteration or removal of any notices in or on the software or
+ *     within the documentation included within the software.
+ *
+ *  ALL SOURCE CODE AS WELL AS ALL DOCUMENTATION INCLUDED WITH THIS
+ *  SOFTWARE IS PROVIDED IN AN “AS IS” CONDITION, WITHOUT WARRANTY OF ANY
+ *  KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ *  CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ *  TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ *  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "bytecode.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+
+#include <cmath>
+
+//
+// Computed gotos are used for dispatching when the compiler supports them,
+// so that each handler jumps straight to the next one instead of going
+// back through a shared switch.
+//
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PJS_BYTECODE_THREADED
+#endif
+
+namespace pjs {
+
+bool Bytecode::s_enabled = true;
+
+//
+// Bytecode::Compiler
+//
+
+int Bytecode::Compiler::push() {
+  auto r = m_top++;
+  if (m_top > m_bytecode->m_register_count) {
+    m_bytecode->m_register_count = m_top;
+  }
+  return r;
+}
+
+int Bytecode::Compiler::emit(Op op, int r, int a, int b, void *p) {
+  auto &code = m_bytecode->m_code;
+  code.push_back({ op, r, a, b, p });
+  switch (op) {
+    case EVAL: case EXEC: case RET: case RETU: break;
+    default: m_lowered++; break;
+  }
+  return code.size() - 1;
+}
+
+int Bytecode::Compiler::constant(const Value &v) {
+  auto &constants = m_bytecode->m_constants;
+  constants.push_back(v);
+  return constants.size() - 1;
+}
+
+void Bytecode::Compiler::patch(int i) {
+  m_bytecode->m_code[i].a = m_bytecode->m_code.size();
+}
+
+void Bytecode::Compiler::binary(Op op, Expr *a, Expr *b, int r, void *p) {
+  a->compile(*this, r);
+  auto t = push();
+  b->compile(*this, t);
+  emit(op, r, r, t, p);
+  pop();
+}
+
+void Bytecode::Compiler::branch(Op op, Expr *a, Expr *b, int r) {
+  a->compile(*this, r);
+  auto j = emit(op, r);
+  b->compile(*this, r);
+  patch(j);
+}
+
+void Bytecode::Compiler::fallback(Expr *expr, int r) {
+  emit(EVAL, r, 0, 0, expr);
+}
+
+void Bytecode::Compiler::fallback(Stmt *stmt) {
+  emit(EXEC, 0, 0, 0, stmt);
+}
+
+//
+// Bytecode
+//
+
+auto Bytecode::compile(Stmt *body) -> Bytecode* {
+  auto *bytecode = new Bytecode;
+  Compiler compiler(bytecode);
+  body->compile(compiler);
+  compiler.emit(RETU);
+  if (!compiler.m_lowered) {
+    delete bytecode;
+    return nullptr;
+  }
+  return bytecode;
+}
+
+bool Bytecode::execute(Context &ctx, Value &result) {
+  vl_array<Value, 16> registers(m_register_count);
+  auto *R = registers.data();
+  auto *K = m_constants.data();
+  auto *code = m_code.data();
+  auto *pc = code;
+
+#ifdef PJS_BYTECODE_THREADED
+
+  static void* labels[] = {
+#define PJS_BYTECODE_OP(op) &&op_##op,
+    PJS_BYTECODE_OPS(PJS_BYTECODE_OP)
+#undef PJS_BYTECODE_OP
+  };
+
+#define OP(op) op_##op:
+#define NEXT() goto *labels[(++pc)->op]
+#define JUMP(i) goto *labels[(pc = code + (i))->op]
+
+  goto *labels[pc->op];
+
+#else // !PJS_BYTECODE_THREADED
+
+#define OP(op) case op:
+#define NEXT() { ++pc; continue; }
+#define JUMP(i) { pc = code + (i); continue; }
+
+  for (;;) switch (pc->op) {
+
+#endif // PJS_BYTECODE_THREADED
+
+  OP(CONST) {
+    R[pc->r] = K[pc->a];
+    NEXT();
+  }
+
+  OP(LOCAL) {
+    auto *scope = ctx.scope();
+    for (int i = 0; i < pc->b; i++) scope = scope->parent();
+    R[pc->r] = scope->value(pc->a);
+    NEXT();
+  }
+
+  OP(GET) {
+    auto *node = static_cast<expr::Property*>(pc->p);
+    if (!node->get(ctx, R[pc->a], R[pc->b], R[pc->r])) return false;
+    NEXT();
+  }
+
+  OP(CHECK) {
+    auto *node = static_cast<expr::Invocation*>(pc->p);
+    if (!node->check(ctx, R[pc->a])) return false;
+    NEXT();
+  }
+
+  OP(CALL) {
+    auto *node = static_cast<expr::Invocation*>(pc->p);
+    auto *f = R + pc->a;
+    auto argc = pc->b;
+    if (!node->call(ctx, *f, argc, f + 1, R[pc->r])) return false;
+    for (int i = 0; i <= argc; i++) f[i] = Value::undefined;
+    NEXT();
+  }
+
+#define BINARY(op, node, number) \
+  OP(op) { \
+    const auto &a = R[pc->a]; \
+    const auto &b = R[pc->b]; \
+    if (a.is_number() && b.is_number()) { \
+      R[pc->r].set(number); \
+    } else { \
+      expr::node::operate(a, b, R[pc->r]); \
+    } \
+    NEXT(); \
+  }
+
+  BINARY(ADD, Addition, a.n() + b.n())
+  BINARY(SUB, Subtraction, a.n() - b.n())
+  BINARY(MUL, Multiplication, a.n() * b.n())
+  BINARY(DIV, Division, a.n() / b.n())
+  BINARY(REM, Remainder, std::fmod(a.n(), b.n()))
+  BINARY(EQ, Equality, a.n() == b.n())
+  BINARY(NE, Inequality, a.n() != b.n())
+  BINARY(SEQ, Identity, a.n() == b.n())
+  BINARY(SNE, Nonidentity, a.n() != b.n())
+  BINARY(LT, LessThan, a.n() < b.n())
+  BINARY(LE, LessThanOrEqual, a.n() <= b.n())
+  BINARY(GT, GreaterThan, a.n() > b.n())
+  BINARY(GE, GreaterThanOrEqual, a.n() >= b.n())
+
+#undef BINARY
+
+  OP(NOT) {
+    R[pc->r].set(!R[pc->a].to_boolean());
+    NEXT();
+  }
+
+  OP(JMP) {
+    JUMP(pc->a);
+  }
+
+  OP(JT) {
+    if (R[pc->r].to_boolean()) JUMP(pc->a);
+    NEXT();
+  }
+
+  OP(JF) {
+    if (!R[pc->r].to_boolean()) JUMP(pc->a);
+    NEXT();
+  }
+
+  OP(JNN) {
+    if (!R[pc->r].is_nullish()) JUMP(pc->a);
+    NEXT();
+  }
+
+  OP(EVAL) {
+    if (!static_cast<Expr*>(pc->p)->eval(ctx, R[pc->r])) return false;
+    NEXT();
+  }
+
+  OP(EXEC) {
+    Stmt::Result res;
+    static_cast<Stmt*>(pc->p)->execute(ctx, res);
+    if (!ctx.ok()) return false;
+    if (res.is_return()) {
+      result = res.value;
+      return true;
+    }
+    NEXT();
+  }
+
+  OP(RET) {
+    result = R[pc->r];
+    return true;
+  }
+
+  OP(RETU) {
+    result = Value::undefined;
+    return true;
+  }
+
+#ifndef PJS_BYTECODE_THREADED
+  }
+#endif
+
+  return false;
+
+#undef OP
+#undef NEXT
+#undef JUMP
+}
+
+} // namespace pjs
@@ -0,0 +1,109 @@
+/*
+ *  Copyright (c) 2019 by flomesh.io
+ *
+ *  Unless prior written consent has been obtained from the copyright
+ *  owner, the following shall not be allowed.
+ *
+ *  1. The distribution of any source codes, header files, make files,
+ *     or libraries of the software.
+ *
+ *  2. Disclosure of any source codes pertaining to the software to any
+ *     additional parties.
+ *
+ *  3. Alteration or removal of any notices in or on the software or
+ *     within the documentation included within the software.
+ *
+ *  ALL SOURCE CODE AS WELL AS ALL DOCUMENTATION INCLUDED WITH THIS
+ *  SOFTWARE IS PROVIDED IN AN “AS IS” CONDITION, WITHOUT WARRANTY OF ANY
+ *  KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ *  CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ *  TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ *  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PJS_BYTECODE_HPP
+#define PJS_BYTECODE_HPP
+
+#include "types.hpp"
+
+#include <vector>
+
+namespace pjs {
+
+class Expr;
+class Stmt;
+
+//
+// Bytecode
+//
+// Function bodies are lowered into a flat array of register instructions
+// after being resolved. Nodes without a lowering are kept as they are and
+// get evaluated by the tree-walker from within the bytecode (EVAL/EXEC).
+//
+
+#define PJS_BYTECODE_OPS(X) \
+  X(CONST) X(LOCAL) X(GET) X(CHECK) X(CALL) \
+  X(ADD) X(SUB) X(MUL) X(DIV) X(REM) \
+  X(EQ) X(NE) X(SEQ) X(SNE) X(LT) X(LE) X(GT) X(GE) X(NOT) \
+  X(JMP) X(JT) X(JF) X(JNN) \
+  X(EVAL) X(EXEC) X(RET) X(RETU)
+
+class Bytecode {
+public:
+  enum Op {
+#define PJS_BYTECODE_OP(op) op,
+    PJS_BYTECODE_OPS(PJS_BYTECODE_OP)
+#undef PJS_BYTECODE_OP
+  };
+
+  struct Instruction {
+    Op op;
+    int r, a, b;
+    void *p;
+  };
+
+  //
+  // Bytecode::Compiler
+  //
+
+  class Compiler {
+  public:
+    int push();
+    void pop() { m_top--; }
+    int emit(Op op, int r = 0, int a = 0, int b = 0, void *p = nullptr);
+    int constant(const Value &v);
+    void patch(int i);
+    void binary(Op op, Expr *a, Expr *b, int r, void *p = nullptr);
+    void branch(Op op, Expr *a, Expr *b, int r);
+    void fallback(Expr *expr, int r);
+    void fallback(Stmt *stmt);
+
+  private:
+    Compiler(Bytecode *bytecode) : m_bytecode(bytecode) {}
+
+    Bytecode* m_bytecode;
+    int m_top = 0;
+    int m_lowered = 0;
+
+    friend class Bytecode;
+  };
+
+  static void enable(bool b) { s_enabled = b; }
+  static bool enabled() { return s_enabled; }
+  static auto compile(Stmt *body) -> Bytecode*;
+
+  bool execute(Context &ctx, Value &result);
+
+private:
+  std::vector<Instruction> m_code;
+  std::vector<Value> m_constants;
+  int m_register_count = 0;
+
+  static bool s_enabled;
+};
+
+} // namespace pjs
+
+#endif // PJS_BYTECODE_HPP
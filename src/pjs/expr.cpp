@@ -54,6 +54,32 @@ Expr::~Expr()
 {
 }
 
+void Expr::fold(std::unique_ptr<Expr> &expr, Module *module, Context &ctx) {
+  if (auto folded = expr->fold(ctx)) {
+    expr.reset(folded);
+    if (module) module->add_folded();
+  }
+}
+
+auto Expr::constant(Context &ctx) -> Expr* {
+  Value v;
+  if (!eval(ctx, v)) {
+    ctx.reset();
+    return nullptr;
+  }
+  Expr *expr = nullptr;
+  switch (v.type()) {
+    case Value::Type::Undefined: expr = new expr::Undefined; break;
+    case Value::Type::Boolean: expr = new expr::BooleanLiteral(v.b()); break;
+    case Value::Type::Number: expr = new expr::NumberLiteral(v.n()); break;
+    case Value::Type::String: expr = new expr::StringLiteral(v.s()->str()); break;
+    case Value::Type::Object: if (v.is_null()) expr = new expr::Null; break;
+    default: break;
+  }
+  if (expr) expr->locate(source(), line(), column());
+  return expr;
+}
+
 namespace expr {
 
 //
@@ -72,6 +98,7 @@ bool Discard::declare(Module *module, Scope &scope, Error &error, bool is_lval)
 
 void Discard::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_x->resolve(module, ctx, l, imports);
+  Expr::fold(m_x, module, ctx);
 }
 
 void Discard::dump(std::ostream &out, const std::string &indent) {
@@ -157,11 +184,19 @@ bool Concatenation::declare(Module *module, Scope &scope, Error &error, bool is_
 }
 
 void Concatenation::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
-  for (const auto &p : m_exprs) {
+  for (auto &p : m_exprs) {
     p->resolve(module, ctx, l, imports);
+    Expr::fold(p, module, ctx);
   }
 }
 
+auto Concatenation::fold(Context &ctx) -> Expr* {
+  for (const auto &p : m_exprs) {
+    if (!p->is_constant()) return nullptr;
+  }
+  return constant(ctx);
+}
+
 void Concatenation::dump(std::ostream &out, const std::string &indent) {
   out << indent << "concatenation" << std::endl;
   for (const auto &p : m_exprs) {
@@ -186,6 +221,10 @@ void Undefined::dump(std::ostream &out, const std::string &indent) {
   out << indent << "undefined" << std::endl;
 }
 
+void Undefined::compile(Bytecode::Compiler &c, int r) {
+  c.emit(Bytecode::CONST, r, c.constant(Value::undefined));
+}
+
 //
 // Null
 //
@@ -203,6 +242,10 @@ void Null::dump(std::ostream &out, const std::string &indent) {
   out << indent << "null" << std::endl;
 }
 
+void Null::compile(Bytecode::Compiler &c, int r) {
+  c.emit(Bytecode::CONST, r, c.constant(Value::null));
+}
+
 //
 // BooleanLiteral
 //
@@ -220,6 +263,10 @@ void BooleanLiteral::dump(std::ostream &out, const std::string &indent) {
   out << indent << (m_b ? "true" : "false") << std::endl;
 }
 
+void BooleanLiteral::compile(Bytecode::Compiler &c, int r) {
+  c.emit(Bytecode::CONST, r, c.constant(m_b));
+}
+
 //
 // NumberLiteral
 //
@@ -237,6 +284,10 @@ void NumberLiteral::dump(std::ostream &out, const std::string &indent) {
   out << indent << "number " << m_n << std::endl;
 }
 
+void NumberLiteral::compile(Bytecode::Compiler &c, int r) {
+  c.emit(Bytecode::CONST, r, c.constant(m_n));
+}
+
 //
 // StringLiteral
 //
@@ -254,6 +305,10 @@ void StringLiteral::dump(std::ostream &out, const std::string &indent) {
   out << indent << "string \"" << m_s->str() << '"' << std::endl;
 }
 
+void StringLiteral::compile(Bytecode::Compiler &c, int r) {
+  c.emit(Bytecode::CONST, r, c.constant(m_s.get()));
+}
+
 //
 // ObjectLiteral
 //
@@ -376,6 +431,7 @@ bool ObjectLiteral::declare(Module *module, Scope &scope, Error &error, bool is_
     m_unpack_vals.resize(vars.size());
     for (size_t i = 0; i < vars.size(); i++) {
       m_unpack_vars[i].reset(new Identifier(vars[i]->str()));
+      m_unpack_vars[i]->declare(module, scope, error, true);
     }
     m_is_left_value = true;
   } else {
@@ -395,11 +451,14 @@ void ObjectLiteral::resolve(Module *module, Context &ctx, int l, LegacyImports *
       v->resolve(module, ctx, l, imports);
     }
   } else {
-    for (const auto &e : m_entries) {
+    for (auto &e : m_entries) {
       auto k = e.key.get();
       auto v = e.value.get();
       if (k) k->resolve(module, ctx, l, imports);
-      if (v) v->resolve(module, ctx, l, imports);
+      if (v) {
+        v->resolve(module, ctx, l, imports);
+        Expr::fold(e.value, module, ctx);
+      }
     }
   }
 }
@@ -543,6 +602,7 @@ bool ArrayLiteral::declare(Module *module, Scope &scope, Error &error, bool is_l
     m_unpack_vals.resize(vars.size());
     for (size_t i = 0; i < vars.size(); i++) {
       m_unpack_vars[i].reset(new Identifier(vars[i]->str()));
+      m_unpack_vars[i]->declare(module, scope, error, true);
     }
     m_is_left_value = true;
   } else {
@@ -554,8 +614,9 @@ bool ArrayLiteral::declare(Module *module, Scope &scope, Error &error, bool is_l
 }
 
 void ArrayLiteral::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
-  for (const auto &p : m_list) {
+  for (auto &p : m_list) {
     p->resolve(module, ctx, l, imports);
+    if (!m_is_left_value) Expr::fold(p, module, ctx);
   }
 }
 
@@ -618,13 +679,17 @@ void FunctionLiteral::resolve(Module *module, Context &ctx, int l, LegacyImports
     name, [this](Context &ctx, Object*, Value &result) {
       auto scope = m_scope.instantiate(ctx);
       if (!scope) return;
-      Stmt::Result res;
-      m_output->execute(ctx, res);
-      if (ctx.ok()) {
-        if (res.is_return()) {
-          result = res.value;
-        } else {
-          result = Value::undefined;
+      if (m_bytecode && Bytecode::enabled()) {
+        m_bytecode->execute(ctx, result);
+      } else {
+        Stmt::Result res;
+        m_output->execute(ctx, res);
+        if (ctx.ok()) {
+          if (res.is_return()) {
+            result = res.value;
+          } else {
+            result = Value::undefined;
+          }
         }
       }
       scope->clear();
@@ -634,6 +699,7 @@ void FunctionLiteral::resolve(Module *module, Context &ctx, int l, LegacyImports
   Context fctx(ctx, 0, nullptr, pjs::Scope::make(ctx.instance(), ctx.scope(), m_scope.size(), m_scope.variables()));
   for (auto &i : m_inputs) i->resolve(module, fctx, l, imports);
   m_output->resolve(module, fctx, l, imports);
+  m_bytecode.reset(Bytecode::compile(m_output.get()));
 }
 
 auto FunctionLiteral::reduce(Reducer &r) -> Reducer::Value* {
@@ -790,6 +856,10 @@ void LocalVariable::dump(std::ostream &out, const std::string &indent) {
   out << indent << "local-variable " << m_i << std::endl;
 }
 
+void LocalVariable::compile(Bytecode::Compiler &c, int r) {
+  c.emit(Bytecode::LOCAL, r, m_i, m_level);
+}
+
 //
 // FiberVariable
 //
@@ -856,6 +926,11 @@ bool Identifier::clear(Context &ctx, Value &result) {
   return m_resolved->clear(ctx, result);
 }
 
+bool Identifier::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
+  if (is_lval && module) module->add_assignment(m_key);
+  return true;
+}
+
 void Identifier::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_l = l;
   m_imports = imports;
@@ -863,6 +938,14 @@ void Identifier::resolve(Module *module, Context &ctx, int l, LegacyImports *imp
   resolve(ctx);
 }
 
+auto Identifier::fold(Context &ctx) -> Expr* {
+  if (m_resolved || !m_module) return nullptr;
+  auto value = m_module->find_constant(m_key);
+  if (!value) return nullptr;
+  auto expr = value->constant(ctx);
+  return expr ? locate(expr) : nullptr;
+}
+
 void Identifier::resolve(Context &ctx) {
   auto *scope = ctx.scope();
   for (int level = 0; scope; scope = scope->parent(), level++) {
@@ -928,6 +1011,14 @@ void Identifier::dump(std::ostream &out, const std::string &indent) {
   out << indent << "identifier " << m_key->c_str() << std::endl;
 }
 
+void Identifier::compile(Bytecode::Compiler &c, int r) {
+  if (m_resolved && m_resolved->is<LocalVariable>()) {
+    m_resolved->compile(c, r);
+  } else {
+    c.fallback(this, r);
+  }
+}
+
 //
 // Property
 //
@@ -938,6 +1029,10 @@ bool Property::eval(Context &ctx, Value &result) {
   Value obj, key;
   if (!m_obj->eval(ctx, obj)) return false;
   if (!m_key->eval(ctx, key)) return false;
+  return get(ctx, obj, key, result);
+}
+
+bool Property::get(Context &ctx, const Value &obj, const Value &key, Value &result) {
   if (obj.is_undefined()) return error(ctx, "cannot read property of undefined");
   if (obj.is_null()) return error(ctx, "cannot read property of null");
   auto o = obj.to_object();
@@ -1013,6 +1108,7 @@ bool Property::declare(Module *module, Scope &scope, Error &error, bool is_lval)
 void Property::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_obj->resolve(module, ctx, l, imports);
   m_key->resolve(module, ctx, l, imports);
+  Expr::fold(m_key, module, ctx);
 }
 
 auto Property::reduce(Reducer &r) -> Reducer::Value* {
@@ -1025,6 +1121,10 @@ void Property::dump(std::ostream &out, const std::string &indent) {
   m_key->dump(out, indent + "  ");
 }
 
+void Property::compile(Bytecode::Compiler &c, int r) {
+  c.binary(Bytecode::GET, m_obj.get(), m_key.get(), r, this);
+}
+
 //
 // OptionalProperty
 //
@@ -1063,6 +1163,7 @@ bool OptionalProperty::declare(Module *module, Scope &scope, Error &error, bool
 void OptionalProperty::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_obj->resolve(module, ctx, l, imports);
   m_key->resolve(module, ctx, l, imports);
+  Expr::fold(m_key, module, ctx);
 }
 
 void OptionalProperty::dump(std::ostream &out, const std::string &indent) {
@@ -1100,8 +1201,9 @@ bool Construction::declare(Module *module, Scope &scope, Error &error, bool is_l
 
 void Construction::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_func->resolve(module, ctx, l, imports);
-  for (const auto &p : m_argv) {
+  for (auto &p : m_argv) {
     p->resolve(module, ctx, l, imports);
+    Expr::fold(p, module, ctx);
   }
 }
 
@@ -1120,10 +1222,19 @@ bool Invocation::eval(Context &ctx, Value &result) {
   vl_array<Value> argv(argc);
   Value f;
   if (!m_func->eval(ctx, f)) return false;
-  if (!f.is_function()) return error(ctx, "not a function");
+  if (!check(ctx, f)) return false;
   for (size_t i = 0; i < argc; i++) {
     if (!m_argv[i]->eval(ctx, argv[i])) return false;
   }
+  return call(ctx, f, argc, argv, result);
+}
+
+bool Invocation::check(Context &ctx, const Value &f) {
+  if (!f.is_function()) return error(ctx, "not a function");
+  return true;
+}
+
+bool Invocation::call(Context &ctx, const Value &f, int argc, Value *argv, Value &result) {
   ctx.trace(m_module, line(), column());
   (*f.as<Function>())(ctx, argc, argv, result);
   if (ctx.ok()) return true;
@@ -1142,11 +1253,21 @@ bool Invocation::declare(Module *module, Scope &scope, Error &error, bool is_lva
 void Invocation::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_module = module;
   m_func->resolve(module, ctx, l, imports);
-  for (const auto &p : m_argv) {
+  for (auto &p : m_argv) {
     p->resolve(module, ctx, l, imports);
+    Expr::fold(p, module, ctx);
   }
 }
 
+auto Invocation::fold(Context &ctx) -> Expr* {
+  if (!m_argv.empty()) return nullptr;
+  auto f = m_func->as<FunctionLiteral>();
+  if (!f || f->input_count() > 0) return nullptr;
+  auto ret = dynamic_cast<stmt::Return*>(f->output());
+  if (!ret || !ret->value() || !ret->value()->is_constant()) return nullptr;
+  return ret->value()->constant(ctx);
+}
+
 auto Invocation::reduce(Reducer &r) -> Reducer::Value* {
   auto argc = m_argv.size();
   vl_array<Reducer::Value*> argv(argc);
@@ -1162,6 +1283,19 @@ void Invocation::dump(std::ostream &out, const std::string &indent) {
   for (const auto &arg : m_argv) arg->dump(out, indent + "  ");
 }
 
+void Invocation::compile(Bytecode::Compiler &c, int r) {
+  auto argc = m_argv.size();
+  auto f = c.push();
+  m_func->compile(c, f);
+  c.emit(Bytecode::CHECK, 0, f, 0, this);
+  for (size_t i = 0; i < argc; i++) {
+    auto a = c.push();
+    m_argv[i]->compile(c, a);
+  }
+  c.emit(Bytecode::CALL, r, f, argc, this);
+  for (size_t i = 0; i <= argc; i++) c.pop();
+}
+
 //
 // OptionalInvocation
 //
@@ -1195,8 +1329,9 @@ bool OptionalInvocation::declare(Module *module, Scope &scope, Error &error, boo
 
 void OptionalInvocation::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_func->resolve(module, ctx, l, imports);
-  for (const auto &p : m_argv) {
+  for (auto &p : m_argv) {
     p->resolve(module, ctx, l, imports);
+    Expr::fold(p, module, ctx);
   }
 }
 
@@ -1223,6 +1358,11 @@ bool Plus::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
 
 void Plus::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_x->resolve(module, ctx, l, imports);
+  Expr::fold(m_x, module, ctx);
+}
+
+auto Plus::fold(Context &ctx) -> Expr* {
+  return m_x->is_constant() ? constant(ctx) : nullptr;
 }
 
 void Plus::dump(std::ostream &out, const std::string &indent) {
@@ -1251,6 +1391,11 @@ bool Negation::declare(Module *module, Scope &scope, Error &error, bool is_lval)
 
 void Negation::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_x->resolve(module, ctx, l, imports);
+  Expr::fold(m_x, module, ctx);
+}
+
+auto Negation::fold(Context &ctx) -> Expr* {
+  return m_x->is_constant() ? constant(ctx) : nullptr;
 }
 
 void Negation::dump(std::ostream &out, const std::string &indent) {
@@ -1266,13 +1411,18 @@ bool Addition::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void Addition::operate(const Value &a, const Value &b, Value &result) {
   if (a.is_string() || b.is_string()) {
     auto sa = a.to_string();
     auto sb = b.to_string();
     result.set(sa->str() + sb->str());
     sa->release();
     sb->release();
-    return true;
+    return;
   }
   if (a.is<Int>() || b.is<Int>()) {
     auto ia = a.to_int();
@@ -1280,12 +1430,11 @@ bool Addition::eval(Context &ctx, Value &result) {
     result.set(ia->add(ib));
     ia->release();
     ib->release();
-    return true;
+    return;
   }
   auto na = a.to_number();
   auto nb = b.to_number();
   result.set(na + nb);
-  return true;
 }
 
 bool Addition::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
@@ -1296,7 +1445,13 @@ bool Addition::declare(Module *module, Scope &scope, Error &error, bool is_lval)
 
 void Addition::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto Addition::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void Addition::dump(std::ostream &out, const std::string &indent) {
@@ -1305,6 +1460,10 @@ void Addition::dump(std::ostream &out, const std::string &indent) {
   m_b->dump(out, indent + "  ");
 }
 
+void Addition::compile(Bytecode::Compiler &c, int r) {
+  c.binary(Bytecode::ADD, m_a.get(), m_b.get(), r);
+}
+
 //
 // Subtraction
 //
@@ -1313,18 +1472,22 @@ bool Subtraction::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void Subtraction::operate(const Value &a, const Value &b, Value &result) {
   if (a.is<Int>() || b.is<Int>()) {
     auto ia = a.to_int();
     auto ib = b.to_int();
     result.set(ia->sub(ib));
     ia->release();
     ib->release();
-    return true;
+    return;
   }
   auto na = a.to_number();
   auto nb = b.to_number();
   result.set(na - nb);
-  return true;
 }
 
 bool Subtraction::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
@@ -1335,7 +1498,13 @@ bool Subtraction::declare(Module *module, Scope &scope, Error &error, bool is_lv
 
 void Subtraction::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto Subtraction::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void Subtraction::dump(std::ostream &out, const std::string &indent) {
@@ -1344,6 +1513,10 @@ void Subtraction::dump(std::ostream &out, const std::string &indent) {
   m_b->dump(out, indent + "  ");
 }
 
+void Subtraction::compile(Bytecode::Compiler &c, int r) {
+  c.binary(Bytecode::SUB, m_a.get(), m_b.get(), r);
+}
+
 //
 // Multiplication
 //
@@ -1352,18 +1525,22 @@ bool Multiplication::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void Multiplication::operate(const Value &a, const Value &b, Value &result) {
   if (a.is<Int>() || b.is<Int>()) {
     auto ia = a.to_int();
     auto ib = b.to_int();
     result.set(ia->mul(ib));
     ia->release();
     ib->release();
-    return true;
+    return;
   }
   auto na = a.to_number();
   auto nb = b.to_number();
   result.set(na * nb);
-  return true;
 }
 
 bool Multiplication::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
@@ -1374,7 +1551,13 @@ bool Multiplication::declare(Module *module, Scope &scope, Error &error, bool is
 
 void Multiplication::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto Multiplication::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void Multiplication::dump(std::ostream &out, const std::string &indent) {
@@ -1383,6 +1566,10 @@ void Multiplication::dump(std::ostream &out, const std::string &indent) {
   m_b->dump(out, indent + "  ");
 }
 
+void Multiplication::compile(Bytecode::Compiler &c, int r) {
+  c.binary(Bytecode::MUL, m_a.get(), m_b.get(), r);
+}
+
 //
 // Division
 //
@@ -1391,18 +1578,22 @@ bool Division::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void Division::operate(const Value &a, const Value &b, Value &result) {
   if (a.is<Int>() || b.is<Int>()) {
     auto ia = a.to_int();
     auto ib = b.to_int();
     result.set(ia->div(ib));
     ia->release();
     ib->release();
-    return true;
+    return;
   }
   auto na = a.to_number();
   auto nb = b.to_number();
   result.set(na / nb);
-  return true;
 }
 
 bool Division::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
@@ -1413,7 +1604,13 @@ bool Division::declare(Module *module, Scope &scope, Error &error, bool is_lval)
 
 void Division::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto Division::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void Division::dump(std::ostream &out, const std::string &indent) {
@@ -1422,6 +1619,10 @@ void Division::dump(std::ostream &out, const std::string &indent) {
   m_b->dump(out, indent + "  ");
 }
 
+void Division::compile(Bytecode::Compiler &c, int r) {
+  c.binary(Bytecode::DIV, m_a.get(), m_b.get(), r);
+}
+
 //
 // Remainder
 //
@@ -1430,18 +1631,22 @@ bool Remainder::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void Remainder::operate(const Value &a, const Value &b, Value &result) {
   if (a.is<Int>() || b.is<Int>()) {
     auto ia = a.to_int();
     auto ib = b.to_int();
     result.set(ia->mod(ib));
     ia->release();
     ib->release();
-    return true;
+    return;
   }
   auto na = a.to_number();
   auto nb = b.to_number();
   result.set(std::fmod(na, nb));
-  return true;
 }
 
 bool Remainder::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
@@ -1452,7 +1657,13 @@ bool Remainder::declare(Module *module, Scope &scope, Error &error, bool is_lval
 
 void Remainder::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto Remainder::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void Remainder::dump(std::ostream &out, const std::string &indent) {
@@ -1461,6 +1672,10 @@ void Remainder::dump(std::ostream &out, const std::string &indent) {
   m_b->dump(out, indent + "  ");
 }
 
+void Remainder::compile(Bytecode::Compiler &c, int r) {
+  c.binary(Bytecode::REM, m_a.get(), m_b.get(), r);
+}
+
 //
 // Exponentiation
 //
@@ -1483,7 +1698,13 @@ bool Exponentiation::declare(Module *module, Scope &scope, Error &error, bool is
 
 void Exponentiation::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto Exponentiation::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void Exponentiation::dump(std::ostream &out, const std::string &indent) {
@@ -1518,7 +1739,13 @@ bool ShiftLeft::declare(Module *module, Scope &scope, Error &error, bool is_lval
 
 void ShiftLeft::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto ShiftLeft::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void ShiftLeft::dump(std::ostream &out, const std::string &indent) {
@@ -1553,7 +1780,13 @@ bool ShiftRight::declare(Module *module, Scope &scope, Error &error, bool is_lva
 
 void ShiftRight::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto ShiftRight::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void ShiftRight::dump(std::ostream &out, const std::string &indent) {
@@ -1588,7 +1821,13 @@ bool UnsignedShiftRight::declare(Module *module, Scope &scope, Error &error, boo
 
 void UnsignedShiftRight::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto UnsignedShiftRight::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void UnsignedShiftRight::dump(std::ostream &out, const std::string &indent) {
@@ -1618,6 +1857,11 @@ bool BitwiseNot::declare(Module *module, Scope &scope, Error &error, bool is_lva
 
 void BitwiseNot::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_x->resolve(module, ctx, l, imports);
+  Expr::fold(m_x, module, ctx);
+}
+
+auto BitwiseNot::fold(Context &ctx) -> Expr* {
+  return m_x->is_constant() ? constant(ctx) : nullptr;
 }
 
 void BitwiseNot::dump(std::ostream &out, const std::string &indent) {
@@ -1655,7 +1899,13 @@ bool BitwiseAnd::declare(Module *module, Scope &scope, Error &error, bool is_lva
 
 void BitwiseAnd::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto BitwiseAnd::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void BitwiseAnd::dump(std::ostream &out, const std::string &indent) {
@@ -1694,7 +1944,13 @@ bool BitwiseOr::declare(Module *module, Scope &scope, Error &error, bool is_lval
 
 void BitwiseOr::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto BitwiseOr::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void BitwiseOr::dump(std::ostream &out, const std::string &indent) {
@@ -1733,7 +1989,13 @@ bool BitwiseXor::declare(Module *module, Scope &scope, Error &error, bool is_lva
 
 void BitwiseXor::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto BitwiseXor::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void BitwiseXor::dump(std::ostream &out, const std::string &indent) {
@@ -1759,6 +2021,11 @@ bool LogicalNot::declare(Module *module, Scope &scope, Error &error, bool is_lva
 
 void LogicalNot::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_x->resolve(module, ctx, l, imports);
+  Expr::fold(m_x, module, ctx);
+}
+
+auto LogicalNot::fold(Context &ctx) -> Expr* {
+  return m_x->is_constant() ? constant(ctx) : nullptr;
 }
 
 void LogicalNot::dump(std::ostream &out, const std::string &indent) {
@@ -1766,6 +2033,11 @@ void LogicalNot::dump(std::ostream &out, const std::string &indent) {
   m_x->dump(out, indent + "  ");
 }
 
+void LogicalNot::compile(Bytecode::Compiler &c, int r) {
+  m_x->compile(c, r);
+  c.emit(Bytecode::NOT, r, r);
+}
+
 //
 // LogicalAnd
 //
@@ -1785,7 +2057,15 @@ bool LogicalAnd::declare(Module *module, Scope &scope, Error &error, bool is_lva
 
 void LogicalAnd::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto LogicalAnd::fold(Context &ctx) -> Expr* {
+  if (!m_a->is_constant()) return nullptr;
+  Value a; m_a->eval(ctx, a);
+  return a.to_boolean() ? m_b.release() : m_a.release();
 }
 
 void LogicalAnd::dump(std::ostream &out, const std::string &indent) {
@@ -1794,6 +2074,10 @@ void LogicalAnd::dump(std::ostream &out, const std::string &indent) {
   m_b->dump(out, indent + "  ");
 }
 
+void LogicalAnd::compile(Bytecode::Compiler &c, int r) {
+  c.branch(Bytecode::JF, m_a.get(), m_b.get(), r);
+}
+
 //
 // LogicalOr
 //
@@ -1813,7 +2097,15 @@ bool LogicalOr::declare(Module *module, Scope &scope, Error &error, bool is_lval
 
 void LogicalOr::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto LogicalOr::fold(Context &ctx) -> Expr* {
+  if (!m_a->is_constant()) return nullptr;
+  Value a; m_a->eval(ctx, a);
+  return a.to_boolean() ? m_a.release() : m_b.release();
 }
 
 void LogicalOr::dump(std::ostream &out, const std::string &indent) {
@@ -1822,6 +2114,10 @@ void LogicalOr::dump(std::ostream &out, const std::string &indent) {
   m_b->dump(out, indent + "  ");
 }
 
+void LogicalOr::compile(Bytecode::Compiler &c, int r) {
+  c.branch(Bytecode::JT, m_a.get(), m_b.get(), r);
+}
+
 //
 // NullishCoalescing
 //
@@ -1841,7 +2137,15 @@ bool NullishCoalescing::declare(Module *module, Scope &scope, Error &error, bool
 
 void NullishCoalescing::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto NullishCoalescing::fold(Context &ctx) -> Expr* {
+  if (!m_a->is_constant()) return nullptr;
+  Value a; m_a->eval(ctx, a);
+  return a.is_nullish() ? m_b.release() : m_a.release();
 }
 
 void NullishCoalescing::dump(std::ostream &out, const std::string &indent) {
@@ -1850,6 +2154,10 @@ void NullishCoalescing::dump(std::ostream &out, const std::string &indent) {
   m_b->dump(out, indent + "  ");
 }
 
+void NullishCoalescing::compile(Bytecode::Compiler &c, int r) {
+  c.branch(Bytecode::JNN, m_a.get(), m_b.get(), r);
+}
+
 //
 // Equality
 //
@@ -1858,16 +2166,20 @@ bool Equality::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void Equality::operate(const Value &a, const Value &b, Value &result) {
   if (a.is<Int>() || b.is<Int>()) {
     auto ia = a.to_int();
     auto ib = b.to_int();
     result.set(ia->eql(ib));
     ia->release();
     ib->release();
-    return true;
+    return;
   }
   result.set(Value::is_equal(a, b));
-  return true;
 }
 
 bool Equality::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
@@ -1878,7 +2190,13 @@ bool Equality::declare(Module *module, Scope &scope, Error &error, bool is_lval)
 
 void Equality::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto Equality::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void Equality::dump(std::ostream &out, const std::string &indent) {
@@ -1887,6 +2205,10 @@ void Equality::dump(std::ostream &out, const std::string &indent) {
   m_b->dump(out, indent + "  ");
 }
 
+void Equality::compile(Bytecode::Compiler &c, int r) {
+  c.binary(Bytecode::EQ, m_a.get(), m_b.get(), r);
+}
+
 //
 // Inequality
 //
@@ -1895,16 +2217,20 @@ bool Inequality::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void Inequality::operate(const Value &a, const Value &b, Value &result) {
   if (a.is<Int>() || b.is<Int>()) {
     auto ia = a.to_int();
     auto ib = b.to_int();
     result.set(!ia->eql(ib));
     ia->release();
     ib->release();
-    return true;
+    return;
   }
   result.set(!Value::is_equal(a, b));
-  return true;
 }
 
 bool Inequality::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
@@ -1915,7 +2241,13 @@ bool Inequality::declare(Module *module, Scope &scope, Error &error, bool is_lva
 
 void Inequality::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto Inequality::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void Inequality::dump(std::ostream &out, const std::string &indent) {
@@ -1924,6 +2256,10 @@ void Inequality::dump(std::ostream &out, const std::string &indent) {
   m_b->dump(out, indent + "  ");
 }
 
+void Inequality::compile(Bytecode::Compiler &c, int r) {
+  c.binary(Bytecode::NE, m_a.get(), m_b.get(), r);
+}
+
 //
 // Identity
 //
@@ -1932,10 +2268,14 @@ bool Identity::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
-  result.set(Value::is_identical(a, b));
+  operate(a, b, result);
   return true;
 }
 
+void Identity::operate(const Value &a, const Value &b, Value &result) {
+  result.set(Value::is_identical(a, b));
+}
+
 bool Identity::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
   if (!m_a->declare(module, scope, error)) return false;
   if (!m_b->declare(module, scope, error)) return false;
@@ -1944,7 +2284,13 @@ bool Identity::declare(Module *module, Scope &scope, Error &error, bool is_lval)
 
 void Identity::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto Identity::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void Identity::dump(std::ostream &out, const std::string &indent) {
@@ -1953,6 +2299,10 @@ void Identity::dump(std::ostream &out, const std::string &indent) {
   m_b->dump(out, indent + "  ");
 }
 
+void Identity::compile(Bytecode::Compiler &c, int r) {
+  c.binary(Bytecode::SEQ, m_a.get(), m_b.get(), r);
+}
+
 //
 // Nonidentity
 //
@@ -1961,10 +2311,14 @@ bool Nonidentity::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
-  result.set(!Value::is_identical(a, b));
+  operate(a, b, result);
   return true;
 }
 
+void Nonidentity::operate(const Value &a, const Value &b, Value &result) {
+  result.set(!Value::is_identical(a, b));
+}
+
 bool Nonidentity::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
   if (!m_a->declare(module, scope, error)) return false;
   if (!m_b->declare(module, scope, error)) return false;
@@ -1973,7 +2327,13 @@ bool Nonidentity::declare(Module *module, Scope &scope, Error &error, bool is_lv
 
 void Nonidentity::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto Nonidentity::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void Nonidentity::dump(std::ostream &out, const std::string &indent) {
@@ -1982,6 +2342,10 @@ void Nonidentity::dump(std::ostream &out, const std::string &indent) {
   m_b->dump(out, indent + "  ");
 }
 
+void Nonidentity::compile(Bytecode::Compiler &c, int r) {
+  c.binary(Bytecode::SNE, m_a.get(), m_b.get(), r);
+}
+
 //
 // GreaterThan
 //
@@ -1990,6 +2354,11 @@ bool GreaterThan::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void GreaterThan::operate(const Value &a, const Value &b, Value &result) {
   if (a.is_undefined() || b.is_undefined()) {
     result.set(false);
   } else if (a.is_string() && b.is_string()) {
@@ -2005,7 +2374,6 @@ bool GreaterThan::eval(Context &ctx, Value &result) {
     auto nb = b.to_number();
     result.set(na > nb);
   }
-  return true;
 }
 
 bool GreaterThan::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
@@ -2016,7 +2384,13 @@ bool GreaterThan::declare(Module *module, Scope &scope, Error &error, bool is_lv
 
 void GreaterThan::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto GreaterThan::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void GreaterThan::dump(std::ostream &out, const std::string &indent) {
@@ -2025,6 +2399,10 @@ void GreaterThan::dump(std::ostream &out, const std::string &indent) {
   m_b->dump(out, indent + "  ");
 }
 
+void GreaterThan::compile(Bytecode::Compiler &c, int r) {
+  c.binary(Bytecode::GT, m_a.get(), m_b.get(), r);
+}
+
 //
 // GreaterThanOrEqual
 //
@@ -2033,6 +2411,11 @@ bool GreaterThanOrEqual::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void GreaterThanOrEqual::operate(const Value &a, const Value &b, Value &result) {
   if (a.is_undefined() || b.is_undefined()) {
     result.set(false);
   } else if (a.is_string() && b.is_string()) {
@@ -2048,7 +2431,6 @@ bool GreaterThanOrEqual::eval(Context &ctx, Value &result) {
     auto nb = b.to_number();
     result.set(na >= nb);
   }
-  return true;
 }
 
 bool GreaterThanOrEqual::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
@@ -2059,7 +2441,13 @@ bool GreaterThanOrEqual::declare(Module *module, Scope &scope, Error &error, boo
 
 void GreaterThanOrEqual::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto GreaterThanOrEqual::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void GreaterThanOrEqual::dump(std::ostream &out, const std::string &indent) {
@@ -2068,6 +2456,10 @@ void GreaterThanOrEqual::dump(std::ostream &out, const std::string &indent) {
   m_b->dump(out, indent + "  ");
 }
 
+void GreaterThanOrEqual::compile(Bytecode::Compiler &c, int r) {
+  c.binary(Bytecode::GE, m_a.get(), m_b.get(), r);
+}
+
 //
 // LessThan
 //
@@ -2076,6 +2468,11 @@ bool LessThan::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void LessThan::operate(const Value &a, const Value &b, Value &result) {
   if (a.is_undefined() || b.is_undefined()) {
     result.set(false);
   } else if (a.is_string() && b.is_string()) {
@@ -2091,7 +2488,6 @@ bool LessThan::eval(Context &ctx, Value &result) {
     auto nb = b.to_number();
     result.set(na < nb);
   }
-  return true;
 }
 
 bool LessThan::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
@@ -2102,7 +2498,13 @@ bool LessThan::declare(Module *module, Scope &scope, Error &error, bool is_lval)
 
 void LessThan::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto LessThan::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void LessThan::dump(std::ostream &out, const std::string &indent) {
@@ -2111,6 +2513,10 @@ void LessThan::dump(std::ostream &out, const std::string &indent) {
   m_b->dump(out, indent + "  ");
 }
 
+void LessThan::compile(Bytecode::Compiler &c, int r) {
+  c.binary(Bytecode::LT, m_a.get(), m_b.get(), r);
+}
+
 //
 // LessThanOrEqual
 //
@@ -2119,6 +2525,11 @@ bool LessThanOrEqual::eval(Context &ctx, Value &result) {
   Value a, b;
   if (!m_a->eval(ctx, a)) return false;
   if (!m_b->eval(ctx, b)) return false;
+  operate(a, b, result);
+  return true;
+}
+
+void LessThanOrEqual::operate(const Value &a, const Value &b, Value &result) {
   if (a.is_undefined() || b.is_undefined()) {
     result.set(false);
   } else if (a.is_string() && b.is_string()) {
@@ -2134,7 +2545,6 @@ bool LessThanOrEqual::eval(Context &ctx, Value &result) {
     auto nb = b.to_number();
     result.set(na <= nb);
   }
-  return true;
 }
 
 bool LessThanOrEqual::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
@@ -2145,7 +2555,13 @@ bool LessThanOrEqual::declare(Module *module, Scope &scope, Error &error, bool i
 
 void LessThanOrEqual::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
+}
+
+auto LessThanOrEqual::fold(Context &ctx) -> Expr* {
+  return m_a->is_constant() && m_b->is_constant() ? constant(ctx) : nullptr;
 }
 
 void LessThanOrEqual::dump(std::ostream &out, const std::string &indent) {
@@ -2154,6 +2570,10 @@ void LessThanOrEqual::dump(std::ostream &out, const std::string &indent) {
   m_b->dump(out, indent + "  ");
 }
 
+void LessThanOrEqual::compile(Bytecode::Compiler &c, int r) {
+  c.binary(Bytecode::LE, m_a.get(), m_b.get(), r);
+}
+
 //
 // In
 //
@@ -2183,7 +2603,9 @@ bool In::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
 
 void In::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
 }
 
 void In::dump(std::ostream &out, const std::string &indent) {
@@ -2221,7 +2643,9 @@ bool InstanceOf::declare(Module *module, Scope &scope, Error &error, bool is_lva
 
 void InstanceOf::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
 }
 
 void InstanceOf::dump(std::ostream &out, const std::string &indent) {
@@ -2259,6 +2683,11 @@ bool TypeOf::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
 
 void TypeOf::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_x->resolve(module, ctx, l, imports);
+  Expr::fold(m_x, module, ctx);
+}
+
+auto TypeOf::fold(Context &ctx) -> Expr* {
+  return m_x->is_constant() ? constant(ctx) : nullptr;
 }
 
 void TypeOf::dump(std::ostream &out, const std::string &indent) {
@@ -2283,7 +2712,7 @@ bool PostIncrement::eval(Context &ctx, Value &result) {
 }
 
 bool PostIncrement::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  return m_x->declare(module, scope, error);
+  return m_x->declare(module, scope, error, m_x->is<Identifier>());
 }
 
 void PostIncrement::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
@@ -2312,7 +2741,7 @@ bool PostDecrement::eval(Context &ctx, Value &result) {
 }
 
 bool PostDecrement::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  return m_x->declare(module, scope, error);
+  return m_x->declare(module, scope, error, m_x->is<Identifier>());
 }
 
 void PostDecrement::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
@@ -2339,7 +2768,7 @@ bool PreIncrement::eval(Context &ctx, Value &result) {
 }
 
 bool PreIncrement::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  return m_x->declare(module, scope, error);
+  return m_x->declare(module, scope, error, m_x->is<Identifier>());
 }
 
 void PreIncrement::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
@@ -2366,7 +2795,7 @@ bool PreDecrement::eval(Context &ctx, Value &result) {
 }
 
 bool PreDecrement::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  return m_x->declare(module, scope, error);
+  return m_x->declare(module, scope, error, m_x->is<Identifier>());
 }
 
 void PreDecrement::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
@@ -2387,7 +2816,7 @@ bool Delete::eval(Context &ctx, Value &result) {
 }
 
 bool Delete::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  return m_x->declare(module, scope, error);
+  return m_x->declare(module, scope, error, m_x->is<Identifier>());
 }
 
 void Delete::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
@@ -2425,6 +2854,7 @@ bool Assignment::declare(Module *module, Scope &scope, Error &error, bool is_lva
 void Assignment::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_l->resolve(module, ctx, l, imports);
   m_r->resolve(module, ctx, l, imports);
+  Expr::fold(m_r, module, ctx);
 }
 
 bool Assignment::unpack(Context &ctx, const Value &src, Value *dst, int &idx) {
@@ -2466,7 +2896,7 @@ bool AdditionAssignment::eval(Context &ctx, Value &result) {
 }
 
 bool AdditionAssignment::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  if (!m_l->declare(module, scope, error)) return false;
+  if (!m_l->declare(module, scope, error, m_l->is<Identifier>())) return false;
   if (!m_r->declare(module, scope, error)) return false;
   return true;
 }
@@ -2474,6 +2904,7 @@ bool AdditionAssignment::declare(Module *module, Scope &scope, Error &error, boo
 void AdditionAssignment::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_l->resolve(module, ctx, l, imports);
   m_r->resolve(module, ctx, l, imports);
+  Expr::fold(m_r, module, ctx);
 }
 
 void AdditionAssignment::dump(std::ostream &out, const std::string &indent) {
@@ -2505,7 +2936,7 @@ bool SubtractionAssignment::eval(Context &ctx, Value &result) {
 }
 
 bool SubtractionAssignment::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  if (!m_l->declare(module, scope, error)) return false;
+  if (!m_l->declare(module, scope, error, m_l->is<Identifier>())) return false;
   if (!m_r->declare(module, scope, error)) return false;
   return true;
 }
@@ -2513,6 +2944,7 @@ bool SubtractionAssignment::declare(Module *module, Scope &scope, Error &error,
 void SubtractionAssignment::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_l->resolve(module, ctx, l, imports);
   m_r->resolve(module, ctx, l, imports);
+  Expr::fold(m_r, module, ctx);
 }
 
 void SubtractionAssignment::dump(std::ostream &out, const std::string &indent) {
@@ -2544,7 +2976,7 @@ bool MultiplicationAssignment::eval(Context &ctx, Value &result) {
 }
 
 bool MultiplicationAssignment::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  if (!m_l->declare(module, scope, error)) return false;
+  if (!m_l->declare(module, scope, error, m_l->is<Identifier>())) return false;
   if (!m_r->declare(module, scope, error)) return false;
   return true;
 }
@@ -2552,6 +2984,7 @@ bool MultiplicationAssignment::declare(Module *module, Scope &scope, Error &erro
 void MultiplicationAssignment::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_l->resolve(module, ctx, l, imports);
   m_r->resolve(module, ctx, l, imports);
+  Expr::fold(m_r, module, ctx);
 }
 
 void MultiplicationAssignment::dump(std::ostream &out, const std::string &indent) {
@@ -2583,7 +3016,7 @@ bool DivisionAssignment::eval(Context &ctx, Value &result) {
 }
 
 bool DivisionAssignment::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  if (!m_l->declare(module, scope, error)) return false;
+  if (!m_l->declare(module, scope, error, m_l->is<Identifier>())) return false;
   if (!m_r->declare(module, scope, error)) return false;
   return true;
 }
@@ -2591,6 +3024,7 @@ bool DivisionAssignment::declare(Module *module, Scope &scope, Error &error, boo
 void DivisionAssignment::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_l->resolve(module, ctx, l, imports);
   m_r->resolve(module, ctx, l, imports);
+  Expr::fold(m_r, module, ctx);
 }
 
 void DivisionAssignment::dump(std::ostream &out, const std::string &indent) {
@@ -2622,7 +3056,7 @@ bool RemainderAssignment::eval(Context &ctx, Value &result) {
 }
 
 bool RemainderAssignment::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  if (!m_l->declare(module, scope, error)) return false;
+  if (!m_l->declare(module, scope, error, m_l->is<Identifier>())) return false;
   if (!m_r->declare(module, scope, error)) return false;
   return true;
 }
@@ -2630,6 +3064,7 @@ bool RemainderAssignment::declare(Module *module, Scope &scope, Error &error, bo
 void RemainderAssignment::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_l->resolve(module, ctx, l, imports);
   m_r->resolve(module, ctx, l, imports);
+  Expr::fold(m_r, module, ctx);
 }
 
 void RemainderAssignment::dump(std::ostream &out, const std::string &indent) {
@@ -2653,7 +3088,7 @@ bool ExponentiationAssignment::eval(Context &ctx, Value &result) {
 }
 
 bool ExponentiationAssignment::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  if (!m_l->declare(module, scope, error)) return false;
+  if (!m_l->declare(module, scope, error, m_l->is<Identifier>())) return false;
   if (!m_r->declare(module, scope, error)) return false;
   return true;
 }
@@ -2661,6 +3096,7 @@ bool ExponentiationAssignment::declare(Module *module, Scope &scope, Error &erro
 void ExponentiationAssignment::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_l->resolve(module, ctx, l, imports);
   m_r->resolve(module, ctx, l, imports);
+  Expr::fold(m_r, module, ctx);
 }
 
 void ExponentiationAssignment::dump(std::ostream &out, const std::string &indent) {
@@ -2688,7 +3124,7 @@ bool ShiftLeftAssignment::eval(Context &ctx, Value &result) {
 }
 
 bool ShiftLeftAssignment::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  if (!m_l->declare(module, scope, error)) return false;
+  if (!m_l->declare(module, scope, error, m_l->is<Identifier>())) return false;
   if (!m_r->declare(module, scope, error)) return false;
   return true;
 }
@@ -2696,6 +3132,7 @@ bool ShiftLeftAssignment::declare(Module *module, Scope &scope, Error &error, bo
 void ShiftLeftAssignment::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_l->resolve(module, ctx, l, imports);
   m_r->resolve(module, ctx, l, imports);
+  Expr::fold(m_r, module, ctx);
 }
 
 void ShiftLeftAssignment::dump(std::ostream &out, const std::string &indent) {
@@ -2723,7 +3160,7 @@ bool ShiftRightAssignment::eval(Context &ctx, Value &result) {
 }
 
 bool ShiftRightAssignment::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  if (!m_l->declare(module, scope, error)) return false;
+  if (!m_l->declare(module, scope, error, m_l->is<Identifier>())) return false;
   if (!m_r->declare(module, scope, error)) return false;
   return true;
 }
@@ -2731,6 +3168,7 @@ bool ShiftRightAssignment::declare(Module *module, Scope &scope, Error &error, b
 void ShiftRightAssignment::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_l->resolve(module, ctx, l, imports);
   m_r->resolve(module, ctx, l, imports);
+  Expr::fold(m_r, module, ctx);
 }
 
 void ShiftRightAssignment::dump(std::ostream &out, const std::string &indent) {
@@ -2758,7 +3196,7 @@ bool UnsignedShiftRightAssignment::eval(Context &ctx, Value &result) {
 }
 
 bool UnsignedShiftRightAssignment::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  if (!m_l->declare(module, scope, error)) return false;
+  if (!m_l->declare(module, scope, error, m_l->is<Identifier>())) return false;
   if (!m_r->declare(module, scope, error)) return false;
   return true;
 }
@@ -2766,6 +3204,7 @@ bool UnsignedShiftRightAssignment::declare(Module *module, Scope &scope, Error &
 void UnsignedShiftRightAssignment::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_l->resolve(module, ctx, l, imports);
   m_r->resolve(module, ctx, l, imports);
+  Expr::fold(m_r, module, ctx);
 }
 
 void UnsignedShiftRightAssignment::dump(std::ostream &out, const std::string &indent) {
@@ -2797,7 +3236,7 @@ bool BitwiseAndAssignment::eval(Context &ctx, Value &result) {
 }
 
 bool BitwiseAndAssignment::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  if (!m_l->declare(module, scope, error)) return false;
+  if (!m_l->declare(module, scope, error, m_l->is<Identifier>())) return false;
   if (!m_r->declare(module, scope, error)) return false;
   return true;
 }
@@ -2805,6 +3244,7 @@ bool BitwiseAndAssignment::declare(Module *module, Scope &scope, Error &error, b
 void BitwiseAndAssignment::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_l->resolve(module, ctx, l, imports);
   m_r->resolve(module, ctx, l, imports);
+  Expr::fold(m_r, module, ctx);
 }
 
 void BitwiseAndAssignment::dump(std::ostream &out, const std::string &indent) {
@@ -2836,7 +3276,7 @@ bool BitwiseOrAssignment::eval(Context &ctx, Value &result) {
 }
 
 bool BitwiseOrAssignment::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  if (!m_l->declare(module, scope, error)) return false;
+  if (!m_l->declare(module, scope, error, m_l->is<Identifier>())) return false;
   if (!m_r->declare(module, scope, error)) return false;
   return true;
 }
@@ -2844,6 +3284,7 @@ bool BitwiseOrAssignment::declare(Module *module, Scope &scope, Error &error, bo
 void BitwiseOrAssignment::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_l->resolve(module, ctx, l, imports);
   m_r->resolve(module, ctx, l, imports);
+  Expr::fold(m_r, module, ctx);
 }
 
 void BitwiseOrAssignment::dump(std::ostream &out, const std::string &indent) {
@@ -2875,7 +3316,7 @@ bool BitwiseXorAssignment::eval(Context &ctx, Value &result) {
 }
 
 bool BitwiseXorAssignment::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  if (!m_l->declare(module, scope, error)) return false;
+  if (!m_l->declare(module, scope, error, m_l->is<Identifier>())) return false;
   if (!m_r->declare(module, scope, error)) return false;
   return true;
 }
@@ -2883,6 +3324,7 @@ bool BitwiseXorAssignment::declare(Module *module, Scope &scope, Error &error, b
 void BitwiseXorAssignment::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_l->resolve(module, ctx, l, imports);
   m_r->resolve(module, ctx, l, imports);
+  Expr::fold(m_r, module, ctx);
 }
 
 void BitwiseXorAssignment::dump(std::ostream &out, const std::string &indent) {
@@ -2903,7 +3345,7 @@ bool LogicalAndAssignment::eval(Context &ctx, Value &result) {
 }
 
 bool LogicalAndAssignment::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  if (!m_l->declare(module, scope, error)) return false;
+  if (!m_l->declare(module, scope, error, m_l->is<Identifier>())) return false;
   if (!m_r->declare(module, scope, error)) return false;
   return true;
 }
@@ -2911,6 +3353,7 @@ bool LogicalAndAssignment::declare(Module *module, Scope &scope, Error &error, b
 void LogicalAndAssignment::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_l->resolve(module, ctx, l, imports);
   m_r->resolve(module, ctx, l, imports);
+  Expr::fold(m_r, module, ctx);
 }
 
 void LogicalAndAssignment::dump(std::ostream &out, const std::string &indent) {
@@ -2931,7 +3374,7 @@ bool LogicalOrAssignment::eval(Context &ctx, Value &result) {
 }
 
 bool LogicalOrAssignment::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  if (!m_l->declare(module, scope, error)) return false;
+  if (!m_l->declare(module, scope, error, m_l->is<Identifier>())) return false;
   if (!m_r->declare(module, scope, error)) return false;
   return true;
 }
@@ -2939,6 +3382,7 @@ bool LogicalOrAssignment::declare(Module *module, Scope &scope, Error &error, bo
 void LogicalOrAssignment::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_l->resolve(module, ctx, l, imports);
   m_r->resolve(module, ctx, l, imports);
+  Expr::fold(m_r, module, ctx);
 }
 
 void LogicalOrAssignment::dump(std::ostream &out, const std::string &indent) {
@@ -2959,7 +3403,7 @@ bool LogicalNullishAssignment::eval(Context &ctx, Value &result) {
 }
 
 bool LogicalNullishAssignment::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
-  if (!m_l->declare(module, scope, error)) return false;
+  if (!m_l->declare(module, scope, error, m_l->is<Identifier>())) return false;
   if (!m_r->declare(module, scope, error)) return false;
   return true;
 }
@@ -2967,6 +3411,7 @@ bool LogicalNullishAssignment::declare(Module *module, Scope &scope, Error &erro
 void LogicalNullishAssignment::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_l->resolve(module, ctx, l, imports);
   m_r->resolve(module, ctx, l, imports);
+  Expr::fold(m_r, module, ctx);
 }
 
 void LogicalNullishAssignment::dump(std::ostream &out, const std::string &indent) {
@@ -2998,8 +3443,17 @@ bool Conditional::declare(Module *module, Scope &scope, Error &error, bool is_lv
 
 void Conditional::resolve(Module *module, Context &ctx, int l, LegacyImports *imports) {
   m_a->resolve(module, ctx, l, imports);
+  Expr::fold(m_a, module, ctx);
   m_b->resolve(module, ctx, l, imports);
+  Expr::fold(m_b, module, ctx);
   m_c->resolve(module, ctx, l, imports);
+  Expr::fold(m_c, module, ctx);
+}
+
+auto Conditional::fold(Context &ctx) -> Expr* {
+  if (!m_a->is_constant()) return nullptr;
+  Value a; m_a->eval(ctx, a);
+  return a.to_boolean() ? m_b.release() : m_c.release();
 }
 
 void Conditional::dump(std::ostream &out, const std::string &indent) {
@@ -3009,6 +3463,16 @@ void Conditional::dump(std::ostream &out, const std::string &indent) {
   m_c->dump(out, indent + "  ");
 }
 
+void Conditional::compile(Bytecode::Compiler &c, int r) {
+  m_a->compile(c, r);
+  auto j = c.emit(Bytecode::JF, r);
+  m_b->compile(c, r);
+  auto k = c.emit(Bytecode::JMP);
+  c.patch(j);
+  m_c->compile(c, r);
+  c.patch(k);
+}
+
 } // namespace expr
 
 } // namespace pjs
@@ -28,6 +28,7 @@
 
 #include "types.hpp"
 #include "tree.hpp"
+#include "bytecode.hpp"
 #include "builtin.hpp"
 
 #include <cmath>
@@ -164,6 +165,17 @@ public:
   virtual auto reduce(Reducer &r) -> Reducer::Value* { return r.undefined(); }
   virtual auto reduce_lval(Reducer &r, Reducer::Value *rval) -> Reducer::Value* { return r.undefined(); }
   virtual void dump(std::ostream &out, const std::string &indent = "") = 0;
+  virtual void compile(Bytecode::Compiler &c, int r) { c.fallback(this, r); }
+  virtual bool is_constant() const { return false; }
+  virtual auto fold(Context &ctx) -> Expr* { return nullptr; }
+
+  //
+  // Constant folding
+  //
+
+  static void fold(std::unique_ptr<Expr> &expr, Module *module, Context &ctx);
+
+  auto constant(Context &ctx) -> Expr*;
 
 protected:
   bool error(Context &ctx, const std::string &msg) {
@@ -244,6 +256,7 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 
 private:
@@ -259,6 +272,8 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual auto reduce(Reducer &r) -> Reducer::Value* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+  virtual bool is_constant() const override { return true; }
 };
 
 //
@@ -270,6 +285,8 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual auto reduce(Reducer &r) -> Reducer::Value* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+  virtual bool is_constant() const override { return true; }
 };
 
 //
@@ -283,6 +300,8 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual auto reduce(Reducer &r) -> Reducer::Value* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+  virtual bool is_constant() const override { return true; }
 
 private:
   bool m_b;
@@ -299,6 +318,8 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual auto reduce(Reducer &r) -> Reducer::Value* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+  virtual bool is_constant() const override { return true; }
 
 private:
   double m_n;
@@ -317,6 +338,8 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual auto reduce(Reducer &r) -> Reducer::Value* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+  virtual bool is_constant() const override { return true; }
 
 private:
   Ref<Str> m_s;
@@ -410,6 +433,9 @@ public:
   FunctionLiteral(Expr *inputs, Expr *output);
   FunctionLiteral(Expr *inputs, Stmt *output);
 
+  auto input_count() const -> size_t { return m_inputs.size(); }
+  auto output() const -> Stmt* { return m_output.get(); }
+
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
@@ -421,6 +447,7 @@ private:
   std::unique_ptr<Stmt> m_output;
   Scope m_scope;
   Ref<Method> m_method;
+  std::unique_ptr<Bytecode> m_bytecode;
 };
 
 //
@@ -514,6 +541,7 @@ public:
   virtual bool assign(Context &ctx, Value &value) override;
   virtual bool clear(Context &ctx, Value &result) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
 
 private:
   int m_i;
@@ -557,9 +585,12 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool assign(Context &ctx, Value &value) override;
   virtual bool clear(Context &ctx, Value &result) override;
+  virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual auto reduce(Reducer &r) -> Reducer::Value* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
 
 private:
   Ref<Str> m_key;
@@ -592,6 +623,9 @@ public:
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
   virtual auto reduce(Reducer &r) -> Reducer::Value* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+
+  bool get(Context &ctx, const Value &obj, const Value &key, Value &result);
 
 private:
   std::unique_ptr<Expr> m_obj;
@@ -648,8 +682,13 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual auto reduce(Reducer &r) -> Reducer::Value* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+
+  bool check(Context &ctx, const Value &f);
+  bool call(Context &ctx, const Value &f, int argc, Value *argv, Value &result);
 
 private:
   Module* m_module = nullptr;
@@ -686,6 +725,7 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 
 private:
@@ -703,6 +743,7 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 
 private:
@@ -720,7 +761,11 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+
+  static void operate(const Value &a, const Value &b, Value &result);
 
 private:
   std::unique_ptr<Expr> m_a;
@@ -738,7 +783,11 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+
+  static void operate(const Value &a, const Value &b, Value &result);
 
 private:
   std::unique_ptr<Expr> m_a;
@@ -756,7 +805,11 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+
+  static void operate(const Value &a, const Value &b, Value &result);
 
 private:
   std::unique_ptr<Expr> m_a;
@@ -774,7 +827,11 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+
+  static void operate(const Value &a, const Value &b, Value &result);
 
 private:
   std::unique_ptr<Expr> m_a;
@@ -792,7 +849,11 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+
+  static void operate(const Value &a, const Value &b, Value &result);
 
 private:
   std::unique_ptr<Expr> m_a;
@@ -810,6 +871,7 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 
 private:
@@ -828,6 +890,7 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 
 private:
@@ -846,6 +909,7 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 
 private:
@@ -864,6 +928,7 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 
 private:
@@ -882,6 +947,7 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 
 private:
@@ -899,6 +965,7 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 
 private:
@@ -917,6 +984,7 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 
 private:
@@ -935,6 +1003,7 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 
 private:
@@ -953,7 +1022,9 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
 
 private:
   std::unique_ptr<Expr> m_x;
@@ -970,7 +1041,9 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
 
 private:
   std::unique_ptr<Expr> m_a;
@@ -988,7 +1061,9 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
 
 private:
   std::unique_ptr<Expr> m_a;
@@ -1006,7 +1081,9 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
 
 private:
   std::unique_ptr<Expr> m_a;
@@ -1024,7 +1101,11 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+
+  static void operate(const Value &a, const Value &b, Value &result);
 
 private:
   std::unique_ptr<Expr> m_a;
@@ -1042,7 +1123,11 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+
+  static void operate(const Value &a, const Value &b, Value &result);
 
 private:
   std::unique_ptr<Expr> m_a;
@@ -1060,7 +1145,11 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+
+  static void operate(const Value &a, const Value &b, Value &result);
 
 private:
   std::unique_ptr<Expr> m_a;
@@ -1078,7 +1167,11 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+
+  static void operate(const Value &a, const Value &b, Value &result);
 
 private:
   std::unique_ptr<Expr> m_a;
@@ -1096,7 +1189,11 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+
+  static void operate(const Value &a, const Value &b, Value &result);
 
 private:
   std::unique_ptr<Expr> m_a;
@@ -1114,7 +1211,11 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+
+  static void operate(const Value &a, const Value &b, Value &result);
 
 private:
   std::unique_ptr<Expr> m_a;
@@ -1132,7 +1233,11 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+
+  static void operate(const Value &a, const Value &b, Value &result);
 
 private:
   std::unique_ptr<Expr> m_a;
@@ -1150,7 +1255,11 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
+
+  static void operate(const Value &a, const Value &b, Value &result);
 
 private:
   std::unique_ptr<Expr> m_a;
@@ -1214,6 +1323,7 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
 
 private:
@@ -1612,7 +1722,9 @@ public:
   virtual bool eval(Context &ctx, Value &result) override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, LegacyImports *imports) override;
+  virtual auto fold(Context &ctx) -> Expr* override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c, int r) override;
 
 private:
   std::unique_ptr<Expr> m_a;
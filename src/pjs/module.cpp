@@ -114,10 +114,32 @@ auto Module::find_export(Str *name) -> int {
   return -1;
 }
 
+void Module::add_constant(Str *name, Expr *value) {
+  auto i = m_assignment_counts.find(name);
+  if (i != m_assignment_counts.end() && i->second == 1) {
+    m_constants[name] = value;
+  }
+}
+
+auto Module::find_constant(Str *name) -> Expr* {
+  if (m_constants_suspended > 0) return nullptr;
+  auto i = m_constants.find(name);
+  if (i == m_constants.end()) return nullptr;
+  return i->second;
+}
+
 bool Module::compile(std::string &error, int &error_line, int &error_column) {
   auto stmt = Parser::parse(&m_source, error, error_line, error_column);
   if (!stmt) return false;
 
+  if (auto block = stmt->as<stmt::Block>()) {
+    for (const auto &s : block->stmts()) {
+      if (auto var = s->as<stmt::Var>()) {
+        var->set_module_level();
+      }
+    }
+  }
+
   Tree::Error tree_error;
   if (!stmt->declare(this, m_scope, tree_error)) {
     auto tree = tree_error.tree;
@@ -56,6 +56,14 @@ public:
   auto new_fiber_data() -> Data*;
   auto find_import(Str *name) -> Tree::Import*;
   auto find_export(Str *name) -> int;
+  void add_assignment(Str *name) { m_assignment_counts[name]++; }
+  void add_constant(Str *name, Expr *value);
+  auto find_constant(Str *name) -> Expr*;
+  void suspend_constants() { m_constants_suspended++; }
+  void resume_constants() { m_constants_suspended--; }
+  void add_pruned(Stmt *stmt) { m_pruned.emplace_back(stmt); }
+  void add_folded() { m_folded_count++; }
+  auto folded_count() const -> int { return m_folded_count; }
   bool compile(std::string &error, int &error_line, int &error_column);
   void resolve(const std::function<Module*(Module*, Str*)> &resolver);
   void execute(Context &ctx, int l, Tree::LegacyImports *imports, Value &result);
@@ -71,6 +79,11 @@ private:
   std::list<Tree::Export> m_exports;
   Ref<Class> m_exports_class;
   Ref<Object> m_exports_object;
+  std::map<Ref<Str>, int> m_assignment_counts;
+  std::map<Ref<Str>, Expr*> m_constants;
+  std::list<std::unique_ptr<Stmt>> m_pruned;
+  int m_constants_suspended = 0;
+  int m_folded_count = 0;
 
   static void check_cyclic_import(Tree::Import *root, Tree::Import *current);
 
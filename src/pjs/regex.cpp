@@ -0,0 +1,1054 @@
+/*
+ *  Copyright (c) 2019 by flomesh.io
+ *
+ *  Unless prior written consent has been obtained from the copyright
+ *  owner, the following shall not be allowed.
+ *
+ *  1. The distribution of any source codes, header files, make files,
+ *     or libraries of the software.
+ *
+ *  2. Disclosure of any source codes pertaining to the software to any
+ *     additional parties.
+ *
+ *  3. Alteration or removal of any notices in or on the software or
+ *     within the documentation included within the software.
+ *
+ *  ALL SOURCE CODE AS WELL AS ALL DOCUMENTATION INCLUDED WITH THIS
+ *  SOFTWARE IS PROVIDED IN AN “AS IS” CONDITION, WITHOUT WARRANTY OF ANY
+ *  KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ *  CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ *  TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ *  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "regex.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+namespace pjs {
+
+static const int MAX_DEPTH = 1000;
+static const int MAX_REPEAT = 100000;
+static const size_t MAX_PROGRAM_SIZE = 100000;
+static const size_t MAX_DFA_STATES = 1000;
+static const int MAX_DFA_FAILURES = 10;
+static const int MAX_MARK_DEPTH = 8;
+
+static bool is_word(char c) {
+  return (
+    ('a' <= c && c <= 'z') ||
+    ('A' <= c && c <= 'Z') ||
+    ('0' <= c && c <= '9') ||
+    c == '_'
+  );
+}
+
+static int hex_value(char c) {
+  if ('0' <= c && c <= '9') return c - '0';
+  if ('a' <= c && c <= 'f') return c - 'a' + 10;
+  if ('A' <= c && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static auto find_literal(const char *s, size_t n, size_t pos, const std::string &lit) -> size_t {
+  auto len = lit.length();
+  auto c = lit[0];
+  while (pos + len <= n) {
+    auto p = (const char *)std::memchr(s + pos, c, n - pos - len + 1);
+    if (!p) break;
+    if (!std::memcmp(p, lit.c_str(), len)) return p - s;
+    pos = p - s + 1;
+  }
+  return n;
+}
+
+//
+// Regex::Charset
+//
+
+int Regex::Charset::count() const {
+  int n = 0;
+  for (int c = 0; c < 256; c++) if (has(c)) n++;
+  return n;
+}
+
+int Regex::Charset::first() const {
+  for (int c = 0; c < 256; c++) if (has(c)) return c;
+  return -1;
+}
+
+//
+// Regex::Node
+//
+
+struct Regex::Node {
+  enum Type {
+    EMPTY,
+    SET,
+    CONCAT,
+    ALTER,
+    REPEAT,
+    GROUP,
+    ASSERT,
+  };
+
+  Node(Type t) : type(t) {}
+
+  Type type;
+  Charset set;
+  std::vector<std::unique_ptr<Node>> children;
+  int min = 0;
+  int max = 0;
+  bool greedy = true;
+  int index = -1;
+  Op assertion = BOL;
+
+  bool is_literal() const { return type == SET && set.count() == 1; }
+  bool is_nullable() const;
+  void group_range(int &first, int &last) const;
+};
+
+bool Regex::Node::is_nullable() const {
+  switch (type) {
+    case SET: return false;
+    case CONCAT:
+      for (const auto &child : children) if (!child->is_nullable()) return false;
+      return true;
+    case ALTER:
+      for (const auto &child : children) if (child->is_nullable()) return true;
+      return false;
+    case REPEAT: return min == 0 || children[0]->is_nullable();
+    case GROUP: return children[0]->is_nullable();
+    default: return true;
+  }
+}
+
+// Groups are numbered in order so the ones inside a node are consecutive
+void Regex::Node::group_range(int &first, int &last) const {
+  if (type == GROUP && index >= 0) {
+    if (first < 0) first = index;
+    last = index;
+  }
+  for (const auto &child : children) child->group_range(first, last);
+}
+
+//
+// Regex::Parser
+//
+
+class Regex::Parser {
+public:
+  Parser(const std::string &pattern, bool ignore_case)
+    : m_pattern(pattern)
+    , m_ignore_case(ignore_case) {}
+
+  auto parse() -> Node* {
+    std::unique_ptr<Node> root(alternation(0));
+    if (!eof()) error("unmatched ')'");
+    return root.release();
+  }
+
+  auto group_count() const -> int { return m_group_count; }
+
+private:
+  const std::string &m_pattern;
+  size_t m_pos = 0;
+  bool m_ignore_case;
+  int m_group_count = 0;
+
+  bool eof() const { return m_pos >= m_pattern.length(); }
+  char peek() const { return m_pattern[m_pos]; }
+  bool looking_at(const char *s) const { return m_pattern.compare(m_pos, std::strlen(s), s) == 0; }
+
+  void error(const std::string &msg) {
+    throw std::runtime_error("invalid RegExp /" + m_pattern + "/: " + msg);
+  }
+
+  auto alternation(int depth) -> Node* {
+    if (depth > MAX_DEPTH) error("too deeply nested");
+    std::unique_ptr<Node> first(concat(depth));
+    if (eof() || peek() != '|') return first.release();
+    std::unique_ptr<Node> alt(new Node(Node::ALTER));
+    alt->children.push_back(std::move(first));
+    while (!eof() && peek() == '|') {
+      m_pos++;
+      alt->children.emplace_back(concat(depth));
+    }
+    return alt.release();
+  }
+
+  auto concat(int depth) -> Node* {
+    std::unique_ptr<Node> seq(new Node(Node::CONCAT));
+    while (!eof() && peek() != '|' && peek() != ')') {
+      seq->children.emplace_back(repeat(depth));
+    }
+    return seq.release();
+  }
+
+  auto repeat(int depth) -> Node* {
+    std::unique_ptr<Node> atom(this->atom(depth));
+    int min, max;
+    if (!quantifier(min, max)) return atom.release();
+    if (atom->type == Node::ASSERT) error("nothing to repeat");
+    std::unique_ptr<Node> rep(new Node(Node::REPEAT));
+    rep->min = min;
+    rep->max = max;
+    if (!eof() && peek() == '?') {
+      rep->greedy = false;
+      m_pos++;
+    }
+    rep->children.push_back(std::move(atom));
+    return rep.release();
+  }
+
+  bool quantifier(int &min, int &max) {
+    if (eof()) return false;
+    switch (peek()) {
+      case '*': m_pos++; min = 0; max = -1; return true;
+      case '+': m_pos++; min = 1; max = -1; return true;
+      case '?': m_pos++; min = 0; max = 1; return true;
+      case '{': return braces(min, max);
+      default: return false;
+    }
+  }
+
+  bool braces(int &min, int &max) {
+    auto p = m_pos + 1;
+    auto n = m_pattern.length();
+    int a, b;
+    if (!number(p, a)) return false;
+    if (p < n && m_pattern[p] == ',') {
+      p++;
+      if (p < n && m_pattern[p] == '}') {
+        b = -1;
+      } else if (!number(p, b)) {
+        return false;
+      }
+    } else {
+      b = a;
+    }
+    if (p >= n || m_pattern[p] != '}') return false;
+    if (b >= 0 && b < a) error("numbers out of order in {} quantifier");
+    m_pos = p + 1;
+    min = a;
+    max = b;
+    return true;
+  }
+
+  bool number(size_t &p, int &n) {
+    auto start = p;
+    n = 0;
+    while (p < m_pattern.length() && '0' <= m_pattern[p] && m_pattern[p] <= '9') {
+      n = n * 10 + (m_pattern[p++] - '0');
+      if (n > MAX_REPEAT) error("repetition count too large");
+    }
+    return p > start;
+  }
+
+  auto atom(int depth) -> Node* {
+    auto c = peek();
+    switch (c) {
+      case '(': return group(depth);
+      case '[': m_pos++; return char_class();
+      case '^': m_pos++; return assertion(BOL);
+      case '$': m_pos++; return assertion(EOL);
+      case '\\': m_pos++; return escape();
+      case '.': {
+        m_pos++;
+        auto node = new Node(Node::SET);
+        for (int i = 0; i < 256; i++) {
+          if (i != '\n' && i != '\r') node->set.add(i);
+        }
+        return node;
+      }
+      case '*': case '+': case '?':
+        error("nothing to repeat");
+        return nullptr;
+      case '{': {
+        int min, max;
+        if (braces(min, max)) error("nothing to repeat");
+        m_pos++;
+        return literal(c);
+      }
+      default:
+        if ((uint8_t)c >= 0x80) return utf8_char();
+        m_pos++;
+        return literal(c);
+    }
+  }
+
+  auto group(int depth) -> Node* {
+    int index = -1;
+    m_pos++;
+    if (looking_at("?:")) {
+      m_pos += 2;
+    } else if (looking_at("?=") || looking_at("?!") || looking_at("?<=") || looking_at("?<!")) {
+      throw Unsupported("lookaround");
+    } else if (looking_at("?<")) {
+      auto p = m_pattern.find('>', m_pos);
+      if (p == std::string::npos) error("invalid group name");
+      m_pos = p + 1;
+      index = ++m_group_count;
+    } else if (!eof() && peek() == '?') {
+      error("invalid group");
+    } else {
+      index = ++m_group_count;
+    }
+    std::unique_ptr<Node> child(alternation(depth + 1));
+    if (eof() || peek() != ')') error("unterminated group");
+    m_pos++;
+    auto node = new Node(Node::GROUP);
+    node->index = index;
+    node->children.push_back(std::move(child));
+    return node;
+  }
+
+  auto assertion(Op op) -> Node* {
+    auto node = new Node(Node::ASSERT);
+    node->assertion = op;
+    return node;
+  }
+
+  auto literal(uint8_t c) -> Node* {
+    auto node = new Node(Node::SET);
+    node->set.add(c);
+    if (m_ignore_case) fold(node->set);
+    return node;
+  }
+
+  auto code_point(uint32_t code) -> Node* {
+    if (code < 0x80) return literal(code);
+    char buf[4];
+    auto len = encode(code, buf);
+    auto node = new Node(Node::CONCAT);
+    for (int i = 0; i < len; i++) {
+      std::unique_ptr<Node> byte(new Node(Node::SET));
+      byte->set.add(buf[i]);
+      node->children.push_back(std::move(byte));
+    }
+    return node;
+  }
+
+  //
+  // A non-ASCII character is taken as a whole so that a
+  // quantifier after it repeats all of its UTF-8 bytes
+  //
+
+  auto utf8_char() -> Node* {
+    auto node = new Node(Node::CONCAT);
+    do {
+      std::unique_ptr<Node> byte(new Node(Node::SET));
+      byte->set.add(m_pattern[m_pos++]);
+      node->children.push_back(std::move(byte));
+    } while (!eof() && ((uint8_t)peek() & 0xc0) == 0x80);
+    return node;
+  }
+
+  auto escape() -> Node* {
+    if (eof()) error("\\ at end of pattern");
+    auto c = m_pattern[m_pos++];
+    switch (c) {
+      case 'b': return assertion(WORD);
+      case 'B': return assertion(NOT_WORD);
+      case 'd': case 'D': case 'w': case 'W': case 's': case 'S': {
+        auto node = new Node(Node::SET);
+        class_escape(c, node->set);
+        return node;
+      }
+      case '1': case '2': case '3': case '4': case '5':
+      case '6': case '7': case '8': case '9':
+      case 'k':
+        throw Unsupported("back-reference");
+      case 'p': case 'P':
+        throw Unsupported("unicode property escape");
+      default:
+        if ((uint8_t)c >= 0x80) {
+          m_pos--;
+          return utf8_char();
+        }
+        return code_point(escape_char(c));
+    }
+  }
+
+  auto escape_char(char c) -> uint32_t {
+    switch (c) {
+      case 'n': return '\n';
+      case 'r': return '\r';
+      case 't': return '\t';
+      case 'v': return '\v';
+      case 'f': return '\f';
+      case '0': return 0;
+      case 'x': {
+        uint32_t code;
+        if (!hex(2, code)) return c;
+        return code;
+      }
+      case 'u': {
+        uint32_t code;
+        if (!eof() && peek() == '{') {
+          auto p = m_pattern.find('}', m_pos);
+          if (p == std::string::npos) error("invalid unicode escape");
+          code = 0;
+          for (auto i = m_pos + 1; i < p; i++) {
+            auto h = hex_value(m_pattern[i]);
+            if (h < 0 || code > 0x10ffff) error("invalid unicode escape");
+            code = (code << 4) | h;
+          }
+          if (p == m_pos + 1 || code > 0x10ffff) error("invalid unicode escape");
+          m_pos = p + 1;
+          return code;
+        }
+        if (!hex(4, code)) return c;
+        return code;
+      }
+      case 'c': {
+        if (!eof()) {
+          auto l = peek();
+          if (('a' <= l && l <= 'z') || ('A' <= l && l <= 'Z')) {
+            m_pos++;
+            return l % 32;
+          }
+        }
+        error("invalid control escape");
+        return 0;
+      }
+      default: return (uint8_t)c;
+    }
+  }
+
+  bool hex(int count, uint32_t &code) {
+    if (m_pos + count > m_pattern.length()) return false;
+    code = 0;
+    for (int i = 0; i < count; i++) {
+      auto h = hex_value(m_pattern[m_pos + i]);
+      if (h < 0) return false;
+      code = (code << 4) | h;
+    }
+    m_pos += count;
+    return true;
+  }
+
+  void class_escape(char c, Charset &set) {
+    Charset s;
+    switch (c) {
+      case 'd': case 'D':
+        for (int i = '0'; i <= '9'; i++) s.add(i);
+        break;
+      case 'w': case 'W':
+        for (int i = 0; i < 128; i++) if (is_word(i)) s.add(i);
+        break;
+      case 's': case 'S':
+        for (auto i : { ' ', '\t', '\n', '\v', '\f', '\r' }) s.add(i);
+        break;
+    }
+    if ('A' <= c && c <= 'Z') s.invert();
+    set.add(s);
+  }
+
+  auto char_class() -> Node* {
+    Charset set;
+    std::vector<uint32_t> wide;
+    bool negated = false;
+    if (!eof() && peek() == '^') {
+      negated = true;
+      m_pos++;
+    }
+    for (;;) {
+      if (eof()) error("unterminated character class");
+      if (peek() == ']') { m_pos++; break; }
+      uint32_t lo, hi;
+      if (class_atom(lo, set)) continue;
+      hi = lo;
+      if (m_pos + 1 < m_pattern.length() && peek() == '-' && m_pattern[m_pos + 1] != ']') {
+        m_pos++;
+        Charset s;
+        if (class_atom(hi, s)) error("invalid character class range");
+        if (hi < lo) error("range out of order in character class");
+      }
+      if (hi < 0x80) {
+        for (auto c = lo; c <= hi; c++) set.add(c);
+      } else if (lo == hi && !negated) {
+        wide.push_back(lo);
+      } else {
+        throw Unsupported("non-ASCII range in character class");
+      }
+    }
+
+    if (m_ignore_case) fold(set);
+    if (negated) set.invert();
+
+    auto node = new Node(Node::SET);
+    node->set = set;
+    if (wide.empty()) return node;
+
+    std::unique_ptr<Node> alt(new Node(Node::ALTER));
+    if (set.count() > 0) alt->children.emplace_back(node); else delete node;
+    for (auto code : wide) alt->children.emplace_back(code_point(code));
+    return alt.release();
+  }
+
+  // Returns true if the atom is a class escape merged into the set
+  bool class_atom(uint32_t &code, Charset &set) {
+    auto c = (uint8_t)m_pattern[m_pos];
+    if (c >= 0x80) {
+      code = decode();
+      return false;
+    }
+    m_pos++;
+    if (c != '\\') {
+      code = c;
+      return false;
+    }
+    if (eof()) error("\\ at end of pattern");
+    auto e = m_pattern[m_pos];
+    switch (e) {
+      case 'd': case 'D': case 'w': case 'W': case 's': case 'S':
+        m_pos++;
+        class_escape(e, set);
+        return true;
+      case 'b': m_pos++; code = '\b'; return false;
+      case '-': m_pos++; code = '-'; return false;
+      case '1': case '2': case '3': case '4': case '5':
+      case '6': case '7': case '8': case '9':
+        throw Unsupported("octal escape");
+      case 'p': case 'P':
+        throw Unsupported("unicode property escape");
+      default:
+        if ((uint8_t)e >= 0x80) {
+          code = decode();
+        } else {
+          m_pos++;
+          code = escape_char(e);
+        }
+        return false;
+    }
+  }
+
+  auto decode() -> uint32_t {
+    auto c = (uint8_t)m_pattern[m_pos];
+    int len;
+    uint32_t code;
+    if ((c & 0xe0) == 0xc0) { len = 2; code = c & 0x1f; }
+    else if ((c & 0xf0) == 0xe0) { len = 3; code = c & 0x0f; }
+    else if ((c & 0xf8) == 0xf0) { len = 4; code = c & 0x07; }
+    else throw Unsupported("invalid UTF-8 in character class");
+    if (m_pos + len > m_pattern.length()) throw Unsupported("invalid UTF-8 in character class");
+    for (int i = 1; i < len; i++) {
+      auto b = (uint8_t)m_pattern[m_pos + i];
+      if ((b & 0xc0) != 0x80) throw Unsupported("invalid UTF-8 in character class");
+      code = (code << 6) | (b & 0x3f);
+    }
+    m_pos += len;
+    return code;
+  }
+
+  static int encode(uint32_t code, char *buf) {
+    if (code < 0x800) {
+      buf[0] = 0xc0 | (code >> 6);
+      buf[1] = 0x80 | (code & 0x3f);
+      return 2;
+    } else if (code < 0x10000) {
+      buf[0] = 0xe0 | (code >> 12);
+      buf[1] = 0x80 | ((code >> 6) & 0x3f);
+      buf[2] = 0x80 | (code & 0x3f);
+      return 3;
+    } else {
+      buf[0] = 0xf0 | (code >> 18);
+      buf[1] = 0x80 | ((code >> 12) & 0x3f);
+      buf[2] = 0x80 | ((code >> 6) & 0x3f);
+      buf[3] = 0x80 | (code & 0x3f);
+      return 4;
+    }
+  }
+
+  static void fold(Charset &set) {
+    for (int c = 'a'; c <= 'z'; c++) {
+      auto u = c - 'a' + 'A';
+      if (set.has(c) || set.has(u)) {
+        set.add(c);
+        set.add(u);
+      }
+    }
+  }
+};
+
+//
+// Regex
+//
+
+Regex::Regex(const std::string &pattern, bool ignore_case)
+  : m_ignore_case(ignore_case)
+{
+  Parser parser(pattern, ignore_case);
+  std::unique_ptr<Node> root(parser.parse());
+  m_group_count = parser.group_count();
+
+  emit(SAVE, 0);
+  compile(root.get());
+  emit(SAVE, 1);
+  emit(MATCH);
+  analyze(root.get());
+
+  // Positions where optional iterations start come after the groups
+  m_slot_count = (m_group_count + 1) * 2 + m_mark_count;
+  m_levels = m_mark_count + 1;
+
+  auto n = m_program.size() * m_levels;
+  for (auto *list : { &m_clist, &m_nlist }) {
+    list->dense.reserve(n);
+    list->sparse.resize(n);
+    list->slots.resize(n * m_slot_count);
+  }
+  m_start.assign(m_slot_count, -1);
+  m_work.resize(m_slot_count);
+}
+
+Regex::~Regex() {
+}
+
+void Regex::emit(Op op, int x, int y) {
+  if (m_program.size() >= MAX_PROGRAM_SIZE) {
+    throw std::runtime_error("RegExp too large");
+  }
+  m_program.push_back({ op, x, y, m_mark_depth });
+}
+
+void Regex::compile(Node *node) {
+  switch (node->type) {
+    case Node::EMPTY:
+      break;
+    case Node::SET:
+      if (node->is_literal()) {
+        emit(CHAR, node->set.first());
+      } else {
+        emit(CLASS, m_classes.size());
+        m_classes.push_back(node->set);
+      }
+      break;
+    case Node::CONCAT:
+      for (const auto &child : node->children) compile(child.get());
+      break;
+    case Node::ALTER: {
+      std::vector<int> jumps;
+      auto n = node->children.size();
+      for (size_t i = 0; i < n; i++) {
+        auto child = node->children[i].get();
+        if (i + 1 < n) {
+          auto split = m_program.size();
+          emit(SPLIT, split + 1);
+          compile(child);
+          jumps.push_back(m_program.size());
+          emit(JMP);
+          m_program[split].y = m_program.size();
+        } else {
+          compile(child);
+        }
+      }
+      for (auto i : jumps) m_program[i].x = m_program.size();
+      break;
+    }
+    case Node::REPEAT: {
+      auto child = node->children[0].get();
+      int first = -1, last = -1;
+      child->group_range(first, last);
+      int mark = -1;
+      if (child->is_nullable()) {
+        if (m_mark_depth >= MAX_MARK_DEPTH) throw Unsupported("repetitions of empty matches nested too deeply");
+        mark = (m_group_count + 1) * 2 + m_mark_depth++;
+        m_mark_count = std::max(m_mark_count, m_mark_depth);
+      }
+      auto iteration = [&](bool optional) {
+        if (first >= 0) emit(RESET, first * 2, last * 2 + 2);
+        if (optional && mark >= 0) emit(MARK, mark);
+        compile(child);
+        if (optional && mark >= 0) emit(PROGRESS, mark);
+      };
+      for (int i = 0; i < node->min; i++) iteration(false);
+      std::vector<int> splits;
+      if (node->max < 0) {
+        auto split = m_program.size();
+        emit(SPLIT);
+        iteration(true);
+        emit(JMP, split);
+        splits.push_back(split);
+      } else {
+        for (int i = node->min; i < node->max; i++) {
+          splits.push_back(m_program.size());
+          emit(SPLIT);
+          iteration(true);
+        }
+      }
+      if (mark >= 0) m_mark_depth--;
+      int out = m_program.size();
+      for (auto i : splits) {
+        auto &inst = m_program[i];
+        if (node->greedy) {
+          inst.x = i + 1;
+          inst.y = out;
+        } else {
+          inst.x = out;
+          inst.y = i + 1;
+        }
+      }
+      break;
+    }
+    case Node::GROUP:
+      if (node->index >= 0) emit(SAVE, node->index * 2);
+      compile(node->children[0].get());
+      if (node->index >= 0) emit(SAVE, node->index * 2 + 1);
+      break;
+    case Node::ASSERT:
+      emit(node->assertion);
+      break;
+  }
+}
+
+void Regex::analyze(Node *root) {
+
+  // Flatten the top-level sequence
+  std::vector<Node*> seq;
+  std::vector<Node*> stack;
+  stack.push_back(root);
+  while (!stack.empty()) {
+    auto node = stack.back();
+    stack.pop_back();
+    if (node->type == Node::CONCAT || node->type == Node::GROUP) {
+      for (auto i = node->children.rbegin(); i != node->children.rend(); ++i) {
+        stack.push_back(i->get());
+      }
+    } else {
+      seq.push_back(node);
+    }
+  }
+
+  // Anchored, leading literal and longest required literal
+  size_t i = 0;
+  while (i < seq.size() && seq[i]->type == Node::ASSERT) {
+    if (seq[i]->assertion == BOL) m_anchored = true;
+    i++;
+  }
+  while (i < seq.size() && seq[i]->is_literal()) {
+    m_prefix += char(seq[i++]->set.first());
+  }
+  std::string run;
+  for (auto node : seq) {
+    if (node->is_literal()) {
+      run += char(node->set.first());
+    } else {
+      run.clear();
+    }
+    if (run.length() > m_required.length()) m_required = run;
+  }
+
+  // Bytes that can start a match
+  std::vector<bool> marks(m_program.size());
+  std::vector<int> pcs;
+  pcs.push_back(0);
+  while (!pcs.empty()) {
+    auto pc = pcs.back();
+    pcs.pop_back();
+    if (marks[pc]) continue;
+    marks[pc] = true;
+    const auto &inst = m_program[pc];
+    switch (inst.op) {
+      case CHAR: m_first_bytes.add(inst.x); break;
+      case CLASS: m_first_bytes.add(m_classes[inst.x]); break;
+      case SPLIT: pcs.push_back(inst.y); pcs.push_back(inst.x); break;
+      case JMP: pcs.push_back(inst.x); break;
+      case MATCH: m_nullable = true; break;
+      default: pcs.push_back(pc + 1); break;
+    }
+  }
+
+  if (m_first_bytes.count() == 1) m_first_byte = m_first_bytes.first();
+
+  for (const auto &inst : m_program) {
+    if (inst.op == WORD || inst.op == NOT_WORD) {
+      m_has_word_boundary = true;
+      break;
+    }
+  }
+}
+
+auto Regex::next_candidate(const char *s, size_t n, size_t pos) -> size_t {
+  if (!m_prefix.empty()) return find_literal(s, n, pos, m_prefix);
+  if (m_first_byte >= 0) {
+    auto p = (const char *)std::memchr(s + pos, m_first_byte, n - pos);
+    return p ? p - s : n;
+  }
+  while (pos < n && !m_first_bytes.has(s[pos])) pos++;
+  return pos;
+}
+
+bool Regex::test(const std::string &str) {
+  auto s = str.c_str();
+  auto n = str.length();
+  if (!m_required.empty() && find_literal(s, n, 0, m_required) == n) return false;
+  if (!m_has_word_boundary && m_dfa_failures < MAX_DFA_FAILURES) {
+    auto ret = dfa_search(s, n);
+    if (ret >= 0) return ret > 0;
+  }
+  std::vector<int> groups;
+  return search(str, 0, groups);
+}
+
+bool Regex::search(const std::string &str, size_t start, std::vector<int> &groups) {
+  auto s = str.c_str();
+  auto n = str.length();
+  if (start > n) return false;
+  if (m_anchored && start > 0) return false;
+  if (!m_required.empty() && find_literal(s, n, start, m_required) == n) return false;
+
+  auto slots = m_slot_count;
+  auto *clist = &m_clist;
+  auto *nlist = &m_nlist;
+  clist->clear();
+  nlist->clear();
+
+  bool matched = false;
+  for (auto pos = start; ; pos++) {
+    if (!matched) {
+      if (clist->dense.empty()) {
+        if (m_anchored && pos > 0) break;
+        if (!m_nullable) {
+          pos = next_candidate(s, n, pos);
+          if (pos >= n) break;
+        }
+      }
+      add_thread(*clist, 0, m_start.data(), s, n, pos);
+    }
+
+    if (clist->dense.empty()) break;
+
+    int c = pos < n ? (uint8_t)s[pos] : -1;
+    for (size_t i = 0; i < clist->dense.size(); i++) {
+      auto pc = clist->dense[i] / m_levels;
+      const auto &inst = m_program[pc];
+      const auto *t = &clist->slots[i * slots];
+      bool step = false;
+      switch (inst.op) {
+        case CHAR: step = (c == inst.x); break;
+        case CLASS: step = (c >= 0 && m_classes[inst.x].has(c)); break;
+        case MATCH:
+          matched = true;
+          groups.assign(t, t + (m_group_count + 1) * 2);
+          i = clist->dense.size();
+          break;
+        default: break;
+      }
+      if (step) add_thread(*nlist, pc + 1, t, s, n, pos + 1);
+    }
+
+    std::swap(clist, nlist);
+    nlist->clear();
+    if (pos >= n) break;
+  }
+
+  return matched;
+}
+
+void Regex::add_thread(ThreadList &list, int pc, const int *slots, const char *s, size_t n, size_t pos) {
+  auto count = m_slot_count;
+  auto *work = m_work.data();
+  std::copy(slots, slots + count, work);
+
+  // Negative entries restore a capture slot on the way back
+  m_stack.clear();
+  m_stack.emplace_back(pc, 0);
+  while (!m_stack.empty()) {
+    auto frame = m_stack.back();
+    m_stack.pop_back();
+    if (frame.first < 0) {
+      work[-1 - frame.first] = frame.second;
+      continue;
+    }
+    auto pc = frame.first;
+    auto key = thread_key(pc, work, pos);
+    if (list.has(key)) continue;
+    list.add(key);
+    const auto &inst = m_program[pc];
+    switch (inst.op) {
+      case JMP:
+        m_stack.emplace_back(inst.x, 0);
+        break;
+      case SPLIT:
+        m_stack.emplace_back(inst.y, 0);
+        m_stack.emplace_back(inst.x, 0);
+        break;
+      case SAVE:
+      case MARK:
+        m_stack.emplace_back(-1 - inst.x, work[inst.x]);
+        m_stack.emplace_back(pc + 1, 0);
+        work[inst.x] = pos;
+        break;
+      case PROGRESS:
+        if (work[inst.x] != int(pos)) m_stack.emplace_back(pc + 1, 0);
+        break;
+      case RESET:
+        for (int i = inst.x; i < inst.y; i++) {
+          m_stack.emplace_back(-1 - i, work[i]);
+          work[i] = -1;
+        }
+        m_stack.emplace_back(pc + 1, 0);
+        break;
+      case BOL:
+        if (pos == 0) m_stack.emplace_back(pc + 1, 0);
+        break;
+      case EOL:
+        if (pos == n) m_stack.emplace_back(pc + 1, 0);
+        break;
+      case WORD:
+      case NOT_WORD: {
+        bool a = pos > 0 && is_word(s[pos - 1]);
+        bool b = pos < n && is_word(s[pos]);
+        if ((a != b) == (inst.op == WORD)) m_stack.emplace_back(pc + 1, 0);
+        break;
+      }
+      default:
+        std::copy(work, work + count, &list.slots[(list.dense.size() - 1) * count]);
+        break;
+    }
+  }
+}
+
+// Threads at the same instruction can only be merged when they also agree
+// on which enclosing iterations have not consumed anything yet. Since inner
+// iterations start no earlier than outer ones, counting them is enough.
+auto Regex::thread_key(int pc, const int *slots, size_t pos) -> int {
+  auto base = (m_group_count + 1) * 2;
+  auto level = 0;
+  for (int i = 0, n = m_program[pc].marks; i < n; i++) {
+    if (slots[base + i] == int(pos)) level++;
+  }
+  return pc * m_levels + level;
+}
+
+//
+// Regex::ThreadList
+//
+
+bool Regex::ThreadList::has(int pc) const {
+  auto i = sparse[pc];
+  return i < (int)dense.size() && dense[i] == pc;
+}
+
+void Regex::ThreadList::add(int pc) {
+  sparse[pc] = dense.size();
+  dense.push_back(pc);
+}
+
+//
+// Regex DFA
+//
+
+void Regex::closure(std::vector<int> &pcs, std::vector<bool> &marks, int pc, bool at_begin, bool at_end) {
+  auto &stack = m_dstack;
+  stack.clear();
+  stack.push_back(pc);
+  while (!stack.empty()) {
+    auto pc = stack.back();
+    stack.pop_back();
+    if (marks[pc]) continue;
+    marks[pc] = true;
+    const auto &inst = m_program[pc];
+    switch (inst.op) {
+      case JMP: stack.push_back(inst.x); break;
+      case SPLIT: stack.push_back(inst.y); stack.push_back(inst.x); break;
+      case SAVE: case MARK: case PROGRESS: case RESET: stack.push_back(pc + 1); break;
+      case BOL: if (at_begin) stack.push_back(pc + 1); break;
+      case EOL: if (at_end) stack.push_back(pc + 1); else pcs.push_back(pc); break;
+      default: pcs.push_back(pc); break;
+    }
+  }
+}
+
+auto Regex::dfa_state(std::vector<int> &pcs) -> int {
+  std::sort(pcs.begin(), pcs.end());
+  auto i = m_dstate_map.find(pcs);
+  if (i != m_dstate_map.end()) return i->second;
+  if (m_dstates.size() >= MAX_DFA_STATES) return -1;
+  int index = m_dstates.size();
+  m_dstates.emplace_back();
+  auto &ds = m_dstates.back();
+  ds.pcs = pcs;
+  ds.match = false;
+  for (auto pc : pcs) if (m_program[pc].op == MATCH) ds.match = true;
+  std::fill(ds.next, ds.next + 256, -1);
+  m_dstate_map[pcs] = index;
+  return index;
+}
+
+auto Regex::dfa_step(int state, uint8_t c) -> int {
+  auto next = m_dstates[state].next[c];
+  if (next >= 0) return next;
+  std::vector<int> pcs;
+  std::vector<bool> marks(m_program.size());
+  for (auto pc : m_dstates[state].pcs) {
+    const auto &inst = m_program[pc];
+    if ((inst.op == CHAR && inst.x == c) || (inst.op == CLASS && m_classes[inst.x].has(c))) {
+      closure(pcs, marks, pc + 1, false, false);
+    }
+  }
+  closure(pcs, marks, 0, false, false);
+  next = dfa_state(pcs);
+  if (next >= 0) m_dstates[state].next[c] = next;
+  return next;
+}
+
+auto Regex::dfa_search(const char *s, size_t n) -> int {
+  if (m_dstates.empty()) {
+    std::vector<int> pcs;
+    std::vector<bool> marks(m_program.size());
+    closure(pcs, marks, 0, true, false);
+    dfa_state(pcs);
+    pcs.clear();
+    marks.assign(m_program.size(), false);
+    closure(pcs, marks, 0, false, false);
+    m_dstate_idle = dfa_state(pcs);
+  }
+
+  int state = 0;
+  for (size_t pos = 0; pos < n; pos++) {
+    const auto &ds = m_dstates[state];
+    if (ds.match) return 1;
+    if (ds.pcs.empty()) return 0;
+    if (state == m_dstate_idle && !m_nullable) {
+      pos = next_candidate(s, n, pos);
+      if (pos >= n) break;
+    }
+    state = dfa_step(state, s[pos]);
+    if (state < 0) {
+      dfa_reset();
+      m_dfa_failures++;
+      return -1;
+    }
+  }
+
+  if (m_dstates[state].match) return 1;
+
+  // Assertions for the end of input
+  std::vector<int> pcs;
+  std::vector<bool> marks(m_program.size());
+  auto at_begin = (n == 0);
+  for (auto pc : m_dstates[state].pcs) {
+    if (m_program[pc].op == EOL) {
+      closure(pcs, marks, pc + 1, at_begin, true);
+    }
+  }
+  for (auto pc : pcs) {
+    if (m_program[pc].op == MATCH) return 1;
+  }
+  return 0;
+}
+
+void Regex::dfa_reset() {
+  m_dstates.clear();
+  m_dstate_map.clear();
+  m_dstate_idle = -1;
+}
+
+} // namespace pjs
@@ -0,0 +1,174 @@
+/*
+ *  Copyright (c) 2019 by flomesh.io
+ *
+ *  Unless prior written consent has been obtained from the copyright
+ *  owner, the following shall not be allowed.
+ *
+ *  1. The distribution of any source codes, header files, make files,
+ *     or libraries of the software.
+ *
+ *  2. Disclosure of any source codes pertaining to the software to any
+ *     additional parties.
+ *
+ *  3. Alteration or removal of any notices in or on the software or
+ *     within the documentation included within the software.
+ *
+ *  ALL SOURCE CODE AS WELL AS ALL DOCUMENTATION INCLUDED WITH THIS
+ *  SOFTWARE IS PROVIDED IN AN “AS IS” CONDITION, WITHOUT WARRANTY OF ANY
+ *  KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ *  CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ *  TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ *  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PJS_REGEX_HPP
+#define PJS_REGEX_HPP
+
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace pjs {
+
+//
+// Regex
+//
+// Patterns are compiled into a Thompson NFA, so matching never backtracks
+// and takes time linear to the input. A DFA is built lazily out of the NFA
+// for yes-or-no questions, with its states kept in a cache of bounded size.
+// When the cache fills up, or when match positions are needed, the NFA is
+// simulated directly by a Pike VM. Literals that every match must contain
+// are looked for before running either of them.
+//
+// Repetitions follow JavaScript: groups inside are cleared at the start of
+// every iteration, and an optional iteration that matches nothing is
+// rejected, which only makes a difference to the positions reported.
+//
+// Matching is done on bytes, where '.' and negated classes match any single
+// byte other than the ones excluded, and case folding only applies to ASCII.
+// Patterns with back-references or lookarounds can't be matched this way
+// and are refused with Regex::Unsupported.
+//
+
+class Regex {
+public:
+  class Unsupported : public std::runtime_error {
+  public:
+    Unsupported(const std::string &what) : std::runtime_error(what) {}
+  };
+
+  Regex(const std::string &pattern, bool ignore_case);
+  ~Regex();
+
+  auto group_count() const -> int { return m_group_count; }
+
+  bool test(const std::string &str);
+  bool search(const std::string &str, size_t start, std::vector<int> &groups);
+
+private:
+  enum Op {
+    CHAR,
+    CLASS,
+    SPLIT,
+    JMP,
+    SAVE,
+    MARK,
+    PROGRESS,
+    RESET,
+    BOL,
+    EOL,
+    WORD,
+    NOT_WORD,
+    MATCH,
+  };
+
+  struct Inst {
+    Op op;
+    int x, y;
+    int marks;
+  };
+
+  struct Charset {
+    uint64_t bits[4] = { 0, 0, 0, 0 };
+    bool has(uint8_t c) const { return bits[c >> 6] & (uint64_t(1) << (c & 63)); }
+    void add(uint8_t c) { bits[c >> 6] |= uint64_t(1) << (c & 63); }
+    void add(const Charset &s) { for (int i = 0; i < 4; i++) bits[i] |= s.bits[i]; }
+    void invert() { for (int i = 0; i < 4; i++) bits[i] = ~bits[i]; }
+    int count() const;
+    int first() const;
+  };
+
+  struct Node;
+  class Parser;
+
+  //
+  // Regex::ThreadList
+  //
+
+  struct ThreadList {
+    std::vector<int> dense;
+    std::vector<int> sparse;
+    std::vector<int> slots;
+    bool has(int pc) const;
+    void add(int pc);
+    void clear() { dense.clear(); }
+  };
+
+  //
+  // Regex::DState
+  //
+
+  struct DState {
+    std::vector<int> pcs;
+    bool match;
+    int next[256];
+  };
+
+  std::vector<Inst> m_program;
+  std::vector<Charset> m_classes;
+  int m_group_count = 0;
+  int m_slot_count = 2;
+  int m_mark_count = 0;
+  int m_mark_depth = 0;
+  int m_levels = 1;
+  bool m_ignore_case;
+  bool m_anchored = false;
+  bool m_nullable = false;
+  bool m_has_word_boundary = false;
+  Charset m_first_bytes;
+  int m_first_byte = -1;
+  std::string m_prefix;
+  std::string m_required;
+
+  ThreadList m_clist, m_nlist;
+  std::vector<std::pair<int, int>> m_stack;
+  std::vector<int> m_start;
+  std::vector<int> m_work;
+
+  std::vector<DState> m_dstates;
+  std::map<std::vector<int>, int> m_dstate_map;
+  std::vector<int> m_dstack;
+  int m_dstate_idle = -1;
+  int m_dfa_failures = 0;
+
+  void compile(Node *node);
+  void emit(Op op, int x = 0, int y = 0);
+  void analyze(Node *root);
+  auto next_candidate(const char *s, size_t n, size_t pos) -> size_t;
+  void add_thread(ThreadList &list, int pc, const int *slots, const char *s, size_t n, size_t pos);
+  auto thread_key(int pc, const int *slots, size_t pos) -> int;
+  void closure(std::vector<int> &pcs, std::vector<bool> &marks, int pc, bool at_begin, bool at_end);
+  auto dfa_state(std::vector<int> &pcs) -> int;
+  auto dfa_step(int state, uint8_t c) -> int;
+  auto dfa_search(const char *s, size_t n) -> int;
+  void dfa_reset();
+};
+
+} // namespace pjs
+
+#endif // PJS_REGEX_HPP
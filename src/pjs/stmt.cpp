@@ -48,6 +48,16 @@ void Stmt::execute(Context &ctx, Value &result) {
   result = res.value;
 }
 
+void Stmt::fold(std::unique_ptr<Stmt> &stmt, Module *module, Context &ctx) {
+  if (!module) return;
+  if (auto folded = stmt->fold(ctx)) {
+    // Hoisted declarations can still point into the pruned statement
+    module->add_pruned(stmt.release());
+    module->add_folded();
+    stmt.reset(folded);
+  }
+}
+
 namespace stmt {
 
 thread_local static ConstStr s_default("default");
@@ -71,8 +81,9 @@ bool Block::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
 }
 
 void Block::resolve(Module *module, Context &ctx, int l, Tree::LegacyImports *imports) {
-  for (const auto &p : m_stmts) {
+  for (auto &p : m_stmts) {
     p->resolve(module, ctx, l, imports);
+    Stmt::fold(p, module, ctx);
   }
 }
 
@@ -97,6 +108,12 @@ void Block::dump(std::ostream &out, const std::string &indent) {
   }
 }
 
+void Block::compile(Bytecode::Compiler &c) {
+  for (const auto &p : m_stmts) {
+    p->compile(c);
+  }
+}
+
 //
 // Label
 //
@@ -132,6 +149,7 @@ bool Evaluate::declare(Module *module, Scope &scope, Error &error, bool is_lval)
 
 void Evaluate::resolve(Module *module, Context &ctx, int l, Tree::LegacyImports *imports) {
   m_expr->resolve(module, ctx, l, imports);
+  Expr::fold(m_expr, module, ctx);
 }
 
 void Evaluate::execute(Context &ctx, Result &result) {
@@ -149,6 +167,16 @@ void Evaluate::dump(std::ostream &out, const std::string &indent) {
   m_expr->dump(out, indent + "  ");
 }
 
+void Evaluate::compile(Bytecode::Compiler &c) {
+  if (m_export) {
+    c.fallback(this);
+  } else {
+    auto r = c.push();
+    m_expr->compile(c, r);
+    c.pop();
+  }
+}
+
 bool Evaluate::declare_export(Module *module, bool is_default, Error &error) {
   m_module = module;
   m_export = module->add_export(s_default, Str::empty);
@@ -208,6 +236,12 @@ bool Var::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
 void Var::resolve(Module *module, Context &ctx, int l, Tree::LegacyImports *imports) {
   for (auto e : m_assignments) {
     e->resolve(module, ctx, l, imports);
+    if (m_is_module_level && module) {
+      auto id = e->lvalue()->as<expr::Identifier>();
+      if (id && !is_fiber(id->name()->str()) && e->rvalue()->is_constant()) {
+        module->add_constant(id->name(), e->rvalue());
+      }
+    }
   }
 }
 
@@ -301,13 +335,22 @@ bool Function::declare(Module *module, Scope &scope, Error &error, bool is_lval)
     return false;
   } else {
     s->declare_var(name, m_is_definition ? m_expr.get() : nullptr);
+    m_identifier->declare(module, scope, error, true);
     return m_expr->declare(module, scope, error);
   }
 }
 
 void Function::resolve(Module *module, Context &ctx, int l, Tree::LegacyImports *imports) {
   m_identifier->resolve(module, ctx, l, imports);
-  m_expr->resolve(module, ctx, l, imports);
+
+  // Hoisted definitions can run before any module-level variable is assigned
+  if (m_is_definition && module) {
+    module->suspend_constants();
+    m_expr->resolve(module, ctx, l, imports);
+    module->resume_constants();
+  } else {
+    m_expr->resolve(module, ctx, l, imports);
+  }
 }
 
 void Function::execute(Context &ctx, Result &result) {
@@ -353,8 +396,34 @@ bool If::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
 
 void If::resolve(Module *module, Context &ctx, int l, Tree::LegacyImports *imports) {
   m_cond->resolve(module, ctx, l, imports);
-  m_then->resolve(module, ctx, l, imports);
-  if (m_else) m_else->resolve(module, ctx, l, imports);
+  Expr::fold(m_cond, module, ctx);
+  if (m_cond->is_constant()) {
+    Value cond;
+    m_cond->eval(ctx, cond);
+    if (cond.to_boolean()) {
+      m_then->resolve(module, ctx, l, imports);
+      Stmt::fold(m_then, module, ctx);
+    } else if (m_else) {
+      m_else->resolve(module, ctx, l, imports);
+      Stmt::fold(m_else, module, ctx);
+    }
+  } else {
+    m_then->resolve(module, ctx, l, imports);
+    Stmt::fold(m_then, module, ctx);
+    if (m_else) {
+      m_else->resolve(module, ctx, l, imports);
+      Stmt::fold(m_else, module, ctx);
+    }
+  }
+}
+
+auto If::fold(Context &ctx) -> Stmt* {
+  if (!m_cond->is_constant()) return nullptr;
+  Value cond;
+  m_cond->eval(ctx, cond);
+  if (cond.to_boolean()) return m_then.release();
+  if (m_else) return m_else.release();
+  return new Block;
 }
 
 void If::execute(Context &ctx, Result &result) {
@@ -380,6 +449,22 @@ void If::dump(std::ostream &out, const std::string &indent) {
   }
 }
 
+void If::compile(Bytecode::Compiler &c) {
+  auto r = c.push();
+  m_cond->compile(c, r);
+  auto j = c.emit(Bytecode::JF, r);
+  c.pop();
+  m_then->compile(c);
+  if (m_else) {
+    auto k = c.emit(Bytecode::JMP);
+    c.patch(j);
+    m_else->compile(c);
+    c.patch(k);
+  } else {
+    c.patch(j);
+  }
+}
+
 //
 // Switch
 //
@@ -396,6 +481,7 @@ bool Switch::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
 
 void Switch::resolve(Module *module, Context &ctx, int l, Tree::LegacyImports *imports) {
   m_cond->resolve(module, ctx, l, imports);
+  Expr::fold(m_cond, module, ctx);
   for (const auto &p : m_cases) {
     if (p.first) p.first->resolve(module, ctx, l, imports);
     if (p.second) p.second->resolve(module, ctx, l, imports);
@@ -598,7 +684,10 @@ bool Return::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
 }
 
 void Return::resolve(Module *module, Context &ctx, int l, Tree::LegacyImports *imports) {
-  if (m_expr) m_expr->resolve(module, ctx, l, imports);
+  if (m_expr) {
+    m_expr->resolve(module, ctx, l, imports);
+    Expr::fold(m_expr, module, ctx);
+  }
 }
 
 void Return::execute(Context &ctx, Result &result) {
@@ -617,6 +706,17 @@ void Return::dump(std::ostream &out, const std::string &indent) {
   if (m_expr) m_expr->dump(out, indent + "  ");
 }
 
+void Return::compile(Bytecode::Compiler &c) {
+  if (m_expr) {
+    auto r = c.push();
+    m_expr->compile(c, r);
+    c.emit(Bytecode::RET, r);
+    c.pop();
+  } else {
+    c.emit(Bytecode::RETU);
+  }
+}
+
 //
 // Throw
 //
@@ -627,7 +727,10 @@ bool Throw::declare(Module *module, Scope &scope, Error &error, bool is_lval) {
 }
 
 void Throw::resolve(Module *module, Context &ctx, int l, Tree::LegacyImports *imports) {
-  if (m_expr) m_expr->resolve(module, ctx, l, imports);
+  if (m_expr) {
+    m_expr->resolve(module, ctx, l, imports);
+    Expr::fold(m_expr, module, ctx);
+  }
 }
 
 void Throw::execute(Context &ctx, Result &result) {
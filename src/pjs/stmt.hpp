@@ -70,6 +70,14 @@ public:
   virtual bool is_expression() const { return false; }
   virtual void execute(Context &ctx, Result &result) {};
   virtual void dump(std::ostream &out, const std::string &indent = "") = 0;
+  virtual void compile(Bytecode::Compiler &c) { c.fallback(this); }
+  virtual auto fold(Context &ctx) -> Stmt* { return nullptr; }
+
+  //
+  // Dead branch elimination
+  //
+
+  static void fold(std::unique_ptr<Stmt> &stmt, Module *module, Context &ctx);
 
   //
   // Statement execution
@@ -98,11 +106,14 @@ public:
   Block() {}
   Block(std::list<std::unique_ptr<Stmt>> &&stmts) : m_stmts(std::move(stmts)) {}
 
+  auto stmts() const -> const std::list<std::unique_ptr<Stmt>>& { return m_stmts; }
+
   virtual bool is_expression() const override;
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, Tree::LegacyImports *imports) override;
   virtual void execute(Context &ctx, Result &result) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c) override;
 
 private:
   std::list<std::unique_ptr<Stmt>> m_stmts;
@@ -140,6 +151,7 @@ public:
   virtual void execute(Context &ctx, Result &result) override;
   virtual bool declare_export(Module *module, bool is_default, Error &error) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c) override;
 
 private:
   Module* m_module = nullptr;
@@ -159,6 +171,8 @@ public:
   static bool is_fiber(const std::string &name);
   static bool is_reserved(const std::string &name);
 
+  void set_module_level() { m_is_module_level = true; }
+
   virtual bool declare(Module *module, Scope &scope, Error &error, bool is_lval) override;
   virtual void resolve(Module *module, Context &ctx, int l, Tree::LegacyImports *imports) override;
   virtual void execute(Context &ctx, Result &result) override;
@@ -168,6 +182,7 @@ public:
 private:
   std::vector<std::unique_ptr<Expr>> m_list;
   std::vector<expr::Assignment*> m_assignments;
+  bool m_is_module_level = false;
 
   bool check_reserved(const std::string &name, Error &error);
 };
@@ -206,6 +221,8 @@ public:
   virtual void resolve(Module *module, Context &ctx, int l, Tree::LegacyImports *imports) override;
   virtual void execute(Context &ctx, Result &result) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c) override;
+  virtual auto fold(Context &ctx) -> Stmt* override;
 
 private:
   std::unique_ptr<Expr> m_cond;
@@ -287,6 +304,7 @@ public:
   virtual void resolve(Module *module, Context &ctx, int l, Tree::LegacyImports *imports) override;
   virtual void execute(Context &ctx, Result &result) override;
   virtual void dump(std::ostream &out, const std::string &indent) override;
+  virtual void compile(Bytecode::Compiler &c) override;
 
 private:
   std::unique_ptr<Expr> m_expr;
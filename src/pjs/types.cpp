@@ -29,6 +29,7 @@
 #include <cstdio>
 #include <cstring>
 #include <cmath>
+#include <mutex>
 
 namespace pjs {
 
@@ -163,6 +164,231 @@ PooledClass::~PooledClass() {
   m_pool->release();
 }
 
+//
+// Arena
+//
+
+// Lanes are shared by all threads, with blocks kept per thread
+static struct {
+  std::string name;
+  size_t slot_size;
+} s_arena_lanes[16];
+
+static std::atomic<int> s_arena_lane_count(0);
+static std::mutex s_arena_lane_mutex;
+
+thread_local Arena::Holder Arena::s_holder;
+thread_local Arena* Arena::s_current = nullptr;
+
+// Classes beyond the last lane get -1 and stay with the pools
+auto Arena::lane(const char *c_name, size_t size) -> int {
+  static_assert(sizeof(s_arena_lanes) / sizeof(s_arena_lanes[0]) == MAX_LANES, "wrong number of arena lanes");
+  std::lock_guard<std::mutex> lock(s_arena_lane_mutex);
+  auto i = s_arena_lane_count.load(std::memory_order_relaxed);
+  if (i >= MAX_LANES) return -1;
+#ifdef _MSC_VER
+  s_arena_lanes[i].name = c_name;
+#else
+  int status;
+  if (auto cxx_name = abi::__cxa_demangle(c_name, 0, 0, &status)) {
+    s_arena_lanes[i].name = cxx_name;
+    std::free(cxx_name);
+  } else {
+    s_arena_lanes[i].name = c_name;
+  }
+#endif
+  s_arena_lanes[i].slot_size = (size + sizeof(Head) - 1) / sizeof(Head) * sizeof(Head) + sizeof(Head);
+  s_arena_lane_count.store(i + 1, std::memory_order_release);
+  return i;
+}
+
+auto Arena::alloc(int lane) -> void* {
+  return s_holder.arena->bump(lane);
+}
+
+void Arena::free(void *p) {
+  auto *h = (Head*)p - 1;
+  auto *b = h->block;
+  if (b->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    auto *a = b->arena;
+    if (a == s_current) {
+      a->recycle(b);
+    } else {
+      a->add_return(b);
+    }
+  }
+}
+
+void Arena::clean() {
+  auto *a = s_current;
+  if (!a) return;
+  a->accept_returns();
+  for (auto &l : a->m_lanes) {
+    while (l.spare_count > l.spare_taken) {
+      auto *b = l.spare_list;
+      l.spare_list = b->next;
+      l.spare_count--;
+      std::free(b);
+    }
+    l.spare_taken = 0;
+  }
+}
+
+auto Arena::lane_count() -> int {
+  return s_arena_lane_count.load(std::memory_order_acquire);
+}
+
+auto Arena::lane_name(int lane) -> const std::string& {
+  return s_arena_lanes[lane].name;
+}
+
+auto Arena::block_size(int lane) -> size_t {
+  return BLOCK_HEAD + s_arena_lanes[lane].slot_size * BLOCK_SLOTS;
+}
+
+auto Arena::allocated(int lane) -> int {
+  auto *a = s_current;
+  if (!a) return 0;
+  a->accept_returns();
+  return a->m_lanes[lane].blocks;
+}
+
+auto Arena::pooled(int lane) -> int {
+  auto *a = s_current;
+  if (!a) return 0;
+  a->accept_returns();
+  return a->m_lanes[lane].spare_count;
+}
+
+Arena::Arena()
+  : m_return_list(nullptr)
+{
+  retain();
+}
+
+Arena::~Arena() {
+  for (auto *b = m_return_list.load(); b; ) {
+    auto *p = b; b = b->next;
+    std::free(p);
+  }
+}
+
+// Blocks in use each hold a reference to the arena, so that the ones
+// outliving their thread can still be returned
+auto Arena::bump(int lane) -> void* {
+  auto &l = m_lanes[lane];
+  auto n = s_arena_lanes[lane].slot_size;
+  if (l.pointer == l.end) {
+    retire(l);
+    accept_returns();
+    Block *b;
+    if (l.spare_list) {
+      b = l.spare_list;
+      l.spare_list = b->next;
+      l.spare_count--;
+      l.spare_taken++;
+    } else {
+      b = new (std::malloc(block_size(lane))) Block;
+      b->lane = lane;
+      b->arena = this;
+    }
+    b->pending.store(BLOCK_BIAS, std::memory_order_relaxed);
+    b->next = nullptr;
+    l.block = b;
+    l.pointer = (char*)b + BLOCK_HEAD;
+    l.end = l.pointer + n * BLOCK_SLOTS;
+    l.count = 0;
+    l.blocks++;
+    retain();
+  }
+  auto *h = (Head*)l.pointer;
+  h->block = l.block;
+  l.pointer += n;
+  l.count++;
+  return h + 1;
+}
+
+void Arena::retire(Lane &l) {
+  if (auto *b = l.block) {
+    int n = BLOCK_BIAS - l.count;
+    l.block = nullptr;
+    l.pointer = l.end = nullptr;
+    if (b->pending.fetch_sub(n, std::memory_order_acq_rel) == n) {
+      recycle(b);
+    }
+  }
+}
+
+void Arena::recycle(Block *b) {
+  auto &l = m_lanes[b->lane];
+  b->next = l.spare_list;
+  l.spare_list = b;
+  l.spare_count++;
+  l.blocks--;
+  release();
+}
+
+void Arena::add_return(Block *b) {
+  auto *p = m_return_list.load(std::memory_order_relaxed);
+  do {
+    b->next = p;
+  } while (!m_return_list.compare_exchange_weak(
+    p, b,
+    std::memory_order_release,
+    std::memory_order_relaxed
+  ));
+  release();
+}
+
+void Arena::accept_returns() {
+  if (auto *b = m_return_list.load(std::memory_order_relaxed)) {
+    while (!m_return_list.compare_exchange_weak(
+      b, nullptr,
+      std::memory_order_acquire,
+      std::memory_order_relaxed
+    )) {}
+    while (b) {
+      auto *next = b->next;
+      auto &l = m_lanes[b->lane];
+      b->next = l.spare_list;
+      l.spare_list = b;
+      l.spare_count++;
+      l.blocks--;
+      b = next;
+    }
+  }
+}
+
+// Spare blocks go away with the thread, and the arena itself
+// when the last block in use is returned
+void Arena::shutdown() {
+  for (auto &l : m_lanes) retire(l);
+  accept_returns();
+  for (auto &l : m_lanes) {
+    while (auto *b = l.spare_list) {
+      l.spare_list = b->next;
+      std::free(b);
+    }
+    l.spare_count = 0;
+  }
+}
+
+//
+// Arena::Holder
+//
+
+Arena::Holder::Holder()
+  : arena(new Arena)
+{
+  s_current = arena;
+}
+
+Arena::Holder::~Holder() {
+  s_current = nullptr;
+  arena->shutdown();
+  arena->release();
+}
+
 //
 // Str
 //
@@ -272,7 +498,10 @@ auto Str::substring(int start, int end) -> std::string {
 // Str::CharData
 //
 
-Str::CharData::CharData(std::string &&str) : m_str(std::move(str)) {
+Str::CharData::CharData(std::string &&str)
+  : m_str(std::move(str))
+  , m_hash(0)
+{
   int n = 0, p = 0, i = 0;
   Utf8Decoder decoder(
     [&](int cp) {
@@ -1622,7 +1851,7 @@ template<> void ClassDef<String>::init() {
   method("match", [](Context &ctx, Object *obj, Value &ret) {
     RegExp *pattern;
     if (!ctx.arguments(1, &pattern)) return;
-    ret.set(pattern->exec(obj->as<String>()->str()));
+    ret.set(pattern->match(obj->as<String>()->str()));
   });
 
   method("padEnd", [](Context &ctx, Object *obj, Value &ret) {
@@ -1676,9 +1905,13 @@ template<> void ClassDef<String>::init() {
 
   method("split", [](Context &ctx, Object *obj, Value &ret) {
     Str *separator = nullptr;
+    RegExp *reg_exp;
     int limit = Array::MAX_SIZE;
-    if (!ctx.arguments(0, &separator, &limit)) return;
-    ret.set(obj->as<String>()->split(separator, limit));
+    if (ctx.try_arguments(0, &separator, &limit)) {
+      ret.set(obj->as<String>()->split(separator, limit));
+    } else if (ctx.arguments(1, &reg_exp, &limit)) {
+      ret.set(obj->as<String>()->split(reg_exp, limit));
+    }
   });
 
   method("startsWith", [](Context &ctx, Object *obj, Value &ret) {
@@ -1876,18 +2109,11 @@ auto String::replace(Str *pattern, Str *replacement, bool all) -> Str* {
 }
 
 auto String::replace(RegExp *pattern, Str *replacement) -> Str* {
-  auto &s = m_s->str();
-  auto &fmt = replacement->str();
-  auto &re = pattern->regex();
-  return Str::make(std::regex_replace(s, re, fmt));
+  return pattern->replace(m_s, replacement);
 }
 
 auto String::search(RegExp *pattern) -> int {
-  std::smatch sm;
-  std::regex_search(m_s->str(), sm, pattern->regex());
-  if (sm.empty()) return -1;
-  auto p = sm.position(0);
-  return m_s->pos_to_chr(p);
+  return pattern->search(m_s);
 }
 
 auto String::slice(int start) -> Str* {
@@ -1955,6 +2181,10 @@ auto String::split(Str *separator, int limit) -> Array* {
   }
 }
 
+auto String::split(RegExp *separator, int limit) -> Array* {
+  return separator->split(m_s, limit);
+}
+
 bool String::startsWith(Str *search, int position) {
   int size = search->size();
   if (size == 0) return true;
@@ -3520,59 +3750,218 @@ template<> void ClassDef<Constructor<RegExp>>::init() {
 
 RegExp::RegExp(Str *pattern)
   : m_source(pattern)
-  , m_regex(pattern->str(), chars_to_flags(nullptr, m_global))
 {
+  compile(nullptr);
 }
 
 RegExp::RegExp(Str *pattern, Str *flags)
   : m_source(pattern)
-  , m_regex(pattern->str(), chars_to_flags(flags, m_global))
 {
+  compile(flags);
 }
 
-auto RegExp::exec(Str *str) -> Array* {
+void RegExp::compile(Str *flags) {
+  if (flags) {
+    for (auto c : flags->str()) {
+      switch (c) {
+        case 'i': m_ignore_case = true; break;
+        case 'g': m_global = true; break;
+        default: throw std::runtime_error(std::string("invalid RegExp flags: ") + flags->str());
+      }
+    }
+  }
+
+  // Back-references and lookarounds are left to std::regex
+  try {
+    m_regex.reset(new Regex(m_source->str(), m_ignore_case));
+  } catch (Regex::Unsupported &) {
+    auto options = std::regex::ECMAScript | std::regex::optimize;
+    if (m_ignore_case) options |= std::regex::icase;
+    m_std_regex.reset(new std::regex(m_source->str(), options));
+  }
+}
+
+bool RegExp::search(const std::string &str, size_t start, std::vector<int> &groups) {
+  if (m_regex) return m_regex->search(str, start, groups);
   std::smatch sm;
-  auto &match = m_global ? m_match : sm;
+  auto flags = start > 0 ? std::regex_constants::match_prev_avail : std::regex_constants::match_default;
+  if (!std::regex_search(str.begin() + start, str.end(), sm, *m_std_regex, flags)) return false;
+  groups.resize(sm.size() * 2);
+  for (size_t i = 0; i < sm.size(); i++) {
+    if (sm[i].matched) {
+      groups[i*2+0] = sm[i].first - str.begin();
+      groups[i*2+1] = sm[i].second - str.begin();
+    } else {
+      groups[i*2+0] = -1;
+      groups[i*2+1] = -1;
+    }
+  }
+  return true;
+}
 
-  std::regex_search(str->str(), match, m_regex);
-  if (match.empty()) return nullptr;
+static auto next_char_pos(const std::string &str, size_t pos) -> size_t {
+  pos++;
+  while (pos < str.length() && (str[pos] & 0xc0) == 0x80) pos++;
+  return pos;
+}
 
-  auto result = Array::make(match.size());
-  for (size_t i = 0; i < match.size(); i++) {
-    auto &sm = match[i];
-    result->set(i, Str::make(sm.str()));
+auto RegExp::exec(Str *str) -> Array* {
+  size_t start = 0;
+  if (m_global) {
+    if (m_last_index > str->length()) {
+      m_last_index = 0;
+      return nullptr;
+    }
+    start = str->chr_to_pos(m_last_index);
+  }
+
+  std::vector<int> groups;
+  if (!search(str->str(), start, groups)) {
+    if (m_global) m_last_index = 0;
+    return nullptr;
+  }
+
+  auto s = str->c_str();
+  auto n = groups.size() / 2;
+  auto result = Array::make(n);
+  for (size_t i = 0; i < n; i++) {
+    auto a = groups[i*2+0];
+    auto b = groups[i*2+1];
+    if (a >= 0 && b >= a) {
+      result->set(i, Str::make(s + a, b - a));
+    } else {
+      result->set(i, Str::empty.get());
+    }
   }
 
   if (m_global) {
-    auto p = match[0].second - str->str().begin();
-    m_last_index = str->pos_to_chr(p);
+    m_last_index = str->pos_to_chr(groups[1]);
   }
 
   return result;
 }
 
 bool RegExp::test(Str *str) {
-  if (m_source->str() == ".*") return true;
-  std::smatch match;
-  std::regex_search(str->str(), match, m_regex);
-  return !match.empty();
+  if (m_regex) return m_regex->test(str->str());
+  std::vector<int> groups;
+  return search(str->str(), 0, groups);
+}
+
+auto RegExp::match(Str *str) -> Array* {
+  if (!m_global) return exec(str);
+  const auto &s = str->str();
+  std::vector<int> groups;
+  Array *result = nullptr;
+  size_t start = 0;
+  while (start <= s.length() && search(s, start, groups)) {
+    auto a = groups[0];
+    auto b = groups[1];
+    if (!result) result = Array::make();
+    result->push(Str::make(s.c_str() + a, b - a));
+    start = (b > a ? b : next_char_pos(s, b));
+  }
+  m_last_index = 0;
+  return result;
 }
 
-auto RegExp::chars_to_flags(Str *chars, bool &global) -> std::regex::flag_type {
-  std::regex::flag_type flags = std::regex::ECMAScript | std::regex::optimize;
-  global = false;
+auto RegExp::search(Str *str) -> int {
+  std::vector<int> groups;
+  if (!search(str->str(), 0, groups)) return -1;
+  return str->pos_to_chr(groups[0]);
+}
 
-  if (chars) {
-    for (auto c : chars->str()) {
-      switch (c) {
-        case 'i': flags |= std::regex::icase; break;
-        case 'g': global = true; break;
-        default: throw std::runtime_error(std::string("invalid RegExp flags: ") + chars->str());
+auto RegExp::replace(Str *str, Str *replacement) -> Str* {
+  const auto &s = str->str();
+  const auto &fmt = replacement->str();
+  std::string result;
+  std::vector<int> groups;
+  size_t start = 0, last = 0;
+  while (start <= s.length() && search(s, start, groups)) {
+    size_t a = groups[0];
+    size_t b = groups[1];
+    size_t n = groups.size() / 2;
+    result.append(s, last, a - last);
+    for (size_t i = 0; i < fmt.length(); i++) {
+      auto c = fmt[i];
+      if (c != '$' || i + 1 >= fmt.length()) {
+        result += c;
+        continue;
+      }
+      auto d = fmt[i+1];
+      switch (d) {
+        case '$': result += '$'; i++; break;
+        case '&': result.append(s, a, b - a); i++; break;
+        case '`': result.append(s, 0, a); i++; break;
+        case '\'': result.append(s, b, std::string::npos); i++; break;
+        default: {
+          if (d < '0' || d > '9') {
+            result += c;
+            break;
+          }
+          size_t k = d - '0', len = 1;
+          if (i + 2 < fmt.length() && '0' <= fmt[i+2] && fmt[i+2] <= '9') {
+            auto kk = k * 10 + (fmt[i+2] - '0');
+            if (kk < n) { k = kk; len = 2; }
+          }
+          if (k == 0 || k >= n) {
+            result += c;
+            break;
+          }
+          auto x = groups[k*2+0];
+          auto y = groups[k*2+1];
+          if (x >= 0 && y >= x) result.append(s, x, y - x);
+          i += len;
+          break;
+        }
+      }
+    }
+    last = b;
+    start = (b > a ? b : next_char_pos(s, b));
+  }
+  result.append(s, last, std::string::npos);
+  return Str::make(std::move(result));
+}
+
+auto RegExp::split(Str *str, int limit) -> Array* {
+  if (limit < 0) limit = 0;
+  if (limit > Array::MAX_SIZE) limit = Array::MAX_SIZE;
+  auto arr = Array::make();
+  if (!limit) return arr;
+
+  const auto &s = str->str();
+  std::vector<int> groups;
+  if (s.empty()) {
+    if (!search(s, 0, groups)) arr->push(str);
+    return arr;
+  }
+
+  size_t p = 0, q = 0;
+  while (q < s.length()) {
+    if (!search(s, q, groups)) break;
+    size_t a = groups[0];
+    size_t b = groups[1];
+    if (a >= s.length()) break;
+    if (b == p) {
+      q = next_char_pos(s, a);
+      continue;
+    }
+    arr->push(Str::make(s.c_str() + p, a - p));
+    if (arr->length() >= limit) return arr;
+    for (size_t i = 1; i < groups.size() / 2; i++) {
+      auto x = groups[i*2+0];
+      auto y = groups[i*2+1];
+      if (x >= 0 && y >= x) {
+        arr->push(Str::make(s.c_str() + x, y - x));
+      } else {
+        arr->push(Str::empty.get());
       }
+      if (arr->length() >= limit) return arr;
     }
+    p = q = b;
   }
 
-  return flags;
+  arr->push(Str::make(s.c_str() + p, s.length() - p));
+  return arr;
 }
 
 //
@@ -26,10 +26,13 @@
 #ifndef PJS_TYPES_HPP
 #define PJS_TYPES_HPP
 
+#include "regex.hpp"
+
 #include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <cmath>
+#include <cstddef>
 #include <cstring>
 #include <functional>
 #include <limits>
@@ -40,6 +43,7 @@
 #include <stdexcept>
 #include <string>
 #include <thread>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
@@ -215,6 +219,101 @@ private:
   Pool* m_pool;
 };
 
+//
+// Arena
+//
+// Objects of classes derived from ArenaResident are carved out of
+// blocks by bumping a pointer instead of coming from the pools. They
+// are made and dropped in bulk for every message, so all objects in a
+// block tend to go away together. They are still reference-counted and
+// deleted one by one, but deleting one only counts it off its block,
+// and a block is reused as a whole once all of its objects have gone.
+//
+// Every class has a lane of its own, whose blocks hold a small number
+// of objects of that class only. An object that outlives its message
+// still holds on to the few objects of its kind made next to it, so
+// classes that scripts tend to keep, such as message heads, are better
+// left to the pools. See test/benchmark/arena for the trade-off.
+//
+
+class ArenaResident {};
+
+class Arena : public RefCountMT<Arena> {
+public:
+  static auto lane(const char *c_name, size_t size) -> int;
+  static auto alloc(int lane) -> void*;
+  static void free(void *p);
+  static void clean();
+
+  static auto lane_count() -> int;
+  static auto lane_name(int lane) -> const std::string&;
+  static auto block_size(int lane) -> size_t;
+  static auto allocated(int lane) -> int;
+  static auto pooled(int lane) -> int;
+
+private:
+  enum {
+    MAX_LANES = 16,
+    BLOCK_SLOTS = 16,
+    BLOCK_BIAS = 0x40000000,
+  };
+
+  struct Block {
+    std::atomic<int> pending;
+    int lane;
+    Arena* arena;
+    Block* next;
+  };
+
+  union Head {
+    Block* block;
+    std::max_align_t align;
+  };
+
+  enum {
+    BLOCK_HEAD = (sizeof(Block) + sizeof(Head) - 1) / sizeof(Head) * sizeof(Head),
+  };
+
+  struct Lane {
+    Block* block = nullptr;
+    char* pointer = nullptr;
+    char* end = nullptr;
+    int count = 0;
+    int blocks = 0;
+    Block* spare_list = nullptr;
+    int spare_count = 0;
+    int spare_taken = 0;
+  };
+
+  //
+  // Arena::Holder
+  //
+
+  struct Holder {
+    Holder();
+    ~Holder();
+    Arena* arena;
+  };
+
+  Arena();
+  ~Arena();
+
+  Lane m_lanes[MAX_LANES];
+  std::atomic<Block*> m_return_list;
+
+  auto bump(int lane) -> void*;
+  void retire(Lane &lane);
+  void recycle(Block *block);
+  void add_return(Block *block);
+  void accept_returns();
+  void shutdown();
+
+  thread_local static Holder s_holder;
+  thread_local static Arena* s_current;
+
+  friend class RefCountMT<Arena>;
+};
+
 //
 // Pooled
 //
@@ -226,10 +325,25 @@ class Pooled : public Base {
 public:
   using Base::Base;
 
-  void* operator new(size_t) { return pool().alloc(); }
-  void operator delete(void *p) { pool().free(p); }
+  void* operator new(size_t) {
+    if (std::is_base_of<ArenaResident, T>::value) {
+      auto lane = arena_lane();
+      if (lane >= 0) return Arena::alloc(lane);
+    }
+    return pool().alloc();
+  }
+
+  void operator delete(void *p) {
+    if (std::is_base_of<ArenaResident, T>::value && arena_lane() >= 0) Arena::free(p);
+    else pool().free(p);
+  }
 
 private:
+  static auto arena_lane() -> int {
+    static int s_lane = Arena::lane(typeid(T).name(), sizeof(T));
+    return s_lane;
+  }
+
   static auto pool() -> Pool& {
     thread_local static PooledClass s_class(typeid(T).name(), sizeof(T));
     return s_class.pool();
@@ -804,6 +918,16 @@ public:
     auto size() const -> size_t { return m_str.length(); }
     auto length() const -> int { return m_length; }
 
+    auto hash() const -> size_t {
+      auto h = m_hash.load(std::memory_order_relaxed);
+      if (!h) {
+        std::hash<std::string> hash;
+        h = hash(m_str);
+        m_hash.store(h, std::memory_order_relaxed);
+      }
+      return h;
+    }
+
     auto pos_to_chr(int i) const -> int;
     auto chr_to_pos(int i) const -> int;
     auto chr_at(int i) const -> int;
@@ -817,6 +941,7 @@ public:
     const std::string m_str;
     int m_length;
     std::vector<uint32_t> m_chunks;
+    mutable std::atomic<size_t> m_hash;
 
     friend class RefCountMT<CharData>;
     friend class Str;
@@ -3578,6 +3703,7 @@ public:
   auto slice(int start, int end) -> Str*;
   auto split(Str *separator = nullptr) -> Array*;
   auto split(Str *separator, int limit) -> Array*;
+  auto split(RegExp *separator, int limit) -> Array*;
   bool startsWith(Str *search, int position = 0);
   auto substring(int start) -> Str*;
   auto substring(int start, int end) -> Str*;
@@ -3807,27 +3933,31 @@ public:
 
 class RegExp : public ObjectTemplate<RegExp> {
 public:
-  auto regex() const -> const std::regex& { return m_regex; }
-
   auto source() const -> Str* { return m_source; }
   bool global() const { return m_global; }
-  bool ignore_case() const { return m_regex.flags() & std::regex::icase; }
+  bool ignore_case() const { return m_ignore_case; }
   auto last_index() const -> int { return m_last_index; }
 
   auto exec(Str *str) -> Array*;
   bool test(Str *str);
+  auto match(Str *str) -> Array*;
+  auto search(Str *str) -> int;
+  auto replace(Str *str, Str *replacement) -> Str*;
+  auto split(Str *str, int limit) -> Array*;
 
 private:
   RegExp(Str *pattern);
   RegExp(Str *pattern, Str *flags);
 
   Ref<Str> m_source;
-  std::regex m_regex;
-  std::smatch m_match;
-  bool m_global;
+  std::unique_ptr<Regex> m_regex;
+  std::unique_ptr<std::regex> m_std_regex;
+  bool m_global = false;
+  bool m_ignore_case = false;
   int m_last_index = 0;
 
-  static auto chars_to_flags(Str *chars, bool &global) -> std::regex::flag_type;
+  void compile(Str *flags);
+  bool search(const std::string &str, size_t start, std::vector<int> &groups);
 
   friend class ObjectTemplate<RegExp>;
 };
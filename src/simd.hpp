@@ -0,0 +1,116 @@
+/*
+ *  Copyright (c) 2019 by flomesh.io
+ *
+ *  Unless prior written consent has been obtained from the copyright
+ *  owner, the following shall not be allowed.
+ *
+ *  1. The distribution of any source codes, header files, make files,
+ *     or libraries of the software.
+ *
+ *  2. Disclosure of any source codes pertaining to the software to any
+ *     additional parties.
+ *
+ *  3. Alteration or removal of any notices in or on the software or
+ *     within the documentation included within the software.
+ *
+ *  ALL SOURCE CODE AS WELL AS ALL DOCUMENTATION INCLUDED WITH THIS
+ *  SOFTWARE IS PROVIDED IN AN “AS IS” CONDITION, WITHOUT WARRANTY OF ANY
+ *  KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ *  CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ *  TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ *  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__AVX2__) || defined(__SSE2__))
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace pipy {
+namespace simd {
+
+//
+// Offset of the first byte equal to c, or n if there is none
+//
+
+inline auto find_byte(const char *p, size_t n, char c) -> size_t {
+  size_t i = 0;
+
+#if defined(__GNUC__) && defined(__AVX2__)
+  auto v32 = _mm256_set1_epi8(c);
+  for (; i + 32 <= n; i += 32) {
+    auto x = _mm256_loadu_si256((const __m256i*)(p + i));
+    auto m = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, v32));
+    if (m) return i + __builtin_ctz(m);
+  }
+#endif
+
+#if defined(__GNUC__) && defined(__SSE2__)
+  auto v16 = _mm_set1_epi8(c);
+  for (; i + 16 <= n; i += 16) {
+    auto x = _mm_loadu_si128((const __m128i*)(p + i));
+    auto m = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x, v16));
+    if (m) return i + __builtin_ctz(m);
+  }
+#elif defined(__GNUC__) && defined(__ARM_NEON)
+  auto v16 = vdupq_n_u8(uint8_t(c));
+  for (; i + 16 <= n; i += 16) {
+    auto eq = vceqq_u8(vld1q_u8((const uint8_t*)p + i), v16);
+    // Narrow the comparison down to 4 bits per byte to get a 64-bit mask
+    auto m = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+    if (m) return i + (__builtin_ctzll(m) >> 2);
+  }
+#endif
+
+  for (; i < n; i++) {
+    if (p[i] == c) return i;
+  }
+  return n;
+}
+
+//
+// Lower-cases ASCII letters from src into dst
+//
+
+inline void to_lower(const char *src, char *dst, size_t n) {
+  size_t i = 0;
+
+#if defined(__GNUC__) && defined(__SSE2__)
+  auto a = _mm_set1_epi8('A' - 1);
+  auto z = _mm_set1_epi8('Z' + 1);
+  auto d = _mm_set1_epi8(0x20);
+  for (; i + 16 <= n; i += 16) {
+    auto x = _mm_loadu_si128((const __m128i*)(src + i));
+    auto m = _mm_and_si128(_mm_cmpgt_epi8(x, a), _mm_cmplt_epi8(x, z));
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(x, _mm_and_si128(m, d)));
+  }
+#elif defined(__GNUC__) && defined(__ARM_NEON)
+  auto a = vdupq_n_u8('A');
+  auto r = vdupq_n_u8('Z' - 'A');
+  auto d = vdupq_n_u8(0x20);
+  for (; i + 16 <= n; i += 16) {
+    auto x = vld1q_u8((const uint8_t*)src + i);
+    auto m = vcleq_u8(vsubq_u8(x, a), r);
+    vst1q_u8((uint8_t*)dst + i, vorrq_u8(x, vandq_u8(m, d)));
+  }
+#endif
+
+  for (; i < n; i++) {
+    auto c = src[i];
+    dst[i] = ('A' <= c && c <= 'Z') ? c + 0x20 : c;
+  }
+}
+
+} // namespace simd
+} // namespace pipy
+
+#endif // SIMD_HPP
@@ -26,8 +26,20 @@
 #include "socket.hpp"
 #include "log.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <errno.h>
 
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace pipy {
 
 using tcp = asio::ip::tcp;
@@ -77,21 +89,72 @@ void SocketBase::log_error(const char *msg) {
   }
 }
 
+auto SocketBase::check_timeout(uint64_t tick_read, uint64_t tick_write, double &wait) const -> StreamEnd::Error {
+  auto now = TimerWheel::get()->now();
+  auto r = (now - tick_read) / 1000.0;
+  auto w = (now - tick_write) / 1000.0;
+
+  wait = 0;
+
+  if (m_options.idle_timeout > 0) {
+    auto t = m_options.idle_timeout;
+    if (r >= t && w >= t) return StreamEnd::IDLE_TIMEOUT;
+    wait = t - std::min(r, w);
+  }
+
+  if (m_options.read_timeout > 0) {
+    auto t = m_options.read_timeout;
+    if (r >= t) return StreamEnd::READ_TIMEOUT;
+    if (wait <= 0 || t - r < wait) wait = t - r;
+  }
+
+  if (m_options.write_timeout > 0) {
+    auto t = m_options.write_timeout;
+    if (w >= t) return StreamEnd::WRITE_TIMEOUT;
+    if (wait <= 0 || t - w < wait) wait = t - w;
+  }
+
+  return StreamEnd::NO_ERROR;
+}
+
 //
 // SocketTCP
 //
 
 Data::Producer SocketTCP::s_dp("TCP Socket");
 
+#ifdef __linux__
+thread_local size_t SocketTCP::s_zero_copy_traffic = 0;
+#endif
+
+auto SocketTCP::zero_copy_traffic() -> size_t {
+#ifdef __linux__
+  auto n = s_zero_copy_traffic;
+  s_zero_copy_traffic = 0;
+  return n;
+#else
+  return 0;
+#endif
+}
+
 SocketTCP::~SocketTCP() {
-  Ticker::get()->unwatch(this);
+#ifdef __linux__
+  splice_unlink();
+#endif
 }
 
 void SocketTCP::open() {
   m_socket.set_option(asio::socket_base::keep_alive(m_options.keep_alive));
   m_socket.set_option(tcp::no_delay(m_options.no_delay));
 
-  auto t = Ticker::get()->tick();
+#ifdef __linux__
+  if (m_options.zero_copy_threshold > 0) {
+    int one = 1;
+    m_zero_copy = !setsockopt(m_socket.native_handle(), SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+  }
+#endif
+
+  auto t = TimerWheel::get()->now();
   m_tick_read = t;
   m_tick_write = t;
   m_state = OPEN;
@@ -107,7 +170,14 @@ void SocketTCP::open() {
   }
 
   receive();
-  Ticker::get()->watch(this);
+
+#ifdef __linux__
+  if (m_splice_peer) m_splice_peer->splice_pump();
+#endif
+
+  double wait;
+  check_timeout(t, t, wait);
+  if (wait > 0) TimerWheel::Entry::arm(wait);
 }
 
 void SocketTCP::output(Event *evt) {
@@ -142,6 +212,19 @@ void SocketTCP::close() {
   close_async();
 }
 
+void SocketTCP::splice(SocketTCP *peer) {
+#ifdef __linux__
+#ifdef PIPY_USE_IO_URING
+  if (IOUring::get()) return;
+#endif
+  if (m_splice_peer || peer->m_splice_peer) return;
+  if (m_state == CLOSED || peer->m_state == CLOSED) return;
+  m_splice_peer = peer;
+  peer->m_splice_peer = this;
+  log_debug("socket spliced");
+#endif
+}
+
 void SocketTCP::bind(const std::string &ip, int port) {
   tcp::endpoint ep(asio::ip::make_address(ip), port);
   m_socket.bind(ep);
@@ -152,7 +235,22 @@ void SocketTCP::receive() {
   if (m_receiving) return;
   if (m_paused) return;
 
-  m_buffer_receive.push(Data(RECEIVE_BUFFER_SIZE, &s_dp));
+#ifdef PIPY_USE_IO_URING
+  if (auto *ring = IOUring::get()) {
+    ring->receive(m_socket.native_handle(), &m_ring_receiver);
+    m_receiving = true;
+    return;
+  }
+#endif
+
+#ifdef __linux__
+  if (m_splice_peer) {
+    splice_pump();
+    return;
+  }
+#endif
+
+  m_buffer_receive.push(Data(m_receive_size, &s_dp));
   m_socket.async_read_some(
     DataChunks(m_buffer_receive.chunks()),
     ReceiveHandler(this)
@@ -187,6 +285,28 @@ void SocketTCP::send() {
     std::cerr << m_buffer_send.size() << std::endl;
   }
 
+#ifdef PIPY_USE_IO_URING
+  if (auto *ring = IOUring::get()) {
+    if (!m_ring_sender) m_ring_sender.reset(new RingSender(this));
+    ring->send(m_socket.native_handle(), m_ring_sender->prepare(m_buffer_send), m_ring_sender.get());
+    m_sending = true;
+    return;
+  }
+#endif
+
+#ifdef __linux__
+  if (m_zero_copy && m_buffer_send.size() >= m_options.zero_copy_threshold) {
+    m_socket.async_send(
+      DataChunks(m_buffer_send.chunks()),
+      MSG_ZEROCOPY,
+      SendHandler(this)
+    );
+    m_sending = true;
+    m_zero_copy_sending = true;
+    return;
+  }
+#endif
+
   m_socket.async_write_some(
     DataChunks(m_buffer_send.chunks()),
     SendHandler(this)
@@ -208,6 +328,28 @@ void SocketTCP::shutdown_socket() {
 }
 
 void SocketTCP::close_socket() {
+#ifdef PIPY_USE_IO_URING
+  if (auto *ring = IOUring::get()) {
+    if (m_receiving) ring->cancel(&m_ring_receiver);
+    if (m_sending) ring->cancel(m_ring_sender.get());
+  }
+#endif
+
+#ifdef __linux__
+  if (m_zero_copy_sending || !m_zero_copy_sends.empty()) {
+    if (!m_zero_copy_lingering && m_socket.is_open()) {
+      std::error_code ec;
+      m_socket.shutdown(tcp::socket::shutdown_receive, ec);
+      m_zero_copy_lingering = true;
+      if (m_options.idle_timeout > 0) {
+        TimerWheel::Entry::arm(m_options.idle_timeout);
+      }
+      log_debug("socket lingering for zero-copy completions");
+    }
+    return;
+  }
+#endif
+
   if (m_socket.is_open()) {
     std::error_code ec;
     m_socket.close(ec);
@@ -223,8 +365,19 @@ void SocketTCP::close_async() {
   if (m_closed) return;
   if (m_receiving) return;
   if (m_sending) return;
+#ifdef __linux__
+  if (m_zero_copy_waiting) return;
+  if (m_zero_copy_lingering) return;
+  if (m_splice_reading) return;
+  if (m_splice_writing) return;
+  if (m_splice_posted) return;
+#endif
   if (m_state != CLOSED) return;
   m_closed = true;
+  TimerWheel::Entry::disarm();
+#ifdef __linux__
+  splice_unlink();
+#endif
   if (m_opened) on_socket_close();
 }
 
@@ -241,33 +394,22 @@ void SocketTCP::on_flush() {
   send();
 }
 
-void SocketTCP::on_tick(double tick) {
-  auto r = tick - m_tick_read;
-  auto w = tick - m_tick_write;
-
-  if (m_options.idle_timeout > 0) {
-    auto t = m_options.idle_timeout;
-    if (r >= t && w >= t) {
-      on_socket_input(StreamEnd::make(StreamEnd::IDLE_TIMEOUT));
-      close();
-      return;
-    }
-  }
-
-  if (m_options.read_timeout > 0) {
-    if (r >= m_options.read_timeout) {
-      on_socket_input(StreamEnd::make(StreamEnd::READ_TIMEOUT));
-      close();
-      return;
-    }
+void SocketTCP::on_expire() {
+#ifdef __linux__
+  if (m_zero_copy_lingering) {
+    zero_copy_abort();
+    close_async();
+    return;
   }
-
-  if (m_options.write_timeout > 0) {
-    if (w >= m_options.write_timeout) {
-      on_socket_input(StreamEnd::make(StreamEnd::WRITE_TIMEOUT));
-      close();
-      return;
-    }
+#endif
+  if (m_state == CLOSED) return;
+  double wait;
+  auto err = check_timeout(m_tick_read, m_tick_write, wait);
+  if (err != StreamEnd::NO_ERROR) {
+    on_socket_input(StreamEnd::make(err));
+    close();
+  } else if (wait > 0) {
+    TimerWheel::Entry::arm(wait);
   }
 }
 
@@ -275,14 +417,22 @@ void SocketTCP::on_receive(const std::error_code &ec, std::size_t n) {
   InputContext ic(this);
 
   m_receiving = false;
-  m_tick_read = Ticker::get()->tick();
+  m_tick_read = TimerWheel::get()->now();
 
   if (ec != asio::error::operation_aborted && m_state != CLOSED) {
     if (n > 0) {
-      m_buffer_receive.pop(m_buffer_receive.size() - n);
+      auto capacity = m_buffer_receive.size();
+      m_buffer_receive.pop(capacity - n);
       auto size = m_buffer_receive.size();
       m_traffic_read += size;
 
+      // Size the next read after this one so that an idle connection
+      // only holds a small buffer while bulk transfers move up to full ones
+      m_receive_size = std::min(
+        Data::chunk_size(n < capacity ? n : n + 1),
+        int(RECEIVE_BUFFER_SIZE)
+      );
+
       if (Log::is_enabled(Log::TCP)) {
         std::cerr << Log::format_elapsed_time();
         std::cerr << (m_is_inbound ? " tcp >>>> recv " : " tcp recv <<<< ");
@@ -293,27 +443,7 @@ void SocketTCP::on_receive(const std::error_code &ec, std::size_t n) {
     }
 
     if (ec) {
-      if (ec == asio::error::eof) {
-        log_debug("EOF from peer");
-        on_socket_input(StreamEnd::make());
-        if (m_state == OPEN) {
-          m_state = HALF_CLOSED_REMOTE;
-        } else if (m_state == HALF_CLOSED_LOCAL) {
-          m_state = CLOSED;
-          close_socket();
-        }
-      } else if (ec == asio::error::connection_reset) {
-        log_warn("connection reset by peer", ec);
-        on_socket_input(StreamEnd::make(StreamEnd::CONNECTION_RESET));
-        m_state = CLOSED;
-        close_socket();
-      } else {
-        log_warn("error reading from peer", ec);
-        on_socket_input(StreamEnd::make(StreamEnd::READ_ERROR));
-        m_state = CLOSED;
-        close_socket();
-      }
-
+      on_receive_end(ec);
     } else {
       receive();
     }
@@ -322,12 +452,52 @@ void SocketTCP::on_receive(const std::error_code &ec, std::size_t n) {
   close_async();
 }
 
+void SocketTCP::on_receive_end(const std::error_code &ec) {
+  if (ec == asio::error::eof) {
+    log_debug("EOF from peer");
+    on_socket_input(StreamEnd::make());
+    if (m_state == OPEN) {
+      m_state = HALF_CLOSED_REMOTE;
+    } else if (m_state == HALF_CLOSED_LOCAL) {
+      m_state = CLOSED;
+      close_socket();
+    }
+  } else if (ec == asio::error::connection_reset) {
+    log_warn("connection reset by peer", ec);
+    on_socket_input(StreamEnd::make(StreamEnd::CONNECTION_RESET));
+    m_state = CLOSED;
+    close_socket();
+  } else {
+    log_warn("error reading from peer", ec);
+    on_socket_input(StreamEnd::make(StreamEnd::READ_ERROR));
+    m_state = CLOSED;
+    close_socket();
+  }
+}
+
 void SocketTCP::on_send(const std::error_code &ec, std::size_t n) {
   m_sending = false;
-  m_tick_write = Ticker::get()->tick();
+  m_tick_write = TimerWheel::get()->now();
 
+#ifdef __linux__
+  if (m_zero_copy_sending) {
+    m_zero_copy_sending = false;
+    if (n > 0) {
+      m_buffer_send.shift(n, m_buffer_zero_copy);
+      m_zero_copy_sends.push_back({ n, false });
+      s_zero_copy_traffic += n;
+      zero_copy_wait();
+    } else if (m_zero_copy_lingering && m_zero_copy_sends.empty()) {
+      m_zero_copy_lingering = false;
+      close_socket();
+    }
+  } else
+#endif
   if (ec != asio::error::operation_aborted && m_state != CLOSED) {
     m_buffer_send.shift(n);
+  }
+
+  if (ec != asio::error::operation_aborted && m_state != CLOSED) {
     m_traffic_write += n;
 
     auto limit = m_options.congestion_limit;
@@ -355,6 +525,11 @@ void SocketTCP::on_send(const std::error_code &ec, std::size_t n) {
           }
         }
       }
+#ifdef __linux__
+      else if (m_splice_peer) {
+        m_splice_peer->splice_pump();
+      }
+#endif
 
     } else {
       send();
@@ -364,20 +539,357 @@ void SocketTCP::on_send(const std::error_code &ec, std::size_t n) {
   close_async();
 }
 
+#ifdef __linux__
+
+void SocketTCP::zero_copy_wait() {
+  if (!m_zero_copy_waiting) {
+    m_socket.async_wait(tcp::socket::wait_error, ZeroCopyHandler(this));
+    m_zero_copy_waiting = true;
+
+    // Completions queued before the wait was armed won't wake it up
+    zero_copy_reap();
+  }
+}
+
+void SocketTCP::zero_copy_reap() {
+  auto sock = m_socket.native_handle();
+  char control[CMSG_SPACE(sizeof(sock_extended_err) + sizeof(sockaddr_in6))];
+  for (;;) {
+    msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(sock, &msg, MSG_ERRQUEUE) < 0) break;
+    for (auto *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+      if (
+        !(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+        !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)
+      ) continue;
+      auto *ee = (const sock_extended_err*)CMSG_DATA(cm);
+      if (ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY || ee->ee_errno != 0) continue;
+
+      // The kernel ended up copying, which makes zero-copy a loss on this socket
+      if (ee->ee_code == SO_EE_CODE_ZEROCOPY_COPIED) m_zero_copy = false;
+
+      for (auto id = ee->ee_info;; id++) {
+        auto i = id - m_zero_copy_id;
+        if (i < m_zero_copy_sends.size()) m_zero_copy_sends[i].done = true;
+        if (id == ee->ee_data) break;
+      }
+    }
+  }
+
+  bool progress = false;
+  while (!m_zero_copy_sends.empty() && m_zero_copy_sends.front().done) {
+    m_buffer_zero_copy.shift(m_zero_copy_sends.front().size);
+    m_zero_copy_sends.pop_front();
+    m_zero_copy_id++;
+    progress = true;
+  }
+
+  if (progress && m_zero_copy_lingering) {
+    if (m_zero_copy_sends.empty() && !m_zero_copy_sending) {
+      m_zero_copy_lingering = false;
+      close_socket();
+    } else if (m_options.idle_timeout > 0) {
+      TimerWheel::Entry::arm(m_options.idle_timeout);
+    }
+  }
+}
+
+void SocketTCP::zero_copy_abort() {
+  log_debug("socket lingered too long for zero-copy completions");
+
+  // After an abortive close the kernel no longer refers to
+  // any of the chunks, so they can be released right away
+  if (m_socket.is_open()) {
+    std::error_code ec;
+    m_socket.set_option(asio::socket_base::linger(true, 0), ec);
+    m_socket.close(ec);
+  }
+
+  m_zero_copy_sends.clear();
+  m_buffer_zero_copy.clear();
+  m_zero_copy_lingering = false;
+}
+
+void SocketTCP::on_zero_copy(const std::error_code &ec) {
+  m_zero_copy_waiting = false;
+
+  if (ec != asio::error::operation_aborted) {
+    zero_copy_reap();
+    if (!m_zero_copy_sends.empty()) zero_copy_wait();
+  }
+
+  close_async();
+}
+
+void SocketTCP::splice_pump() {
+  auto peer = m_splice_peer;
+  if (!peer) return;
+  if (m_state != OPEN && m_state != HALF_CLOSED_LOCAL) return;
+  if (m_receiving || m_paused) return;
+
+  // Only take over once everything sent through the pipeline has gone out
+  if (peer->m_state != OPEN && peer->m_state != HALF_CLOSED_REMOTE) return;
+  if (peer->m_sending || peer->m_eos || !peer->m_buffer_send.empty()) return;
+
+  if (m_splice_pipe[0] < 0 && pipe2(m_splice_pipe, O_NONBLOCK | O_CLOEXEC)) {
+    log_warn("cannot create pipe for splicing", std::error_code(errno, std::system_category()));
+    splice_unlink();
+    receive();
+    return;
+  }
+
+  auto src = m_socket.native_handle();
+  auto dst = peer->m_socket.native_handle();
+
+  // Readiness is edge-triggered, so every wait is armed before
+  // the call that gets EAGAIN is retried, or else a wake-up could be lost
+  for (int i = 0; i < 16; i++) {
+    if (m_splice_pipe_size > 0) {
+      auto n = ::splice(m_splice_pipe[0], nullptr, dst, nullptr, m_splice_pipe_size, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      if (n > 0) {
+        m_splice_pipe_size -= n;
+        peer->m_traffic_write += n;
+        peer->m_tick_write = TimerWheel::get()->now();
+      } else if (n == 0 || errno == EAGAIN) {
+        if (peer->m_splice_writing) return;
+        peer->m_socket.async_wait(tcp::socket::wait_write, SpliceWriteHandler(peer));
+        peer->m_splice_writing = true;
+      } else if (errno != EINTR) {
+        peer->log_warn("error writing to peer", std::error_code(errno, std::system_category()));
+        peer->m_state = CLOSED;
+        peer->close_socket();
+        peer->splice_post();
+        return;
+      }
+
+    } else {
+      auto n = ::splice(src, nullptr, m_splice_pipe[1], nullptr, SPLICE_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      if (n > 0) {
+        m_splice_pipe_size += n;
+        m_traffic_read += n;
+        m_tick_read = TimerWheel::get()->now();
+        if (Log::is_enabled(Log::TCP)) {
+          std::cerr << Log::format_elapsed_time();
+          std::cerr << (m_is_inbound ? " tcp >>>> splice " : " tcp splice <<<< ");
+          std::cerr << n << std::endl;
+        }
+      } else if (n < 0 && errno == EAGAIN) {
+        if (m_splice_reading) return;
+        m_socket.async_wait(tcp::socket::wait_read, SpliceReadHandler(this));
+        m_splice_reading = true;
+      } else if (n == 0 || errno != EINTR) {
+        InputContext ic(this);
+        on_receive_end(n == 0 ? std::error_code(asio::error::eof) : std::error_code(errno, std::system_category()));
+        if (m_state == CLOSED) splice_post();
+        return;
+      }
+    }
+  }
+
+  // Give other sockets on this thread a turn
+  splice_post();
+}
+
+void SocketTCP::splice_unlink() {
+  if (auto peer = m_splice_peer) {
+    m_splice_peer = nullptr;
+    peer->m_splice_peer = nullptr;
+    peer->receive();
+  }
+  for (auto &fd : m_splice_pipe) {
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+  m_splice_pipe_size = 0;
+}
+
+void SocketTCP::splice_post() {
+  if (!m_splice_posted) {
+    asio::post(m_socket.get_executor(), SplicePostHandler(this));
+    m_splice_posted = true;
+  }
+}
+
+void SocketTCP::on_splice_read(const std::error_code &ec) {
+  m_splice_reading = false;
+
+  if (ec != asio::error::operation_aborted && m_state != CLOSED) {
+    receive();
+  }
+
+  close_async();
+}
+
+void SocketTCP::on_splice_write(const std::error_code &ec) {
+  m_splice_writing = false;
+
+  if (ec != asio::error::operation_aborted && m_state != CLOSED) {
+    if (auto peer = m_splice_peer) {
+      peer->splice_pump();
+    }
+  }
+
+  close_async();
+}
+
+void SocketTCP::on_splice_post() {
+  m_splice_posted = false;
+
+  if (m_state != CLOSED) {
+    receive();
+  }
+
+  close_async();
+}
+
+#endif // __linux__
+
+#ifdef PIPY_USE_IO_URING
+
+void SocketTCP::on_ring_receive(int result, Data *data) {
+  InputContext ic(this);
+
+  m_receiving = false;
+  m_tick_read = TimerWheel::get()->now();
+
+  if (result != -ECANCELED && m_state != CLOSED) {
+    if (result > 0) {
+      m_traffic_read += result;
+
+      if (Log::is_enabled(Log::TCP)) {
+        std::cerr << Log::format_elapsed_time();
+        std::cerr << (m_is_inbound ? " tcp >>>> recv " : " tcp recv <<<< ");
+        std::cerr << result << std::endl;
+      }
+
+      on_socket_input(Data::make(std::move(*data)));
+    }
+
+    if (result == 0) {
+      on_receive_end(asio::error::eof);
+    } else if (result < 0 && result != -ENOBUFS) {
+      on_receive_end(std::error_code(-result, std::system_category()));
+    } else {
+      receive();
+    }
+  }
+
+  close_async();
+}
+
+void SocketTCP::on_ring_send(int result) {
+  if (result < 0) {
+    on_send(std::error_code(-result, std::system_category()), 0);
+  } else {
+    on_send(std::error_code(), result);
+  }
+}
+
+auto SocketTCP::RingSender::prepare(const Data &data) -> const msghdr* {
+  int n = 0;
+  for (const auto c : data.chunks()) {
+    m_iov[n].iov_base = std::get<0>(c);
+    m_iov[n].iov_len = std::get<1>(c);
+    if (++n == MAX_IOVECS) break;
+  }
+  std::memset(&m_msg, 0, sizeof(m_msg));
+  m_msg.msg_iov = m_iov;
+  m_msg.msg_iovlen = n;
+  return &m_msg;
+}
+
+#endif // PIPY_USE_IO_URING
+
 //
 // SocketUDP
 //
 
 Data::Producer SocketUDP::s_dp("UDP Socket");
 
+#ifdef __linux__
+
+//
+// SocketUDP::Batch
+//
+
+struct SocketUDP::Batch {
+  enum {
+    MAX_SEGMENTS = 64,
+    MAX_SEGMENTED_SIZE = 0xff00,
+    CONTROL_SIZE = CMSG_SPACE(sizeof(int)),
+  };
+
+  struct Send {
+    Data* data;
+    udp::endpoint endpoint;
+    bool connected;
+  };
+
+  std::vector<mmsghdr> headers;
+  std::vector<iovec> iovecs;
+  std::vector<size_t> offsets;
+  std::vector<size_t> counts;
+  std::vector<udp::endpoint> endpoints;
+  std::vector<Data> buffers;
+  std::vector<char> control;
+  std::deque<Send> sends;
+  int buffer_size = RECEIVE_BUFFER_SIZE;
+  size_t receive_count = 1;
+  bool gso = false;
+
+  Batch(int size)
+    : headers(size)
+    , iovecs(size)
+    , offsets(size)
+    , counts(size)
+    , endpoints(size)
+    , buffers(size)
+    , control(size * CONTROL_SIZE) {}
+
+  ~Batch() {
+    clear();
+  }
+
+  void clear() {
+    for (const auto &s : sends) s.data->release();
+    sends.clear();
+  }
+};
+
+#endif // __linux__
+
 SocketUDP::~SocketUDP() {
-  Ticker::get()->unwatch(this);
+#ifdef __linux__
+  delete m_batch;
+#endif
 }
 
 void SocketUDP::open() {
   m_endpoint = m_socket.local_endpoint();
   m_opened = true;
 
+#ifdef __linux__
+  if (m_options.batch_size > 1) {
+    if (!m_batch) m_batch = new Batch(std::min(m_options.batch_size, int(UIO_MAXIOV)));
+    auto sock = m_socket.native_handle();
+#ifdef UDP_GRO
+    int one = 1;
+    if (!setsockopt(sock, SOL_UDP, UDP_GRO, &one, sizeof(one))) {
+      m_batch->buffer_size = DATA_CHUNK_SIZE_MAX;
+    }
+#endif
+#ifdef UDP_SEGMENT
+    int zero = 0;
+    m_batch->gso = !setsockopt(sock, SOL_UDP, UDP_SEGMENT, &zero, sizeof(zero));
+#endif
+  }
+#endif
+
   if (!m_buffer.empty()) {
     m_buffer.flush(
       [this](Event *evt) {
@@ -389,10 +901,12 @@ void SocketUDP::open() {
   }
 
   receive();
-  Ticker::get()->watch(this);
 }
 
 void SocketUDP::close() {
+#ifdef __linux__
+  if (m_batch && !m_closing) send_batch();
+#endif
   m_closing = true;
   close_peers();
   close_socket();
@@ -419,21 +933,33 @@ void SocketUDP::bind(const std::string &ip, int port) {
 void SocketUDP::output(Event *evt, Peer *peer) {
   if (auto data = evt->as<Data>()) {
     if (!data->empty()) {
-      peer->m_tick_write = Ticker::get()->tick();
+      peer->m_tick_write = TimerWheel::get()->now();
       send(data, peer->m_endpoint);
     }
   } else if (evt->is<StreamEnd>()) {
     m_peers.erase(peer->m_endpoint);
     peer->m_socket = nullptr;
+    peer->disarm();
     peer->close();
   }
 }
 
 void SocketUDP::receive() {
   if (m_closing) return;
-  if (m_receiving) return;
   if (m_paused) return;
 
+#ifdef __linux__
+  if (m_batch) {
+    if (!m_receive_posted) {
+      asio::post(m_socket.get_executor(), BatchPostHandler(this));
+      m_receive_posted = true;
+    }
+    return;
+  }
+#endif
+
+  if (m_receiving) return;
+
   auto *buf = Data::make(RECEIVE_BUFFER_SIZE, &s_dp);
   buf->retain();
 
@@ -459,17 +985,26 @@ void SocketUDP::send(Data *data) {
     std::cerr << data->size() << std::endl;
   }
 
+#ifdef __linux__
+  if (m_batch) {
+    m_batch->sends.push_back({ data, udp::endpoint(), true });
+    if (InputContext::origin()) FlushTarget::need_flush(); else send_batch();
+  } else
+#endif
   m_socket.async_send(
     DataChunks(data->chunks()),
     SendHandler(this, data)
   );
 
-  auto t = Ticker::get()->tick();
+  auto t = TimerWheel::get()->now();
   m_tick_write = t;
 
   if (!m_sending) {
     m_sending = true;
     m_tick_read = t;
+    double wait;
+    check_timeout(t, t, wait);
+    if (wait > 0) TimerWheel::Entry::arm(wait);
   }
 }
 
@@ -486,6 +1021,14 @@ void SocketUDP::send(Data *data, const asio::ip::udp::endpoint &endpoint) {
     std::cerr << data->size() << std::endl;
   }
 
+#ifdef __linux__
+  if (m_batch) {
+    m_batch->sends.push_back({ data, endpoint, false });
+    if (InputContext::origin()) FlushTarget::need_flush(); else send_batch();
+    return;
+  }
+#endif
+
   m_socket.async_send_to(
     DataChunks(data->chunks()),
     endpoint,
@@ -493,18 +1036,68 @@ void SocketUDP::send(Data *data, const asio::ip::udp::endpoint &endpoint) {
   );
 }
 
+void SocketUDP::dispatch(Data *data, const asio::ip::udp::endpoint &from) {
+  auto size = data->size();
+  m_traffic_read += size;
+
+  if (Log::is_enabled(Log::UDP)) {
+    std::cerr << Log::format_elapsed_time();
+    std::cerr << (m_is_inbound ? " udp >>>> recv " : " udp recv <<<< ");
+    std::cerr << size << std::endl;
+  }
+
+  Peer *peer = nullptr;
+  auto i = m_peers.find(from);
+  if (i == m_peers.end()) {
+    peer = on_socket_new_peer();
+    if (peer) {
+      peer->m_socket = this;
+      peer->m_endpoint = from;
+      peer->m_tick_write = TimerWheel::get()->now();
+      m_peers[from] = peer;
+      peer->on_peer_open();
+      if (peer->m_closed) {
+        peer->on_peer_close();
+        peer = nullptr;
+      } else {
+        peer->m_opened = true;
+        double wait;
+        check_timeout(peer->m_tick_write, peer->m_tick_write, wait);
+        if (wait > 0) peer->arm(wait);
+      }
+    }
+  } else {
+    peer = i->second;
+  }
+
+  if (peer) {
+    peer->m_tick_read = TimerWheel::get()->now();
+    peer->on_peer_input(data);
+  } else {
+    on_socket_input(data);
+  }
+}
+
 void SocketUDP::close_peers(StreamEnd::Error err) {
   InputContext ic;
   std::map<asio::ip::udp::endpoint, Peer*> peers(std::move(m_peers));
   for (const auto &pair : peers) {
     auto p = pair.second;
     p->m_socket = nullptr;
+    p->disarm();
     p->on_peer_input(StreamEnd::make(err));
     p->close();
   }
 }
 
 void SocketUDP::close_socket() {
+#ifdef __linux__
+  if (m_batch) {
+    m_sending_count -= m_batch->sends.size();
+    m_batch->clear();
+  }
+#endif
+
   if (m_socket.is_open()) {
     std::error_code ec;
     m_socket.close(ec);
@@ -520,8 +1113,13 @@ void SocketUDP::close_async() {
   if (m_closed) return;
   if (m_receiving) return;
   if (m_sending_count > 0) return;
+#ifdef __linux__
+  if (m_receive_posted) return;
+  if (m_batch_writing) return;
+#endif
   if (m_closing) {
     m_closed = true;
+    TimerWheel::Entry::disarm();
     if (m_opened) on_socket_close();
   }
 }
@@ -535,42 +1133,24 @@ void SocketUDP::on_tap_close() {
   m_paused = true;
 }
 
-void SocketUDP::on_tick(double tick) {
-  if (m_sending) {
-    const auto &options = m_options;
-    auto r = tick - m_tick_read;
-    auto w = tick - m_tick_write;
-
-    if (options.idle_timeout > 0) {
-      auto t = options.idle_timeout;
-      if (r >= t && w >= t) {
-        on_socket_input(StreamEnd::make(StreamEnd::IDLE_TIMEOUT));
-        close();
-        return;
-      }
-    }
-
-    if (options.read_timeout > 0) {
-      if (r >= options.read_timeout) {
-        on_socket_input(StreamEnd::make(StreamEnd::READ_TIMEOUT));
-        close();
-        return;
-      }
-    }
-
-    if (options.write_timeout > 0) {
-      if (w >= options.write_timeout) {
-        on_socket_input(StreamEnd::make(StreamEnd::WRITE_TIMEOUT));
-        close();
-        return;
-      }
-    }
+void SocketUDP::on_flush() {
+#ifdef __linux__
+  if (m_batch && !m_closing) {
+    send_batch();
+    close_async();
   }
+#endif
+}
 
-  auto i = m_peers.begin();
-  while (i != m_peers.end()) {
-    auto p = i->second; i++;
-    p->tick(tick);
+void SocketUDP::on_expire() {
+  if (m_closing) return;
+  double wait;
+  auto err = check_timeout(m_tick_read, m_tick_write, wait);
+  if (err != StreamEnd::NO_ERROR) {
+    on_socket_input(StreamEnd::make(err));
+    close();
+  } else if (wait > 0) {
+    TimerWheel::Entry::arm(wait);
   }
 }
 
@@ -578,47 +1158,13 @@ void SocketUDP::on_receive(Data *data, const std::error_code &ec, std::size_t n)
   InputContext ic(this);
 
   m_receiving = false;
-  m_tick_read = Ticker::get()->tick();
+  m_tick_read = TimerWheel::get()->now();
 
   if (ec != asio::error::operation_aborted && !m_closing) {
     if (n > 0) {
       data->pop(data->size() - n);
-      auto size = data->size();
-      m_traffic_read += size;
-
-      if (Log::is_enabled(Log::UDP)) {
-        std::cerr << Log::format_elapsed_time();
-        std::cerr << (m_is_inbound ? " udp >>>> recv " : " udp recv <<<< ");
-        std::cerr << size << std::endl;
-      }
-
-      Peer *peer = nullptr;
-      auto i = m_peers.find(m_from);
-      if (i == m_peers.end()) {
-        peer = on_socket_new_peer();
-        if (peer) {
-          peer->m_socket = this;
-          peer->m_endpoint = m_from;
-          peer->m_tick_write = Ticker::get()->tick();
-          m_peers[m_from] = peer;
-          peer->on_peer_open();
-          if (peer->m_closed) {
-            peer->on_peer_close();
-            peer = nullptr;
-          } else {
-            peer->m_opened = true;
-          }
-        }
-      } else {
-        peer = i->second;
-      }
-
-      if (peer) {
-        peer->m_tick_read = Ticker::get()->tick();
-        peer->on_peer_input(data);
-      } else {
-        on_socket_input(data);
-      }
+      data->shrink(&s_dp);
+      dispatch(data, m_from);
     }
 
     if (ec) {
@@ -660,44 +1206,262 @@ void SocketUDP::on_send(Data *data, const std::error_code &ec, std::size_t n) {
   close_async();
 }
 
-//
-// SocketUDP::Peer
-//
+#ifdef __linux__
+
+void SocketUDP::receive_batch() {
+  auto &b = *m_batch;
+  auto sock = m_socket.native_handle();
+  auto size = b.buffer_size;
+
+  // Readiness is edge-triggered, so the wait is armed before
+  // the call that got EAGAIN is retried, or else a wake-up could be lost
+  for (int round = 0; round < 16; round++) {
+    if (m_closing || m_paused) return;
+
+    // Buffers are added as the traffic grows, so that a socket
+    // only seeing a few datagrams doesn't hold a full batch of them
+    auto n = b.receive_count;
+    if (b.iovecs.size() < n) b.iovecs.resize(n);
+    for (size_t i = 0; i < n; i++) {
+      auto &buf = b.buffers[i];
+      if (buf.empty()) buf = Data(size, &s_dp);
+      auto chunk = *buf.chunks().begin();
+      auto &iov = b.iovecs[i];
+      iov.iov_base = std::get<0>(chunk);
+      iov.iov_len = std::get<1>(chunk);
+      auto &msg = b.headers[i].msg_hdr;
+      msg.msg_name = b.endpoints[i].data();
+      msg.msg_namelen = b.endpoints[i].capacity();
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = &b.control[i * Batch::CONTROL_SIZE];
+      msg.msg_controllen = Batch::CONTROL_SIZE;
+      msg.msg_flags = 0;
+    }
 
-void SocketUDP::Peer::tick(double t) {
-  const auto &options = m_socket->m_options;
+    auto r = recvmmsg(sock, b.headers.data(), n, MSG_DONTWAIT, nullptr);
+    if (r < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (m_receiving) return;
+        m_socket.async_wait(udp::socket::wait_read, BatchReceiveHandler(this));
+        m_receiving = true;
+        continue;
+      }
+      InputContext ic(this);
+      log_warn("error reading from peers", std::error_code(errno, std::system_category()));
+      m_closing = true;
+      close_peers(StreamEnd::READ_ERROR);
+      close_socket();
+      return;
+    }
 
-  auto r = t - m_tick_read;
-  auto w = t - m_tick_write;
+    if (size_t(r) == n && n < b.headers.size()) {
+      b.receive_count = std::min(n * 2, b.headers.size());
+    }
 
-  if (options.idle_timeout > 0) {
-    auto t = options.idle_timeout;
-    if (r >= t && w >= t) {
-      m_socket->m_peers.erase(m_endpoint);
-      m_socket = nullptr;
-      on_peer_input(StreamEnd::make(StreamEnd::IDLE_TIMEOUT));
-      close();
-      return;
+    InputContext ic(this);
+    m_tick_read = TimerWheel::get()->now();
+
+    for (int i = 0; i < r && !m_closing; i++) {
+      auto &hdr = b.headers[i];
+      auto &from = b.endpoints[i];
+      from.resize(hdr.msg_hdr.msg_namelen);
+      int len = hdr.msg_len;
+      int seg = len;
+
+#ifdef UDP_GRO
+      for (auto *cm = CMSG_FIRSTHDR(&hdr.msg_hdr); cm; cm = CMSG_NXTHDR(&hdr.msg_hdr, cm)) {
+        if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+          int gso_size;
+          std::memcpy(&gso_size, CMSG_DATA(cm), sizeof(gso_size));
+          if (0 < gso_size && gso_size < len) seg = gso_size;
+        }
+      }
+#endif
+
+      // Copy out small datagrams and coalesced segments so that
+      // the buffer can be reused, otherwise hand over the whole buffer
+      if (seg < len || Data::chunk_size(len) < size) {
+        auto p = (const char *)b.iovecs[i].iov_base;
+        for (int k = 0; k < len && !m_closing; k += seg) {
+          pjs::Ref<Data> data = Data::make(p + k, std::min(seg, len - k), &s_dp);
+          dispatch(data, from);
+        }
+      } else {
+        pjs::Ref<Data> data = Data::make(std::move(b.buffers[i]));
+        data->pop(data->size() - len);
+        dispatch(data, from);
+      }
     }
   }
 
-  if (options.read_timeout > 0) {
-    if (r >= options.read_timeout) {
-      m_socket->m_peers.erase(m_endpoint);
-      m_socket = nullptr;
-      on_peer_input(StreamEnd::make(StreamEnd::READ_TIMEOUT));
-      close();
+  // Give other sockets on this thread a turn
+  receive();
+}
+
+void SocketUDP::send_batch() {
+  auto &b = *m_batch;
+  auto sock = m_socket.native_handle();
+  auto n = b.headers.size();
+
+  while (!b.sends.empty()) {
+    if (m_closing) return;
+
+    // Consecutive datagrams of the same size to the same destination
+    // go out as one GSO message, with only the last one allowed to be shorter
+    size_t m = 0, i = 0;
+    b.iovecs.clear();
+    while (m < n && i < b.sends.size()) {
+      auto &first = b.sends[i];
+      auto seg = first.data->size();
+      auto offset = b.iovecs.size();
+      size_t count = 0, total = 0;
+      for (;;) {
+        auto *data = b.sends[i + count].data;
+        for (const auto c : data->chunks()) {
+          b.iovecs.push_back({ std::get<0>(c), size_t(std::get<1>(c)) });
+        }
+        total += data->size();
+        count++;
+        if (!b.gso || count >= Batch::MAX_SEGMENTS) break;
+        if (i + count >= b.sends.size()) break;
+        if (data->size() != seg) break;
+        auto &next = b.sends[i + count];
+        if (next.data->size() > seg) break;
+        if (next.connected != first.connected) break;
+        if (!first.connected && next.endpoint != first.endpoint) break;
+        if (total + next.data->size() > Batch::MAX_SEGMENTED_SIZE) break;
+      }
+
+      auto &msg = b.headers[m].msg_hdr;
+      std::memset(&msg, 0, sizeof(msg));
+      if (!first.connected) {
+        msg.msg_name = first.endpoint.data();
+        msg.msg_namelen = first.endpoint.size();
+      }
+      msg.msg_iovlen = b.iovecs.size() - offset;
+
+#ifdef UDP_SEGMENT
+      if (count > 1) {
+        msg.msg_control = &b.control[m * Batch::CONTROL_SIZE];
+        msg.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+        auto *cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_UDP;
+        cm->cmsg_type = UDP_SEGMENT;
+        cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        uint16_t gso_size = seg;
+        std::memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+      }
+#endif
+
+      b.offsets[m] = offset;
+      b.counts[m] = count;
+      i += count;
+      m++;
+    }
+
+    for (size_t k = 0; k < m; k++) {
+      b.headers[k].msg_hdr.msg_iov = &b.iovecs[b.offsets[k]];
+    }
+
+    auto r = sendmmsg(sock, b.headers.data(), m, MSG_DONTWAIT);
+    if (r < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (m_batch_writing) return;
+        m_socket.async_wait(udp::socket::wait_write, BatchSendHandler(this));
+        m_batch_writing = true;
+        continue;
+      }
+
+      // No checksum offload on the way out, so segment in user space
+      if (errno == EIO && b.gso) {
+        b.gso = false;
+        continue;
+      }
+
+      InputContext ic(this);
+      log_warn("error writing to peers", std::error_code(errno, std::system_category()));
+      m_closing = true;
+      close_peers(StreamEnd::WRITE_ERROR);
+      close_socket();
+
+      // Called from output() at times, so finish closing from the event loop
+      if (!m_receive_posted) {
+        asio::post(m_socket.get_executor(), BatchPostHandler(this));
+        m_receive_posted = true;
+      }
       return;
     }
+
+    m_tick_write = TimerWheel::get()->now();
+
+    for (int k = 0; k < r; k++) {
+      for (size_t j = 0; j < b.counts[k]; j++) {
+        auto *data = b.sends.front().data;
+        m_sending_size -= data->size();
+        m_sending_count--;
+        m_traffic_write += data->size();
+        data->release();
+        b.sends.pop_front();
+      }
+    }
+
+    auto limit = m_options.congestion_limit;
+    if (limit > 0 && m_sending_size < limit) {
+      m_congestion.end();
+    }
   }
+}
 
-  if (options.write_timeout > 0) {
-    if (w >= options.write_timeout) {
-      m_socket->m_peers.erase(m_endpoint);
+void SocketUDP::on_batch_receive(const std::error_code &ec) {
+  m_receiving = false;
+
+  if (ec != asio::error::operation_aborted && !m_closing) {
+    receive_batch();
+  }
+
+  close_async();
+}
+
+void SocketUDP::on_batch_post() {
+  m_receive_posted = false;
+
+  if (!m_closing) {
+    receive_batch();
+  }
+
+  close_async();
+}
+
+void SocketUDP::on_batch_send(const std::error_code &ec) {
+  m_batch_writing = false;
+
+  if (ec != asio::error::operation_aborted && !m_closing) {
+    send_batch();
+  }
+
+  close_async();
+}
+
+#endif // __linux__
+
+//
+// SocketUDP::Peer
+//
+
+void SocketUDP::Peer::on_expire() {
+  if (auto s = m_socket) {
+    double wait;
+    auto err = s->check_timeout(m_tick_read, m_tick_write, wait);
+    if (err != StreamEnd::NO_ERROR) {
+      s->m_peers.erase(m_endpoint);
       m_socket = nullptr;
-      on_peer_input(StreamEnd::make(StreamEnd::WRITE_TIMEOUT));
+      on_peer_input(StreamEnd::make(err));
       close();
-      return;
+    } else if (wait > 0) {
+      arm(wait);
     }
   }
 }
@@ -832,6 +1596,7 @@ void SocketNetlink::on_receive(Data *data, const std::error_code &ec, std::size_
   if (ec != asio::error::operation_aborted && !m_closing) {
     if (n > 0) {
       data->pop(data->size() - n);
+      data->shrink(&s_dp);
       auto size = data->size();
       m_traffic_read += size;
 
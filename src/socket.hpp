@@ -32,6 +32,10 @@
 #include "data.hpp"
 #include "buffer.hpp"
 #include "timer.hpp"
+#include "io-uring.hpp"
+
+#include <deque>
+#include <memory>
 
 namespace pipy {
 
@@ -44,6 +48,8 @@ public:
   struct Options {
     size_t congestion_limit = 1024*1024;
     size_t buffer_limit = 0;
+    size_t zero_copy_threshold = 0;
+    int batch_size = 0;
     double read_timeout = 0;
     double write_timeout = 0;
     double idle_timeout = 60;
@@ -63,6 +69,8 @@ protected:
   void log_error(const char *msg, const std::error_code &ec);
   void log_error(const char *msg);
 
+  auto check_timeout(uint64_t tick_read, uint64_t tick_write, double &wait) const -> StreamEnd::Error;
+
   bool m_is_inbound;
   const Options& m_options;
   size_t m_traffic_read = 0;
@@ -81,8 +89,18 @@ class SocketTCP :
   public SocketBase,
   public InputSource,
   public FlushTarget,
-  public Ticker::Watcher
+  public TimerWheel::Entry
 {
+public:
+  static auto zero_copy_traffic() -> size_t;
+
+  // Sends that go through kernel TLS can't use MSG_ZEROCOPY
+  void disable_zero_copy() {
+#ifdef __linux__
+    m_zero_copy = false;
+#endif
+  }
+
 protected:
   SocketTCP(bool is_inbound, const Options &options)
     : SocketBase(is_inbound, options)
@@ -97,6 +115,7 @@ protected:
   void open();
   void output(Event *evt);
   void close();
+  void splice(SocketTCP *peer);
 
 private:
   enum State {
@@ -110,10 +129,11 @@ private:
   asio::ip::tcp::socket m_socket;
   Data m_buffer_receive;
   Data m_buffer_send;
+  int m_receive_size = DATA_CHUNK_SIZE_MIN;
   pjs::Ref<StreamEnd> m_eos;
   Congestion m_congestion;
-  double m_tick_read;
-  double m_tick_write;
+  uint64_t m_tick_read;
+  uint64_t m_tick_write;
   State m_state = IDLE;
   bool m_opened = false;
   bool m_receiving = false;
@@ -121,6 +141,80 @@ private:
   bool m_paused = false;
   bool m_closed = false;
 
+#ifdef __linux__
+
+  //
+  // Sends with MSG_ZEROCOPY leave their chunks in m_buffer_zero_copy
+  // until the kernel reports them done on the socket's error queue
+  //
+
+  struct ZeroCopySend {
+    size_t size;
+    bool done;
+  };
+
+  Data m_buffer_zero_copy;
+  std::deque<ZeroCopySend> m_zero_copy_sends;
+  uint32_t m_zero_copy_id = 0;
+  bool m_zero_copy = false;
+  bool m_zero_copy_sending = false;
+  bool m_zero_copy_waiting = false;
+  bool m_zero_copy_lingering = false;
+
+  void zero_copy_wait();
+  void zero_copy_reap();
+  void zero_copy_abort();
+  void on_zero_copy(const std::error_code &ec);
+
+  struct ZeroCopyHandler : public SelfHandler<SocketTCP> {
+    using SelfHandler::SelfHandler;
+    ZeroCopyHandler(const ZeroCopyHandler &r) : SelfHandler(r) {}
+    void operator()(const std::error_code &ec) { self->on_zero_copy(ec); }
+  };
+
+  thread_local static size_t s_zero_copy_traffic;
+
+  //
+  // A spliced socket reads straight into a pipe that is then
+  // drained into the peer socket, without going through any pipeline
+  //
+
+  enum { SPLICE_SIZE = 0x10000 };
+
+  SocketTCP* m_splice_peer = nullptr;
+  int m_splice_pipe[2] = { -1, -1 };
+  size_t m_splice_pipe_size = 0;
+  bool m_splice_reading = false;
+  bool m_splice_writing = false;
+  bool m_splice_posted = false;
+
+  void splice_pump();
+  void splice_unlink();
+  void splice_post();
+  void on_splice_read(const std::error_code &ec);
+  void on_splice_write(const std::error_code &ec);
+  void on_splice_post();
+
+  struct SpliceReadHandler : public SelfHandler<SocketTCP> {
+    using SelfHandler::SelfHandler;
+    SpliceReadHandler(const SpliceReadHandler &r) : SelfHandler(r) {}
+    void operator()(const std::error_code &ec) { self->on_splice_read(ec); }
+  };
+
+  struct SplicePostHandler : public SelfHandler<SocketTCP> {
+    using SelfHandler::SelfHandler;
+    SplicePostHandler(const SplicePostHandler &r) : SelfHandler(r) {}
+    void operator()() { self->on_splice_post(); }
+  };
+
+  struct SpliceWriteHandler : public SelfHandler<SocketTCP> {
+    using SelfHandler::SelfHandler;
+    SpliceWriteHandler(const SpliceWriteHandler &r) : SelfHandler(r) {}
+    void operator()(const std::error_code &ec) { self->on_splice_write(ec); }
+  };
+
+#endif // __linux__
+
   virtual void bind(const std::string &ip, int port) override;
 
   void receive();
@@ -132,9 +226,10 @@ private:
   virtual void on_tap_open() override;
   virtual void on_tap_close() override;
   virtual void on_flush() override;
-  virtual void on_tick(double tick) override;
+  virtual void on_expire() override;
 
   void on_receive(const std::error_code &ec, std::size_t n);
+  void on_receive_end(const std::error_code &ec);
   void on_send(const std::error_code &ec, std::size_t n);
 
   struct ReceiveHandler : public SelfHandler<SocketTCP> {
@@ -149,6 +244,54 @@ private:
     void operator()(const std::error_code &ec, std::size_t n) { self->on_send(ec, n); }
   };
 
+#ifdef PIPY_USE_IO_URING
+
+  //
+  // SocketTCP::RingReceiver
+  //
+
+  class RingReceiver : public IOUring::Request {
+  public:
+    RingReceiver(SocketTCP *s) : m_socket(s) {}
+
+  private:
+    SocketTCP* m_socket;
+
+    virtual void on_complete(int result, bool more, Data *data) override {
+      m_socket->on_ring_receive(result, data);
+    }
+  };
+
+  //
+  // SocketTCP::RingSender
+  //
+
+  class RingSender : public pjs::Pooled<RingSender>, public IOUring::Request {
+  public:
+    enum { MAX_IOVECS = 8 };
+
+    RingSender(SocketTCP *s) : m_socket(s) {}
+
+    auto prepare(const Data &data) -> const msghdr*;
+
+  private:
+    SocketTCP* m_socket;
+    msghdr m_msg;
+    iovec m_iov[MAX_IOVECS];
+
+    virtual void on_complete(int result, bool more, Data *data) override {
+      m_socket->on_ring_send(result);
+    }
+  };
+
+  RingReceiver m_ring_receiver{this};
+  std::unique_ptr<RingSender> m_ring_sender;
+
+  void on_ring_receive(int result, Data *data);
+  void on_ring_send(int result);
+
+#endif // PIPY_USE_IO_URING
+
   static Data::Producer s_dp;
 };
 
@@ -159,7 +302,8 @@ private:
 class SocketUDP :
   public SocketBase,
   public InputSource,
-  public Ticker::Watcher
+  public FlushTarget,
+  public TimerWheel::Entry
 {
 public:
 
@@ -167,7 +311,7 @@ public:
   // SocketUDP::Peer
   //
 
-  class Peer {
+  class Peer : public TimerWheel::Entry {
   public:
     Peer() {}
     ~Peer() { if (auto s = m_socket) s->m_peers.erase(m_endpoint); }
@@ -178,19 +322,19 @@ public:
     auto peer() const -> const asio::ip::udp::endpoint& { return m_endpoint; }
 
   private:
-    void tick(double t);
     void close();
 
     SocketUDP* m_socket = nullptr;
     asio::ip::udp::endpoint m_endpoint;
-    double m_tick_read;
-    double m_tick_write;
+    uint64_t m_tick_read;
+    uint64_t m_tick_write;
     bool m_opened = false;
     bool m_closed = false;
 
     virtual void on_peer_open() = 0;
     virtual void on_peer_input(Event *evt) = 0;
     virtual void on_peer_close() = 0;
+    virtual void on_expire() override;
 
     friend class SocketUDP;
   };
@@ -198,6 +342,7 @@ public:
 protected:
   SocketUDP(bool is_inbound, const Options &options)
     : SocketBase(is_inbound, options)
+    , FlushTarget(true)
     , m_socket(Net::context()) {}
 
   ~SocketUDP();
@@ -220,8 +365,8 @@ private:
   Congestion m_congestion;
   int m_sending_size = 0;
   int m_sending_count = 0;
-  double m_tick_read;
-  double m_tick_write;
+  uint64_t m_tick_read;
+  uint64_t m_tick_write;
   bool m_sending = false;
   bool m_receiving = false;
   bool m_opened = false;
@@ -229,19 +374,60 @@ private:
   bool m_closing = false;
   bool m_closed = false;
 
+#ifdef __linux__
+
+  //
+  // With a batch size above 1, datagrams are moved in batches
+  // with recvmmsg()/sendmmsg() and coalesced by GRO/GSO if available
+  //
+
+  struct Batch;
+
+  Batch* m_batch = nullptr;
+  bool m_receive_posted = false;
+  bool m_batch_writing = false;
+
+  void receive_batch();
+  void send_batch();
+  void on_batch_receive(const std::error_code &ec);
+  void on_batch_post();
+  void on_batch_send(const std::error_code &ec);
+
+  struct BatchReceiveHandler : public SelfHandler<SocketUDP> {
+    using SelfHandler::SelfHandler;
+    BatchReceiveHandler(const BatchReceiveHandler &r) : SelfHandler(r) {}
+    void operator()(const std::error_code &ec) { self->on_batch_receive(ec); }
+  };
+
+  struct BatchPostHandler : public SelfHandler<SocketUDP> {
+    using SelfHandler::SelfHandler;
+    BatchPostHandler(const BatchPostHandler &r) : SelfHandler(r) {}
+    void operator()() { self->on_batch_post(); }
+  };
+
+  struct BatchSendHandler : public SelfHandler<SocketUDP> {
+    using SelfHandler::SelfHandler;
+    BatchSendHandler(const BatchSendHandler &r) : SelfHandler(r) {}
+    void operator()(const std::error_code &ec) { self->on_batch_send(ec); }
+  };
+
+#endif // __linux__
+
   virtual void bind(const std::string &ip, int port) override;
 
   void output(Event *evt, Peer *peer);
   void receive();
   void send(Data *data);
   void send(Data *data, const asio::ip::udp::endpoint &endpoint);
+  void dispatch(Data *data, const asio::ip::udp::endpoint &from);
   void close_peers(StreamEnd::Error err = StreamEnd::Error::NO_ERROR);
   void close_socket();
   void close_async();
 
   virtual void on_tap_open() override;
   virtual void on_tap_close() override;
-  virtual void on_tick(double tick) override;
+  virtual void on_flush() override;
+  virtual void on_expire() override;
 
   void on_receive(Data *data, const std::error_code &ec, std::size_t n);
   void on_send(Data *data, const std::error_code &ec, std::size_t n);
@@ -337,6 +523,7 @@ public:
   auto get_raw_option(int level, int option, Data *data) -> int;
   auto set_raw_option(int level, int option, Data *data) -> int;
   void discard() { m_socket = nullptr; m_fd = 0; }
+  auto fd() const -> int { return m_fd; }
 
 private:
   Socket(SocketBase *s, int fd) : m_socket(s), m_fd(fd) {}
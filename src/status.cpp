@@ -340,6 +340,20 @@ void Status::update_local() {
     }
   }
 
+  // Arena lanes are counted in blocks rather than objects
+  for (int i = 0, n = pjs::Arena::lane_count(); i < n; i++) {
+    auto allocated = pjs::Arena::allocated(i);
+    auto pooled = pjs::Arena::pooled(i);
+    if (allocated + pooled > 0) {
+      pools.insert({
+        pjs::Arena::lane_name(i),
+        pjs::Arena::block_size(i),
+        (size_t)allocated,
+        (size_t)pooled,
+      });
+    }
+  }
+
   for (const auto &i : pjs::Class::all()) {
     static const std::string prefix("pjs::Constructor");
     if (utils::starts_with(i.second->name()->str(), prefix)) continue;
@@ -353,6 +367,7 @@ void Status::update_local() {
       chunks.insert({
         producer->name(),
         producer->count(),
+        producer->size(),
       });
     });
   }
@@ -379,6 +394,7 @@ void Status::update_local() {
         mod->worker() != Worker::current(),
         (int)p->active(),
         (int)p->allocated(),
+        p->inflight(),
       });
     }
   });
@@ -592,7 +608,7 @@ void Status::dump_chunks(Data::Builder &db) {
   for (const auto &i : chunks) {
     rows.push_back({
       i.name,
-      std::to_string(DATA_CHUNK_SIZE * i.count / 1024),
+      std::to_string(i.size / 1024),
     });
   }
   print_table(db, { "DATA", "SIZE(KB)" }, rows);
@@ -612,7 +628,7 @@ void Status::dump_buffers(Data::Builder &db) {
 void Status::dump_pipelines(Data::Builder &db) {
   static const std::string s_draining("Draining");
   static const std::string s_running("Running");
-  std::list<std::array<std::string, 5>> rows;
+  std::list<std::array<std::string, 6>> rows;
   for (const auto &i : pipelines) {
     rows.push_back({
       i.module,
@@ -620,9 +636,10 @@ void Status::dump_pipelines(Data::Builder &db) {
       i.stale ? s_draining : s_running,
       std::to_string(i.allocated),
       std::to_string(i.active),
+      std::to_string(i.inflight),
     });
   }
-  print_table(db, { "MODULE", "PIPELINE", "STATE", "#ALLOCATED", "#ACTIVE" }, rows);
+  print_table(db, { "MODULE", "PIPELINE", "STATE", "#ALLOCATED", "#ACTIVE", "#INFLIGHT" }, rows);
 }
 
 void Status::dump_inbound(Data::Builder &db) {
@@ -694,7 +711,7 @@ void Status::dump_json(Data::Builder &db) {
     db.push('"');
     db.push(i.name);
     db.push("\":");
-    db.push(std::to_string(DATA_CHUNK_SIZE * i.count / 1024));
+    db.push(std::to_string(i.size / 1024));
   }
   db.push("},\"buffers\":{");
   first = true;
@@ -726,6 +743,8 @@ void Status::dump_json(Data::Builder &db) {
     db.push(std::to_string(i.allocated));
     db.push(",\"active\":");
     db.push(std::to_string(i.active));
+    db.push(",\"inflight\":");
+    db.push(std::to_string(i.inflight));
     db.push(",\"stale\":");
     db.push(i.stale ? "true" : "false");
     db.push('}');
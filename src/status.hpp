@@ -99,6 +99,7 @@ public:
   struct ChunkInfo {
     std::string name;
     mutable size_t count;
+    mutable size_t size;
 
     bool operator<(const ChunkInfo &r) const {
       return name < r.name;
@@ -106,6 +107,7 @@ public:
 
     auto operator+=(const ChunkInfo &r) const -> const ChunkInfo& {
       count += r.count;
+      size += r.size;
       return *this;
     }
   };
@@ -116,6 +118,7 @@ public:
     bool stale;
     mutable int active;
     mutable int allocated;
+    mutable int inflight;
 
     bool operator<(const PipelineInfo &r) const {
       if (stale < r.stale) return true;
@@ -128,6 +131,7 @@ public:
     auto operator+=(const PipelineInfo &r) const -> const PipelineInfo& {
       active += r.active;
       allocated += r.allocated;
+      inflight += r.inflight;
       return *this;
     }
   };
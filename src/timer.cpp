@@ -26,83 +26,233 @@
 #include "timer.hpp"
 #include "input.hpp"
 
+#include <cmath>
+#include <limits>
+
 namespace pipy {
 
-thread_local List<Timer> Timer::s_all_timers;
+#ifdef _MSC_VER
+inline static int ctz(uint64_t x) {
+  unsigned long i;
+  _BitScanForward64(&i, x);
+  return i;
+}
+#else
+inline static int ctz(uint64_t x) {
+  return __builtin_ctzll(x);
+}
+#endif
 
-void Timer::cancel_all() {
-  for (auto *timer = s_all_timers.head(); timer; timer = timer->next()) {
-    timer->cancel();
-  }
+//
+// TimerWheel
+//
+
+auto TimerWheel::get() -> TimerWheel* {
+  thread_local static TimerWheel s_wheel;
+  return &s_wheel;
 }
 
-void Timer::schedule(double timeout, const std::function<void()> &handler) {
-  cancel();
-  pjs::Ref<Handler> h = new Handler(handler);
-  m_handler = h;
-  m_timer.expires_after(std::chrono::microseconds((long long)(timeout * 1000000)));
-  m_timer.async_wait(
-    [=](const asio::error_code &ec) {
-      InputContext ic;
-      h->trigger(ec);
+TimerWheel::TimerWheel()
+  : m_timer(Net::context())
+  , m_epoch(std::chrono::steady_clock::now()) {}
+
+TimerWheel::~TimerWheel() {
+  for (int level = 0; level < LEVEL_COUNT; level++) {
+    for (int slot = 0; slot < SLOT_COUNT; slot++) {
+      auto &list = m_slots[level][slot];
+      while (auto *e = list.head()) {
+        list.remove(e);
+        e->m_wheel = nullptr;
+      }
     }
-  );
+  }
+  while (auto *e = m_expiring.head()) {
+    m_expiring.remove(e);
+    e->m_wheel = nullptr;
+  }
 }
 
-void Timer::cancel() {
-  if (m_handler) {
-    asio::error_code ec;
+auto TimerWheel::now() const -> uint64_t {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - m_epoch
+  ).count();
+}
+
+void TimerWheel::add(Entry *e) {
+  auto expires = e->m_expires;
+  if (expires < m_current) expires = m_current;
+
+  auto delta = expires - m_current;
+  int level = 0;
+  while (level < LEVEL_COUNT - 1 && delta >= (uint64_t(1) << ((level + 1) * SLOT_BITS))) level++;
+
+  if (delta >= (uint64_t(1) << (LEVEL_COUNT * SLOT_BITS))) {
+    expires = m_current + (uint64_t(1) << (LEVEL_COUNT * SLOT_BITS)) - 1;
+  }
+
+  auto slot = int(expires >> (level * SLOT_BITS)) & SLOT_MASK;
+  m_slots[level][slot].push(e);
+  m_occupancy[level] |= uint64_t(1) << slot;
+  m_level_counts[level]++;
+  m_count++;
+  e->m_wheel = this;
+  e->m_level = level;
+  e->m_slot = slot;
+}
+
+void TimerWheel::remove(Entry *e) {
+  if (e->m_level < 0) {
+    m_expiring.remove(e);
+  } else {
+    auto level = e->m_level;
+    auto slot = e->m_slot;
+    auto &list = m_slots[level][slot];
+    list.remove(e);
+    if (list.empty()) m_occupancy[level] &= ~(uint64_t(1) << slot);
+    m_level_counts[level]--;
+    m_count--;
+  }
+  e->m_wheel = nullptr;
+  if (!m_count && m_is_scheduled) {
+    std::error_code ec;
     m_timer.cancel(ec);
-    m_handler->cancel();
-    m_handler = nullptr;
+    m_is_scheduled = false;
+  }
+}
+
+void TimerWheel::advance(uint64_t now) {
+  while (m_count > 0) {
+    auto t = next_tick();
+    if (t > now) break;
+    m_current = t;
+    auto slot = int(t & SLOT_MASK);
+    for (int level = 1; level < LEVEL_COUNT; level++) {
+      auto shift = (level - 1) * SLOT_BITS;
+      if ((t >> shift) & SLOT_MASK) break;
+      cascade(level, int(t >> (level * SLOT_BITS)) & SLOT_MASK);
+    }
+    m_current = t + 1;
+    expire(slot);
   }
+  if (now + 1 > m_current) m_current = now + 1;
 }
 
-void Timer::Handler::trigger(const asio::error_code &ec) {
-  if (!m_canceled && ec != asio::error::operation_aborted) {
-    m_handler();
+void TimerWheel::cascade(int level, int slot) {
+  auto &list = m_slots[level][slot];
+  if (list.empty()) return;
+  List<Entry> entries(std::move(list));
+  m_occupancy[level] &= ~(uint64_t(1) << slot);
+  m_level_counts[level] -= entries.size();
+  m_count -= entries.size();
+  while (auto *e = entries.head()) {
+    entries.remove(e);
+    add(e);
   }
 }
 
-void Timer::Handler::cancel() {
-  m_canceled = true;
+void TimerWheel::expire(int slot) {
+  auto &list = m_slots[0][slot];
+  if (list.empty()) return;
+  m_expiring = std::move(list);
+  m_occupancy[0] &= ~(uint64_t(1) << slot);
+  m_level_counts[0] -= m_expiring.size();
+  m_count -= m_expiring.size();
+  for (auto *e = m_expiring.head(); e; e = e->next()) e->m_level = -1;
+  while (auto *e = m_expiring.head()) {
+    m_expiring.remove(e);
+    e->m_wheel = nullptr;
+    InputContext ic;
+    e->on_expire();
+  }
+}
+
+void TimerWheel::schedule() {
+  if (!m_count) return;
+  auto t = next_tick();
+  if (m_is_scheduled && m_scheduled <= t) return;
+  m_scheduled = t;
+  m_is_scheduled = true;
+  m_timer.expires_at(m_epoch + std::chrono::milliseconds(t));
+  m_timer.async_wait(
+    [this](const asio::error_code &ec) {
+      if (ec != asio::error::operation_aborted) {
+        m_is_scheduled = false;
+        advance(now());
+        schedule();
+      }
+    }
+  );
 }
 
 //
-// Ticker
+// Finds the earliest tick when a level-0 slot expires or a
+// higher-level slot needs to cascade down. Slots behind the current
+// position of their level belong to the next round of that level.
 //
 
-auto Ticker::get() -> Ticker* {
-  thread_local static Ticker s_ticker;
-  return &s_ticker;
+auto TimerWheel::next_tick() const -> uint64_t {
+  auto next = std::numeric_limits<uint64_t>::max();
+  for (int level = 0; level < LEVEL_COUNT; level++) {
+    auto bits = m_occupancy[level];
+    if (!bits) continue;
+    auto shift = level * SLOT_BITS;
+    auto unit = uint64_t(1) << shift;
+    auto base = (m_current + unit - 1) >> shift;
+    auto index = int(base & SLOT_MASK);
+    auto ahead = bits >> index;
+    auto n = ahead ? ctz(ahead) : SLOT_COUNT - index + ctz(bits);
+    auto t = (base + n) << shift;
+    if (t < next) next = t;
+  }
+  return next;
 }
 
-void Ticker::start() {
-  if (!m_is_running) {
-    schedule();
-    m_is_running = true;
+//
+// TimerWheel::Entry
+//
+
+void TimerWheel::Entry::arm(double timeout) {
+  auto *wheel = TimerWheel::get();
+  if (m_wheel) m_wheel->remove(this);
+  auto t = wheel->now();
+  if (!wheel->m_count && t > wheel->m_current) wheel->m_current = t;
+  m_expires = t + (timeout > 0 ? uint64_t(std::ceil(timeout * 1000)) : 0);
+  wheel->add(this);
+  wheel->schedule();
+}
+
+void TimerWheel::Entry::disarm() {
+  if (m_wheel) m_wheel->remove(this);
+}
+
+//
+// Timer
+//
+
+thread_local List<Timer> Timer::s_all_timers;
+
+void Timer::cancel_all() {
+  for (auto *timer = s_all_timers.head(); timer; timer = timer->List<Timer>::Item::next()) {
+    timer->cancel();
   }
 }
 
-void Ticker::stop() {
-  if (m_is_running) {
-    m_timer.cancel();
-    m_is_running = false;
+void Timer::schedule(double timeout, const std::function<void()> &handler) {
+  cancel();
+  m_handler = new Handler(handler);
+  TimerWheel::Entry::arm(timeout);
+}
+
+void Timer::cancel() {
+  if (m_handler) {
+    TimerWheel::Entry::disarm();
+    m_handler = nullptr;
   }
 }
 
-void Ticker::schedule() {
-  m_timer.schedule(
-    1, [this]() {
-      auto t = ++m_tick;
-      m_visiting = m_watchers.head();
-      while (auto w = m_visiting) {
-        m_visiting = m_visiting->next();
-        w->on_tick(t);
-      }
-      schedule();
-    }
-  );
+void Timer::on_expire() {
+  pjs::Ref<Handler> h(m_handler);
+  h->trigger();
 }
 
 } // namespace pipy
@@ -31,15 +31,89 @@
 
 namespace pipy {
 
+//
+// TimerWheel
+//
+// One hierarchical timing wheel per Net (i.e. per thread), driven by
+// a single asio::steady_timer. Arming, disarming and expiring an entry
+// are all O(1), so it is cheap enough to give every socket its own entry.
+//
+
+class TimerWheel {
+public:
+  enum {
+    SLOT_BITS = 6,
+    SLOT_COUNT = 1 << SLOT_BITS,
+    SLOT_MASK = SLOT_COUNT - 1,
+    LEVEL_COUNT = 4,
+  };
+
+  //
+  // TimerWheel::Entry
+  //
+
+  class Entry : public List<Entry>::Item {
+  public:
+    ~Entry() { disarm(); }
+
+    bool is_armed() const { return m_wheel; }
+
+    void arm(double timeout);
+    void disarm();
+
+  private:
+    TimerWheel* m_wheel = nullptr;
+    uint64_t m_expires = 0;
+    int m_level = 0;
+    int m_slot = 0;
+
+    virtual void on_expire() = 0;
+
+    friend class TimerWheel;
+  };
+
+  static auto get() -> TimerWheel*;
+
+  TimerWheel();
+  ~TimerWheel();
+
+  auto now() const -> uint64_t;
+  auto count() const -> size_t { return m_count; }
+  auto count(int level) const -> size_t { return m_level_counts[level]; }
+
+private:
+  asio::steady_timer m_timer;
+  std::chrono::steady_clock::time_point m_epoch;
+  List<Entry> m_slots[LEVEL_COUNT][SLOT_COUNT];
+  List<Entry> m_expiring;
+  uint64_t m_occupancy[LEVEL_COUNT] = {};
+  size_t m_level_counts[LEVEL_COUNT] = {};
+  size_t m_count = 0;
+  uint64_t m_current = 0;
+  uint64_t m_scheduled = 0;
+  bool m_is_scheduled = false;
+
+  void add(Entry *e);
+  void remove(Entry *e);
+  void advance(uint64_t now);
+  void cascade(int level, int slot);
+  void expire(int slot);
+  void schedule();
+  auto next_tick() const -> uint64_t;
+};
+
 //
 // Timer
 //
 
-class Timer : public List<Timer>::Item {
+class Timer :
+  public List<Timer>::Item,
+  private TimerWheel::Entry
+{
 public:
   static void cancel_all();
 
-  Timer() : m_timer(Net::context()) {
+  Timer() {
     s_all_timers.push(this);
   }
 
@@ -62,73 +136,17 @@ private:
     Handler(const std::function<void()> &handler)
       : m_handler(handler) {}
 
-    void trigger(const asio::error_code &ec);
-    void cancel();
+    void trigger() { m_handler(); }
 
   private:
     std::function<void()> m_handler;
-    bool m_canceled = false;
   };
 
-  asio::steady_timer m_timer;
   pjs::Ref<Handler> m_handler;
 
-  thread_local static List<Timer> s_all_timers;
-};
-
-//
-// Ticker
-//
-
-class Ticker {
-public:
-
-  //
-  // Ticker::Watcher
-  //
+  virtual void on_expire() override;
 
-  class Watcher : public List<Watcher>::Item {
-    Ticker* m_ticker = nullptr;
-    virtual void on_tick(double tick) = 0;
-    friend class Ticker;
-  };
-
-  static auto get() -> Ticker*;
-
-  double tick() const {
-    return m_tick;
-  }
-
-  void watch(Watcher *w) {
-    if (!w->m_ticker) {
-      m_watchers.push(w);
-      w->m_ticker = this;
-      start();
-    }
-  }
-
-  void unwatch(Watcher *w) {
-    if (w->m_ticker == this) {
-      if (w == m_visiting) {
-        m_visiting = w->next();
-      }
-      m_watchers.remove(w);
-      if (m_watchers.empty()) {
-        stop();
-      }
-    }
-  }
-
-private:
-  List<Watcher> m_watchers;
-  Timer m_timer;
-  Watcher* m_visiting = nullptr;
-  double m_tick = 0;
-  bool m_is_running = false;
-
-  void start();
-  void stop();
-  void schedule();
+  thread_local static List<Timer> s_all_timers;
 };
 
 } // namespace pipy
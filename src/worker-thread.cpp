@@ -26,18 +26,33 @@
 #include "worker-thread.hpp"
 #include "worker.hpp"
 #include "codebase.hpp"
+#include "event-channel.hpp"
 #include "pipeline-lb.hpp"
 #include "timer.hpp"
 #include "api/configuration.hpp"
 #include "api/console.hpp"
 #include "api/pipy.hpp"
 #include "net.hpp"
+#include "os-platform.hpp"
+#include "socket.hpp"
 #include "log.hpp"
 #include "utils.hpp"
 
 namespace pipy {
 
 thread_local WorkerThread* WorkerThread::s_current = nullptr;
+std::vector<int> WorkerThread::s_cpu_affinity;
+bool WorkerThread::s_numa = false;
+
+void WorkerThread::set_cpu_affinity(const std::vector<int> &cpus, bool numa) {
+  s_cpu_affinity = cpus;
+  s_numa = numa;
+}
+
+auto WorkerThread::cpu_of(int index) -> int {
+  if (s_cpu_affinity.empty()) return -1;
+  return s_cpu_affinity[index % s_cpu_affinity.size()];
+}
 
 WorkerThread::WorkerThread(WorkerManager *manager, int index)
   : m_manager(manager)
@@ -162,6 +177,7 @@ void WorkerThread::recycle() {
         for (const auto &p : pjs::Pool::all()) {
           p.second->clean();
         }
+        pjs::Arena::clean();
         m_recycling = false;
       }
     );
@@ -328,6 +344,16 @@ void WorkerThread::init_metrics() {
           name->release();
         }
       }
+      for (int i = 0, n = pjs::Arena::lane_count(); i < n; i++) {
+        if (auto n = pjs::Arena::allocated(i)) {
+          pjs::Str *name = pjs::Str::make(pjs::Arena::lane_name(i))->retain();
+          auto metric = gauge->with_labels(&name, 1);
+          auto size = n * pjs::Arena::block_size(i);
+          metric->set(size);
+          total += size;
+          name->release();
+        }
+      }
       gauge->set(total);
     }
   );
@@ -356,6 +382,16 @@ void WorkerThread::init_metrics() {
           name->release();
         }
       }
+      for (int i = 0, n = pjs::Arena::lane_count(); i < n; i++) {
+        if (auto n = pjs::Arena::pooled(i)) {
+          pjs::Str *name = pjs::Str::make(pjs::Arena::lane_name(i))->retain();
+          auto metric = gauge->with_labels(&name, 1);
+          auto size = n * pjs::Arena::block_size(i);
+          metric->set(size);
+          total += size;
+          name->release();
+        }
+      }
       gauge->set(total);
     }
   );
@@ -412,6 +448,64 @@ void WorkerThread::init_metrics() {
     }
   );
 
+  //
+  // Stats - bytes sent with MSG_ZEROCOPY
+  //
+
+  stats::Counter::make(
+    pjs::Str::make("pipy_tcp_zero_copy_out"),
+    nullptr,
+    [](stats::Counter *counter) {
+      counter->increase(SocketTCP::zero_copy_traffic());
+    }
+  );
+
+  //
+  // Stats - # of events waiting in the cross-thread event channel
+  //
+
+  stats::Gauge::make(
+    pjs::Str::make("pipy_event_channel_depth"),
+    nullptr,
+    [](stats::Gauge *gauge) {
+      gauge->set(EventChannel::current()->depth());
+    }
+  );
+
+  //
+  // Stats - # of wakeups to drain the cross-thread event channel
+  //
+
+  stats::Counter::make(
+    pjs::Str::make("pipy_event_channel_wakeups"),
+    nullptr,
+    [](stats::Counter *counter) {
+      counter->increase(EventChannel::wakeups());
+    }
+  );
+
+  //
+  // Stats - # of timers in each level of the timing wheel
+  //
+
+  label_names->length(1);
+  label_names->set(0, "level");
+
+  stats::Gauge::make(
+    pjs::Str::make("pipy_timer_wheel_occupancy"),
+    label_names,
+    [](stats::Gauge *gauge) {
+      auto *wheel = TimerWheel::get();
+      for (int i = 0; i < TimerWheel::LEVEL_COUNT; i++) {
+        pjs::Ref<pjs::Str> str(pjs::Str::make(std::to_string(i)));
+        pjs::Str *level = str.get();
+        auto metric = gauge->with_labels(&level, 1);
+        metric->set(wheel->count(i));
+      }
+      gauge->set(wheel->count());
+    }
+  );
+
   //
   // Stats - # of pipelines
   //
@@ -450,8 +544,19 @@ void WorkerThread::shutdown_all(bool force) {
   Listener::for_each([&](Listener *l) { l->pipeline_layout(nullptr); return true; });
 }
 
+void WorkerThread::pin() {
+  auto cpu = cpu_of(m_index);
+  if (cpu < 0) return;
+  if (os::pin_thread(cpu, s_numa)) {
+    Log::debug(Log::THREAD, "[thread] Thread %d pinned to CPU %d", m_index, cpu);
+  } else {
+    Log::warn("[thread] Failed pinning thread %d to CPU %d", m_index, cpu);
+  }
+}
+
 void WorkerThread::main() {
   Log::init();
+  pin();
   Pipy::argv(m_manager->m_argv);
 
   pjs::Promise::Period::set_uncaught_exception_handler(
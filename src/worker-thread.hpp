@@ -58,6 +58,8 @@ public:
   ~WorkerThread();
 
   static auto current() -> WorkerThread* { return s_current; }
+  static void set_cpu_affinity(const std::vector<int> &cpus, bool numa);
+  static auto cpu_of(int index) -> int;
 
   auto manager() const -> WorkerManager* { return m_manager; }
   auto index() const -> int { return m_index; }
@@ -106,8 +108,11 @@ private:
   static void shutdown_all(bool force);
 
   void main();
+  void pin();
 
   thread_local static WorkerThread* s_current;
+  static std::vector<int> s_cpu_affinity;
+  static bool s_numa;
 };
 
 //
@@ -346,6 +346,7 @@ auto Worker::load_module(pjs::Module *referer, const std::string &path) -> pjs::
     return nullptr;
   }
 
+  Log::debug(Log::SCRIPT, "[pjs] Folded %d constant nodes in %s", mod->folded_count(), name.c_str());
   return mod;
 }
 
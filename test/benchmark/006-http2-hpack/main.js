@@ -0,0 +1,42 @@
+((
+  //
+  // Client preface followed by 6 HEADERS frames from a browser-style
+  // navigation session on one connection, so both Huffman literals and
+  // the dynamic table are exercised. Every incoming request replays it
+  // through the HTTP/2 decoder before being answered.
+  //
+  session = new Data([
+    '505249202a20485454502f322e300d0a0d0a534d0d0a0d0a00000004000000000000023501050000000182418cf1e3c2',
+    'e5f23a6ba0ab90f4ff878440874148b1275ad1ffb8fe6f4f61e935b4ff3f7de0fe4217bf9fa53f9c473cd4154bd3d87a',
+    '4bfcfdf783f9085efe7e94fe749d3043fe5db07549fcfdf783f97dffe7408b4148b1275ad1ad49e3350582ff01408d41',
+    '48b1275ad1ad5d034ca7b29f87fe739aab7cff3f4092b6b9ac1c8558d520a4b6c2ad617b5a54251f810f7aced07f66a2',
+    '81b0dae053fafc087ed4ce6aadf2a7979c89c6bfb521aeba0bc8b1e632586d975765c53facd8f7e8cff4a506ea553114',
+    '9d4ffda97a7b0f4958085e5c0b817029b8728ec330db2eaecb9f53e5497ca589d34d1f43aeba0c41a4c7a98f33a69a3f',
+    'df9a68fa1d75d0620d263d4c79a68fbed00177fe8d48e62b03ee697e8d48e62b1e0b1d7f46a4731581d754df5f2c7cfd',
+    'f6800bbdf43aeba0c41a4c7a9841a6a8b22c5f249c754c5fbef046cfdf6800bbbf408a4148b4a549275906497f8840e9',
+    '2ac7b0d31aaf408a4148b4a549275a93c85f86a87dcd30d25f408a4148b4a549275ad416cf82ff03408a4148b4a54927',
+    '5a42a13f8690e4b692d49f73929d29ad171863c78f0b97c8e9ae82ae43d2c7508d9bd9abfa5242cb40d25fa523b3519d',
+    '2d4b70ddf45abefb4005dffaf73ad7b4fdf6800bbdf5ee7fbed001777f60e08a61c18a10ae15c2265a6dc75e7c0b85c7',
+    'dd00000003ed44150831ea81a95c1ba4095f8c523457a51b246e37647ca195900c44fb51339692c120ecebf6a4530e28',
+    '6edebf830c18b70570ae171f7400000005d95c2b85c7dd00001132b81702e000002201050000000382cc87448f624391',
+    '0c4c54a4d54cb2123b12593fcccbcac9c8c7c6c5c4c3c2c1c0bf00002501050000000582cd87449261091a4c463a218a',
+    '466a9766510c245fa23fcdcccbcac9c8c7c6c5c4c3c2c1c000002501050000000782ce87449261091a4c460884303aeb',
+    '5de28636a45c8847cecdcccbcac9c8c7c6c5c4c3c2c100002801050000000982cf8744956075998ee160c92d28ff2b1c',
+    'c5805f0837b2c0d83fcfcecdcccbcac9c8c7c6c5c4c3c200001c01050000000b82d08744896251f7310f52e621ffd0cf',
+    'cecdcccbcac9c8c7c6c5c4c3'
+  ].join(''), 'hex'),
+
+) => pipy()
+
+.listen(os.env.LISTEN || 8000)
+.demuxHTTP().to($=>$
+  .fork().to($=>$
+    .replaceMessage(session)
+    .demuxHTTP().to($=>$
+      .replaceMessage(new Message)
+    )
+  )
+  .replaceMessage(new Message('hello'))
+)
+
+)()
@@ -0,0 +1,46 @@
+((
+  //
+  // A gateway-sized routing table with exact, parameterized and
+  // prefix routes spread over 100 virtual hosts. Every incoming
+  // request runs a batch of lookups against it, so the throughput
+  // reflects the lookup latency at the given route count.
+  //
+  routeCount = Number.parseInt(os.env.ROUTES || '20000'),
+  lookupCount = Number.parseInt(os.env.LOOKUPS || '100'),
+
+  router = new algo.URLRouter,
+  samples = [],
+
+) => (
+
+  new Array(routeCount).fill().forEach(
+    (_, i) => {
+      var host = `svc${i % 100}.example.com`
+      var path = `/api/v${i % 7}/res${i}`
+      switch (i % 3) {
+        case 0: router.add(`${host}${path}`, i); break
+        case 1: router.add(`${host}${path}/:id/items/:item`, i); break
+        case 2: router.add(`${host}${path}/*`, i); break
+      }
+      if (i % 10 === 0) samples.push(`${host}${path}/123/items/456?q=1`)
+    }
+  ),
+
+  router.add('/*', -1),
+
+  console.log('URLRouter benchmark with', router.size, 'routes and', lookupCount, 'lookups per request'),
+
+  pipy()
+
+  .listen(os.env.LISTEN || 8000)
+  .serveHTTP(
+    () => {
+      var found = 0
+      for (var i = 0; i < lookupCount; i++) {
+        if (router.find(samples[i % samples.length]) >= 0) found++
+      }
+      return new Message(found.toString())
+    }
+  )
+
+))()
@@ -0,0 +1,45 @@
+((
+  //
+  // A routing handler of the kind commonly found in gateway scripts.
+  // Every incoming request runs the rules a number of times so that
+  // the throughput reflects how fast the script itself executes.
+  // The same script runs under '--script-tier=tree' in 009-script-tree.
+  //
+  iterationCount = Number.parseInt(os.env.ITERATIONS || '100'),
+
+  services = {
+    'api.example.com': { weight: 3, canary: false, prefix: '/api/' },
+    'www.example.com': { weight: 1, canary: true, prefix: '/' },
+  },
+
+  samples = [
+    { method: 'GET', path: '/api/v1/users/123', headers: { host: 'api.example.com' } },
+    { method: 'POST', path: '/api/v1/orders', headers: { host: 'api.example.com', 'x-canary': 'true' } },
+    { method: 'GET', path: '/index.html', headers: { host: 'www.example.com' } },
+    { method: 'GET', path: '/', headers: { host: 'unknown.example.com' } },
+  ],
+
+  route = (head) => {
+    var service = services[head.headers.host]
+    if (!service) return 'default'
+    if (head.headers['x-canary'] === 'true' && service.canary) return 'canary'
+    if (head.path.startsWith(service.prefix) && head.path.length > service.prefix.length) {
+      return head.method === 'GET' ? 'read-' + (head.path.length * service.weight) % 7 : 'write'
+    }
+    return service.weight > 1 && head.method !== 'GET' ? 'heavy' : 'light'
+  },
+
+) => pipy()
+
+  .listen(os.env.LISTEN || 8000)
+  .serveHTTP(
+    () => {
+      var n = 0
+      for (var i = 0; i < iterationCount; i++) {
+        if (route(samples[i % samples.length]) !== 'default') n++
+      }
+      return new Message(n.toString())
+    }
+  )
+
+)()
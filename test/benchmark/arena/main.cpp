@@ -0,0 +1,195 @@
+//
+// Compares allocating message events from the arena with allocating
+// them from the pools, in the patterns a proxy makes them.
+//
+// Both kinds of events are the same apart from being ArenaResident,
+// and are reference-counted the same way as pipy::Event. Heads always
+// come from the pools, as they do in pipy.
+//
+// Build with 'cmake --build . --target arena' and run 'bin/arena [count]'.
+//
+
+#include "pjs/types.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <vector>
+
+using namespace pjs;
+
+template<class Base>
+class Head : public Pooled<Head<Base>>, public RefCount<Head<Base>> {
+public:
+  static auto make() -> Head* { return new Head(); }
+  char fields[160];
+private:
+  void finalize() { delete this; }
+  friend class RefCount<Head>;
+};
+
+template<class Base>
+class Event : public Pooled<Event<Base>, Base>, public RefCount<Event<Base>> {
+public:
+  static auto make(Head<Base> *head) -> Event* { return new Event(head); }
+  Ref<Head<Base>> head;
+  Event* next = nullptr;
+private:
+  Event(Head<Base> *h) : head(h) {}
+  void finalize() { delete this; }
+  friend class RefCount<Event>;
+};
+
+struct Message {
+  std::vector<void*> events;
+};
+
+template<class Base>
+struct Flow {
+  typedef Event<Base> E;
+  typedef Head<Base> H;
+
+  // A message start, a few data-less events and an end, all sharing a head
+  static void make(std::vector<Ref<E>> &msg) {
+    auto *head = H::make();
+    msg.push_back(E::make(head));
+    msg.push_back(E::make(nullptr));
+    msg.push_back(E::make(nullptr));
+    msg.push_back(E::make(head));
+  }
+
+  // Messages released right after they are made
+  static void one_by_one(int n) {
+    std::vector<Ref<E>> msg;
+    for (int i = 0; i < n; i++) {
+      make(msg);
+      msg.clear();
+    }
+  }
+
+  // Many messages in flight, released in the order they came in
+  static void in_flight(int n, int window) {
+    std::deque<std::vector<Ref<E>>> queue;
+    for (int i = 0; i < n; i++) {
+      queue.emplace_back();
+      make(queue.back());
+      if ((int)queue.size() > window) queue.pop_front();
+    }
+  }
+
+  // Like in_flight, but every 100th head is kept around by a script
+  static void retained_heads(int n, int window, std::vector<Ref<H>> &kept) {
+    std::deque<std::vector<Ref<E>>> queue;
+    for (int i = 0; i < n; i++) {
+      queue.emplace_back();
+      make(queue.back());
+      if (i % 100 == 0) kept.push_back(queue.back().front()->head.get());
+      if ((int)queue.size() > window) queue.pop_front();
+    }
+  }
+
+  // Like in_flight, but every 100th message start is kept for a long-lived
+  // session, as websocket and mux sessions do
+  static void retained_events(int n, int window, std::vector<Ref<E>> &kept) {
+    std::deque<std::vector<Ref<E>>> queue;
+    for (int i = 0; i < n; i++) {
+      queue.emplace_back();
+      make(queue.back());
+      if (i % 100 == 0) kept.push_back(queue.back().front());
+      if ((int)queue.size() > window) queue.pop_front();
+    }
+  }
+};
+
+template<class F>
+static double measure(int rounds, const F &f) {
+  double best = 0;
+  for (int i = 0; i < rounds; i++) {
+    auto t0 = std::chrono::steady_clock::now();
+    f();
+    auto t1 = std::chrono::steady_clock::now();
+    auto t = std::chrono::duration<double>(t1 - t0).count();
+    if (i == 0 || t < best) best = t;
+  }
+  return best;
+}
+
+static auto arena_bytes() -> size_t {
+  size_t n = 0;
+  for (int i = 0; i < Arena::lane_count(); i++) {
+    n += Arena::allocated(i) * Arena::block_size(i);
+  }
+  return n;
+}
+
+static auto pool_bytes() -> size_t {
+  size_t n = 0;
+  for (const auto &i : Pool::all()) {
+    n += i.second->allocated() * i.second->size();
+  }
+  return n;
+}
+
+int main(int argc, char *argv[]) {
+  int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+  int rounds = 5;
+
+  typedef Flow<DefaultPooledBase> P;
+  typedef Flow<ArenaResident> A;
+
+  auto report = [&](const char *name, double tp, double ta) {
+    std::printf(
+      "%-12s pool %7.2f ns/msg   arena %7.2f ns/msg   %+.1f%%\n",
+      name, tp * 1e9 / n, ta * 1e9 / n, (tp - ta) * 100 / tp
+    );
+  };
+
+  report(
+    "one-by-one",
+    measure(rounds, [&]() { P::one_by_one(n); }),
+    measure(rounds, [&]() { A::one_by_one(n); })
+  );
+
+  report(
+    "in-flight",
+    measure(rounds, [&]() { P::in_flight(n, 1000); }),
+    measure(rounds, [&]() { A::in_flight(n, 1000); })
+  );
+
+  // Memory in use by all events and heads while some of them are kept
+  auto footprint = [&](const char *name, size_t bp, size_t ba) {
+    std::printf(
+      "%-12s pool %7zu KiB       arena %7zu KiB\n",
+      name, bp / 1024, ba / 1024
+    );
+  };
+
+  {
+    std::vector<Ref<P::H>> kept_p;
+    std::vector<Ref<A::H>> kept_a;
+    auto tp = measure(rounds, [&]() { kept_p.clear(); P::retained_heads(n, 1000, kept_p); });
+    auto bp = pool_bytes() + arena_bytes();
+    kept_p.clear();
+    auto ta = measure(rounds, [&]() { kept_a.clear(); A::retained_heads(n, 1000, kept_a); });
+    auto ba = pool_bytes() + arena_bytes();
+    kept_a.clear();
+    report("kept-heads", tp, ta);
+    footprint("", bp, ba);
+  }
+
+  {
+    std::vector<Ref<P::E>> kept_p;
+    std::vector<Ref<A::E>> kept_a;
+    auto tp = measure(rounds, [&]() { kept_p.clear(); P::retained_events(n, 1000, kept_p); });
+    auto bp = pool_bytes() + arena_bytes();
+    kept_p.clear();
+    auto ta = measure(rounds, [&]() { kept_a.clear(); A::retained_events(n, 1000, kept_a); });
+    auto ba = pool_bytes() + arena_bytes();
+    kept_a.clear();
+    report("kept-events", tp, ta);
+    footprint("", bp, ba);
+  }
+
+  return 0;
+}
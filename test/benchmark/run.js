@@ -31,6 +31,15 @@ fs.readdirSync(currentDir, { withFileTypes: true })
     if (!isNaN(n)) allTests[n] = ent.name;
   });
 
+function testArgs(name) {
+  const dir = join(currentDir, name);
+  const argsFile = join(dir, 'args');
+  if (!fs.existsSync(argsFile)) return [ join(dir, 'main.js') ];
+  return fs.readFileSync(argsFile, 'utf8').trim().split(/\s+/).map(
+    arg => arg.endsWith('.js') ? join(dir, arg) : arg
+  );
+}
+
 async function summary() {
   const sysinfo = [];
   const collectSysinfo = (info, depth) => {
@@ -108,9 +117,8 @@ async function start(id) {
       for (const i in allTests) {
         const name = allTests[i];
         const port = 8000 + (i|0);
-        const path = join(currentDir, name, 'main.js');
         log('Starting', chalk.magenta(name), '...');
-        procs.push(await startPipy([ path ], { LISTEN: `0.0.0.0:${port}` }));
+        procs.push(await startPipy(testArgs(name), { LISTEN: `0.0.0.0:${port}` }));
       }
 
       await benchmark('baseline', 8000);
@@ -125,9 +133,8 @@ async function start(id) {
 
     } else if (id in allTests) {
       const name = allTests[id];
-      const path = join(currentDir, name, 'main.js');
       log('Starting', chalk.magenta(name), '...');
-      procs.push(await startPipy([ path ], { LISTEN: '0.0.0.0:8001' }));
+      procs.push(await startPipy(testArgs(name), { LISTEN: '0.0.0.0:8001' }));
       await benchmark('baseline', 8000);
       await benchmark(name, 8001);
       await summary();
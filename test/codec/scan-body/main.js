@@ -0,0 +1,37 @@
+var found = {}
+
+var plain = new algo.MultiMatcher(['needle', 'stack', 'needle', 'haystack'])
+var caseless = new algo.MultiMatcher(['Needle', 'STACK', 'needle'], { ignoreCase: true })
+
+// Patterns covering all 256 byte values
+var bytes = new algo.MultiMatcher(
+  new Array(256).fill(0).map((_, i) => new Data([i, (i + 1) & 255]))
+)
+
+pipy.read('input', $=>$
+  .split('\n')
+  .replaceMessage(
+    msg => {
+      var body = msg.body
+      return [
+        new MessageStart,
+        ...new Array(Math.ceil(body.size / 3)).fill(0).map(() => body.shift(3)),
+        new MessageEnd,
+      ]
+    }
+  )
+  .scanMessageBody(plain, list => found.plain = list)
+  .scanMessageBody(caseless, list => found.caseless = list)
+  .scanMessageBody(() => bytes, list => found.bytes = list)
+  .replaceMessage(
+    msg => new Message(
+      [
+        msg.body.toString('hex'),
+        JSON.stringify(found.plain),
+        JSON.stringify(found.caseless),
+        JSON.stringify(found.bytes),
+      ].join(' ') + '\n'
+    )
+  )
+  .tee('-')
+)
@@ -0,0 +1,34 @@
+//
+// Runs every case in cases.json through RegExp and the String methods
+// taking a RegExp, and prints one line of results per case. run.js does
+// the same in node and compares the output line by line.
+//
+
+var cases = JSON.parse(pipy.load('cases.json').toString())
+
+function evaluate(pattern, flags, input) {
+  var execs = []
+  var re = new RegExp(pattern, flags)
+  for (var i = 0; i < 3; i++) {
+    var m = re.exec(input)
+    execs.push(m)
+    if (!m || flags.indexOf('g') < 0) break
+  }
+  return JSON.stringify([
+    execs,
+    new RegExp(pattern, flags).test(input),
+    input.match(new RegExp(pattern, 'g' + flags.replace('g', ''))),
+    input.replace(new RegExp(pattern, 'g' + flags.replace('g', '')), '[$&|$1]'),
+    input.split(new RegExp(pattern, flags)),
+  ])
+}
+
+pipy.read('cases.json', $=>$
+  .replaceStreamStart(evt => [new MessageStart, evt])
+  .replaceMessage(
+    () => new Message(
+      cases.map(c => evaluate(c[0], c[1], c[2])).join('\n') + '\n'
+    )
+  )
+  .tee('-')
+)
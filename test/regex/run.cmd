@@ -0,0 +1,3 @@
+@echo off
+
+node run.js %*
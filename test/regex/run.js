@@ -0,0 +1,70 @@
+#!/usr/bin/env node
+
+import os from 'os';
+import fs from 'fs';
+import url from 'url';
+import chalk from 'chalk';
+
+import { spawn } from 'child_process';
+import { join, dirname } from 'path';
+
+const log = console.log;
+const error = (...args) => log.apply(this, [chalk.bgRed('ERROR')].concat(args.map(a => chalk.red(a))));
+const currentDir = dirname(url.fileURLToPath(import.meta.url));
+const pipyBinName = os.platform() === 'win32' ? '..\\..\\bin\\Release\\pipy.exe' : '../../bin/pipy';
+const pipyBinPath = join(currentDir, pipyBinName);
+
+//
+// Same as evaluate() in main.js, with unmatched groups turned into
+// empty strings as PipyJS does
+//
+
+function evaluate(pattern, flags, input) {
+  const strings = a => a && Array.from(a, s => s === undefined ? '' : s);
+  const execs = [];
+  const re = new RegExp(pattern, flags);
+  for (let i = 0; i < 3; i++) {
+    const m = re.exec(input);
+    execs.push(strings(m));
+    if (!m || flags.indexOf('g') < 0) break;
+  }
+  return JSON.stringify([
+    execs,
+    new RegExp(pattern, flags).test(input),
+    input.match(new RegExp(pattern, 'g' + flags.replace('g', ''))),
+    input.replace(new RegExp(pattern, 'g' + flags.replace('g', '')), '[$&|$1]'),
+    strings(input.split(new RegExp(pattern, flags))),
+  ]);
+}
+
+function runPipy() {
+  return new Promise((resolve, reject) => {
+    const stdout = [];
+    const proc = spawn(pipyBinPath, ['--no-graph', '--log-level=error', 'main.js'], { cwd: currentDir });
+    proc.stdout.on('data', data => stdout.push(data));
+    proc.stderr.on('data', data => process.stderr.write(data));
+    proc.on('error', reject);
+    proc.on('exit', () => resolve(Buffer.concat(stdout).toString()));
+  });
+}
+
+const cases = JSON.parse(fs.readFileSync(join(currentDir, 'cases.json'), 'utf8'));
+const expected = cases.map(c => evaluate(c[0], c[1], c[2]));
+const actual = (await runPipy()).split('\n');
+
+let failed = 0;
+cases.forEach((c, i) => {
+  if (actual[i] !== expected[i]) {
+    failed++;
+    error(`/${c[0]}/${c[1]} on ${JSON.stringify(c[2])}`);
+    log('  expected:', expected[i]);
+    log('  actual:  ', actual[i]);
+  }
+});
+
+if (failed > 0) {
+  error(`${failed} of ${cases.length} cases failed`);
+  process.exit(-1);
+}
+
+log(`All ${cases.length} cases passed`);